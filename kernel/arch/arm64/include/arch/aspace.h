@@ -34,6 +34,7 @@ public:
     zx_status_t Protect(vaddr_t vaddr, size_t count, uint mmu_flags) override;
 
     zx_status_t Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) override;
+    size_t LargePageBytes(vaddr_t vaddr, size_t count) override;
 
     vaddr_t PickSpot(vaddr_t base, uint prev_region_mmu_flags,
                      vaddr_t end, uint next_region_mmu_flags,
@@ -86,7 +87,10 @@ private:
     zx_status_t ProtectPages(vaddr_t vaddr, size_t size, pte_t attrs,
                              vaddr_t vaddr_base, uint top_size_shift,
                              uint top_index_shift, uint page_size_shift) TA_REQ(lock_);
-    zx_status_t QueryLocked(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) TA_REQ(lock_);
+    // If |size_shift| is not null it is set to the log2 of the size of the page or
+    // block that maps |vaddr|.
+    zx_status_t QueryLocked(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags,
+                            uint* size_shift = nullptr) TA_REQ(lock_);
 
     void FlushTLBEntry(vaddr_t vaddr, bool terminal) TA_REQ(lock_);
 
@@ -297,7 +297,36 @@ zx_status_t ArmArchVmAspace::Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flag
     return QueryLocked(vaddr, paddr, mmu_flags);
 }
 
-zx_status_t ArmArchVmAspace::QueryLocked(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) {
+size_t ArmArchVmAspace::LargePageBytes(vaddr_t vaddr, size_t count) {
+    if (count == 0 || !IsValidVaddr(vaddr))
+        return 0;
+
+    const vaddr_t last = vaddr + (count * PAGE_SIZE - 1);
+    size_t bytes = 0;
+
+    fbl::AutoLock a(&lock_);
+
+    // Blocks are naturally aligned and no smaller than LARGE_PAGE_SIZE, so one
+    // lookup per LARGE_PAGE_SIZE is enough to find them all.
+    for (;;) {
+        size_t block_size = LARGE_PAGE_SIZE;
+        uint size_shift;
+        if (QueryLocked(vaddr, nullptr, nullptr, &size_shift) == ZX_OK &&
+            size_shift > PAGE_SIZE_SHIFT) {
+            block_size = 1UL << size_shift;
+            bytes += MIN(last, ROUNDDOWN(vaddr, block_size) + (block_size - 1)) - vaddr + 1;
+        }
+        const vaddr_t next = ROUNDDOWN(vaddr, block_size) + block_size;
+        if (next - 1 >= last)
+            break;
+        vaddr = next;
+    }
+
+    return bytes;
+}
+
+zx_status_t ArmArchVmAspace::QueryLocked(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags,
+                                         uint* size_shift) {
     ulong index;
     uint index_shift;
     uint page_size_shift;
@@ -373,6 +402,8 @@ zx_status_t ArmArchVmAspace::QueryLocked(vaddr_t vaddr, paddr_t* paddr, uint* mm
 
     if (paddr)
         *paddr = pte_addr + vaddr_rem;
+    if (size_shift)
+        *size_shift = index_shift;
     if (mmu_flags) {
         *mmu_flags = 0;
         if (flags_ & ARCH_ASPACE_FLAG_GUEST) {
@@ -1155,6 +1186,11 @@ void arch_zero_page(void* _ptr) {
     } while (ptr != end_ptr);
 }
 
+void arch_zero_page_nontemporal(void* ptr) {
+    // dc zva zeroes whole blocks without reading them in first, there is nothing better to use
+    arch_zero_page(ptr);
+}
+
 zx_status_t arm64_mmu_translate(vaddr_t va, paddr_t* pa, bool user, bool write) {
     // disable interrupts around this operation to make the at/par instruction combination atomic
     spin_lock_saved_state_t state;
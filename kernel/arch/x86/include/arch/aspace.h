@@ -44,6 +44,7 @@ private:
     void TlbInvalidate(PendingTlbInvalidation* pending) final;
     uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) final;
     bool needs_cache_flushes() final { return false; }
+    PtFlags accessed_flag() final;
 
     // If true, all mappings will have the global bit set.
     bool use_global_mappings_ = false;
@@ -66,6 +67,7 @@ private:
     void TlbInvalidate(PendingTlbInvalidation* pending) final;
     uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) final;
     bool needs_cache_flushes() final { return false; }
+    PtFlags accessed_flag() final;
 };
 
 class X86ArchVmAspace final : public ArchVmAspaceInterface {
@@ -85,6 +87,12 @@ public:
     zx_status_t Unmap(vaddr_t vaddr, size_t count, size_t* unmapped) override;
     zx_status_t Protect(vaddr_t vaddr, size_t count, uint mmu_flags) override;
     zx_status_t Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) override;
+    size_t LargePageBytes(vaddr_t vaddr, size_t count) override;
+    zx_status_t HarvestAccessed(vaddr_t vaddr, size_t count,
+                                arch_accessed_fn_t accessed_fn, void* context) override;
+
+    void BeginTlbBatch() override { pt_->BeginTlbBatch(); }
+    void EndTlbBatch() override { pt_->EndTlbBatch(); }
 
     vaddr_t PickSpot(vaddr_t base, uint prev_region_mmu_flags,
                      vaddr_t end, uint next_region_mmu_flags,
@@ -96,6 +104,19 @@ public:
 
     int active_cpus() { return active_cpus_.load(); }
 
+    // CPUs whose TLB may still hold entries tagged with this aspace's PCID,
+    // whether or not they are currently executing in it. Only maintained when
+    // PCIDs are in use.
+    int tlb_cpus() { return tlb_cpus_.load(); }
+    void clear_tlb_cpu(int cpu_bit) { tlb_cpus_.fetch_and(~cpu_bit); }
+    // Drop every CPU not in |keep| from tlb_cpus(), so that they flush this
+    // aspace's PCID when they next switch to it.  Returns the CPUs that were
+    // in tlb_cpus() before.
+    int drop_tlb_cpus(int keep) { return tlb_cpus_.fetch_and(keep); }
+
+    // The PCID this aspace was last assigned, or 0 if it has none.
+    uint16_t pcid() const;
+
     IoBitmap& io_bitmap() { return io_bitmap_; }
 
     static void ContextSwitch(X86ArchVmAspace* from, X86ArchVmAspace* to);
@@ -129,6 +150,18 @@ private:
     // CPUs that are currently executing in this aspace.
     // Actually an mp_cpu_mask_t, but header dependencies.
     fbl::atomic_int active_cpus_{0};
+
+    // See tlb_cpus().
+    fbl::atomic_int tlb_cpus_{0};
+
+    // The PCID assigned to this aspace in the low bits and the generation it
+    // was assigned in above them, or 0 if it has never been assigned one.
+    fbl::atomic<uint64_t> pcid_state_{0};
+
+    // Make sure this aspace has a PCID that is valid in the current
+    // generation, flushing this CPU's TLB if it was last flushed in an
+    // earlier one, and return it.
+    uint16_t ActivatePcid();
 };
 
 using ArchVmAspace = X86ArchVmAspace;
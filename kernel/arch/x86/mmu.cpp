@@ -5,6 +5,7 @@
 // https://opensource.org/licenses/MIT
 
 #include <assert.h>
+#include <debug.h>
 #include <err.h>
 #include <string.h>
 #include <trace.h>
@@ -16,7 +17,11 @@
 #include <arch/x86/feature.h>
 #include <arch/x86/mmu.h>
 #include <arch/x86/mmu_mem_types.h>
+#include <arch/x86/mp.h>
+#include <fbl/atomic.h>
+#include <kernel/cmdline.h>
 #include <kernel/mp.h>
+#include <lib/counters.h>
 #include <new>
 #include <vm/arch_vm_aspace.h>
 #include <vm/physmap.h>
@@ -34,6 +39,20 @@ uint8_t g_paddr_width = 32;
 /* True if the system supports 1GB pages */
 static bool supports_huge_pages = false;
 
+/* True if user address spaces are tagged with PCIDs, see X86ArchVmAspace::ActivatePcid() */
+static bool use_pcid = false;
+
+/* PCIDs handed out so far. PCID 0 is left to the kernel aspace, so each generation
+ * gives out kPcidsPerGeneration of them before they are all recycled. */
+static constexpr uint64_t kPcidsPerGeneration = X86_CR3_PCID_MASK;
+static fbl::atomic<uint64_t> pcids_assigned{0};
+
+KCOUNTER(tlb_shootdowns, "kernel.x86.tlb.shootdowns");
+KCOUNTER(tlb_full_shootdowns, "kernel.x86.tlb.full_shootdowns");
+KCOUNTER(tlb_pages_invalidated, "kernel.x86.tlb.pages_invalidated");
+KCOUNTER(tlb_ipis, "kernel.x86.tlb.ipis");
+KCOUNTER(tlb_lazy_cpus, "kernel.x86.tlb.lazy_cpus");
+
 /* top level kernel page tables, initialized in start.S */
 volatile pt_entry_t pml4[NO_OF_PT_ENTRIES] __ALIGNED(PAGE_SIZE);
 volatile pt_entry_t pdp[NO_OF_PT_ENTRIES] __ALIGNED(PAGE_SIZE); /* temporary */
@@ -137,18 +156,75 @@ static void x86_tlb_nonglobal_invalidate() {
     x86_set_cr3(x86_get_cr3());
 }
 
+/* INVPCID invalidation types, see Intel 3A section 4.10.4.1 */
+enum class InvpcidType : uint64_t {
+    kAddress = 0,
+    kSingleContext = 1,
+    kAllContextsAndGlobals = 2,
+    kAllContexts = 3,
+};
+
+static void x86_invpcid(InvpcidType type, uint16_t pcid, vaddr_t addr) {
+    struct {
+        uint64_t pcid;
+        uint64_t addr;
+    } desc = {pcid, addr};
+    __asm__ volatile("invpcid %0, %1" ::"m"(desc), "r"(static_cast<uint64_t>(type))
+                     : "memory");
+}
+
+/* Call |func| with each address a pending invalidation covers */
+template <typename F>
+static void x86_for_each_pending_addr(const PendingTlbInvalidation* pending, F func) {
+    if (pending->use_range) {
+        for (vaddr_t va = pending->range_start; va < pending->range_end; va += PAGE_SIZE) {
+            func(va);
+        }
+        return;
+    }
+    for (uint i = 0; i < pending->count; ++i) {
+        const auto& item = pending->item[i];
+        switch (item.page_level()) {
+            case PML4_L:
+                panic("PML4_L invld found; should not be here\n");
+            case PDP_L:
+            case PD_L:
+            case PT_L:
+                func(item.addr());
+                break;
+        }
+    }
+}
+
 /* Task used for invalidating a TLB entry on each CPU */
 struct TlbInvalidatePage_context {
     ulong target_cr3;
+    // The target aspace's PCID, or 0 if it doesn't have one.
+    uint16_t target_pcid;
+    X86ArchVmAspace* aspace;
     const PendingTlbInvalidation* pending;
 };
 static void TlbInvalidatePage_task(void* raw_context) {
     DEBUG_ASSERT(arch_ints_disabled());
     TlbInvalidatePage_context* context = (TlbInvalidatePage_context*)raw_context;
 
-    ulong cr3 = x86_get_cr3();
+    ulong cr3 = x86_get_cr3() & X86_CR3_BASE_MASK;
     if (context->target_cr3 != cr3 && !context->pending->contains_global) {
-        /* This invalidation doesn't apply to this CPU, ignore it */
+        if (context->target_pcid == 0) {
+            /* This invalidation doesn't apply to this CPU, ignore it */
+            return;
+        }
+
+        /* This CPU isn't running in the aspace, but its TLB may still hold
+         * entries tagged with the aspace's PCID from when it last did. */
+        if (context->pending->full_shootdown) {
+            x86_invpcid(InvpcidType::kSingleContext, context->target_pcid, 0);
+            context->aspace->clear_tlb_cpu(cpu_num_to_mask(arch_curr_cpu_num()));
+            return;
+        }
+        x86_for_each_pending_addr(context->pending, [context](vaddr_t va) {
+            x86_invpcid(InvpcidType::kAddress, context->target_pcid, va);
+        });
         return;
     }
 
@@ -161,18 +237,9 @@ static void TlbInvalidatePage_task(void* raw_context) {
         return;
     }
 
-    for (uint i = 0; i < context->pending->count; ++i) {
-        const auto& item = context->pending->item[i];
-        switch (item.page_level()) {
-            case PML4_L:
-                panic("PML4_L invld found; should not be here\n");
-            case PDP_L:
-            case PD_L:
-            case PT_L:
-                __asm__ volatile("invlpg %0" ::"m"(*(uint8_t*)item.addr()));
-                break;
-        }
-    }
+    x86_for_each_pending_addr(context->pending, [](vaddr_t va) {
+        __asm__ volatile("invlpg %0" ::"m"(*(uint8_t*)va));
+    });
 }
 
 /**
@@ -182,28 +249,57 @@ static void TlbInvalidatePage_task(void* raw_context) {
  * @param pending The planned invalidation
  */
 static void x86_tlb_invalidate_page(const X86PageTableBase* pt, PendingTlbInvalidation* pending) {
-    if (pending->count == 0) {
+    if (pending->is_empty()) {
         return;
     }
 
-    ulong cr3 = pt ? pt->phys() : x86_get_cr3();
+    ulong cr3 = pt ? pt->phys() : x86_get_cr3() & X86_CR3_BASE_MASK;
+    X86ArchVmAspace* aspace = pt ? static_cast<X86ArchVmAspace*>(pt->ctx()) : nullptr;
     struct TlbInvalidatePage_context task_context = {
-        .target_cr3 = cr3, .pending = pending,
+        .target_cr3 = cr3,
+        .target_pcid = aspace ? aspace->pcid() : static_cast<uint16_t>(0),
+        .aspace = aspace,
+        .pending = pending,
     };
 
     /* Target only CPUs this aspace is active on.  It may be the case that some
      * other CPU will become active in it after this load, or will have left it
      * just before this load.  In the former case, it is becoming active after
      * the write to the page table, so it will see the change.  In the latter
-     * case, it will get a spurious request to flush. */
+     * case, it will get a spurious request to flush.
+     *
+     * With PCIDs, CPUs that have left the aspace keep its TLB entries around
+     * for when they return.  Rather than interrupting them, they are dropped
+     * from the aspace's tlb_cpus(), which makes them flush the PCID when they
+     * switch back in.  A CPU that switched in after |active| was loaded may
+     * have seen its tlb_cpus() bit still set, so the active set is reloaded
+     * once the bits are dropped, and every CPU in either load is targeted. */
     mp_ipi_target_t target;
     cpu_mask_t target_mask = 0;
     if (pending->contains_global || pt == nullptr) {
         target = MP_IPI_TARGET_ALL;
+        target_mask = mp_get_online_mask();
+    } else if (task_context.target_pcid != 0) {
+        target = MP_IPI_TARGET_MASK;
+        cpu_mask_t active = aspace->active_cpus();
+        cpu_mask_t lazy = aspace->drop_tlb_cpus(active);
+        target_mask = active | aspace->active_cpus();
+        kcounter_add(tlb_lazy_cpus, __builtin_popcount(lazy & ~target_mask));
     } else {
         target = MP_IPI_TARGET_MASK;
-        target_mask = static_cast<X86ArchVmAspace*>(pt->ctx())->active_cpus();
+        target_mask = aspace->active_cpus();
+    }
+
+    kcounter_add(tlb_shootdowns, 1);
+    if (pending->full_shootdown) {
+        kcounter_add(tlb_full_shootdowns, 1);
+    } else {
+        kcounter_add(tlb_pages_invalidated, pending->page_count());
     }
+    // Approximate, since this thread may move to another CPU before the IPIs
+    // are sent.
+    kcounter_add(tlb_ipis,
+                 __builtin_popcount(target_mask & ~cpu_num_to_mask(arch_curr_cpu_num())));
 
     mp_sync_exec(target, target_mask, TlbInvalidatePage_task, &task_context);
     pending->clear();
@@ -355,6 +451,15 @@ uint X86PageTableMmu::pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level)
     return mmu_flags;
 }
 
+X86PageTableBase::PtFlags X86PageTableMmu::accessed_flag() {
+    return X86_MMU_PG_A;
+}
+
+// The EPT accessed and dirty flags are not enabled.
+X86PageTableBase::PtFlags X86PageTableEpt::accessed_flag() {
+    return 0;
+}
+
 bool X86PageTableEpt::allowed_flags(uint flags) {
     if (!(flags & ARCH_MMU_FLAG_PERM_READ)) {
         return false;
@@ -494,7 +599,19 @@ void x86_mmu_early_init() {
     LTRACEF("paddr_width %u vaddr_width %u\n", g_paddr_width, g_vaddr_width);
 }
 
-void x86_mmu_init(void) {}
+void x86_mmu_init(void) {
+    // PCIDs are only worth it if stale entries can be dropped from other
+    // CPUs without switching to the aspace, which needs INVPCID.
+    use_pcid = x86_feature_test(X86_FEATURE_PCID) && x86_feature_test(X86_FEATURE_INVPCID) &&
+               cmdline_get_bool("kernel.x86.pcid", true);
+    dprintf(INFO, "x86: PCIDs %s\n", use_pcid ? "enabled" : "disabled");
+
+    // the other CPUs are brought up later and pick this up in x86_mmu_percpu_init()
+    if (use_pcid) {
+        DEBUG_ASSERT((x86_get_cr3() & X86_CR3_PCID_MASK) == 0);
+        x86_set_cr4(x86_get_cr4() | X86_CR4_PCIDE);
+    }
+}
 
 X86PageTableBase::X86PageTableBase() {
 }
@@ -641,9 +758,63 @@ zx_status_t X86ArchVmAspace::Protect(vaddr_t vaddr, size_t count, uint mmu_flags
     return pt_->ProtectPages(vaddr, count, mmu_flags);
 }
 
+uint16_t X86ArchVmAspace::pcid() const {
+    return static_cast<uint16_t>(pcid_state_.load(fbl::memory_order_relaxed) & X86_CR3_PCID_MASK);
+}
+
+uint16_t X86ArchVmAspace::ActivatePcid() {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    // PCIDs are handed out in order, and once they run out every aspace has
+    // to get a new one. An aspace's PCID is only valid in the generation it
+    // was handed out in.
+    const uint64_t generation = pcids_assigned.load() / kPcidsPerGeneration + 1;
+    uint64_t state = pcid_state_.load();
+    if ((state >> 12) != generation) {
+        const uint64_t n = pcids_assigned.fetch_add(1);
+        const uint64_t new_state =
+            ((n / kPcidsPerGeneration + 1) << 12) | (n % kPcidsPerGeneration + 1);
+
+        // another CPU switching into this aspace may have beaten us to it, in
+        // which case our PCID goes unused
+        if (pcid_state_.compare_exchange_strong(&state, new_state, fbl::memory_order_seq_cst,
+                                                fbl::memory_order_seq_cst)) {
+            state = new_state;
+        }
+    }
+
+    // the previous generation's PCIDs are being handed out again, so entries
+    // this CPU cached for their previous owners have to go
+    x86_percpu* percpu = x86_get_percpu();
+    if (percpu->pcid_generation != (state >> 12)) {
+        x86_invpcid(InvpcidType::kAllContexts, 0, 0);
+        percpu->pcid_generation = state >> 12;
+    }
+
+    return static_cast<uint16_t>(state & X86_CR3_PCID_MASK);
+}
+
 void X86ArchVmAspace::ContextSwitch(X86ArchVmAspace* old_aspace, X86ArchVmAspace* aspace) {
     cpu_mask_t cpu_bit = cpu_num_to_mask(arch_curr_cpu_num());
-    if (aspace != nullptr) {
+    if (aspace != nullptr && use_pcid) {
+        aspace->canary_.Assert();
+        uint16_t pcid = aspace->ActivatePcid();
+        paddr_t phys = aspace->pt_phys();
+        LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR ", pcid %u\n",
+                      aspace, phys, pcid);
+
+        // become a shootdown target before any entries can be cached.  what is
+        // already cached for this PCID can be kept only if shootdowns have kept
+        // it up to date, rather than dropping this CPU from tlb_cpus_, see
+        // x86_tlb_invalidate_page().
+        aspace->active_cpus_.fetch_or(cpu_bit);
+        bool tlb_current = aspace->tlb_cpus_.fetch_or(cpu_bit) & cpu_bit;
+        x86_set_cr3(phys | pcid | (tlb_current ? X86_CR3_NOFLUSH : 0));
+
+        if (old_aspace != nullptr) {
+            old_aspace->active_cpus_.fetch_and(~cpu_bit);
+        }
+    } else if (aspace != nullptr) {
         aspace->canary_.Assert();
         paddr_t phys = aspace->pt_phys();
         LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR "\n", aspace, phys);
@@ -655,7 +826,8 @@ void X86ArchVmAspace::ContextSwitch(X86ArchVmAspace* old_aspace, X86ArchVmAspace
         aspace->active_cpus_.fetch_or(cpu_bit);
     } else {
         LTRACEF_LEVEL(3, "switching to kernel aspace, pt %#" PRIxPTR "\n", kernel_pt_phys);
-        x86_set_cr3(kernel_pt_phys);
+        // the kernel aspace only has global mappings, which PCID 0 has no need to flush
+        x86_set_cr3(use_pcid ? kernel_pt_phys | X86_CR3_NOFLUSH : kernel_pt_phys);
         if (old_aspace != nullptr) {
             old_aspace->active_cpus_.fetch_and(~cpu_bit);
         }
@@ -677,6 +849,21 @@ zx_status_t X86ArchVmAspace::Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flag
     return pt_->QueryVaddr(vaddr, paddr, mmu_flags);
 }
 
+size_t X86ArchVmAspace::LargePageBytes(vaddr_t vaddr, size_t count) {
+    if (!IsValidVaddr(vaddr))
+        return 0;
+
+    return pt_->LargePageBytes(vaddr, count);
+}
+
+zx_status_t X86ArchVmAspace::HarvestAccessed(vaddr_t vaddr, size_t count,
+                                             arch_accessed_fn_t accessed_fn, void* context) {
+    if (!IsValidVaddr(vaddr))
+        return ZX_ERR_INVALID_ARGS;
+
+    return pt_->HarvestAccessed(vaddr, count, accessed_fn, context);
+}
+
 void x86_mmu_percpu_init(void) {
     ulong cr0 = x86_get_cr0();
     /* Set write protect bit in CR0*/
@@ -691,6 +878,8 @@ void x86_mmu_percpu_init(void) {
         cr4 |= X86_CR4_SMEP;
     if (x86_feature_test(X86_FEATURE_SMAP))
         cr4 |= X86_CR4_SMAP;
+    if (use_pcid)
+        cr4 |= X86_CR4_PCIDE;
     x86_set_cr4(cr4);
 
     // Set NXE bit in X86_MSR_IA32_EFER.
@@ -129,6 +129,18 @@ void x86_pat_sync(cpu_mask_t targets) {
     mp_sync_exec(MP_IPI_TARGET_MASK, targets, x86_pat_sync_task, &context);
 }
 
+/* Flush the TLB for every PCID. Once CR4.PCIDE is set a CR3 reload only
+ * flushes the current PCID, but any change to CR4.PGE flushes them all. */
+static void x86_tlb_flush_all_contexts(void) {
+    ulong cr4 = x86_get_cr4();
+    if (cr4 & X86_CR4_PCIDE) {
+        x86_set_cr4(cr4 ^ X86_CR4_PGE);
+        x86_set_cr4(cr4);
+    } else {
+        x86_set_cr3(x86_get_cr3());
+    }
+}
+
 static void x86_pat_sync_task(void* raw_context) {
     /* Step 2: Disable interrupts */
     DEBUG_ASSERT(arch_ints_disabled());
@@ -160,9 +172,9 @@ static void x86_pat_sync_task(void* raw_context) {
     cr4 &= ~X86_CR4_PGE;
     x86_set_cr4(cr4);
 
-    /* Step 7: If the PGE flag wasn't set, flush the TLB via CR3 */
+    /* Step 7: If the PGE flag wasn't set, flush the TLB another way */
     if (!pge_was_set) {
-        x86_set_cr3(x86_get_cr3());
+        x86_tlb_flush_all_contexts();
     }
 
     /* Step 8: Disable MTRRs */
@@ -208,7 +220,7 @@ static void x86_pat_sync_task(void* raw_context) {
     /* Step 11: Flush all cache and the TLB again */
     __asm volatile("wbinvd" ::
                        : "memory");
-    x86_set_cr3(x86_get_cr3());
+    x86_tlb_flush_all_contexts();
 
     /* Step 12: Enter the normal cache mode */
     cr0 = x86_get_cr0();
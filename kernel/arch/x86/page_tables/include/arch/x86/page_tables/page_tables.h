@@ -37,14 +37,25 @@ struct PendingTlbInvalidation {
     };
     static_assert(sizeof(Item) == 8, "");
 
+    // Once |item| is full, invalidating every page between the lowest and
+    // highest queued addresses is preferred to a full invalidation, as long as
+    // that range spans at most this many pages.
+    static constexpr size_t kMaxRangePages = 128;
+
     // If true, ignore |vaddr| and perform a full invalidation for this context.
     bool full_shootdown = false;
     // If true, at least one enqueued entry was for a global page.
     bool contains_global = false;
+    // If true, |item| overflowed; ignore it and invalidate every page in
+    // [range_start, range_end) instead.
+    bool use_range = false;
     // Number of valid elements in |item|
     uint count = 0;
     // List of addresses queued for invalidation
     Item item[32];
+    // Range covering every address queued so far
+    vaddr_t range_start = 0;
+    vaddr_t range_end = 0;
 
     // Add address |v|, translated at depth |level|, to the set of addresses to be invalidated.
     // |is_terminal| should be true iff this invalidation is targeting the final step of the translation
@@ -53,10 +64,26 @@ struct PendingTlbInvalidation {
     // bit set.
     void enqueue(vaddr_t v, PageTableLevel level, bool is_global_page, bool is_terminal);
 
+    // Add everything queued in |other| to the set of addresses to be invalidated.
+    void merge(const PendingTlbInvalidation& other);
+
+    // Returns true if there is nothing to invalidate.
+    bool is_empty() const { return count == 0 && !use_range; }
+
+    // Number of pages that will be invalidated one by one.  Meaningless if
+    // |full_shootdown| is set.
+    size_t page_count() const {
+        return use_range ? (range_end - range_start) / PAGE_SIZE : count;
+    }
+
     // Clear the list of pending invalidations
     void clear();
 
     ~PendingTlbInvalidation();
+
+private:
+    void add(Item entry);
+    void extend_range(vaddr_t start, vaddr_t end);
 };
 
 class X86PageTableBase {
@@ -90,6 +117,18 @@ public:
     zx_status_t ProtectPages(vaddr_t vaddr, size_t count, uint flags);
 
     zx_status_t QueryVaddr(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags);
+    size_t LargePageBytes(vaddr_t vaddr, size_t count);
+    zx_status_t HarvestAccessed(vaddr_t vaddr, size_t count,
+                                arch_accessed_fn_t accessed_fn, void* context);
+
+    // Between these calls, the TLB invalidations for ProtectPages() calls made
+    // by the calling thread are deferred, so that consecutive calls share a
+    // single shootdown.  They are issued by EndTlbBatch(), or earlier along
+    // with any other invalidation of these page tables.  Invalidations for
+    // entries that are removed are never deferred, since the pages they
+    // pointed at may be freed as soon as UnmapPages() returns.
+    void BeginTlbBatch();
+    void EndTlbBatch();
 
 protected:
     // Initialize an empty page table, assigning this given context to it.
@@ -124,6 +163,9 @@ protected:
     // Returns true if a cache flush is necessary for pagetable changes to be
     // visible.
     virtual bool needs_cache_flushes() = 0;
+    // Returns the flag the processor sets in terminal entries on access, or 0
+    // if it doesn't track accesses.
+    virtual PtFlags accessed_flag() = 0;
 
     // Pointer to the translation table.
     paddr_t phys_ = 0;
@@ -172,6 +214,10 @@ private:
                              enum PageTableLevel* ret_level,
                              volatile pt_entry_t** mapping) TA_REQ(lock_);
 
+    void HarvestAccessedLocked(volatile pt_entry_t* table, PageTableLevel level,
+                               vaddr_t vaddr, vaddr_t last, PtFlags accessed,
+                               arch_accessed_fn_t accessed_fn, void* context) TA_REQ(lock_);
+
     zx_status_t SplitLargePage(PageTableLevel level, vaddr_t vaddr,
                                volatile pt_entry_t* pte, ConsistencyManager* cm) TA_REQ(lock_);
 
@@ -185,4 +231,9 @@ private:
 
     // low lock to protect the mmu code
     fbl::Mutex lock_;
+
+    // The thread that has a batch open, see BeginTlbBatch().
+    struct thread* batch_owner_ TA_GUARDED(lock_) = nullptr;
+    // Invalidations deferred by the open batch.
+    PendingTlbInvalidation batch_tlb_ TA_GUARDED(lock_);
 };
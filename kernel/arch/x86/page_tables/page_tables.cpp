@@ -12,12 +12,16 @@
 #include <fbl/algorithm.h>
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
+#include <kernel/thread.h>
+#include <lib/counters.h>
 #include <trace.h>
 #include <vm/physmap.h>
 #include <vm/pmm.h>
 
 #define LOCAL_TRACE 0
 
+KCOUNTER(tlb_deferred, "kernel.x86.tlb.deferred");
+
 namespace {
 
 // Return the page size for this level
@@ -94,21 +98,76 @@ void PendingTlbInvalidation::enqueue(vaddr_t v, PageTableLevel level, bool is_gl
 
     // We mark PML4_L entries as full shootdowns, since it's going to be
     // expensive one way or another.
-    if (count >= fbl::count_of(item) || level == PML4_L) {
+    if (level == PML4_L) {
         full_shootdown = true;
         return;
     }
-    item[count].set_page_level(static_cast<uint64_t>(level));
-    item[count].set_is_global(is_global_page);
-    item[count].set_is_terminal(is_terminal);
-    item[count].set_encoded_addr(v >> PAGE_SIZE_SHIFT);
-    count++;
+    Item entry;
+    entry.raw = 0;
+    entry.set_page_level(static_cast<uint64_t>(level));
+    entry.set_is_global(is_global_page);
+    entry.set_is_terminal(is_terminal);
+    entry.set_encoded_addr(v >> PAGE_SIZE_SHIFT);
+    add(entry);
+}
+
+void PendingTlbInvalidation::merge(const PendingTlbInvalidation& other) {
+    if (other.contains_global) {
+        contains_global = true;
+    }
+    if (other.full_shootdown) {
+        full_shootdown = true;
+    }
+    if (other.use_range) {
+        extend_range(other.range_start, other.range_end);
+        use_range = true;
+        if (page_count() > kMaxRangePages) {
+            full_shootdown = true;
+        }
+        return;
+    }
+    for (uint i = 0; i < other.count; ++i) {
+        add(other.item[i]);
+    }
+}
+
+void PendingTlbInvalidation::add(Item entry) {
+    // The TLB may hold a large page as several smaller entries (e.g. when
+    // the hypervisor backs it with small pages), so if this item overflows
+    // into the range, the range has to cover the whole page. The entries
+    // under a non-terminal item were queued on their own when unmapped.
+    const PageTableLevel level = static_cast<PageTableLevel>(entry.page_level());
+    const size_t size = entry.is_terminal() ? page_size(level) : PAGE_SIZE;
+    extend_range(entry.addr(), entry.addr() + size);
+
+    if (count < fbl::count_of(item)) {
+        item[count] = entry;
+        count++;
+        return;
+    }
+    use_range = true;
+    if (page_count() > kMaxRangePages) {
+        full_shootdown = true;
+    }
+}
+
+void PendingTlbInvalidation::extend_range(vaddr_t start, vaddr_t end) {
+    if (is_empty()) {
+        range_start = start;
+        range_end = end;
+        return;
+    }
+    range_start = fbl::min(range_start, start);
+    range_end = fbl::max(range_end, end);
 }
 
 void PendingTlbInvalidation::clear() {
     count = 0;
     full_shootdown = false;
     contains_global = false;
+    use_range = false;
+    range_start = 0;
+    range_end = 0;
 }
 
 PendingTlbInvalidation::~PendingTlbInvalidation() {
@@ -185,6 +244,10 @@ public:
     CacheLineFlusher* cache_line_flusher() { return &clf_; }
     PendingTlbInvalidation* pending_tlb() { return &tlb_; }
 
+    // Allow the TLB invalidation to be deferred to the batch the calling
+    // thread has open, if any.  Only valid if no entries are removed.
+    void set_deferrable() { deferrable_ = true; }
+
     // This function must be called while holding pt_->lock_.
     void Finish();
 private:
@@ -196,6 +259,9 @@ private:
     // TLB invalidations that need to occur
     PendingTlbInvalidation tlb_;
 
+    // See set_deferrable()
+    bool deferrable_ = false;
+
     // vm_page_t's to relese to the PMM after the TLB invalidation occurs
     list_node to_free_;
 };
@@ -227,6 +293,22 @@ void X86PageTableBase::ConsistencyManager::Finish() {
         // invalidations.
         mb();
     }
+
+    if (deferrable_ && pt_->batch_owner_ == get_current_thread() && list_is_empty(&to_free_)) {
+        if (!tlb_.is_empty()) {
+            pt_->batch_tlb_.merge(tlb_);
+            kcounter_add(tlb_deferred, 1);
+        }
+        tlb_.clear();
+        pt_ = nullptr;
+        return;
+    }
+
+    // Piggyback anything an open batch has deferred on this shootdown.
+    if (!tlb_.is_empty() && !pt_->batch_tlb_.is_empty()) {
+        tlb_.merge(pt_->batch_tlb_);
+        pt_->batch_tlb_.clear();
+    }
     pt_->TlbInvalidate(&tlb_);
     pt_ = nullptr;
 }
@@ -960,6 +1042,7 @@ zx_status_t X86PageTableBase::ProtectPages(vaddr_t vaddr, size_t count, uint mmu
     };
     MappingCursor result;
     ConsistencyManager cm(this);
+    cm.set_deferrable();
     {
         fbl::AutoLock a(&lock_);
         zx_status_t status = UpdateMapping(virt_, mmu_flags, top_level(), start, &result, &cm);
@@ -972,6 +1055,27 @@ zx_status_t X86PageTableBase::ProtectPages(vaddr_t vaddr, size_t count, uint mmu
     return ZX_OK;
 }
 
+void X86PageTableBase::BeginTlbBatch() {
+    canary_.Assert();
+
+    fbl::AutoLock a(&lock_);
+    DEBUG_ASSERT(batch_owner_ == nullptr);
+    DEBUG_ASSERT(batch_tlb_.is_empty());
+    batch_owner_ = get_current_thread();
+}
+
+void X86PageTableBase::EndTlbBatch() {
+    canary_.Assert();
+
+    fbl::AutoLock a(&lock_);
+    DEBUG_ASSERT(batch_owner_ == get_current_thread());
+    batch_owner_ = nullptr;
+    if (!batch_tlb_.is_empty()) {
+        TlbInvalidate(&batch_tlb_);
+    }
+    batch_tlb_.clear();
+}
+
 zx_status_t X86PageTableBase::QueryVaddr(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) {
     canary_.Assert();
 
@@ -1021,6 +1125,93 @@ zx_status_t X86PageTableBase::QueryVaddr(vaddr_t vaddr, paddr_t* paddr, uint* mm
     return ZX_OK;
 }
 
+size_t X86PageTableBase::LargePageBytes(vaddr_t vaddr, size_t count) {
+    canary_.Assert();
+
+    if (count == 0) {
+        return 0;
+    }
+    const vaddr_t last = vaddr + (count * PAGE_SIZE - 1);
+    size_t bytes = 0;
+
+    fbl::AutoLock a(&lock_);
+
+    // A large page covers a whole naturally aligned block, so one lookup per
+    // 2MB block is enough to find them all.
+    for (;;) {
+        PageTableLevel level;
+        volatile pt_entry_t* entry;
+        size_t ps = page_size(PD_L);
+        if (GetMapping(virt_, vaddr, top_level(), &level, &entry) == ZX_OK && level != PT_L) {
+            ps = page_size(level);
+            bytes += fbl::min(last, ROUNDDOWN(vaddr, ps) + (ps - 1)) - vaddr + 1;
+        }
+        const vaddr_t next = ROUNDDOWN(vaddr, ps) + ps;
+        if (next - 1 >= last) {
+            break;
+        }
+        vaddr = next;
+    }
+
+    return bytes;
+}
+
+zx_status_t X86PageTableBase::HarvestAccessed(vaddr_t vaddr, size_t count,
+                                              arch_accessed_fn_t accessed_fn, void* context) {
+    canary_.Assert();
+
+    const PtFlags accessed = accessed_flag();
+    if (!accessed) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (count == 0) {
+        return ZX_OK;
+    }
+
+    fbl::AutoLock a(&lock_);
+    HarvestAccessedLocked(virt_, top_level(), vaddr, vaddr + (count * PAGE_SIZE - 1), accessed,
+                          accessed_fn, context);
+    return ZX_OK;
+}
+
+// Walk [vaddr, last] within |table|, skipping everything under entries that
+// aren't present.
+void X86PageTableBase::HarvestAccessedLocked(volatile pt_entry_t* table, PageTableLevel level,
+                                             vaddr_t vaddr, vaddr_t last, PtFlags accessed,
+                                             arch_accessed_fn_t accessed_fn, void* context) {
+    const size_t ps = page_size(level);
+    for (;;) {
+        const vaddr_t block = ROUNDDOWN(vaddr, ps);
+        const vaddr_t block_last = fbl::min(last, block + (ps - 1));
+
+        volatile pt_entry_t* e = table + vaddr_to_index(level, vaddr);
+        pt_entry_t pt_val = *e;
+        if (IS_PAGE_PRESENT(pt_val)) {
+            if (level == PT_L || IS_LARGE_PAGE(pt_val)) {
+                // the processor may be setting the dirty flag at the same time
+                if (pt_val & accessed) {
+                    __atomic_fetch_and(const_cast<pt_entry_t*>(e), ~accessed, __ATOMIC_RELAXED);
+                    const paddr_t pa = paddr_from_pte(level, pt_val);
+                    for (vaddr_t v = vaddr;; v += PAGE_SIZE) {
+                        accessed_fn(context, v, pa + (v - block));
+                        if (v + (PAGE_SIZE - 1) >= block_last) {
+                            break;
+                        }
+                    }
+                }
+            } else {
+                HarvestAccessedLocked(get_next_table_from_entry(pt_val), lower_level(level),
+                                      vaddr, block_last, accessed, accessed_fn, context);
+            }
+        }
+
+        if (block_last >= last) {
+            break;
+        }
+        vaddr = block_last + 1;
+    }
+}
+
 void X86PageTableBase::Destroy(vaddr_t base, size_t size) {
     canary_.Assert();
 
@@ -59,6 +59,10 @@ static void arch_spinloop_pause(void);
 /* arch optimized version of a page zero routine against a page aligned buffer */
 void arch_zero_page(void *);
 
+/* same as above, but avoids pulling the page into the cache where the arch can.
+ * for zeroing pages that won't be touched again soon */
+void arch_zero_page_nontemporal(void *);
+
 /* give the specific arch a chance to override some routines */
 #include <arch/arch_ops.h>
 
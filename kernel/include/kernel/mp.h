@@ -107,6 +107,12 @@ struct mp_state {
 
     // lock for serializing CPU hotplug/unplug operations
     mutex_t hotplug_lock;
+
+    // scheduler topology: for each cpu, the cpus sharing its core (smt siblings) and the
+    // cpus sharing its last level cache, both including the cpu itself. Zero if the
+    // platform never described the cpu. See mp_set_cpu_topology().
+    cpu_mask_t smt_siblings[SMP_MAX_CPUS];
+    cpu_mask_t cache_siblings[SMP_MAX_CPUS];
 };
 
 extern struct mp_state mp;
@@ -179,4 +185,20 @@ static inline int mp_is_cpu_active(cpu_num_t cpu) {
     return mp_get_active_mask() & cpu_num_to_mask(cpu);
 }
 
+// Record which cpus share a core and which share a last level cache with |cpu|.
+// Called by the platform as it discovers the cpu topology.
+void mp_set_cpu_topology(cpu_num_t cpu, cpu_mask_t smt_siblings, cpu_mask_t cache_siblings);
+
+// the cpus sharing a core with |cpu|, defaulting to just |cpu| if unknown
+static inline cpu_mask_t mp_get_smt_siblings(cpu_num_t cpu) {
+    cpu_mask_t mask = mp.smt_siblings[cpu];
+    return mask ? mask : cpu_num_to_mask(cpu);
+}
+
+// the cpus sharing a last level cache with |cpu|, defaulting to all cpus if unknown
+static inline cpu_mask_t mp_get_cache_siblings(cpu_num_t cpu) {
+    cpu_mask_t mask = mp.cache_siblings[cpu];
+    return mask ? mask : CPU_MASK_ALL;
+}
+
 __END_CDECLS
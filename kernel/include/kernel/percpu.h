@@ -19,7 +19,7 @@ __BEGIN_CDECLS
 
 struct percpu {
     // per cpu timer queue
-    struct list_node timer_queue;
+    TimerQueue timer_queue;
 
     // per cpu preemption timer; ZX_TIME_INFINITE means not set
     zx_time_t preempt_timer_deadline;
@@ -31,6 +31,26 @@ struct percpu {
     struct list_node run_queue[NUM_PRIORITIES];
     uint32_t run_queue_bitmap;
 
+    // fair class queue sorted by virtual runtime, the total weight of the threads in it,
+    // and the virtual runtime floor handed to threads that join it
+    struct list_node fair_queue;
+    uint64_t fair_weight_total;
+    zx_duration_t fair_min_vruntime;
+
+    // deadline class queue sorted by absolute deadline
+    struct list_node deadline_queue;
+
+    // deadline threads out of budget, sorted by the start of their next period, and the
+    // earliest of those or ZX_TIME_INFINITE. Not counted in run_queue_len.
+    struct list_node deadline_throttled;
+    zx_time_t deadline_replenish_time;
+
+    // number of threads in all of the above queues; read without the lock by load balancing
+    uint32_t run_queue_len;
+
+    // next time this cpu looks for a busier cpu to pull work from while it is busy
+    zx_time_t next_balance_time;
+
 #if WITH_LOCK_DEP
     // state for runtime lock validation when in irq context
     lockdep_state_t lock_state;
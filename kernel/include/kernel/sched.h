@@ -30,10 +30,31 @@ void sched_migrate(thread_t* t) TA_REQ(thread_lock);
 // pri should be <= MAX_PRIORITY, negative values disable priority inheritance.
 void sched_inherit_priority(thread_t* t, int pri, bool* local_resched) TA_REQ(thread_lock);
 
+// lend the priority of t, which is about to wait on a priority inheriting futex, to the futex's
+// owner, taking it back from any thread it was lent to before. The owner inherits the highest
+// priority lent to it. Returns if the caller should locally reschedule.
+void sched_futex_lend_priority(thread_t* t, thread_t* owner, bool* local_resched) TA_REQ(thread_lock);
+
+// take back the priority t lent to a futex owner, if any, and lower what the owner inherits if
+// nothing else holds it up. Returns if the caller should locally reschedule.
+void sched_futex_unlend_priority(thread_t* t, bool* local_resched) TA_REQ(thread_lock);
+
+// forget the priorities lent to t, which is exiting.
+void sched_futex_owner_exit(thread_t* t) TA_REQ(thread_lock);
+
 // set the priority of a thread and reset the boost value. This function might reschedule.
 // pri should be 0 <= to <= MAX_PRIORITY.
 void sched_change_priority(thread_t* t, int pri) TA_REQ(thread_lock);
 
+// move a thread into the fair class with the given weight. This function might reschedule.
+// weight should be FAIR_WEIGHT_MIN <= weight <= FAIR_WEIGHT_MAX.
+void sched_set_fair(thread_t* t, uint32_t weight) TA_REQ(thread_lock);
+
+// move a thread into the deadline class. This function might reschedule.
+// 0 < capacity <= relative_deadline <= period, and capacity must be under a second.
+void sched_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t relative_deadline,
+                        zx_duration_t period) TA_REQ(thread_lock);
+
 // return true if the thread was placed on the current cpu's run queue
 // this usually means the caller should locally reschedule soon
 bool sched_unblock(thread_t* t) __WARN_UNUSED_RESULT TA_REQ(thread_lock);
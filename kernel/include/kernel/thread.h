@@ -42,6 +42,13 @@ enum thread_user_state_change {
     THREAD_USER_STATE_RESUME,
 };
 
+// scheduling classes; see sched.cpp for how the classes are ordered against each other
+enum thread_sched_class {
+    SCHED_CLASS_PRIORITY = 0, // fixed priority round robin with boosting
+    SCHED_CLASS_FAIR,         // weighted proportional share by virtual runtime
+    SCHED_CLASS_DEADLINE,     // earliest deadline first with a capacity per period
+};
+
 typedef int (*thread_start_routine)(void* arg);
 typedef void (*thread_trampoline_routine)(void) __NO_RETURN;
 typedef void (*thread_user_callback_t)(enum thread_user_state_change new_state,
@@ -106,10 +113,44 @@ typedef struct thread {
     // thread blocked on a locking primitive this thread holds. -1 means no inherit.
     // effective_priority is MAX(base_priority + priority boost, inherited_priority) and is
     // the working priority for run queue decisions.
+    // futex_inherited_priority is the part of inherited_priority that comes from threads
+    // blocked on priority inheriting futexes this thread owns: the highest priority lent by
+    // the threads in futex_waiters. It outlives boosts from kernel mutexes, which are dropped
+    // when the last mutex is released.
     int effec_priority;
     int base_priority;
     int priority_boost;
     int inherited_priority;
+    int futex_inherited_priority;
+    struct list_node futex_waiters;
+
+    // the owner of the priority inheriting futex this thread is blocked on, if any, the
+    // priority it lent to that owner, and its node in the owner's futex_waiters.
+    struct thread* futex_owner;
+    int futex_lent_priority;
+    struct list_node futex_owner_node;
+
+    // scheduling class, and whether the thread is sitting in its class queue rather than in
+    // one of the priority run queues.
+    enum thread_sched_class sched_class;
+    bool class_queued;
+
+    // fair class: share weight, weighted virtual runtime, and the time up to which the
+    // virtual runtime has been charged.
+    uint32_t fair_weight;
+    zx_duration_t fair_vruntime;
+    zx_time_t fair_charged_time;
+
+    // deadline class: the thread may run for deadline_capacity out of every deadline_period
+    // and must get it within deadline_relative of the start of the period.
+    // deadline_absolute is the current deadline; remaining_time_slice holds the budget left.
+    // A thread that runs out of budget is throttled, off the run queues, until its next
+    // period starts.
+    zx_duration_t deadline_capacity;
+    zx_duration_t deadline_relative;
+    zx_duration_t deadline_period;
+    zx_time_t deadline_absolute;
+    bool deadline_throttled;
 
     // current cpu the thread is either running on or in the ready queue, undefined otherwise
     cpu_num_t curr_cpu;
@@ -220,6 +261,11 @@ typedef struct thread {
 #define DEFAULT_PRIORITY (NUM_PRIORITIES / 2)
 #define HIGH_PRIORITY ((NUM_PRIORITIES / 4) * 3)
 
+// fair class share weights
+#define FAIR_WEIGHT_MIN (1)
+#define FAIR_WEIGHT_DEFAULT (100)
+#define FAIR_WEIGHT_MAX (1000)
+
 // stack size
 #ifdef CUSTOM_DEFAULT_STACK_SIZE
 #define DEFAULT_STACK_SIZE CUSTOM_DEFAULT_STACK_SIZE
@@ -236,6 +282,9 @@ void thread_construct_first(thread_t* t, const char* name);
 thread_t* thread_create_idle_thread(uint cpu_num);
 void thread_set_name(const char* name);
 void thread_set_priority(thread_t* t, int priority);
+void thread_set_fair_weight(thread_t* t, uint32_t weight);
+void thread_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t relative_deadline,
+                         zx_duration_t period);
 void thread_set_user_callback(thread_t* t, thread_user_callback_t cb);
 thread_t* thread_create(const char* name, thread_start_routine entry, void* arg, int priority);
 thread_t* thread_create_etc(thread_t* t, const char* name, thread_start_routine entry, void* arg,
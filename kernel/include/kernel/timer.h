@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <fbl/intrusive_wavl_tree.h>
 #include <kernel/spinlock.h>
 #include <list.h>
 #include <sys/types.h>
@@ -30,7 +31,9 @@ enum slack_mode {
 
 typedef struct timer {
     int magic;
-    struct list_node node;
+    // Node in the timer queue of |queue_cpu|, see TimerQueue.
+    fbl::WAVLTreeNodeState<struct timer*> node;
+    uint queue_cpu;
 
     zx_time_t scheduled_time;
     zx_duration_t slack; // Stores the applied slack adjustment from
@@ -45,7 +48,8 @@ typedef struct timer {
 #define TIMER_INITIAL_VALUE(t)              \
     {                                       \
         .magic = TIMER_MAGIC,               \
-        .node = LIST_INITIAL_CLEARED_VALUE, \
+        .node = {},                         \
+        .queue_cpu = 0,                     \
         .scheduled_time = 0,                \
         .slack = 0,                         \
         .callback = NULL,                   \
@@ -143,3 +147,31 @@ void timer_thaw_percpu(void);
 zx_status_t timer_trylock_or_cancel(timer_t* t, spin_lock_t* lock) TA_TRY_ACQ(false, lock);
 
 __END_CDECLS
+
+// Each cpu's pending timers, ordered by scheduled_time.  Timers with the same
+// scheduled_time are told apart by their address, which is all that keeps
+// their keys unique; the order in which they fire is unspecified.
+struct TimerQueueKey {
+    zx_time_t scheduled_time;
+    const timer_t* timer;
+};
+
+struct TimerQueueTraits {
+    static TimerQueueKey GetKey(const timer_t& timer) {
+        return {timer.scheduled_time, &timer};
+    }
+    static bool LessThan(const TimerQueueKey& a, const TimerQueueKey& b) {
+        if (a.scheduled_time != b.scheduled_time) {
+            return a.scheduled_time < b.scheduled_time;
+        }
+        return a.timer < b.timer;
+    }
+    static bool EqualTo(const TimerQueueKey& a, const TimerQueueKey& b) {
+        return a.scheduled_time == b.scheduled_time && a.timer == b.timer;
+    }
+    static fbl::WAVLTreeNodeState<timer_t*>& node_state(timer_t& timer) {
+        return timer.node;
+    }
+};
+
+using TimerQueue = fbl::WAVLTree<TimerQueueKey, timer_t*, TimerQueueTraits, TimerQueueTraits>;
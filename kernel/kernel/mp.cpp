@@ -48,6 +48,15 @@ void mp_init(void) {
     }
 }
 
+void mp_set_cpu_topology(cpu_num_t cpu, cpu_mask_t smt_siblings, cpu_mask_t cache_siblings) {
+    DEBUG_ASSERT(cpu < SMP_MAX_CPUS);
+    DEBUG_ASSERT(smt_siblings & cpu_num_to_mask(cpu));
+    DEBUG_ASSERT((smt_siblings & cache_siblings) == smt_siblings);
+
+    mp.smt_siblings[cpu] = smt_siblings;
+    mp.cache_siblings[cpu] = cache_siblings;
+}
+
 void mp_prepare_current_cpu_idle_state(bool idle) {
     arch_prepare_current_cpu_idle_state(idle);
 }
@@ -23,12 +23,22 @@
 #include <kernel/sched.h>
 #include <kernel/thread.h>
 #include <kernel/thread_lock.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
+#include <platform.h>
 #include <trace.h>
 #include <zircon/types.h>
 
 #define LOCAL_TRACE 0
 
+// How long a contended acquire may spin waiting for a running holder to release
+// the mutex before it gives up and blocks.
+static const zx_duration_t kMutexSpinTimeout = ZX_USEC(20);
+
+KCOUNTER(mutex_spin_acquired, "kernel.mutex.spin_acquired");
+KCOUNTER(mutex_spin_timeout, "kernel.mutex.spin_timeout");
+KCOUNTER(mutex_blocked, "kernel.mutex.blocked");
+
 /**
  * @brief  Initialize a mutex_t
  */
@@ -60,6 +70,48 @@ void mutex_destroy(mutex_t* m) {
     wait_queue_destroy(&m->wait);
 }
 
+// Spins while |m| is held by a thread that is running on another cpu, on the bet
+// that the holder will release it sooner than we could block and be woken back
+// up. Gives up as soon as the holder stops running, a waiter queues up (the
+// mutex will then be handed straight to that waiter), or the spin times out.
+// Returns true if the mutex was acquired.
+static bool mutex_spin(mutex_t* m, thread_t* ct) {
+    zx_time_t deadline = ZX_TIME_INFINITE;
+
+    for (;;) {
+        uintptr_t oldval = mutex_val(m);
+        if (oldval == 0) {
+            if (atomic_cmpxchg_u64(&m->val, &oldval, (uintptr_t)ct)) {
+                kcounter_add(mutex_spin_acquired, 1);
+                return true;
+            }
+            continue;
+        }
+
+        if (oldval & MUTEX_FLAG_QUEUED) {
+            return false;
+        }
+
+        // The holder may release the mutex and exit at any point after we read
+        // it, but thread structures live in memory that stays mapped, so a stale
+        // read here at worst ends the spin early or extends it by a pass.
+        const thread_t* holder = (const thread_t*)oldval;
+        if (__atomic_load_n(&holder->state, __ATOMIC_RELAXED) != THREAD_RUNNING) {
+            return false;
+        }
+
+        const zx_time_t now = current_time();
+        if (deadline == ZX_TIME_INFINITE) {
+            deadline = zx_time_add_duration(now, kMutexSpinTimeout);
+        } else if (now >= deadline) {
+            kcounter_add(mutex_spin_timeout, 1);
+            return false;
+        }
+
+        arch_spinloop_pause();
+    }
+}
+
 /**
  * @brief  Acquire the mutex
  */
@@ -85,6 +137,12 @@ retry:
               ct, ct->name, m);
 #endif
 
+    // the holder may be about to release it; if it's running, wait it out
+    if (mutex_spin(m, ct)) {
+        ct->mutexes_held++;
+        return;
+    }
+
     {
         // we contended with someone else, will probably need to block
         Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
@@ -107,6 +165,7 @@ retry:
         sched_inherit_priority(mutex_holder(m), ct->effec_priority, &unused);
 
         // we have signalled that we're blocking, so drop into the wait queue
+        kcounter_add(mutex_blocked, 1);
         zx_status_t ret = wait_queue_block(&m->wait, ZX_TIME_INFINITE);
         if (unlikely(ret < ZX_OK)) {
             // mutexes are not interruptable and cannot time out, so it
@@ -13,6 +13,7 @@
 #include <kernel/mp.h>
 #include <kernel/percpu.h>
 #include <kernel/thread.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
 #include <list.h>
 #include <platform.h>
@@ -53,11 +54,54 @@
 // threads get 10ms to run before they use up their time slice and the scheduler is invoked
 #define THREAD_INITIAL_TIME_SLICE ZX_MSEC(10)
 
+// Scheduling classes
+//
+// Fair and deadline threads do not use the priority run queues. Each class has its own
+// per-cpu queue, and the class as a whole competes against the priority run queues as
+// if it were a single priority level (its band):
+//
+//   deadline class: HIGH_PRIORITY, earliest absolute deadline first
+//   fair class:     DEFAULT_PRIORITY, smallest weighted virtual runtime first
+//
+// A class queue wins ties against the priority run queue at the same level. A class
+// thread that inherits a priority above its band through a kernel mutex is queued in the
+// priority run queues until the inheritance ends.
+#define DEADLINE_BAND_PRIORITY HIGH_PRIORITY
+#define FAIR_BAND_PRIORITY DEFAULT_PRIORITY
+
+// all runnable fair threads on a cpu should get to run within this period, but no
+// thread runs for less than the minimum granularity at a time
+#define FAIR_TARGET_LATENCY ZX_MSEC(16)
+#define FAIR_MIN_GRANULARITY ZX_MSEC(1)
+
+// how often a busy cpu checks whether it should pull work from a busier one
+#define SCHED_BALANCE_INTERVAL ZX_MSEC(20)
+
+// a busy cpu only pulls from a cpu with at least this many more queued threads than itself
+#define SCHED_BALANCE_IMBALANCE 2
+
+KCOUNTER(sched_steal_attempts, "kernel.sched.steal.attempts");
+KCOUNTER(sched_steal_success, "kernel.sched.steal.success");
+KCOUNTER(sched_steal_smt, "kernel.sched.steal.smt_sibling");
+KCOUNTER(sched_steal_cache, "kernel.sched.steal.cache_sibling");
+KCOUNTER(sched_steal_remote, "kernel.sched.steal.remote");
+
 static bool local_migrate_if_needed(thread_t* curr_thread);
 
 // compute the effective priority of a thread
 static void compute_effec_priority(thread_t* t) {
-    int ep = t->base_priority + t->priority_boost;
+    int ep;
+    switch (t->sched_class) {
+    case SCHED_CLASS_FAIR:
+        ep = FAIR_BAND_PRIORITY;
+        break;
+    case SCHED_CLASS_DEADLINE:
+        ep = DEADLINE_BAND_PRIORITY;
+        break;
+    default:
+        ep = t->base_priority + t->priority_boost;
+        break;
+    }
     if (t->inherited_priority > ep) {
         ep = t->inherited_priority;
     }
@@ -77,6 +121,11 @@ static void boost_thread(thread_t* t) {
         return;
     }
 
+    // only the priority class uses boosting
+    if (t->sched_class != SCHED_CLASS_PRIORITY) {
+        return;
+    }
+
     if (t->priority_boost < MAX_PRIORITY_ADJ &&
         likely((t->base_priority + t->priority_boost) < HIGHEST_PRIORITY)) {
         t->priority_boost++;
@@ -96,6 +145,10 @@ static void deboost_thread(thread_t* t, bool quantum_expiration) {
         return;
     }
 
+    if (t->sched_class != SCHED_CLASS_PRIORITY) {
+        return;
+    }
+
     int boost_floor;
     if (quantum_expiration) {
         // deboost into negative boost
@@ -213,11 +266,158 @@ static cpu_mask_t find_cpu_mask(thread_t* t) TA_REQ(thread_lock) {
 }
 
 // run queue manipulation
+
+// returns true if the thread should be queued in its class queue instead of a priority queue
+static bool uses_class_queue(const thread_t* t) {
+    switch (t->sched_class) {
+    case SCHED_CLASS_FAIR:
+        return t->effec_priority == FAIR_BAND_PRIORITY;
+    case SCHED_CLASS_DEADLINE:
+        return t->effec_priority == DEADLINE_BAND_PRIORITY;
+    default:
+        return false;
+    }
+}
+
+// charge the time a fair thread has run since it was last charged to its virtual runtime,
+// scaled so that heavier threads accumulate virtual runtime more slowly
+static void fair_charge_runtime(thread_t* t, zx_time_t now) {
+    DEBUG_ASSERT(t->sched_class == SCHED_CLASS_FAIR);
+
+    if (now > t->fair_charged_time) {
+        zx_duration_t delta = zx_time_sub_time(now, t->fair_charged_time);
+        t->fair_vruntime += delta * FAIR_WEIGHT_DEFAULT / t->fair_weight;
+    }
+    t->fair_charged_time = now;
+}
+
+// the time slice a fair thread gets when picked: its weighted share of the target latency
+static zx_duration_t fair_time_slice(const struct percpu* c, const thread_t* t) {
+    uint64_t total_weight = c->fair_weight_total + t->fair_weight;
+    zx_duration_t slice = FAIR_TARGET_LATENCY * t->fair_weight / total_weight;
+    return MAX(slice, FAIR_MIN_GRANULARITY);
+}
+
+static int64_t fair_key(const thread_t* t) {
+    return t->fair_vruntime;
+}
+
+static int64_t deadline_key(const thread_t* t) {
+    return t->deadline_absolute;
+}
+
+// the start of a deadline thread's next period, when it gets its budget back
+static zx_time_t deadline_next_period(const thread_t* t) {
+    return zx_time_add_duration(zx_time_sub_duration(t->deadline_absolute, t->deadline_relative),
+                                t->deadline_period);
+}
+
+// start a deadline thread's next period with a full budget. If the deadline of that period
+// has passed already, a period starting now is used instead.
+static void deadline_start_next_period(thread_t* t, zx_time_t now) {
+    zx_time_t start = deadline_next_period(t);
+    if (zx_time_add_duration(start, t->deadline_relative) <= now) {
+        start = now;
+    }
+    t->deadline_absolute = zx_time_add_duration(start, t->deadline_relative);
+    t->remaining_time_slice = t->deadline_capacity;
+}
+
+static void deadline_update_replenish_time(struct percpu* c) {
+    thread_t* t = list_peek_head_type(&c->deadline_throttled, thread_t, queue_node);
+    // read without the lock by the preemption timer tick
+    __atomic_store_n(&c->deadline_replenish_time,
+                     t ? deadline_next_period(t) : ZX_TIME_INFINITE, __ATOMIC_RELAXED);
+}
+
+// insert into a list of threads sorted by ascending |key|, ahead of threads with an equal
+// key if |head| is set, otherwise behind them
+static void insert_sorted(struct list_node* list, thread_t* t, int64_t (*key)(const thread_t*),
+                          bool head) {
+    int64_t k = key(t);
+    thread_t* entry;
+    list_for_every_entry (list, entry, thread_t, queue_node) {
+        int64_t entry_key = key(entry);
+        if (head ? (k <= entry_key) : (k < entry_key)) {
+            list_add_before(&entry->queue_node, &t->queue_node);
+            return;
+        }
+    }
+    list_add_tail(list, &t->queue_node);
+}
+
+static void insert_in_class_queue(struct percpu* c, thread_t* t, bool head) TA_REQ(thread_lock) {
+    if (t->sched_class == SCHED_CLASS_FAIR) {
+        // the thread just ran, bring its virtual runtime up to date before sorting on it
+        if (t == get_current_thread()) {
+            fair_charge_runtime(t, current_time());
+        }
+
+        // don't let a thread that slept bank virtual runtime against the threads that ran
+        if (t->fair_vruntime < c->fair_min_vruntime) {
+            t->fair_vruntime = c->fair_min_vruntime;
+        }
+
+        insert_sorted(&c->fair_queue, t, fair_key, head);
+        c->fair_weight_total += t->fair_weight;
+    } else {
+        DEBUG_ASSERT(t->sched_class == SCHED_CLASS_DEADLINE);
+        DEBUG_ASSERT(t->remaining_time_slice > 0);
+
+        insert_sorted(&c->deadline_queue, t, deadline_key, head);
+    }
+
+    t->class_queued = true;
+}
+
+// a deadline thread that is about to be queued without any budget left is throttled instead:
+// it waits off the run queues until its next period starts. returns true if it was throttled.
+static bool deadline_throttle(struct percpu* c, thread_t* t) TA_REQ(thread_lock) {
+    if (t->sched_class != SCHED_CLASS_DEADLINE || !uses_class_queue(t)) {
+        return false;
+    }
+
+    zx_time_t now = current_time();
+    if (t == get_current_thread()) {
+        // the thread is being switched away from. Charge what it ran so far against its
+        // budget now rather than after it has been queued.
+        zx_duration_t ran = zx_time_sub_time(now, t->last_started_running);
+        t->runtime_ns = zx_duration_add_duration(t->runtime_ns, ran);
+        t->remaining_time_slice = zx_duration_sub_duration(
+            t->remaining_time_slice, MIN(ran, t->remaining_time_slice));
+        t->last_started_running = now;
+    }
+    if (t->remaining_time_slice > 0) {
+        return false;
+    }
+
+    if (deadline_next_period(t) <= now) {
+        deadline_start_next_period(t, now);
+        return false;
+    }
+
+    insert_sorted(&c->deadline_throttled, t, deadline_next_period, false);
+    t->deadline_throttled = true;
+    deadline_update_replenish_time(c);
+
+    LOCAL_KTRACE2("sched_throttle", (uint32_t)t->user_tid, (uint32_t)(c - percpu));
+    return true;
+}
+
 static void insert_in_run_queue_head(cpu_num_t cpu, thread_t* t) TA_REQ(thread_lock) {
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
-    list_add_head(&percpu[cpu].run_queue[t->effec_priority], &t->queue_node);
-    percpu[cpu].run_queue_bitmap |= (1u << t->effec_priority);
+    struct percpu* c = &percpu[cpu];
+    if (deadline_throttle(c, t)) {
+        return;
+    }
+    if (uses_class_queue(t)) {
+        insert_in_class_queue(c, t, true);
+    } else {
+        list_add_head(&c->run_queue[t->effec_priority], &t->queue_node);
+        c->run_queue_bitmap |= (1u << t->effec_priority);
+    }
+    c->run_queue_len++;
 
     // mark the cpu as busy since the run queue now has at least one item in it
     mp_set_cpu_busy(cpu);
@@ -226,8 +426,17 @@ static void insert_in_run_queue_head(cpu_num_t cpu, thread_t* t) TA_REQ(thread_l
 static void insert_in_run_queue_tail(cpu_num_t cpu, thread_t* t) TA_REQ(thread_lock) {
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
-    list_add_tail(&percpu[cpu].run_queue[t->effec_priority], &t->queue_node);
-    percpu[cpu].run_queue_bitmap |= (1u << t->effec_priority);
+    struct percpu* c = &percpu[cpu];
+    if (deadline_throttle(c, t)) {
+        return;
+    }
+    if (uses_class_queue(t)) {
+        insert_in_class_queue(c, t, false);
+    } else {
+        list_add_tail(&c->run_queue[t->effec_priority], &t->queue_node);
+        c->run_queue_bitmap |= (1u << t->effec_priority);
+    }
+    c->run_queue_len++;
 
     // mark the cpu as busy since the run queue now has at least one item in it
     mp_set_cpu_busy(cpu);
@@ -238,11 +447,23 @@ static void remove_from_run_queue(thread_t* t, int prio_queue) TA_REQ(thread_loc
     DEBUG_ASSERT(t->state == THREAD_READY);
     DEBUG_ASSERT(is_valid_cpu_num(t->curr_cpu));
 
+    struct percpu* c = &percpu[t->curr_cpu];
+
     list_delete(&t->queue_node);
+    if (t->deadline_throttled) {
+        t->deadline_throttled = false;
+        deadline_update_replenish_time(c);
+        return;
+    }
+    c->run_queue_len--;
 
-    // clear the old cpu's queue bitmap if that was the last entry
-    struct percpu* c = &percpu[t->curr_cpu];
-    if (list_is_empty(&c->run_queue[prio_queue])) {
+    if (t->class_queued) {
+        if (t->sched_class == SCHED_CLASS_FAIR) {
+            c->fair_weight_total -= t->fair_weight;
+        }
+        t->class_queued = false;
+    } else if (list_is_empty(&c->run_queue[prio_queue])) {
+        // clear the old cpu's queue bitmap if that was the last entry
         c->run_queue_bitmap &= ~(1u << prio_queue);
     }
 }
@@ -253,17 +474,52 @@ static uint highest_run_queue(const struct percpu* c) TA_REQ(thread_lock) {
            (sizeof(c->run_queue_bitmap) * CHAR_BIT - NUM_PRIORITIES);
 }
 
+// pop the head of a class queue
+static thread_t* pop_class_queue(struct percpu* c, struct list_node* queue) TA_REQ(thread_lock) {
+    thread_t* t = list_remove_head_type(queue, thread_t, queue_node);
+    DEBUG_ASSERT(t && t->class_queued);
+
+    c->run_queue_len--;
+    t->class_queued = false;
+    if (t->sched_class == SCHED_CLASS_FAIR) {
+        c->fair_weight_total -= t->fair_weight;
+
+        // the virtual runtime floor only moves forward
+        if (t->fair_vruntime > c->fair_min_vruntime) {
+            c->fair_min_vruntime = t->fair_vruntime;
+        }
+    }
+
+    LOCAL_KTRACE2("sched_get_top class", t->sched_class, (uint32_t)t->user_tid);
+
+    return t;
+}
+
 static thread_t* sched_get_top_thread(cpu_num_t cpu) TA_REQ(thread_lock) {
     // pop the head of the highest priority queue with any threads
-    // queued up on the passed in cpu.
+    // queued up on the passed in cpu, treating each class queue as a queue at its band.
 
     struct percpu* c = &percpu[cpu];
+
+    int highest_prio = c->run_queue_bitmap ? (int)highest_run_queue(c) : -1;
+    thread_t* class_thread = nullptr;
+    if (!list_is_empty(&c->deadline_queue) && highest_prio <= DEADLINE_BAND_PRIORITY) {
+        class_thread = pop_class_queue(c, &c->deadline_queue);
+    } else if (!list_is_empty(&c->fair_queue) && highest_prio <= FAIR_BAND_PRIORITY) {
+        class_thread = pop_class_queue(c, &c->fair_queue);
+    }
+    if (class_thread) {
+        DEBUG_ASSERT(class_thread->curr_cpu == cpu);
+        return class_thread;
+    }
+
     if (likely(c->run_queue_bitmap)) {
         uint highest_queue = highest_run_queue(c);
 
         thread_t* newthread = list_remove_head_type(&c->run_queue[highest_queue], thread_t, queue_node);
 
         DEBUG_ASSERT(newthread);
+        c->run_queue_len--;
         DEBUG_ASSERT_MSG(newthread->cpu_affinity & cpu_num_to_mask(cpu),
                          "thread %p name %s, aff %#x cpu %u\n", newthread, newthread->name,
                          newthread->cpu_affinity, cpu);
@@ -282,13 +538,212 @@ static thread_t* sched_get_top_thread(cpu_num_t cpu) TA_REQ(thread_lock) {
     return &c->idle_thread;
 }
 
+// Load balancing
+//
+// Threads otherwise only change cpus when they are woken up (find_cpu_and_insert) or
+// their affinity changes, so a burst of threads queued on one cpu can wait there while
+// other cpus have nothing to do. To even this out, cpus pull queued threads from busier
+// cpus:
+//
+//   - a cpu about to run its idle thread first takes a thread from any cpu that has
+//     threads queued
+//   - every SCHED_BALANCE_INTERVAL a busy cpu kicks an idle cpu if it has more queued
+//     work than it can run soon, or otherwise takes a thread from a cpu with at least
+//     SCHED_BALANCE_IMBALANCE more queued threads than itself
+//
+// Candidate cpus are searched nearest first: smt siblings, then cpus sharing the last
+// level cache, then every other active cpu. Only threads in the priority run queues are
+// moved; class threads stay where their class bookkeeping is.
+
+// the number of threads queued on a cpu. read without holding anything, so this is
+// only a hint.
+static uint32_t queued_threads(cpu_num_t cpu) {
+    return __atomic_load_n(&percpu[cpu].run_queue_len, __ATOMIC_RELAXED);
+}
+
+// find the cpu in |mask| with the most queued threads, if any has at least |min_queued|
+static cpu_num_t find_busiest_cpu(cpu_mask_t mask, uint32_t min_queued) {
+    cpu_num_t busiest = INVALID_CPU;
+    uint32_t busiest_queued = 0;
+
+    while (mask) {
+        cpu_num_t i = lowest_cpu_set(mask);
+        mask &= ~cpu_num_to_mask(i);
+
+        uint32_t queued = queued_threads(i);
+        if (queued >= min_queued && queued > busiest_queued) {
+            busiest = i;
+            busiest_queued = queued;
+        }
+    }
+
+    return busiest;
+}
+
+// take the highest priority queued thread on |victim| that is allowed to run on |cpu|.
+// threads are taken from the tail of their queue, since those will wait the longest.
+static thread_t* steal_thread(cpu_num_t cpu, cpu_num_t victim) TA_REQ(thread_lock) {
+    struct percpu* c = &percpu[victim];
+    cpu_mask_t cpu_mask = cpu_num_to_mask(cpu);
+
+    uint32_t bitmap = c->run_queue_bitmap;
+    while (bitmap) {
+        int prio = HIGHEST_PRIORITY - __builtin_clz(bitmap) -
+                   (int)(sizeof(bitmap) * CHAR_BIT - NUM_PRIORITIES);
+        bitmap &= ~(1u << prio);
+
+        thread_t* t = list_peek_tail_type(&c->run_queue[prio], thread_t, queue_node);
+        while (t) {
+            if (!thread_is_idle(t) && (t->cpu_affinity & cpu_mask)) {
+                remove_from_run_queue(t, prio);
+                return t;
+            }
+            t = list_prev_type(&c->run_queue[prio], &t->queue_node, thread_t, queue_node);
+        }
+    }
+
+    return nullptr;
+}
+
+// try to move one queued thread from a busier cpu onto |cpu|'s run queue.
+// if |idle| is set the local cpu has nothing else to run.
+static bool sched_pull_work(cpu_num_t cpu, bool idle) TA_REQ(thread_lock) {
+    const cpu_mask_t local_mask = cpu_num_to_mask(cpu);
+    const cpu_mask_t active = mp_get_active_mask() & ~local_mask;
+    if (active == 0) {
+        return false;
+    }
+
+    const cpu_mask_t smt = mp_get_smt_siblings(cpu) & active;
+    const cpu_mask_t cache = mp_get_cache_siblings(cpu) & active & ~smt;
+    const cpu_mask_t remote = active & ~smt & ~cache;
+
+    struct {
+        cpu_mask_t mask;
+        const struct k_counter_desc* counter;
+    } const levels[] = {
+        {smt, sched_steal_smt},
+        {cache, sched_steal_cache},
+        {remote, sched_steal_remote},
+    };
+
+    const uint32_t min_queued = idle ? 1 : queued_threads(cpu) + SCHED_BALANCE_IMBALANCE;
+
+    kcounter_add(sched_steal_attempts, 1);
+
+    for (const auto& level : levels) {
+        cpu_num_t victim = find_busiest_cpu(level.mask, min_queued);
+        if (victim == INVALID_CPU) {
+            continue;
+        }
+
+        thread_t* t = steal_thread(cpu, victim);
+        if (!t) {
+            continue;
+        }
+
+        LOCAL_KTRACE2("sched_pull_work", victim, (uint32_t)t->user_tid);
+
+        t->curr_cpu = cpu;
+        insert_in_run_queue_tail(cpu, t);
+
+        kcounter_add(sched_steal_success, 1);
+        kcounter_add(level.counter, 1);
+        return true;
+    }
+
+    return false;
+}
+
+// periodic balancing, run from the preemption path of a busy cpu
+static void sched_balance(cpu_num_t cpu) TA_REQ(thread_lock) {
+    struct percpu* c = &percpu[cpu];
+
+    zx_time_t now = current_time();
+    if (now < c->next_balance_time) {
+        return;
+    }
+    c->next_balance_time = zx_time_add_duration(now, SCHED_BALANCE_INTERVAL);
+
+    if (!mp_is_cpu_active(cpu)) {
+        return;
+    }
+
+    // we have queued work that could be running elsewhere right now. an idle cpu pulls
+    // from us as soon as it reschedules, so kick the nearest one.
+    if (queued_threads(cpu) >= SCHED_BALANCE_IMBALANCE) {
+        cpu_mask_t idle = mp_get_idle_mask() & mp_get_active_mask() & ~cpu_num_to_mask(cpu);
+        if (idle) {
+            cpu_mask_t near = idle & mp_get_smt_siblings(cpu);
+            if (!near) {
+                near = idle & mp_get_cache_siblings(cpu);
+            }
+            if (!near) {
+                near = idle;
+            }
+            mp_reschedule(cpu_num_to_mask(lowest_cpu_set(near)), 0);
+            return;
+        }
+    }
+
+    sched_pull_work(cpu, false);
+}
+
 void sched_init_thread(thread_t* t, int priority) {
     t->base_priority = priority;
     t->priority_boost = 0;
     t->inherited_priority = -1;
+    t->futex_inherited_priority = -1;
+    t->futex_owner = nullptr;
+    list_initialize(&t->futex_waiters);
+    t->sched_class = SCHED_CLASS_PRIORITY;
+    t->class_queued = false;
+    t->fair_weight = FAIR_WEIGHT_DEFAULT;
     compute_effec_priority(t);
 }
 
+// give the throttled deadline threads of |cpu| whose next period has started their budget
+// back and queue them again
+static void deadline_replenish(cpu_num_t cpu, zx_time_t now) TA_REQ(thread_lock) {
+    struct percpu* c = &percpu[cpu];
+    if (c->deadline_replenish_time > now) {
+        return;
+    }
+
+    thread_t* t;
+    while ((t = list_peek_head_type(&c->deadline_throttled, thread_t, queue_node)) != NULL &&
+           deadline_next_period(t) <= now) {
+        list_delete(&t->queue_node);
+        t->deadline_throttled = false;
+        deadline_start_next_period(t, now);
+        insert_in_run_queue_tail(cpu, t);
+    }
+    deadline_update_replenish_time(c);
+}
+
+// make sure the preemption timer goes off by the time the next throttled deadline thread
+// on |cpu| gets its budget back
+static void deadline_arm_preempt_timer(cpu_num_t cpu) {
+    zx_time_t replenish_time = percpu[cpu].deadline_replenish_time;
+    if (replenish_time < percpu[cpu].preempt_timer_deadline) {
+        timer_preempt_reset(replenish_time);
+    }
+}
+
+// a deadline thread is waking up. If it can no longer finish its remaining budget by its
+// current deadline, start a new period from now with a full budget.
+static void deadline_wakeup(thread_t* t) {
+    if (t->sched_class != SCHED_CLASS_DEADLINE) {
+        return;
+    }
+
+    zx_time_t now = current_time();
+    if (zx_time_add_duration(now, t->remaining_time_slice) > t->deadline_absolute) {
+        t->deadline_absolute = zx_time_add_duration(now, t->deadline_relative);
+        t->remaining_time_slice = t->deadline_capacity;
+    }
+}
+
 void sched_block() {
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
@@ -337,6 +792,7 @@ bool sched_unblock(thread_t* t) {
 
     // thread is being woken up, boost its priority
     boost_thread(t);
+    deadline_wakeup(t);
 
     // stuff the new thread in the run queue
     t->state = THREAD_READY;
@@ -367,6 +823,7 @@ bool sched_unblock_list(struct list_node* list) {
 
         // thread is being woken up, boost its priority
         boost_thread(t);
+        deadline_wakeup(t);
 
         // stuff the new thread in the run queue
         t->state = THREAD_READY;
@@ -447,6 +904,8 @@ void sched_preempt() {
         } else {
             insert_in_run_queue_tail(curr_cpu, current_thread);
         }
+
+        sched_balance(curr_cpu);
     }
 
     sched_resched_internal();
@@ -531,6 +990,19 @@ void sched_transition_off_cpu(cpu_num_t old_cpu) {
         }
     }
 
+    // Throttled deadline threads wait out their period on another cpu.
+    while ((t = list_remove_head_type(&percpu[old_cpu].deadline_throttled,
+                                      thread_t, queue_node)) != NULL) {
+        t->deadline_throttled = false;
+        if (t->cpu_affinity != pinned_mask) {
+            find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
+            DEBUG_ASSERT(!local_resched);
+        } else {
+            list_add_head(&pinned_threads, &t->queue_node);
+        }
+    }
+    deadline_update_replenish_time(&percpu[old_cpu]);
+
     // Put pinned threads back on old_cpu's queue.
     while ((t = list_remove_head_type(&pinned_threads, thread_t, queue_node)) != NULL) {
         insert_in_run_queue_head(old_cpu, t);
@@ -660,7 +1132,8 @@ static void sched_priority_changed(thread_t* t, int old_prio,
 }
 
 // set the priority to the higher value of what it was before and the newly inherited value
-// pri < 0 disables priority inheritance and goes back to the naturally computed values
+// pri < 0 disables priority inheritance through kernel mutexes and goes back to the naturally
+// computed values, or to what the thread still inherits as a futex owner
 void sched_inherit_priority(thread_t* t, int pri, bool* local_resched) {
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
@@ -673,6 +1146,10 @@ void sched_inherit_priority(thread_t* t, int pri, bool* local_resched) {
         return;
     }
 
+    if (pri < 0) {
+        pri = t->futex_inherited_priority;
+    }
+
     // adjust the priority and remember the old value
     t->inherited_priority = pri;
     int old_ep = t->effec_priority;
@@ -692,6 +1169,168 @@ void sched_inherit_priority(thread_t* t, int pri, bool* local_resched) {
     }
 }
 
+// apply a change to the priority |t| inherits as a futex owner. A boost from a kernel mutex the
+// thread still holds may be higher, so while it holds one the futex boost is only raised; a lower
+// value takes effect when the last mutex is released.
+static void futex_inherited_priority_changed(thread_t* t, bool* local_resched) TA_REQ(thread_lock) {
+    if (t->mutexes_held == 0) {
+        sched_inherit_priority(t, -1, local_resched);
+    } else if (t->futex_inherited_priority >= 0) {
+        sched_inherit_priority(t, t->futex_inherited_priority, local_resched);
+    }
+}
+
+void sched_futex_lend_priority(thread_t* t, thread_t* owner, bool* local_resched) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(t != owner);
+
+    if (t->futex_owner == owner) {
+        return;
+    }
+    sched_futex_unlend_priority(t, local_resched);
+
+    t->futex_owner = owner;
+    t->futex_lent_priority = MIN(t->effec_priority, HIGHEST_PRIORITY);
+    list_add_tail(&owner->futex_waiters, &t->futex_owner_node);
+
+    if (t->futex_lent_priority > owner->futex_inherited_priority) {
+        owner->futex_inherited_priority = t->futex_lent_priority;
+        futex_inherited_priority_changed(owner, local_resched);
+    }
+}
+
+void sched_futex_unlend_priority(thread_t* t, bool* local_resched) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    thread_t* owner = t->futex_owner;
+    if (!owner) {
+        return;
+    }
+    t->futex_owner = nullptr;
+    list_delete(&t->futex_owner_node);
+
+    // the owner's boost only drops if no other waiter lent as much as this one
+    const int old_pri = owner->futex_inherited_priority;
+    if (t->futex_lent_priority < old_pri) {
+        return;
+    }
+    int pri = -1;
+    thread_t* waiter;
+    list_for_every_entry (&owner->futex_waiters, waiter, thread_t, futex_owner_node) {
+        pri = MAX(pri, waiter->futex_lent_priority);
+        if (pri == old_pri) {
+            return;
+        }
+    }
+    owner->futex_inherited_priority = pri;
+    futex_inherited_priority_changed(owner, local_resched);
+}
+
+void sched_futex_owner_exit(thread_t* t) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    thread_t* waiter;
+    while ((waiter = list_remove_head_type(&t->futex_waiters, thread_t, futex_owner_node))) {
+        waiter->futex_owner = nullptr;
+    }
+    t->futex_inherited_priority = -1;
+}
+
+// start changing a thread's scheduling class or class parameters. The thread is pulled out
+// of the queue it's in, since the new parameters may place it in a different one.
+// returns true if the thread has to be put back in a queue by class_change_finish().
+static bool class_change_dequeue(thread_t* t) TA_REQ(thread_lock) {
+    if (t->state != THREAD_READY) {
+        return false;
+    }
+
+    DEBUG_ASSERT_MSG(list_in_list(&t->queue_node), "thread %p name %s curr_cpu %u\n", t, t->name, t->curr_cpu);
+    remove_from_run_queue(t, t->effec_priority);
+    return true;
+}
+
+// finish a change started by class_change_dequeue(): recompute the effective priority, put the
+// thread back in the right queue and reschedule the cpu it is on so the change takes effect
+static void class_change_finish(thread_t* t, int old_ep, bool requeue) TA_REQ(thread_lock) {
+    compute_effec_priority(t);
+
+    bool local_resched = false;
+    cpu_mask_t accum_cpu_mask = 0;
+    switch (t->state) {
+    case THREAD_READY:
+        DEBUG_ASSERT(requeue);
+        insert_in_run_queue_tail(t->curr_cpu, t);
+        __FALLTHROUGH;
+    case THREAD_RUNNING:
+        if (t->curr_cpu == arch_curr_cpu_num()) {
+            local_resched = true;
+        } else {
+            accum_cpu_mask |= cpu_num_to_mask(t->curr_cpu);
+        }
+        break;
+    case THREAD_BLOCKED:
+        if (t->blocking_wait_queue && t->effec_priority != old_ep) {
+            wait_queue_priority_changed(t, old_ep);
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (accum_cpu_mask) {
+        mp_reschedule(accum_cpu_mask, 0);
+    }
+    if (local_resched) {
+        sched_reschedule();
+    }
+}
+
+void sched_set_fair(thread_t* t, uint32_t weight) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(weight >= FAIR_WEIGHT_MIN && weight <= FAIR_WEIGHT_MAX);
+
+    if (unlikely(t->state == THREAD_DEATH)) {
+        return;
+    }
+
+    int old_ep = t->effec_priority;
+    bool requeue = class_change_dequeue(t);
+
+    // start from the floor of whichever queue it lands in
+    t->sched_class = SCHED_CLASS_FAIR;
+    t->fair_weight = weight;
+    t->fair_vruntime = 0;
+    t->fair_charged_time = current_time();
+    t->priority_boost = 0;
+
+    class_change_finish(t, old_ep, requeue);
+}
+
+void sched_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t relative_deadline,
+                        zx_duration_t period) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(capacity > 0 && capacity <= relative_deadline && relative_deadline <= period);
+    DEBUG_ASSERT(capacity < ZX_SEC(1));
+
+    if (unlikely(t->state == THREAD_DEATH)) {
+        return;
+    }
+
+    int old_ep = t->effec_priority;
+    bool requeue = class_change_dequeue(t);
+
+    // the first period starts now with a full budget
+    t->sched_class = SCHED_CLASS_DEADLINE;
+    t->deadline_capacity = capacity;
+    t->deadline_relative = relative_deadline;
+    t->deadline_period = period;
+    t->deadline_absolute = zx_time_add_duration(current_time(), relative_deadline);
+    t->remaining_time_slice = capacity;
+    t->priority_boost = 0;
+
+    class_change_finish(t, old_ep, requeue);
+}
+
 // changes the thread's base priority and if the re-computed effective priority changed
 //  then the thread is moved to the proper queue on the same processor and a re-schedule
 //  might be issued.
@@ -706,6 +1345,20 @@ void sched_change_priority(thread_t* t, int pri) {
         pri = HIGHEST_PRIORITY;
     }
 
+    // setting a priority moves a fair or deadline thread back into the priority class
+    if (t->sched_class != SCHED_CLASS_PRIORITY) {
+        int old_ep = t->effec_priority;
+        bool requeue = class_change_dequeue(t);
+
+        t->sched_class = SCHED_CLASS_PRIORITY;
+        t->base_priority = pri;
+        t->priority_boost = 0;
+        t->remaining_time_slice = MIN(t->remaining_time_slice, THREAD_INITIAL_TIME_SLICE);
+
+        class_change_finish(t, old_ep, requeue);
+        return;
+    }
+
     int old_ep = t->effec_priority;
     t->base_priority = pri;
     t->priority_boost = 0;
@@ -733,6 +1386,12 @@ void sched_change_priority(thread_t* t, int pri) {
 
 // preemption timer that is set whenever a thread is scheduled
 void sched_preempt_timer_tick(zx_time_t now) {
+    // a throttled deadline thread gets its budget back, let the scheduler queue it again
+    cpu_num_t cpu = arch_curr_cpu_num();
+    if (__atomic_load_n(&percpu[cpu].deadline_replenish_time, __ATOMIC_RELAXED) <= now) {
+        thread_preempt_set_pending();
+    }
+
     // if the preemption timer went off on the idle or a real time thread, ignore it
     thread_t* current_thread = get_current_thread();
     if (unlikely(thread_is_real_time_or_idle(current_thread))) {
@@ -787,11 +1446,24 @@ void sched_resched_internal() {
 
     CPU_STATS_INC(reschedules);
 
-    // pick a new thread to run
+    deadline_replenish(cpu, current_time());
+
+    // rather than go idle, see if a busier cpu has work queued that we can run
+    if (percpu[cpu].run_queue_len == 0 && mp_is_cpu_active(cpu)) {
+        sched_pull_work(cpu, true);
+    }
+
+    // pick a new thread to run, timing how long the decision takes
+    zx_ticks_t pick_start = current_ticks();
     thread_t* newthread = sched_get_top_thread(cpu);
+    zx_ticks_t pick_ticks = current_ticks() - pick_start;
 
     DEBUG_ASSERT(newthread);
 
+    ktrace(TAG_SCHED_DECISION, (uint32_t)newthread->user_tid,
+           (cpu | (newthread->sched_class << 8)), (uint32_t)pick_ticks,
+           percpu[cpu].run_queue_bitmap);
+
     newthread->state = THREAD_RUNNING;
 
     thread_t* oldthread = current_thread;
@@ -806,6 +1478,7 @@ void sched_resched_internal() {
 
     // if it's the same thread as we're already running, exit
     if (newthread == oldthread) {
+        deadline_arm_preempt_timer(cpu);
         return;
     }
 
@@ -817,10 +1490,29 @@ void sched_resched_internal() {
     oldthread->runtime_ns = zx_duration_add_duration(oldthread->runtime_ns, old_runtime);
     oldthread->remaining_time_slice = zx_duration_sub_duration(
         oldthread->remaining_time_slice, MIN(old_runtime, oldthread->remaining_time_slice));
+    if (oldthread->sched_class == SCHED_CLASS_FAIR) {
+        fair_charge_runtime(oldthread, now);
+    }
 
     // set up quantum for the new thread if it was consumed
     if (newthread->remaining_time_slice == 0) {
-        newthread->remaining_time_slice = THREAD_INITIAL_TIME_SLICE;
+        switch (newthread->sched_class) {
+        case SCHED_CLASS_FAIR:
+            newthread->remaining_time_slice = fair_time_slice(&percpu[cpu], newthread);
+            break;
+        case SCHED_CLASS_DEADLINE:
+            // the budget only comes back at the start of a period, so this is a thread
+            // running above its band on an inherited priority. Let it run a regular slice
+            // until it gives the priority back.
+            newthread->remaining_time_slice = THREAD_INITIAL_TIME_SLICE;
+            break;
+        default:
+            newthread->remaining_time_slice = THREAD_INITIAL_TIME_SLICE;
+            break;
+        }
+    }
+    if (newthread->sched_class == SCHED_CLASS_FAIR) {
+        newthread->fair_charged_time = now;
     }
 
     newthread->last_started_running = now;
@@ -877,6 +1569,7 @@ void sched_resched_internal() {
 
         timer_preempt_reset(zx_time_add_duration(now, newthread->remaining_time_slice));
     }
+    deadline_arm_preempt_timer(cpu);
 
     // set some optional target debug leds
     target_set_debug_led(0, !thread_is_idle(newthread));
@@ -900,8 +1593,13 @@ void sched_resched_internal() {
 
 void sched_init_early() {
     // initialize the run queues
-    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++)
+    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
         for (unsigned int i = 0; i < NUM_PRIORITIES; i++) {
             list_initialize(&percpu[cpu].run_queue[i]);
         }
+        list_initialize(&percpu[cpu].fair_queue);
+        list_initialize(&percpu[cpu].deadline_queue);
+        list_initialize(&percpu[cpu].deadline_throttled);
+        percpu[cpu].deadline_replenish_time = ZX_TIME_INFINITE;
+    }
 }
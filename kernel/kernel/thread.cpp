@@ -482,6 +482,9 @@ __NO_RETURN static void thread_exit_locked(thread_t* current_thread,
     current_thread->state = THREAD_DEATH;
     current_thread->retcode = retcode;
 
+    // the threads waiting on futexes it owned can't lend it their priority anymore
+    sched_futex_owner_exit(current_thread);
+
     // if we're detached, then do our teardown here
     if (current_thread->flags & THREAD_FLAG_DETACHED) {
         // remove it from the master thread list
@@ -1039,6 +1042,45 @@ void thread_set_priority(thread_t* t, int priority) {
     sched_change_priority(t, priority);
 }
 
+/**
+ * @brief  Move a thread into the fair scheduling class
+ *
+ * The thread shares the cpu with other fair threads in proportion to its weight.
+ * Applying a priority with thread_set_priority() moves it back to the priority class.
+ *
+ * @param t       Thread to change
+ * @param weight  Share weight, FAIR_WEIGHT_MIN to FAIR_WEIGHT_MAX
+ */
+void thread_set_fair_weight(thread_t* t, uint32_t weight) {
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+    DEBUG_ASSERT(weight >= FAIR_WEIGHT_MIN && weight <= FAIR_WEIGHT_MAX);
+
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+
+    sched_set_fair(t, weight);
+}
+
+/**
+ * @brief  Move a thread into the deadline scheduling class
+ *
+ * The thread is guaranteed up to |capacity| of cpu time in every |period|,
+ * delivered within |relative_deadline| of the start of the period.
+ *
+ * @param t                  Thread to change
+ * @param capacity           Cpu time per period, less than one second
+ * @param relative_deadline  Deadline from the start of each period
+ * @param period             Length of the period
+ */
+void thread_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t relative_deadline,
+                         zx_duration_t period) {
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+    DEBUG_ASSERT(capacity > 0 && capacity <= relative_deadline && relative_deadline <= period);
+
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+
+    sched_set_deadline(t, capacity, relative_deadline, period);
+}
+
 /**
  * @brief  Become an idle thread
  *
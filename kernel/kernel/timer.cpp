@@ -74,110 +74,84 @@ static void insert_timer_in_queue(uint cpu, timer_t* timer,
     LTRACEF("timer %p, cpu %u, scheduled %" PRIi64 "\n", timer, cpu, timer->scheduled_time);
 
     // For inserting the timer we consider several cases. In general we
-    // want to coalesce with the current timer unless we can prove that
+    // want to coalesce with an existing timer unless we can prove that
     // either that:
-    //  1- there is no slack overlap with current timer OR
-    //  2- the next timer is a better fit.
+    //  1- there is no slack overlap with any existing timer OR
+    //  2- another timer is a better fit.
+    //
+    // Only the two timers surrounding the new one can be candidates, as any
+    // other timer in the slack interval is further away than one of them.
     //
     // In diagrams that follow
-    // - Let |e| be the current (existing) timer deadline
     // - Let |t| be the deadline of the timer we are inserting
-    // - Let |n| be the next timer deadline if any
-    // - Let |x| be the end of the list (not a timer)
+    // - Let |p| be the last timer deadline before |t|, if any
+    // - Let |n| be the first timer deadline at or after |t|, if any
     // - Let |(| and |)| the earliest_deadline and latest_deadline.
     //
-    timer_t* entry;
-
-    list_for_every_entry (&percpu[cpu].timer_queue, entry, timer_t, node) {
-        if (entry->scheduled_time > latest_deadline) {
-            // New timer latest is earlier than the current timer.
-            // Just add upfront as is, without slack.
-            //
-            //   ---------t---)--e-------------------------------> time
-            //
-            timer->slack = 0ll;
-            list_add_before(&entry->node, &timer->node);
-            return;
-        }
-
-        if (entry->scheduled_time >= timer->scheduled_time) {
-            //  New timer slack overlaps and is to the left (or equal). We
-            //  coalesce with current by scheduling late.
-            //
-            //  --------(----t---e-)----------------------------> time
-            //
-            timer->slack = zx_time_sub_time(entry->scheduled_time, timer->scheduled_time);
-            timer->scheduled_time = entry->scheduled_time;
-            list_add_after(&entry->node, &timer->node);
-            return;
-        }
+    TimerQueue& queue = percpu[cpu].timer_queue;
 
-        if (entry->scheduled_time < earliest_deadline) {
-            // new timer earliest is later than the current timer. This case
-            // is handled in a future iteration.
-            //
-            //   ----------------e--(---t-----------------------> time
-            //
-            continue;
-        }
+    auto next = queue.lower_bound({timer->scheduled_time, nullptr});
+    auto prev = next;
+    --prev;
 
-        // New timer is to the right of current timer and there is overlap
-        // with the current timer, but could the next timer (if any) be
-        // a better fit?
+    // Candidates outside of the slack interval don't overlap with the new timer.
+    //
+    //   ------p--(---t---)--n-------------------------------> time
+    //
+    const timer_t* n = (next.IsValid() && next->scheduled_time <= latest_deadline)
+                           ? &*next
+                           : nullptr;
+    const timer_t* p = (prev.IsValid() && prev->scheduled_time >= earliest_deadline)
+                           ? &*prev
+                           : nullptr;
+
+    const timer_t* target = nullptr;
+    if (n != NULL && p != NULL) {
+        // There is slack overlap with both timers. Which coalescing is a
+        // better match? Scheduling late wins ties that are exactly at the
+        // deadline, as does a timer that is closer.
         //
-        //  -------------(--e---t-----?-------------------> time
+        //  --------------(-p---t---n-)-----------------------> time
         //
-
-        const timer_t* next =
-            list_next_type(&percpu[cpu].timer_queue, &entry->node, timer_t, node);
-
-        if (next != NULL) {
-            if (next->scheduled_time <= timer->scheduled_time) {
-                // The new timer is to the right of the next timer. There is no
-                // chance the current timer is a better fit.
-                //
-                //  -------------(--e---n---t----------------------> time
-                //
-                continue;
-            }
-
-            if (next->scheduled_time < latest_deadline) {
-                // There is slack overlap with the next timer, and also with the
-                // current timer. Which coalescing is a better match?
-                //
-                //  --------------(-e---t---n-)-----------------------> time
-                //
-                zx_duration_t delta_entry =
-                    zx_time_sub_time(timer->scheduled_time, entry->scheduled_time);
-                zx_duration_t delta_next =
-                    zx_time_sub_time(next->scheduled_time, timer->scheduled_time);
-                if (delta_next < delta_entry) {
-                    // New timer is closer to the next timer, handle it in the
-                    // next iteration.
-                    continue;
-                }
-            }
+        zx_duration_t delta_prev = zx_time_sub_time(timer->scheduled_time, p->scheduled_time);
+        zx_duration_t delta_next = zx_time_sub_time(n->scheduled_time, timer->scheduled_time);
+        if (delta_next == 0 || (n->scheduled_time < latest_deadline && delta_next < delta_prev)) {
+            target = n;
+        } else {
+            target = p;
         }
-
-        // Handles the remaining cases, note that there is overlap with
-        // the current timer.
+    } else if (n != NULL) {
+        //  New timer slack overlaps and is to the left (or equal). We
+        //  coalesce with next by scheduling late.
         //
-        //  1- this is the last timer (next == NULL) or
-        //  2- there is no overlap with the next timer, or
-        //  3- there is overlap with both current and next but
-        //     current is closer.
+        //  --------(----t---n-)----------------------------> time
         //
-        //  So we coalesce by scheduling early.
+        target = n;
+    } else if (p != NULL) {
+        //  New timer slack overlaps and is to the right. We coalesce with
+        //  prev by scheduling early.
         //
-        timer->slack = zx_time_sub_time(entry->scheduled_time, timer->scheduled_time);
-        timer->scheduled_time = entry->scheduled_time;
-        list_add_after(&entry->node, &timer->node);
-        return;
+        //  -------------(--p---t---------)-------------------> time
+        //
+        target = p;
     }
 
-    // Walked off the end of the list and there was no overlap.
-    timer->slack = 0;
-    list_add_tail(&percpu[cpu].timer_queue, &timer->node);
+    if (target != NULL) {
+        timer->slack = zx_time_sub_time(target->scheduled_time, timer->scheduled_time);
+        timer->scheduled_time = target->scheduled_time;
+    } else {
+        // No overlap, add it as is, without slack.
+        timer->slack = 0;
+    }
+
+    timer->queue_cpu = cpu;
+    queue.insert(timer);
+}
+
+// Returns the timer at the head of |cpu|'s queue, or NULL if it is empty.
+static timer_t* timer_queue_head(uint cpu) {
+    TimerQueue& queue = percpu[cpu].timer_queue;
+    return queue.is_empty() ? NULL : &queue.front();
 }
 
 void timer_set(timer_t* timer, zx_time_t deadline,
@@ -190,7 +164,7 @@ void timer_set(timer_t* timer, zx_time_t deadline,
     DEBUG_ASSERT(mode <= TIMER_SLACK_EARLY);
     DEBUG_ASSERT(slack >= 0);
 
-    if (list_in_list(&timer->node)) {
+    if (timer->node.InContainer()) {
         panic("timer %p already in list\n", timer);
     }
 
@@ -244,7 +218,7 @@ void timer_set(timer_t* timer, zx_time_t deadline,
 
     insert_timer_in_queue(cpu, timer, earliest_deadline, latest_deadline);
 
-    if (list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node) == timer) {
+    if (timer_queue_head(cpu) == timer) {
         // we just modified the head of the timer queue
         update_platform_timer(cpu, deadline);
     }
@@ -299,14 +273,14 @@ bool timer_cancel(timer_t* timer) {
     bool callback_not_running;
 
     // if the timer is in a queue, remove it and adjust hardware timers if needed
-    if (list_in_list(&timer->node)) {
+    if (timer->node.InContainer()) {
         callback_not_running = true;
 
         // save a copy of the old head of the queue so later we can see if we modified the head
-        timer_t* oldhead = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+        timer_t* oldhead = timer_queue_head(cpu);
 
         // remove our timer from the queue
-        list_delete(&timer->node);
+        percpu[timer->queue_cpu].timer_queue.erase(*timer);
 
         // TODO(cpu): if  after removing |timer| there is one other single timer with
         // the same scheduled_time and slack non-zero then it is possible to return
@@ -316,7 +290,7 @@ bool timer_cancel(timer_t* timer) {
         // if we modified another cpu's queue, we'll just let it fire and sort itself out
         if (unlikely(oldhead == timer)) {
             // timer we're canceling was at head of queue, see if we should update platform timer
-            timer_t* newhead = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+            timer_t* newhead = timer_queue_head(cpu);
             if (newhead) {
                 update_platform_timer(cpu, newhead->scheduled_time);
             } else if (percpu[cpu].next_timer_deadline == ZX_TIME_INFINITE) {
@@ -367,7 +341,7 @@ void timer_tick(zx_time_t now) {
 
     for (;;) {
         // see if there's an event to process
-        timer = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+        timer = timer_queue_head(cpu);
         if (likely(timer == 0)) {
             break;
         }
@@ -382,7 +356,7 @@ void timer_tick(zx_time_t now) {
         DEBUG_ASSERT_MSG(timer && timer->magic == TIMER_MAGIC,
                          "ASSERT: timer failed magic check: timer %p, magic 0x%x\n",
                          timer, (uint)timer->magic);
-        list_delete(&timer->node);
+        percpu[cpu].timer_queue.erase(*timer);
 
         // mark the timer busy
         timer->active_cpu = cpu;
@@ -409,7 +383,7 @@ void timer_tick(zx_time_t now) {
 
     // get the deadline of the event at the head of the queue (if any)
     zx_time_t deadline = ZX_TIME_INFINITE;
-    timer = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+    timer = timer_queue_head(cpu);
     if (timer) {
         deadline = timer->scheduled_time;
 
@@ -447,19 +421,18 @@ void timer_transition_off_cpu(uint old_cpu) {
     Guard<spin_lock_t, IrqSave> guard{TimerLock::Get()};
     uint cpu = arch_curr_cpu_num();
 
-    timer_t* old_head = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+    timer_t* old_head = timer_queue_head(cpu);
 
-    timer_t *entry = NULL, *tmp_entry = NULL;
     // Move all timers from old_cpu to this cpu
-    list_for_every_entry_safe (&percpu[old_cpu].timer_queue, entry, tmp_entry, timer_t, node) {
-        list_delete(&entry->node);
+    while (!percpu[old_cpu].timer_queue.is_empty()) {
+        timer_t* entry = percpu[old_cpu].timer_queue.pop_front();
         // We lost the original asymmetric slack information so when we combine them
         // with the other timer queue they are not coalesced again.
         // TODO(cpu): figure how important this case is.
         insert_timer_in_queue(cpu, entry, entry->scheduled_time, entry->scheduled_time);
     }
 
-    timer_t* new_head = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+    timer_t* new_head = timer_queue_head(cpu);
     if (new_head != NULL && new_head != old_head) {
         // we just modified the head of the timer queue
         update_platform_timer(cpu, new_head->scheduled_time);
@@ -480,7 +453,7 @@ void timer_thaw_percpu(void) {
     percpu[cpu].next_timer_deadline = ZX_TIME_INFINITE;
     zx_time_t deadline = percpu[cpu].preempt_timer_deadline;
 
-    timer_t* t = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+    timer_t* t = timer_queue_head(cpu);
     if (t) {
         if (t->scheduled_time < deadline) {
             deadline = t->scheduled_time;
@@ -494,7 +467,7 @@ void timer_thaw_percpu(void) {
 
 void timer_queue_init(void) {
     for (uint i = 0; i < SMP_MAX_CPUS; i++) {
-        list_initialize(&percpu[i].timer_queue);
+        DEBUG_ASSERT(percpu[i].timer_queue.is_empty());
         percpu[i].preempt_timer_deadline = ZX_TIME_INFINITE;
         percpu[i].next_timer_deadline = ZX_TIME_INFINITE;
     }
@@ -507,19 +480,22 @@ static void dump_timer_queues(char* buf, size_t len) {
 
     Guard<spin_lock_t, IrqSave> guard{TimerLock::Get()};
 
-    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+    // queues can be long, stop once the buffer is full.
+    for (uint i = 0; i < SMP_MAX_CPUS && ptr < len; i++) {
         if (mp_is_cpu_online(i)) {
             ptr += snprintf(buf + ptr, len - ptr, "cpu %u:\n", i);
 
-            timer_t* t;
             zx_time_t last = now;
-            list_for_every_entry (&percpu[i].timer_queue, t, timer_t, node) {
-                zx_duration_t delta_now = zx_time_sub_time(t->scheduled_time, now);
-                zx_duration_t delta_last = zx_time_sub_time(t->scheduled_time, last);
+            for (const timer_t& t : percpu[i].timer_queue) {
+                if (ptr >= len) {
+                    break;
+                }
+                zx_duration_t delta_now = zx_time_sub_time(t.scheduled_time, now);
+                zx_duration_t delta_last = zx_time_sub_time(t.scheduled_time, last);
                 ptr += snprintf(buf + ptr, len - ptr,
                                 "\ttime %" PRIi64 " delta_now %" PRIi64 " delta_last %" PRIi64 " func %p arg %p\n",
-                                t->scheduled_time, delta_now, delta_last, t->callback, t->arg);
-                last = t->scheduled_time;
+                                t.scheduled_time, delta_now, delta_last, t.callback, t.arg);
+                last = t.scheduled_time;
             }
         }
     }
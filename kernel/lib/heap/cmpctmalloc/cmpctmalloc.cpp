@@ -897,22 +897,15 @@ void cmpct_trim(void) {
     unlock();
 }
 
-void* cmpct_alloc(size_t size) {
-    if (size == 0u) {
-        return NULL;
-    }
-
-    // Large allocations are no longer allowed. See ZX-1318 for details.
-    if (size > (HEAP_LARGE_ALLOC_BYTES - sizeof(header_t))) {
-        return NULL;
-    }
-
+// Carves an allocation of |size| bytes (already checked by the caller) out of
+// the free lists, growing the heap if needed. Returns NULL if the heap can't
+// grow.
+static void* alloc_locked(size_t size) TA_REQ(theheap.lock) {
     size_t rounded_up;
     int start_bucket = size_to_index_allocating(size, &rounded_up);
 
     rounded_up += sizeof(header_t);
 
-    lock();
     int bucket = find_nonempty_bucket(start_bucket);
     if (bucket == -1) {
         // Grow heap by at least 12% if we can.
@@ -923,7 +916,6 @@ void* cmpct_alloc(size_t size) {
         // we succeed or get too small.
         while (heap_grow(growby) < 0) {
             if (growby <= rounded_up) {
-                unlock();
                 return NULL;
             }
             growby = MAX(growby >> 1, rounded_up);
@@ -955,10 +947,42 @@ void* cmpct_alloc(size_t size) {
     memset(((char*)result) + size, PADDING_FILL,
            rounded_up - size - sizeof(header_t));
 #endif
+    return result;
+}
+
+static bool is_valid_alloc_size(size_t size) {
+    // Large allocations are no longer allowed. See ZX-1318 for details.
+    return size != 0u && size <= (HEAP_LARGE_ALLOC_BYTES - sizeof(header_t));
+}
+
+void* cmpct_alloc(size_t size) {
+    if (!is_valid_alloc_size(size)) {
+        return NULL;
+    }
+
+    lock();
+    void* result = alloc_locked(size);
     unlock();
     return result;
 }
 
+size_t cmpct_alloc_many(size_t size, void** ptrs, size_t count) {
+    if (!is_valid_alloc_size(size)) {
+        return 0;
+    }
+
+    size_t i;
+    lock();
+    for (i = 0; i < count; i++) {
+        ptrs[i] = alloc_locked(size);
+        if (ptrs[i] == NULL) {
+            break;
+        }
+    }
+    unlock();
+    return i;
+}
+
 void* cmpct_memalign(size_t size, size_t alignment) {
     if (alignment < 8) {
         return cmpct_alloc(size);
@@ -995,14 +1019,11 @@ void* cmpct_memalign(size_t size, size_t alignment) {
     return payload;
 }
 
-void cmpct_free(void* payload) {
-    if (payload == NULL) {
-        return;
-    }
+// Returns |payload| to the free lists, coalescing it with its neighbours.
+static void free_locked(void* payload) TA_REQ(theheap.lock) {
     header_t* header = (header_t*)payload - 1;
     DEBUG_ASSERT(!is_tagged_as_free(header)); // Double free!
     size_t size = header->size;
-    lock();
     header_t* left = header->left;
     if (left != NULL && is_tagged_as_free(left)) {
         // Coalesce with left free object.
@@ -1031,9 +1052,32 @@ void cmpct_free(void* payload) {
             free_memory(header, left, size);
         }
     }
+}
+
+void cmpct_free(void* payload) {
+    if (payload == NULL) {
+        return;
+    }
+    lock();
+    free_locked(payload);
+    unlock();
+}
+
+void cmpct_free_many(void** ptrs, size_t count) {
+    lock();
+    for (size_t i = 0; i < count; i++) {
+        if (ptrs[i] != NULL) {
+            free_locked(ptrs[i]);
+        }
+    }
     unlock();
 }
 
+size_t cmpct_usable_size(const void* payload) {
+    const header_t* header = (const header_t*)payload - 1;
+    return header->size - sizeof(header_t);
+}
+
 void* cmpct_realloc(void* payload, size_t size) {
     if (payload == NULL) {
         return cmpct_alloc(size);
@@ -19,6 +19,16 @@ void* cmpct_realloc(void*, size_t);
 void cmpct_free(void*);
 void* cmpct_memalign(size_t size, size_t alignment);
 
+// Batched forms of cmpct_alloc() and cmpct_free() that take the heap lock once
+// for the whole batch. cmpct_alloc_many() returns the number of |size| byte
+// blocks it stored in |ptrs|, which is less than |count| if the heap ran out.
+size_t cmpct_alloc_many(size_t size, void** ptrs, size_t count);
+void cmpct_free_many(void** ptrs, size_t count);
+
+// Returns the number of bytes that can be used at |ptr|, which is at least the
+// size that was asked for when it was allocated.
+size_t cmpct_usable_size(const void* ptr);
+
 void cmpct_init(void);
 void cmpct_dump(bool panic_time);
 void cmpct_get_info(size_t* size_bytes, size_t* free_bytes);
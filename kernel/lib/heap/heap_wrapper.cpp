@@ -11,11 +11,18 @@
 #include <assert.h>
 #include <debug.h>
 #include <err.h>
+#include <fbl/algorithm.h>
+#include <fbl/atomic.h>
+#include <kernel/align.h>
 #include <kernel/auto_lock.h>
+#include <kernel/cmdline.h>
 #include <kernel/spinlock.h>
+#include <kernel/thread.h>
 #include <lib/cmpctmalloc.h>
 #include <lib/console.h>
+#include <lib/counters.h>
 #include <list.h>
+#include <lk/init.h>
 #include <stdlib.h>
 #include <string.h>
 #include <trace.h>
@@ -128,14 +135,292 @@ void dump_stats() {
 
 } // namespace
 
+// Per-cpu object caches
+//
+// Small allocations are served from per-cpu magazines of free blocks, one per
+// size class, so a malloc/free pair on a warm cpu doesn't touch the heap lock.
+// An empty magazine is refilled with half a magazine of blocks in a single
+// trip to the heap, and a full one hands its older half back the same way.
+// Rounds that sit unused in a magazine for a whole trim period are returned to
+// the heap by the trim thread.
+namespace {
+
+constexpr size_t cache_class_sizes[] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 2048,
+};
+constexpr size_t num_cache_classes = fbl::count_of(cache_class_sizes);
+constexpr size_t max_cached_size = cache_class_sizes[num_cache_classes - 1];
+
+// Blocks are filed on free by their usable size, which cmpctmalloc may round
+// past the size that was asked for. Don't keep blocks that are much larger than
+// the biggest class.
+constexpr size_t max_cached_usable_size = max_cached_size + max_cached_size / 16;
+
+constexpr size_t magazine_size = 32;
+constexpr size_t magazine_batch = magazine_size / 2;
+
+constexpr zx_duration_t cache_trim_interval = ZX_SEC(1);
+
+#define HEAP_CACHE_COUNTERS(size)                                      \
+    KCOUNTER(cache_hit_##size, "kernel.heap.cache." #size ".hit");    \
+    KCOUNTER(cache_miss_##size, "kernel.heap.cache." #size ".miss")
+
+HEAP_CACHE_COUNTERS(16);
+HEAP_CACHE_COUNTERS(32);
+HEAP_CACHE_COUNTERS(48);
+HEAP_CACHE_COUNTERS(64);
+HEAP_CACHE_COUNTERS(96);
+HEAP_CACHE_COUNTERS(128);
+HEAP_CACHE_COUNTERS(192);
+HEAP_CACHE_COUNTERS(256);
+HEAP_CACHE_COUNTERS(384);
+HEAP_CACHE_COUNTERS(512);
+HEAP_CACHE_COUNTERS(768);
+HEAP_CACHE_COUNTERS(1024);
+HEAP_CACHE_COUNTERS(2048);
+
+const k_counter_desc* const cache_hit_counters[] = {
+    cache_hit_16, cache_hit_32, cache_hit_48, cache_hit_64, cache_hit_96,
+    cache_hit_128, cache_hit_192, cache_hit_256, cache_hit_384, cache_hit_512,
+    cache_hit_768, cache_hit_1024, cache_hit_2048,
+};
+const k_counter_desc* const cache_miss_counters[] = {
+    cache_miss_16, cache_miss_32, cache_miss_48, cache_miss_64, cache_miss_96,
+    cache_miss_128, cache_miss_192, cache_miss_256, cache_miss_384, cache_miss_512,
+    cache_miss_768, cache_miss_1024, cache_miss_2048,
+};
+static_assert(fbl::count_of(cache_hit_counters) == num_cache_classes, "");
+static_assert(fbl::count_of(cache_miss_counters) == num_cache_classes, "");
+
+struct magazine {
+    void* rounds[magazine_size];
+    size_t count;
+
+    // lowest |count| since the last trim pass; that many rounds went unused
+    size_t low_water;
+
+    // kept here as well as in the kcounters so the console can read them
+    uint64_t hits;
+    uint64_t misses;
+};
+
+struct heap_cache {
+    SpinLock lock;
+    magazine magazines[num_cache_classes];
+} __CPU_ALIGN;
+
+heap_cache heap_caches[SMP_MAX_CPUS];
+
+// smallest class that fits an allocation, and largest class that fits in a
+// freed block, indexed by size / 16; -1 where there is none
+int8_t alloc_class[max_cached_size / 16 + 1];
+int8_t free_class[max_cached_usable_size / 16 + 1];
+
+// set once the trim thread is running, unless disabled on the command line
+fbl::atomic<bool> cache_enabled;
+
+void init_cache_classes() {
+    int8_t cls = -1;
+    for (size_t i = 0; i < fbl::count_of(free_class); i++) {
+        while (static_cast<size_t>(cls + 1) < num_cache_classes &&
+               cache_class_sizes[cls + 1] <= i * 16) {
+            cls++;
+        }
+        free_class[i] = cls;
+    }
+
+    cls = 0;
+    alloc_class[0] = -1;
+    for (size_t i = 1; i < fbl::count_of(alloc_class); i++) {
+        while (cache_class_sizes[cls] < i * 16) {
+            cls++;
+        }
+        alloc_class[i] = cls;
+    }
+}
+
+heap_cache* current_cache() {
+    // we may migrate right after this, which only costs a little locality
+    return &heap_caches[arch_curr_cpu_num()];
+}
+
+// Hands |count| rounds from the bottom (coldest end) of |mag| to |out|.
+void take_rounds(magazine* mag, void** out, size_t count) {
+    DEBUG_ASSERT(count <= mag->count);
+    memcpy(out, mag->rounds, count * sizeof(void*));
+    memmove(mag->rounds, mag->rounds + count, (mag->count - count) * sizeof(void*));
+    mag->count -= count;
+    mag->low_water = fbl::min(mag->low_water, mag->count);
+}
+
+// Returns rounds from every magazine to the heap: all of them if |all|,
+// otherwise only those that went unused since the last pass.
+void cache_trim(bool all) {
+    void* batch[magazine_size];
+
+    for (uint cpu = 0; cpu < arch_max_num_cpus(); cpu++) {
+        heap_cache* cache = &heap_caches[cpu];
+        for (size_t cls = 0; cls < num_cache_classes; cls++) {
+            size_t count;
+            {
+                AutoSpinLock guard(&cache->lock);
+                magazine* mag = &cache->magazines[cls];
+                count = all ? mag->count : mag->low_water;
+                take_rounds(mag, batch, count);
+                mag->low_water = mag->count;
+            }
+            if (count > 0) {
+                cmpct_free_many(batch, count);
+            }
+        }
+    }
+}
+
+void* cache_alloc(size_t size) {
+    const int cls = alloc_class[(size + 15) / 16];
+    {
+        heap_cache* cache = current_cache();
+        AutoSpinLock guard(&cache->lock);
+
+        magazine* mag = &cache->magazines[cls];
+        if (mag->count > 0) {
+            void* ptr = mag->rounds[--mag->count];
+            mag->low_water = fbl::min(mag->low_water, mag->count);
+            mag->hits++;
+            kcounter_add(cache_hit_counters[cls], 1);
+            return ptr;
+        }
+        mag->misses++;
+    }
+    kcounter_add(cache_miss_counters[cls], 1);
+
+    void* batch[magazine_batch];
+    size_t count = cmpct_alloc_many(cache_class_sizes[cls], batch, magazine_batch);
+    if (count == 0) {
+        // the last free memory may be sitting in other cpus' magazines
+        cache_trim(true);
+        return cmpct_alloc(size);
+    }
+
+    // keep the first block for the caller and stash the rest, unless the
+    // magazine was refilled by someone else in the meantime
+    size_t stashed = 0;
+    {
+        heap_cache* cache = current_cache();
+        AutoSpinLock guard(&cache->lock);
+
+        magazine* mag = &cache->magazines[cls];
+        stashed = fbl::min(count - 1, magazine_size - mag->count);
+        memcpy(mag->rounds + mag->count, batch + 1, stashed * sizeof(void*));
+        mag->count += stashed;
+    }
+    if (1 + stashed < count) {
+        cmpct_free_many(batch + 1 + stashed, count - 1 - stashed);
+    }
+
+    return batch[0];
+}
+
+// Returns false if |ptr| doesn't belong in any magazine.
+bool cache_free(void* ptr) {
+    const size_t usable = cmpct_usable_size(ptr);
+    if (usable > max_cached_usable_size) {
+        return false;
+    }
+    const int cls = free_class[usable / 16];
+    if (cls < 0) {
+        return false;
+    }
+
+    void* batch[magazine_batch];
+    size_t count = 0;
+    {
+        heap_cache* cache = current_cache();
+        AutoSpinLock guard(&cache->lock);
+
+        magazine* mag = &cache->magazines[cls];
+        if (mag->count == magazine_size) {
+            count = magazine_batch;
+            take_rounds(mag, batch, count);
+        }
+        mag->rounds[mag->count++] = ptr;
+    }
+    if (count > 0) {
+        cmpct_free_many(batch, count);
+    }
+
+    return true;
+}
+
+int cache_trim_thread(void*) {
+    for (;;) {
+        thread_sleep_relative(cache_trim_interval);
+        cache_trim(false);
+    }
+    return 0;
+}
+
+void heap_cache_init(uint /*level*/) {
+    if (!cmdline_get_bool("kernel.heap.cache", true)) {
+        return;
+    }
+
+    thread_t* t = thread_create("heap cache trim", &cache_trim_thread, nullptr,
+                                LOW_PRIORITY);
+    thread_detach_and_resume(t);
+
+    cache_enabled.store(true);
+}
+
+#if LK_DEBUGLEVEL > 1
+void dump_cache() {
+    printf("%6s %12s %12s %6s %8s\n", "class", "hits", "misses", "hit%", "cached");
+
+    size_t cached_bytes = 0;
+    for (size_t cls = 0; cls < num_cache_classes; cls++) {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t cached = 0;
+        for (uint cpu = 0; cpu < arch_max_num_cpus(); cpu++) {
+            heap_cache* cache = &heap_caches[cpu];
+            AutoSpinLock guard(&cache->lock);
+
+            const magazine* mag = &cache->magazines[cls];
+            hits += mag->hits;
+            misses += mag->misses;
+            cached += mag->count;
+        }
+        const uint64_t total = hits + misses;
+        printf("%6zu %12" PRIu64 " %12" PRIu64 " %5" PRIu64 "%% %8zu\n",
+               cache_class_sizes[cls], hits, misses, total ? hits * 100 / total : 0, cached);
+        cached_bytes += cached * cache_class_sizes[cls];
+    }
+    printf("%zu bytes cached, caches are %s\n", cached_bytes,
+           cache_enabled.load() ? "enabled" : "disabled");
+}
+#endif
+
+} // namespace
+
+LK_INIT_HOOK(heap_cache, heap_cache_init, LK_INIT_LEVEL_THREADING);
+
 void heap_init() {
     cmpct_init();
+    init_cache_classes();
 }
 
 void heap_trim() {
+    cache_trim(true);
     cmpct_trim();
 }
 
+static void* heap_alloc(size_t size) {
+    if (size == 0 || size > max_cached_size || !cache_enabled.load()) {
+        return cmpct_alloc(size);
+    }
+    return cache_alloc(size);
+}
+
 void* malloc(size_t size) {
     DEBUG_ASSERT(!arch_blocking_disallowed());
 
@@ -143,7 +428,7 @@ void* malloc(size_t size) {
 
     add_stat(__GET_CALLER(), size);
 
-    void* ptr = cmpct_alloc(size);
+    void* ptr = heap_alloc(size);
     if (unlikely(heap_trace)) {
         printf("caller %p malloc %zu -> %p\n", __GET_CALLER(), size, ptr);
     }
@@ -162,7 +447,7 @@ void* malloc_debug_caller_(size_t size, void* caller) {
 
     add_stat(caller, size);
 
-    void* ptr = cmpct_alloc(size);
+    void* ptr = heap_alloc(size);
     if (unlikely(heap_trace)) {
         printf("caller %p malloc %zu -> %p\n", caller, size, ptr);
     }
@@ -202,7 +487,7 @@ void* calloc(size_t count, size_t size) {
 
     size_t realsize = count * size;
 
-    void* ptr = cmpct_alloc(realsize);
+    void* ptr = heap_alloc(realsize);
     if (likely(ptr)) {
         memset(ptr, 0, realsize);
     }
@@ -239,7 +524,9 @@ void free(void* ptr) {
         printf("caller %p free %p\n", __GET_CALLER(), ptr);
     }
 
-    cmpct_free(ptr);
+    if (ptr == nullptr || !cache_enabled.load() || !cache_free(ptr)) {
+        cmpct_free(ptr);
+    }
 }
 
 static void heap_dump(bool panic_time) {
@@ -323,6 +610,7 @@ static int cmd_heap(int argc, const cmd_args* argv, uint32_t flags) {
             printf("\t%s stats\n", argv[0].str);
         }
         if (!(flags & CMD_FLAG_PANIC)) {
+            printf("\t%s cache\n", argv[0].str);
             printf("\t%s trace\n", argv[0].str);
             printf("\t%s trim\n", argv[0].str);
             printf("\t%s test\n", argv[0].str);
@@ -334,6 +622,8 @@ static int cmd_heap(int argc, const cmd_args* argv, uint32_t flags) {
         heap_dump(flags & CMD_FLAG_PANIC);
     } else if (HEAP_COLLECT_STATS && strcmp(argv[1].str, "stats") == 0) {
         dump_stats();
+    } else if (!(flags & CMD_FLAG_PANIC) && strcmp(argv[1].str, "cache") == 0) {
+        dump_cache();
     } else if (!(flags & CMD_FLAG_PANIC) && strcmp(argv[1].str, "test") == 0) {
         heap_test();
     } else if (!(flags & CMD_FLAG_PANIC) && strcmp(argv[1].str, "trace") == 0) {
@@ -15,6 +15,8 @@ MODULE_SRCS += \
 	$(LOCAL_DIR)/heap_wrapper.cpp
 
 # use the cmpctmalloc heap implementation
-MODULE_DEPS := kernel/lib/heap/cmpctmalloc
+MODULE_DEPS := \
+	kernel/lib/fbl \
+	kernel/lib/heap/cmpctmalloc
 
 include make/module.mk
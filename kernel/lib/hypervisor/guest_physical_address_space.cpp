@@ -132,7 +132,8 @@ zx_status_t GuestPhysicalAddressSpace::PageFault(zx_gpaddr_t guest_paddr) {
         pf_flags |= VMM_PF_FLAG_INSTRUCTION;
     }
     Guard<fbl::Mutex> guard{guest_aspace_->lock()};
-    return mapping->PageFault(guest_paddr, pf_flags);
+    // guest faults can't wait for a page source
+    return mapping->PageFault(guest_paddr, pf_flags, nullptr);
 }
 
 zx_status_t GuestPhysicalAddressSpace::CreateGuestPtr(zx_gpaddr_t guest_paddr, size_t len,
@@ -15,9 +15,10 @@ typedef void(oom_lowmem_callback_t)(size_t shortfall_bytes);
 // Initializes the out-of-memory system. If |enable| is true, starts the
 // memory-watcher thread, which calls |lowmem_callback| when the PMM has less
 // than |redline_bytes| free memory, sleeping for |sleep_duration_ns| between
-// checks.
+// checks. Before that, once there is less than |reclaim_bytes| free above the
+// redline, it tries to reclaim unused pages from VMOs.
 //
 // If |enable| is false, the thread can be started manually using 'k oom start'.
 // TODO(dbort): Add a programmatic way to start/stop the thread.
 void oom_init(bool enable, uint64_t sleep_duration_ns, size_t redline_bytes,
-              oom_lowmem_callback_t* lowmem_callback);
+              size_t reclaim_bytes, oom_lowmem_callback_t* lowmem_callback);
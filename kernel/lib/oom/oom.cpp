@@ -13,11 +13,13 @@
 #include <platform.h>
 #include <pretty/sizes.h>
 #include <vm/pmm.h>
+#include <vm/scanner.h>
 #include <zircon/errors.h>
 #include <zircon/time.h>
 #include <zircon/types.h>
 
 #include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
@@ -41,6 +43,10 @@ static uint64_t oom_sleep_duration_ns TA_GUARDED(oom_mutex);
 // If the PMM has fewer than this many bytes free, start killing processes.
 static uint64_t oom_redline_bytes TA_GUARDED(oom_mutex);
 
+// If the PMM has fewer than this many bytes free above the redline, reclaim
+// pages before the redline is reached.
+static uint64_t oom_reclaim_bytes TA_GUARDED(oom_mutex);
+
 // True if the thread should print the current free value when it runs.
 static bool oom_printing TA_GUARDED(oom_mutex);
 
@@ -54,7 +60,24 @@ static int oom_loop(void* arg) {
 
     size_t last_free_bytes = total_bytes;
     while (true) {
-        const size_t free_bytes = pmm_count_free_pages() * PAGE_SIZE;
+        size_t free_bytes = pmm_count_free_pages() * PAGE_SIZE;
+
+        size_t reclaim_target_bytes = 0;
+        {
+            AutoLock lock(&oom_mutex);
+            if (free_bytes < oom_redline_bytes + oom_reclaim_bytes) {
+                reclaim_target_bytes = oom_redline_bytes + oom_reclaim_bytes - free_bytes;
+            }
+        }
+        if (reclaim_target_bytes > 0) {
+            // reclaim may bring us back above the redline without killing anything
+            size_t reclaimed = vm_scanner_reclaim(ROUNDUP(reclaim_target_bytes, PAGE_SIZE) /
+                                                  PAGE_SIZE);
+            free_bytes = pmm_count_free_pages() * PAGE_SIZE;
+            if (reclaimed > 0) {
+                printf("OOM: reclaimed %zu pages\n", reclaimed);
+            }
+        }
 
         bool lowmem = false;
         bool printing = false;
@@ -131,7 +154,7 @@ static void start_thread_locked() TA_REQ(oom_mutex) {
 }
 
 void oom_init(bool enable, uint64_t sleep_duration_ns, size_t redline_bytes,
-              oom_lowmem_callback_t* lowmem_callback) {
+              size_t reclaim_bytes, oom_lowmem_callback_t* lowmem_callback) {
     DEBUG_ASSERT(sleep_duration_ns > 0);
     DEBUG_ASSERT(redline_bytes > 0);
     DEBUG_ASSERT(lowmem_callback != nullptr);
@@ -141,6 +164,7 @@ void oom_init(bool enable, uint64_t sleep_duration_ns, size_t redline_bytes,
     oom_lowmem_callback = lowmem_callback;
     oom_sleep_duration_ns = sleep_duration_ns;
     oom_redline_bytes = redline_bytes;
+    oom_reclaim_bytes = reclaim_bytes;
     oom_printing = false;
     oom_simulate_lowmem = false;
     if (enable) {
@@ -202,6 +226,8 @@ static int cmd_oom(int argc, const cmd_args* argv, uint32_t flags) {
         char buf[MAX_FORMAT_SIZE_LEN];
         format_size_fixed(buf, sizeof(buf), oom_redline_bytes, 'M');
         printf("  redline: %s (%" PRIu64 " bytes)\n", buf, oom_redline_bytes);
+        format_size_fixed(buf, sizeof(buf), oom_reclaim_bytes, 'M');
+        printf("  reclaim margin: %s (%" PRIu64 " bytes)\n", buf, oom_reclaim_bytes);
     } else if (strcmp(argv[1].str, "print") == 0) {
         oom_printing = !oom_printing;
         printf("OOM print is now %s\n", oom_printing ? "on" : "off");
@@ -152,7 +152,7 @@ static zx_status_t make_bootstrap_channel(
     {
         fbl::RefPtr<Dispatcher> mpd0, mpd1;
         zx_rights_t rights;
-        zx_status_t status = ChannelDispatcher::Create(&mpd0, &mpd1, &rights);
+        zx_status_t status = ChannelDispatcher::Create(0u, &mpd0, &mpd1, &rights);
         if (status != ZX_OK)
             return status;
         user_channel_handle = Handle::Make(fbl::move(mpd0), rights);
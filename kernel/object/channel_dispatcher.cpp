@@ -19,6 +19,7 @@
 #include <object/message_packet.h>
 #include <object/process_dispatcher.h>
 #include <object/thread_dispatcher.h>
+#include <vm/vm_object_paged.h>
 
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
@@ -34,10 +35,27 @@ KCOUNTER(channel_packet_depth_64, "kernel.channel.depth.64");
 KCOUNTER(channel_packet_depth_256, "kernel.channel.depth.256");
 KCOUNTER(channel_packet_depth_unbounded, "kernel.channel.depth.unbounded");
 
+static constexpr uint64_t kRingVmoSize =
+    ZX_CHANNEL_RING_CONTROL_SIZE + 2 * static_cast<uint64_t>(ZX_CHANNEL_RING_SIZE);
+static_assert(ZX_CHANNEL_RING_CONTROL_SIZE % PAGE_SIZE == 0, "");
+static_assert(ZX_CHANNEL_RING_SIZE % PAGE_SIZE == 0, "");
+
 // static
-zx_status_t ChannelDispatcher::Create(fbl::RefPtr<Dispatcher>* dispatcher0,
+zx_status_t ChannelDispatcher::Create(uint32_t options,
+                                      fbl::RefPtr<Dispatcher>* dispatcher0,
                                       fbl::RefPtr<Dispatcher>* dispatcher1,
                                       zx_rights_t* rights) {
+    // The ring is ordinary anonymous memory; the kernel never looks at its
+    // contents, it only hands the same VMO to both endpoints.
+    fbl::RefPtr<VmObject> ring;
+    if (options & ZX_CHANNEL_RING) {
+        zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, kRingVmoSize, &ring);
+        if (status != ZX_OK)
+            return status;
+        static const char kRingName[] = "channel-ring";
+        ring->set_name(kRingName, sizeof(kRingName));
+    }
+
     fbl::AllocChecker ac;
     auto holder0 = fbl::AdoptRef(new (&ac) PeerHolder<ChannelDispatcher>());
     if (!ac.check())
@@ -52,8 +70,8 @@ zx_status_t ChannelDispatcher::Create(fbl::RefPtr<Dispatcher>* dispatcher0,
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
-    ch0->Init(ch1);
-    ch1->Init(ch0);
+    ch0->Init(ch1, ring, 0u);
+    ch1->Init(ch0, fbl::move(ring), 1u);
 
     *rights = default_rights();
     *dispatcher0 = fbl::move(ch0);
@@ -67,9 +85,12 @@ ChannelDispatcher::ChannelDispatcher(fbl::RefPtr<PeerHolder<ChannelDispatcher>>
 
 // This is called before either ChannelDispatcher is accessible from threads other than the one
 // initializing the channel, so it does not need locking.
-void ChannelDispatcher::Init(fbl::RefPtr<ChannelDispatcher> other) TA_NO_THREAD_SAFETY_ANALYSIS {
+void ChannelDispatcher::Init(fbl::RefPtr<ChannelDispatcher> other, fbl::RefPtr<VmObject> ring,
+                             uint32_t side) TA_NO_THREAD_SAFETY_ANALYSIS {
     peer_ = fbl::move(other);
     peer_koid_ = peer_->get_koid();
+    ring_ = fbl::move(ring);
+    ring_side_ = side;
 }
 
 ChannelDispatcher::~ChannelDispatcher() {
@@ -135,6 +156,17 @@ void ChannelDispatcher::on_zero_handles_locked() {
     }
 }
 
+zx_status_t ChannelDispatcher::GetRing(fbl::RefPtr<VmObject>* vmo, uint32_t* side) const {
+    canary_.Assert();
+
+    if (!ring_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    *vmo = ring_;
+    *side = ring_side_;
+    return ZX_OK;
+}
+
 void ChannelDispatcher::set_owner(zx_koid_t new_owner) {
     // Testing for ZX_KOID_INVALID is an optimization so we don't
     // pay the cost of grabbing the lock when the endpoint moves
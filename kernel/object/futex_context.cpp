@@ -7,6 +7,8 @@
 #include <object/futex_context.h>
 
 #include <assert.h>
+#include <fbl/alloc_checker.h>
+#include <lib/counters.h>
 #include <lib/user_copy/user_ptr.h>
 #include <object/thread_dispatcher.h>
 #include <trace.h>
@@ -14,6 +16,8 @@
 
 #define LOCAL_TRACE 0
 
+KCOUNTER(futex_table_grow_count, "kernel.futex.table_grow");
+
 FutexContext::FutexContext() {
     LTRACE_ENTRY;
 }
@@ -23,23 +27,29 @@ FutexContext::~FutexContext() {
 
     // All of the threads should have removed themselves from wait queues
     // by the time the process has exited.
-    DEBUG_ASSERT(futex_table_.is_empty());
+    for (const auto& stripe : stripes_) {
+        DEBUG_ASSERT(stripe.active_futexes.load() == 0);
+    }
 }
 
-zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline) {
+zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline,
+                                    thread_t* owner) {
     LTRACE_ENTRY;
 
     uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
     if (futex_key % sizeof(int))
         return ZX_ERR_INVALID_ARGS;
 
+    MaybeGrow(futex_key);
+
     // FutexWait() checks that the address value_ptr still contains
     // current_value, and if so it sleeps awaiting a FutexWake() on value_ptr.
     // Those two steps must together be atomic with respect to FutexWake().
     // If a FutexWake() operation could occur between them, a userland mutex
     // operation built on top of futexes would have a race condition that
     // could miss wakeups.
-    Guard<fbl::Mutex> guard{&lock_};
+    Stripe* stripe = StripeFor(futex_key);
+    Guard<fbl::Mutex> guard{&stripe->lock};
 
     int value;
     zx_status_t result = value_ptr.copy_from_user(&value);
@@ -54,10 +64,11 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int curren
     node.set_hash_key(futex_key);
     node.SetAsSingletonList();
 
-    QueueNodesLocked(&node);
+    QueueNodesLocked(stripe, &node);
 
-    // Block current thread.  This releases lock_ and does not reacquire it.
-    result = node.BlockThread(guard.take(), deadline);
+    // Block current thread.  This releases the stripe lock and does not
+    // reacquire it.
+    result = node.BlockThread(guard.take(), deadline, owner);
     if (result == ZX_OK) {
         DEBUG_ASSERT(!node.IsInQueue());
         // All the work necessary for removing us from the hash table was done by FutexWake()
@@ -70,8 +81,7 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int curren
     //
     // We need to ensure that the thread's node is removed from the wait
     // queue, because FutexWake() probably didn't do that.
-    Guard<fbl::Mutex> guard2{&lock_};
-    if (UnqueueNodeLocked(&node)) {
+    if (UnqueueNode(&node)) {
         return result;
     }
     // The current thread was not found on the wait queue.  This means
@@ -108,9 +118,10 @@ zx_status_t FutexContext::FutexWake(user_in_ptr<const int> value_ptr,
 
     AutoReschedDisable resched_disable; // Must come before the Guard.
     resched_disable.Disable();
-    Guard<fbl::Mutex> guard{&lock_};
+    Stripe* stripe = StripeFor(futex_key);
+    Guard<fbl::Mutex> guard{&stripe->lock};
 
-    FutexNode* node = futex_table_.erase(futex_key);
+    FutexNode* node = EraseLocked(stripe, futex_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return ZX_OK;
@@ -122,7 +133,38 @@ zx_status_t FutexContext::FutexWake(user_in_ptr<const int> value_ptr,
 
     if (remaining_waiters) {
         DEBUG_ASSERT(remaining_waiters->GetKey() == futex_key);
-        futex_table_.insert(remaining_waiters);
+        InsertLocked(stripe, remaining_waiters);
+    }
+
+    return ZX_OK;
+}
+
+zx_status_t FutexContext::FutexWakeOwner(user_in_ptr<const int> value_ptr) {
+    LTRACE_ENTRY;
+
+    uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
+    if (futex_key % sizeof(int))
+        return ZX_ERR_INVALID_ARGS;
+
+    // The waiters that leave this futex take back the priority they lent to
+    // the current thread.  Since it holds the stripe lock, the boost it still
+    // inherits from waiters on other futexes is applied when that is released.
+    AutoReschedDisable resched_disable; // Must come before the Guard.
+    resched_disable.Disable();
+    Stripe* stripe = StripeFor(futex_key);
+    Guard<fbl::Mutex> guard{&stripe->lock};
+
+    FutexNode* node = EraseLocked(stripe, futex_key);
+    if (!node) {
+        // nothing blocked on this futex if we can't find it
+        return ZX_OK;
+    }
+    DEBUG_ASSERT(node->GetKey() == futex_key);
+
+    FutexNode* remaining_waiters = FutexNode::WakeOwner(node, futex_key);
+    if (remaining_waiters) {
+        DEBUG_ASSERT(remaining_waiters->GetKey() == futex_key);
+        InsertLocked(stripe, remaining_waiters);
     }
 
     return ZX_OK;
@@ -135,24 +177,46 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
     if ((requeue_ptr.get() == nullptr) && requeue_count)
         return ZX_ERR_INVALID_ARGS;
 
+    uintptr_t wake_key = reinterpret_cast<uintptr_t>(wake_ptr.get());
+    uintptr_t requeue_key = reinterpret_cast<uintptr_t>(requeue_ptr.get());
+
+    // Both futexes must be locked for the whole operation. When they hash to
+    // the same stripe there is only one lock to take; otherwise GuardMultiple
+    // takes the pair in address order.
     AutoReschedDisable resched_disable; // Must come before the Guard.
-    Guard<fbl::Mutex> guard{&lock_};
+    Stripe* wake_stripe = StripeFor(wake_key);
+    Stripe* requeue_stripe = StripeFor(requeue_key);
+    if (wake_stripe == requeue_stripe) {
+        Guard<fbl::Mutex> guard{&wake_stripe->lock};
+        return FutexRequeueLocked(&resched_disable, wake_ptr, wake_count, current_value,
+                                  requeue_key, requeue_count);
+    }
+    GuardMultiple<2, fbl::Mutex> guard{&wake_stripe->lock, &requeue_stripe->lock};
+    return FutexRequeueLocked(&resched_disable, wake_ptr, wake_count, current_value,
+                              requeue_key, requeue_count);
+}
 
+zx_status_t FutexContext::FutexRequeueLocked(AutoReschedDisable* resched_disable,
+                                             user_in_ptr<const int> wake_ptr, uint32_t wake_count,
+                                             int current_value, uintptr_t requeue_key,
+                                             uint32_t requeue_count) {
     int value;
     zx_status_t result = wake_ptr.copy_from_user(&value);
     if (result != ZX_OK) return result;
     if (value != current_value) return ZX_ERR_BAD_STATE;
 
     uintptr_t wake_key = reinterpret_cast<uintptr_t>(wake_ptr.get());
-    uintptr_t requeue_key = reinterpret_cast<uintptr_t>(requeue_ptr.get());
     if (wake_key == requeue_key) return ZX_ERR_INVALID_ARGS;
     if (wake_key % sizeof(int) || requeue_key % sizeof(int))
         return ZX_ERR_INVALID_ARGS;
 
+    Stripe* wake_stripe = StripeFor(wake_key);
+    Stripe* requeue_stripe = StripeFor(requeue_key);
+
     // This must happen before RemoveFromHead() calls set_hash_key() on
-    // nodes below, because operations on futex_table_ look at the GetKey
-    // field of the list head nodes for wake_key and requeue_key.
-    FutexNode* node = futex_table_.erase(wake_key);
+    // nodes below, because bucket lookups look at the GetKey field of the
+    // list head nodes for wake_key and requeue_key.
+    FutexNode* node = EraseLocked(wake_stripe, wake_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return ZX_OK;
@@ -160,7 +224,7 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
 
     // This must come before WakeThreads() to be useful, but we want to
     // avoid doing it before copy_from_user() in case that faults.
-    resched_disable.Disable();
+    resched_disable->Disable();
 
     if (wake_count > 0) {
         node = FutexNode::WakeThreads(node, wake_count, wake_key);
@@ -176,51 +240,139 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
 
             // now requeue our nodes to requeue_ptr mutex
             DEBUG_ASSERT(requeue_head->GetKey() == requeue_key);
-            QueueNodesLocked(requeue_head);
+            QueueNodesLocked(requeue_stripe, requeue_head);
         }
     }
 
     // add any remaining nodes back to wake_key futex
     if (node != nullptr) {
         DEBUG_ASSERT(node->GetKey() == wake_key);
-        futex_table_.insert(node);
+        InsertLocked(wake_stripe, node);
     }
 
     return ZX_OK;
 }
 
-void FutexContext::QueueNodesLocked(FutexNode* head) {
-    DEBUG_ASSERT(lock_.lock().IsHeld());
+// Removes and returns the head of the blocked thread list for |key|, or
+// nullptr if no thread is blocked on it.
+FutexNode* FutexContext::EraseLocked(Stripe* stripe, uintptr_t key) {
+    DEBUG_ASSERT(stripe->lock.lock().IsHeld());
+
+    FutexNode* head = BucketForLocked(key)->erase_if(
+        [key](const FutexNode& node) { return node.GetKey() == key; });
+    if (head) {
+        stripe->active_futexes.fetch_sub(1, fbl::memory_order_relaxed);
+    }
+    return head;
+}
+
+// Makes |head| the head of the blocked thread list for its key, which must
+// not already have one.
+void FutexContext::InsertLocked(Stripe* stripe, FutexNode* head) {
+    DEBUG_ASSERT(stripe->lock.lock().IsHeld());
 
-    FutexNode::HashTable::iterator iter;
+    BucketForLocked(head->GetKey())->push_front(head);
+    stripe->active_futexes.fetch_add(1, fbl::memory_order_relaxed);
+}
 
-    // Attempt to insert this FutexNode into the hash table.  If the insert
-    // succeeds, then the current thread is first to block on this futex and we
-    // are finished.  If the insert fails, then there is already a thread
-    // waiting on this futex.  Add ourselves to that thread's list.
-    if (!futex_table_.insert_or_find(head, &iter))
+void FutexContext::QueueNodesLocked(Stripe* stripe, FutexNode* head) {
+    DEBUG_ASSERT(stripe->lock.lock().IsHeld());
+
+    // If there is already a thread waiting on this futex, add ourselves to
+    // that thread's list.  Otherwise the current thread is first to block on
+    // this futex and becomes the head of its list.
+    uintptr_t key = head->GetKey();
+    auto iter = BucketForLocked(key)->find_if(
+        [key](const FutexNode& node) { return node.GetKey() == key; });
+    if (iter.IsValid()) {
         iter->AppendList(head);
+    } else {
+        InsertLocked(stripe, head);
+    }
 }
 
 // This attempts to unqueue a thread (which may or may not be waiting on a
 // futex), given its FutexNode.  This returns whether the FutexNode was
 // found and removed from a futex wait queue.
-bool FutexContext::UnqueueNodeLocked(FutexNode* node) {
-    DEBUG_ASSERT(lock_.lock().IsHeld());
-
-    if (!node->IsInQueue())
-        return false;
-
+bool FutexContext::UnqueueNode(FutexNode* node) {
     // Note: When UnqueueNode() is called from FutexWait(), it might be
     // tempting to reuse the futex key that was passed to FutexWait().
     // However, that could be out of date if the thread was requeued by
-    // FutexRequeue(), so we need to re-get the hash table key here.
-    uintptr_t futex_key = node->GetKey();
-
-    FutexNode* old_head = futex_table_.erase(futex_key);
-    DEBUG_ASSERT(old_head);
-    FutexNode* new_head = FutexNode::RemoveNodeFromList(old_head, node);
-    if (new_head)
-        futex_table_.insert(new_head);
-    return true;
+    // FutexRequeue(), so we need to re-get the key here.  The key only
+    // changes under the lock of the stripe it hashes to, so if it still
+    // matches once that lock is held it is stable; otherwise the node was
+    // requeued or woken concurrently and we try again.
+    for (;;) {
+        uintptr_t futex_key = node->GetKey();
+        Stripe* stripe = StripeFor(futex_key);
+        Guard<fbl::Mutex> guard{&stripe->lock};
+        if (node->GetKey() != futex_key)
+            continue;
+
+        if (!node->IsInQueue())
+            return false;
+
+        FutexNode* old_head = EraseLocked(stripe, futex_key);
+        DEBUG_ASSERT(old_head);
+        FutexNode* new_head = FutexNode::RemoveNodeFromList(old_head, node);
+        if (new_head)
+            InsertLocked(stripe, new_head);
+        return true;
+    }
+}
+
+void FutexContext::MaybeGrow(uintptr_t key) {
+    // Unlocked reads: a stale answer only means growing a little early or late.
+    uint32_t shift = bucket_shift_.load(fbl::memory_order_relaxed);
+    if (shift >= kMaxBucketShift)
+        return;
+    uint32_t buckets_per_stripe = 1u << (shift - kStripeShift);
+    if (StripeFor(key)->active_futexes.load(fbl::memory_order_relaxed) <=
+        kMaxLoadFactor * buckets_per_stripe)
+        return;
+    Grow(shift);
+}
+
+// Doubles the bucket table, unless another thread already grew it past
+// |old_shift|.  Failing to allocate the new table is not an error; the
+// existing table keeps working with longer chains.
+void FutexContext::Grow(uint32_t old_shift) {
+    Guard<fbl::Mutex> grow_guard{&grow_lock_};
+    if (bucket_shift_.load(fbl::memory_order_relaxed) != old_shift)
+        return;
+
+    uint32_t new_shift = old_shift + 1;
+    size_t new_count = size_t{1} << new_shift;
+    fbl::AllocChecker ac;
+    BucketList* new_buckets = new (&ac) BucketList[new_count];
+    if (!ac.check())
+        return;
+    fbl::Array<BucketList> new_array(new_buckets, new_count);
+
+    // Every futex operation holds the stripe lock for its key while it uses
+    // the table, so holding all of them excludes everyone.  Stripes are
+    // always taken in ascending address order, matching GuardMultiple in
+    // FutexRequeue().  lockdep cannot track an unbounded set of same-class
+    // locks, so take the raw mutexes.
+    for (auto& stripe : stripes_) {
+        stripe.lock.lock().Acquire();
+    }
+
+    size_t old_count = size_t{1} << old_shift;
+    for (size_t i = 0; i < old_count; i++) {
+        while (!buckets_[i].is_empty()) {
+            FutexNode* head = buckets_[i].pop_front();
+            new_buckets[Hash(head->GetKey()) >> (64 - new_shift)].push_front(head);
+        }
+    }
+    buckets_ = new_buckets;
+    bucket_shift_.store(new_shift, fbl::memory_order_relaxed);
+
+    for (auto& stripe : stripes_) {
+        stripe.lock.lock().Release();
+    }
+
+    // Free the old (now empty) table outside of the stripe locks.
+    grown_buckets_.swap(new_array);
+    kcounter_add(futex_table_grow_count, 1);
 }
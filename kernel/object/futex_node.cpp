@@ -12,12 +12,14 @@
 #include <fbl/mutex.h>
 #include <platform.h>
 #include <trace.h>
+#include <kernel/sched.h>
 #include <kernel/thread_lock.h>
 #include <zircon/types.h>
 
 #define LOCAL_TRACE 0
 
-FutexNode::FutexNode() {
+FutexNode::FutexNode()
+    : thread_(get_current_thread()) {
     LTRACE_ENTRY;
 }
 
@@ -106,6 +108,31 @@ FutexNode* FutexNode::WakeThreads(FutexNode* node, uint32_t count,
     return node;
 }
 
+// This wakes the thread at the head of |list_head|, like WakeThreads() with
+// a count of 1, and returns the list of remaining nodes.  The woken thread is
+// about to take over the lock that the remaining threads are waiting for, so
+// before waking it, those of them that lent their priority to the old owner
+// lend it to the new one instead.
+FutexNode* FutexNode::WakeOwner(FutexNode* list_head, uintptr_t old_hash_key) {
+    ASSERT(list_head);
+
+    thread_t* const new_owner = list_head->thread_;
+    {
+        Guard<spin_lock_t, IrqSave> thread_lock_guard{ThreadLock::Get()};
+        // the new owner is still blocked, and the old owner holds the stripe lock, which keeps
+        // its boost until it is released, so there is nothing to reschedule
+        bool unused;
+        for (FutexNode* node = list_head->queue_next_; node != list_head;
+             node = node->queue_next_) {
+            if (node->thread_->futex_owner) {
+                sched_futex_lend_priority(node->thread_, new_owner, &unused);
+            }
+        }
+    }
+
+    return WakeThreads(list_head, 1, old_hash_key);
+}
+
 // This removes up to |count| nodes from |list_head|.  It returns the new
 // list head (i.e. the list of remaining nodes), which may be null (empty).
 // On return, |list_head| is the list of nodes that were removed --
@@ -128,6 +155,14 @@ FutexNode* FutexNode::RemoveFromHead(FutexNode* list_head, uint32_t count,
         // For requeuing, update the key so that FutexWait() can remove the
         // thread from its current queue if the wait operation times out.
         node->set_hash_key(new_hash_key);
+        // The thread no longer waits for the owner of the old futex.
+        // |futex_owner| is only set with the stripe lock held, so it can't
+        // become non-null under us.
+        if (node->thread_->futex_owner) {
+            Guard<spin_lock_t, IrqSave> thread_lock_guard{ThreadLock::Get()};
+            bool unused;
+            sched_futex_unlend_priority(node->thread_, &unused);
+        }
 
         node = node->queue_next_;
         if (node == list_head) {
@@ -146,7 +181,8 @@ FutexNode* FutexNode::RemoveFromHead(FutexNode* list_head, uint32_t count,
 // This blocks the current thread.  This releases the given mutex (which
 // must be held when BlockThread() is called).  To reduce contention, it
 // does not reclaim the mutex on return.
-zx_status_t FutexNode::BlockThread(Guard<fbl::Mutex>&& adopt_guard, zx_time_t deadline) {
+zx_status_t FutexNode::BlockThread(Guard<fbl::Mutex>&& adopt_guard, zx_time_t deadline,
+                                   thread_t* owner) {
     // Adopt the guarded lock from the caller. This could happen before or after
     // the following locks because the underlying lock is held from the caller's
     // frame. The runtime validator state is not affected by the adoption.
@@ -155,17 +191,29 @@ zx_status_t FutexNode::BlockThread(Guard<fbl::Mutex>&& adopt_guard, zx_time_t de
     Guard<spin_lock_t, IrqSave> thread_lock_guard{ThreadLock::Get()};
     ThreadDispatcher::AutoBlocked by(ThreadDispatcher::Blocked::FUTEX);
 
+    // This happens before the stripe lock is released, so that FutexRequeue()
+    // sees whether we lend our priority.  We're just about to block, so the
+    // local reschedule flag can be discarded.
+    thread_t* current_thread = get_current_thread();
+    bool unused;
+    if (owner) {
+        sched_futex_lend_priority(current_thread, owner, &unused);
+    }
+
     // We specifically want reschedule=MutexPolicy::NoReschedule here, otherwise
     // the combination of releasing the mutex and enqueuing the current thread
     // would not be atomic, which would mean that we could miss wakeups.
     guard.Release(MutexPolicy::ThreadLockHeld, MutexPolicy::NoReschedule);
 
-    thread_t* current_thread = get_current_thread();
     zx_status_t result;
     current_thread->interruptable = true;
     result = wait_queue_.Block(deadline);
     current_thread->interruptable = false;
 
+    // If we timed out or were killed or suspended, the owner must not keep
+    // our priority.  If we were woken, WakeThread() already took it back.
+    sched_futex_unlend_priority(current_thread, &unused);
+
     return result;
 }
 
@@ -175,17 +223,22 @@ void FutexNode::WakeThread() {
     // cases to consider:
     //  1) The thread's wait times out, or the thread is killed or
     //     suspended.  In those cases, FutexWait() will reacquire the
-    //     FutexContext lock.  We are currently holding that lock, so
-    //     FutexWait() will not race with us.
+    //     FutexContext stripe lock for this futex.  We are currently
+    //     holding that lock, so FutexWait() will not race with us.
     //  2) The thread is woken by our wait_queue_wake_one() call.  In
-    //     this case, FutexWait() will *not* reacquire the FutexContext
-    //     lock.  To handle this correctly, we must not access |this|
-    //     after wait_queue_wake_one().
+    //     this case, FutexWait() will *not* reacquire the stripe lock.
+    //     To handle this correctly, we must not access |this| after
+    //     wait_queue_wake_one().
 
     // We must do this before we wake the thread, to handle case 2.
     MarkAsNotInQueue();
 
     Guard<spin_lock_t, IrqSave> thread_lock_guard{ThreadLock::Get()};
+    // The owner is deboosted before the waiter runs.  If the owner is the
+    // current thread, it holds the stripe lock, which keeps its boost until
+    // it is released, so there is nothing to reschedule.
+    bool unused;
+    sched_futex_unlend_priority(thread_, &unused);
     wait_queue_.WakeOne(/* reschedule */ true, ZX_OK);
 }
 
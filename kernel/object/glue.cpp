@@ -82,6 +82,7 @@ static void object_glue_init(uint level) TA_NO_THREAD_SAFETY_ANALYSIS {
     oom_init(cmdline_get_bool("kernel.oom.enable", true),
              ZX_SEC(cmdline_get_uint64("kernel.oom.sleep-sec", 1)),
              cmdline_get_uint64("kernel.oom.redline-mb", 50) * MB,
+             cmdline_get_uint64("kernel.oom.reclaim-mb", 50) * MB,
              oom_lowmem);
 }
 
@@ -6,9 +6,12 @@
 
 #include <object/handle.h>
 
+#include <arch/ops.h>
 #include <object/dispatcher.h>
 #include <fbl/arena.h>
 #include <fbl/mutex.h>
+#include <kernel/align.h>
+#include <kernel/thread.h>
 #include <lib/counters.h>
 #include <pow2.h>
 
@@ -24,6 +27,17 @@ constexpr size_t kHighHandleCount = (kMaxHandleCount * 7) / 8;
 KCOUNTER(handle_count_made, "kernel.handles.made");
 KCOUNTER(handle_count_duped, "kernel.handles.duped");
 KCOUNTER(handle_count_live, "kernel.handles.live");
+KCOUNTER(handle_reader_waits, "kernel.handles.reader_waits");
+
+// Per-cpu state of Handle::ReadSections. A section runs with preemption
+// disabled and sections don't nest, so at most one is live on a cpu at a time,
+// and |seq| is odd while it is. Only its own cpu writes |seq|, so it only ever
+// sees cache line traffic from the occasional scan in WaitForReaders().
+struct ReaderSeq {
+    fbl::atomic<uint64_t> seq;
+} __CPU_ALIGN;
+
+ReaderSeq reader_seqs[SMP_MAX_CPUS];
 
 // Masks for building a Handle's base_value, which ProcessDispatcher
 // uses to create zx_handle_t values.
@@ -57,7 +71,7 @@ void Handle::Init() TA_NO_THREAD_SAFETY_ANALYSIS {
 }
 
 void Handle::set_process_id(zx_koid_t pid) {
-    process_id_.store(pid, fbl::memory_order_relaxed);
+    process_id_.store(pid, fbl::memory_order_release);
     dispatcher_->set_owner(pid);
 }
 
@@ -176,12 +190,56 @@ void Handle::TearDown() TA_EXCL(ArenaLock::Get()) {
     DEBUG_ASSERT(process_id() == 0);
 }
 
+Handle::ReadSection::ReadSection() {
+    thread_preempt_disable();
+    seq_ = &reader_seqs[arch_curr_cpu_num()].seq;
+    uint64_t seq = seq_->load(fbl::memory_order_relaxed);
+    DEBUG_ASSERT((seq & 1) == 0);
+    seq_->store(seq + 1, fbl::memory_order_relaxed);
+    // The store must be visible before this section reads any Handle.
+    // Pairs with the fence in WaitForReaders(): either it sees this section,
+    // or this section sees the Handle's process id already cleared.
+    fbl::atomic_thread_fence();
+}
+
+Handle::ReadSection::~ReadSection() {
+    seq_->store(seq_->load(fbl::memory_order_relaxed) + 1, fbl::memory_order_release);
+    thread_preempt_reenable();
+}
+
+// The caller has already made the Handle unreachable through its process
+// (process_id() no longer matches). Every ReadSection either started late
+// enough to see that, or was live on its cpu when the fence below ran and
+// must be waited out. A cpu's sequence moving on means that section ended,
+// so this waits for at most one section per cpu, without any lock shared
+// with other deleters. Sections are short and cannot be preempted, so spin.
+void Handle::WaitForReaders() {
+    // Pairs with the fence in ReadSection().
+    fbl::atomic_thread_fence();
+
+    bool waited = false;
+    for (uint i = 0; i < arch_max_num_cpus(); i++) {
+        const uint64_t seq = reader_seqs[i].seq.load(fbl::memory_order_acquire);
+        if ((seq & 1) == 0)
+            continue;
+        waited = true;
+        while (reader_seqs[i].seq.load(fbl::memory_order_acquire) == seq)
+            arch_spinloop_pause();
+    }
+
+    if (waited)
+        kcounter_add(handle_reader_waits, 1);
+}
+
 void Handle::Delete() {
     fbl::RefPtr<Dispatcher> disp = dispatcher();
 
     if (disp->is_waitable())
         disp->Cancel(this);
 
+    // TearDown() drops this Handle's reference to |disp| and scribbles over
+    // the Handle, so lock-free lookups must be done with it first.
+    WaitForReaders();
     TearDown();
 
     bool zero_handles = false;
@@ -199,13 +257,12 @@ void Handle::Delete() {
     kcounter_add(handle_count_live, -1);
 }
 
+// This does not need ArenaLock: the arena's bounds are fixed by Init(), and
+// the caller checks process_id() to see whether the slot is really in use.
 Handle* Handle::FromU32(uint32_t value) TA_NO_THREAD_SAFETY_ANALYSIS {
     uintptr_t handle_addr = IndexToHandle(value & kHandleIndexMask);
-    {
-        Guard<fbl::Mutex> guard{ArenaLock::Get()};
-        if (unlikely(!arena_.in_range(handle_addr)))
-            return nullptr;
-    }
+    if (unlikely(!arena_.in_range(handle_addr)))
+        return nullptr;
     auto handle = reinterpret_cast<Handle*>(handle_addr);
     return likely(handle->base_value() == value) ? handle : nullptr;
 }
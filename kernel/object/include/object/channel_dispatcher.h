@@ -11,6 +11,7 @@
 #include <kernel/event.h>
 #include <object/dispatcher.h>
 #include <object/message_packet.h>
+#include <vm/vm_object.h>
 
 #include <zircon/rights.h>
 #include <zircon/types.h>
@@ -26,7 +27,8 @@ class ChannelDispatcher final :
 public:
     class MessageWaiter;
 
-    static zx_status_t Create(fbl::RefPtr<Dispatcher>* dispatcher0,
+    // |options| may be 0 or ZX_CHANNEL_RING.
+    static zx_status_t Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher0,
                               fbl::RefPtr<Dispatcher>* dispatcher1, zx_rights_t* rights);
 
     ~ChannelDispatcher() final;
@@ -50,6 +52,11 @@ public:
     zx_status_t Write(zx_koid_t owner,
                       fbl::unique_ptr<MessagePacket> msg) TA_NO_THREAD_SAFETY_ANALYSIS;
 
+    // Returns the ring VMO shared by both endpoints and which of its data areas
+    // this endpoint writes into. Fails with ZX_ERR_NOT_SUPPORTED if the channel
+    // was not created with ZX_CHANNEL_RING.
+    zx_status_t GetRing(fbl::RefPtr<VmObject>* vmo, uint32_t* side) const;
+
     // Perform a transacted Write + Read. |owner| is the process attempting to write
     // to the channel, or ZX_KOID_INVALID if kernel is doing it. If |owner| does not
     // match what was last set by Dispatcher::set_owner() the call will fail.
@@ -113,7 +120,7 @@ private:
     void RemoveWaiter(MessageWaiter* waiter);
 
     explicit ChannelDispatcher(fbl::RefPtr<PeerHolder<ChannelDispatcher>> holder);
-    void Init(fbl::RefPtr<ChannelDispatcher> other);
+    void Init(fbl::RefPtr<ChannelDispatcher> other, fbl::RefPtr<VmObject> ring, uint32_t side);
     void WriteSelf(fbl::unique_ptr<MessagePacket> msg) TA_REQ(get_lock());
     zx_status_t UserSignalSelf(uint32_t clear_mask, uint32_t set_mask) TA_REQ(get_lock());
 
@@ -131,4 +138,9 @@ private:
 
     uint32_t txid_ TA_GUARDED(get_lock()) = 0;
     WaiterList waiters_ TA_GUARDED(get_lock());
+
+    // Set by Init() and constant afterwards. |ring_| is null unless the channel
+    // was created with ZX_CHANNEL_RING.
+    fbl::RefPtr<VmObject> ring_;
+    uint32_t ring_side_ = 0;
 };
@@ -7,9 +7,14 @@
 #pragma once
 
 #include <lib/user_copy/user_ptr.h>
+#include <zircon/thread_annotations.h>
 #include <zircon/types.h>
+#include <fbl/array.h>
+#include <fbl/atomic.h>
+#include <fbl/intrusive_single_list.h>
 #include <fbl/mutex.h>
 #include <kernel/lockdep.h>
+#include <kernel/thread.h>
 #include <object/futex_node.h>
 
 // FutexContext is a class that encapsulates support for futex operations.
@@ -24,6 +29,13 @@
 // When the thread at the head of the futex's blocked thread list is resumed,
 // The FutexNode for the new head of the blocked thread list is set as the hash table value
 // for the futex.
+//
+// The hash table is split into kNumStripes stripes, each with its own lock, so
+// operations on futexes that land in different stripes never contend. Each
+// stripe owns a contiguous range of buckets; the table starts with one bucket
+// per stripe and doubles whenever a stripe holds more than kMaxLoadFactor
+// active futexes per bucket, which keeps the chains short in processes that
+// block many threads on many distinct futexes. The table never shrinks.
 class FutexContext {
 public:
     FutexContext();
@@ -34,11 +46,22 @@ public:
     // Otherwise it will block the current thread until the |deadline| passes,
     // or until the thread is woken by a FutexWake or FutexRequeue operation
     // on the same |value_ptr| futex.
-    zx_status_t FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline);
+    //
+    // If |owner| is non-null, it is the thread the caller believes holds the
+    // lock that the futex implements. It inherits the caller's priority while
+    // the caller is blocked, and keeps it until it calls FutexWakeOwner().
+    zx_status_t FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline,
+                          thread_t* owner = nullptr);
 
     // FutexWake will wake up to |count| number of threads blocked on the |value_ptr| futex.
     zx_status_t FutexWake(user_in_ptr<const int> value_ptr, uint32_t count);
 
+    // FutexWakeOwner releases the current thread's ownership of the |value_ptr|
+    // futex, dropping any priority it inherited as an owner, and wakes one
+    // thread blocked on it. The woken thread is expected to take the lock over,
+    // so it inherits the priority of the threads still blocked on the futex.
+    zx_status_t FutexWakeOwner(user_in_ptr<const int> value_ptr);
+
     // FutexWait first verifies that the integer pointed to by |wake_ptr|
     // still equals |current_value|. If the test fails, FutexWait returns FAILED_PRECONDITION.
     // Otherwise it will wake up to |wake_count| number of threads blocked on the |wake_ptr| futex.
@@ -52,14 +75,69 @@ private:
     FutexContext(const FutexContext&) = delete;
     FutexContext& operator=(const FutexContext&) = delete;
 
-    void QueueNodesLocked(FutexNode* head) TA_REQ(lock_);
+    using BucketList = fbl::SinglyLinkedList<FutexNode*>;
+
+    // log2 of the number of lock stripes, and of the initial number of buckets.
+    static constexpr uint32_t kStripeShift = 5;
+    static constexpr uint32_t kNumStripes = 1u << kStripeShift;
+    // log2 of the largest number of buckets the table will grow to.
+    static constexpr uint32_t kMaxBucketShift = 14;
+    // Average number of active futexes per bucket that triggers a grow.
+    static constexpr uint32_t kMaxLoadFactor = 2;
+
+    struct Stripe {
+        // protects the buckets owned by this stripe, and the FutexNodes queued in them
+        DECLARE_MUTEX(Stripe) lock;
+
+        // number of futexes with blocked threads hashed to this stripe
+        fbl::atomic<uint32_t> active_futexes{0};
+    };
+
+    // Futex keys are hashed once; the top kStripeShift bits of the hash select the
+    // stripe and the top bucket_shift_ bits select the bucket, so a key's stripe
+    // does not change when the table grows.
+    static uint64_t Hash(uintptr_t key) {
+        return static_cast<uint64_t>(key >> 2) * 0x9E3779B97F4A7C15ull;
+    }
+    Stripe* StripeFor(uintptr_t key) {
+        return &stripes_[Hash(key) >> (64 - kStripeShift)];
+    }
+    BucketList* BucketForLocked(uintptr_t key) {
+        return &buckets_[Hash(key) >> (64 - bucket_shift_.load(fbl::memory_order_relaxed))];
+    }
+
+    zx_status_t FutexRequeueLocked(AutoReschedDisable* resched_disable,
+                                   user_in_ptr<const int> wake_ptr, uint32_t wake_count,
+                                   int current_value, uintptr_t requeue_key,
+                                   uint32_t requeue_count)
+        // Holds one or two stripe locks, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    FutexNode* EraseLocked(Stripe* stripe, uintptr_t key) TA_REQ(stripe->lock);
+    void InsertLocked(Stripe* stripe, FutexNode* head) TA_REQ(stripe->lock);
+
+    void QueueNodesLocked(Stripe* stripe, FutexNode* head) TA_REQ(stripe->lock);
+
+    bool UnqueueNode(FutexNode* node);
+
+    // Doubles the number of buckets if the stripe for |key| is overloaded.
+    void MaybeGrow(uintptr_t key);
+    void Grow(uint32_t old_shift)
+        // Acquires every stripe lock, which lockdep cannot express.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    Stripe stripes_[kNumStripes];
 
-    bool UnqueueNodeLocked(FutexNode* node) TA_REQ(lock_);
+    // serializes Grow(); taken before any stripe lock
+    DECLARE_MUTEX(FutexContext) grow_lock_;
 
-    // protects futex_table_
-    DECLARE_MUTEX(FutexContext) lock_;
+    // The bucket table: 1 << bucket_shift_ lists of FutexNodes, each the head
+    // of a futex's blocked thread list, keyed by futex address. Reading either
+    // member requires holding at least one stripe lock; changing them requires
+    // holding all of them.
+    fbl::atomic<uint32_t> bucket_shift_{kStripeShift};
+    BucketList* buckets_ = initial_buckets_;
 
-    // Hash table for futexes in this context.
-    // Key is futex address, value is the FutexNode for the head of futex's blocked thread list.
-    FutexNode::HashTable futex_table_ TA_GUARDED(lock_);
+    BucketList initial_buckets_[kNumStripes];
+    fbl::Array<BucketList> grown_buckets_;
 };
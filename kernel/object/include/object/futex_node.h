@@ -11,15 +11,13 @@
 #include <kernel/wait.h>
 #include <list.h>
 #include <zircon/types.h>
-#include <fbl/intrusive_hash_table.h>
+#include <fbl/intrusive_single_list.h>
 #include <fbl/mutex.h>
 
 // Node for linked list of threads blocked on a futex
 // Intended to be embedded within a ThreadDispatcher Instance
 class FutexNode : public fbl::SinglyLinkedListable<FutexNode*> {
 public:
-    using HashTable = fbl::HashTable<uintptr_t, FutexNode*>;
-
     FutexNode();
     ~FutexNode();
 
@@ -37,22 +35,27 @@ public:
     static FutexNode* WakeThreads(FutexNode* node, uint32_t count,
                                   uintptr_t old_hash_key);
 
+    static FutexNode* WakeOwner(FutexNode* list_head, uintptr_t old_hash_key);
+
     static FutexNode* RemoveFromHead(FutexNode* list_head,
                                      uint32_t count,
                                      uintptr_t old_hash_key,
                                      uintptr_t new_hash_key);
 
     // This must be called with a guard held in the calling scope. Releases the
-    // guard and does not reacquire it.
-    zx_status_t BlockThread(Guard<fbl::Mutex>&& adopt_guard, zx_time_t deadline);
+    // guard and does not reacquire it. If |owner| is non-null, it inherits the
+    // blocking thread's priority for as long as the thread waits on the futex.
+    zx_status_t BlockThread(Guard<fbl::Mutex>&& adopt_guard, zx_time_t deadline,
+                            thread_t* owner = nullptr);
 
     void set_hash_key(uintptr_t key) {
         hash_key_ = key;
     }
 
-    // Trait implementation for fbl::HashTable
     uintptr_t GetKey() const { return hash_key_; }
-    static size_t GetHash(uintptr_t key) { return (key >> 3); }
+
+    // the thread that constructed this node and waits on it
+    thread_t* thread() const { return thread_; }
 
 private:
     static void RelinkAsAdjacent(FutexNode* node1, FutexNode* node2);
@@ -66,13 +69,15 @@ private:
     //  * It is used by FutexWait() to determine which queue to remove the
     //    thread from when a wait operation times out.
     //  * Additionally, when this FutexNode is the head of a futex wait
-    //    queue, this field is used by the HashTable (because it uses
-    //    intrusive SinglyLinkedLists).
+    //    queue, this field is used to look it up in the FutexContext's
+    //    bucket lists.
     uintptr_t hash_key_;
 
     // Used for waking the thread corresponding to the FutexNode.
     WaitQueue wait_queue_;
 
+    thread_t* const thread_;
+
     // queue_prev_ and queue_next_ are used for maintaining a circular
     // doubly-linked list of threads that are waiting on one futex address.
     //  * When the list contains only this node, queue_prev_ and
@@ -88,8 +88,10 @@ public:
 
     // Returns the process that owns this instance. Used to guarantee
     // that one process may not access a handle owned by a different process.
+    // The acquire pairs with the release in set_process_id(), so a lookup that
+    // sees its own process id here also sees the fully constructed Handle.
     zx_koid_t process_id() const {
-        return process_id_.load(fbl::memory_order_relaxed);
+        return process_id_.load(fbl::memory_order_acquire);
     }
 
     // Sets the value returned by process_id().
@@ -131,6 +133,24 @@ public:
         static size_t OutstandingHandles();
     };
 
+    // Lets a process resolve handle values without taking its
+    // handle_table_lock_. While a ReadSection is alive, any Handle that was
+    // in a process's handle table when the section began stays valid, along
+    // with the reference it holds on its Dispatcher: Delete() waits for every
+    // such section to end before tearing the Handle down. A handle removed
+    // from the table before the section began reads as belonging to no
+    // process. ReadSections disable preemption and must not block or nest.
+    class ReadSection {
+    public:
+        ReadSection();
+        ~ReadSection();
+
+        DISALLOW_COPY_ASSIGN_AND_MOVE(ReadSection);
+
+    private:
+        fbl::atomic<uint64_t>* seq_;
+    };
+
     // Handle should never be created by anything other than Make or Dup.
     static HandleOwner Make(
         fbl::RefPtr<Dispatcher> dispatcher, zx_rights_t rights);
@@ -156,12 +176,16 @@ private:
     void TearDown() TA_EXCL(ArenaLock::Get());
     void Delete();
 
+    // Waits until no ReadSection could still be using a Handle that has
+    // already been removed from its process.
+    static void WaitForReaders();
+
     // Only HandleOwner is allowed to call Delete.
     friend class HandleOwner;
 
     // process_id_ is atomic because threads from different processes can
     // access it concurrently, while holding different instances of
-    // handle_table_lock_.
+    // handle_table_lock_, and because lookups read it without any lock.
     fbl::atomic<zx_koid_t> process_id_;
     fbl::RefPtr<Dispatcher> dispatcher_;
     const zx_rights_t rights_;
@@ -38,11 +38,22 @@ public:
                               uint32_t num_handles,
                               fbl::unique_ptr<MessagePacket>* msg);
 
+    // Packets whose MessagePacket object, handles and data together fit in
+    // this many bytes are carved from a size-classed slab rather than from a
+    // page-backed BufferChain.
+    static constexpr size_t kMaxSlabPacketSize = 2048;
+
     uint32_t data_size() const { return data_size_; }
 
+    // Returns true if the packet lives in a slab object rather than a BufferChain.
+    bool is_slab_allocated() const { return buffer_chain_ == nullptr; }
+
     // Copies the packet's |data_size()| bytes to |buf|.
     // Returns an error if |buf| points to a bad user address.
     zx_status_t CopyDataTo(user_out_ptr<void> buf) const {
+        if (buffer_chain_ == nullptr) {
+            return buf.copy_array_to_user(payload(), data_size_);
+        }
         return buffer_chain_->CopyOut(buf, payload_offset_, data_size_);
     }
 
@@ -59,22 +70,21 @@ public:
             return 0;
         }
         // The first few bytes of the payload are a zx_txid_t.
-        void* payload_start = buffer_chain_->buffers()->front().data() + payload_offset_;
-        return *reinterpret_cast<zx_txid_t*>(payload_start);
+        return *reinterpret_cast<const zx_txid_t*>(payload());
     }
 
     void set_txid(zx_txid_t txid) {
         if (data_size_ >= sizeof(zx_txid_t)) {
-            void* payload_start = buffer_chain_->buffers()->front().data() + payload_offset_;
-            *(reinterpret_cast<zx_txid_t*>(payload_start)) = txid;
+            *(reinterpret_cast<zx_txid_t*>(payload())) = txid;
         }
     }
 
 private:
-    MessagePacket(BufferChain* chain, uint32_t data_size, uint32_t payload_offset,
-                  uint16_t num_handles, Handle** handles)
+    MessagePacket(BufferChain* chain, uint8_t slab_class, uint32_t data_size,
+                  uint32_t payload_offset, uint16_t num_handles, Handle** handles)
         : buffer_chain_(chain), handles_(handles), data_size_(data_size),
-          payload_offset_(payload_offset), num_handles_(num_handles), owns_handles_(false) {}
+          payload_offset_(payload_offset), num_handles_(num_handles), owns_handles_(false),
+          slab_class_(slab_class) {}
 
     friend class fbl::unique_ptr<MessagePacket>;
     ~MessagePacket() {
@@ -93,10 +103,21 @@ private:
     static zx_status_t CreateCommon(uint32_t data_size, uint32_t num_handles,
                                     fbl::unique_ptr<MessagePacket>* msg);
 
+    // The packet always sits at the start of its storage, whether that is a
+    // slab object or the first buffer of a BufferChain, and the payload is
+    // contiguous with it up to at least sizeof(zx_txid_t) bytes.
+    char* payload() { return reinterpret_cast<char*>(this) + payload_offset_; }
+    const char* payload() const {
+        return reinterpret_cast<const char*>(this) + payload_offset_;
+    }
+
+    // Null if the packet is slab allocated, in which case |slab_class_| says
+    // which slab it came from.
     BufferChain* buffer_chain_;
     Handle** const handles_;
     const uint32_t data_size_;
     const uint32_t payload_offset_;
     const uint16_t num_handles_;
     bool owns_handles_;
+    const uint8_t slab_class_;
 };
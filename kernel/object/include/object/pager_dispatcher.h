@@ -0,0 +1,76 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <zircon/rights.h>
+#include <zircon/types.h>
+
+#include <fbl/canary.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/mutex.h>
+#include <object/dispatcher.h>
+#include <object/port_dispatcher.h>
+#include <vm/page_source.h>
+#include <vm/vm_object.h>
+
+#include <sys/types.h>
+
+class PagerDispatcher;
+
+// The page source of a vmo created by a pager. Requests for pages are sent
+// as packets to a port, with the key the vmo was created with.
+class PagerSource final : public PageSource,
+                          public fbl::DoublyLinkedListable<fbl::RefPtr<PagerSource>> {
+public:
+    PagerSource(fbl::RefPtr<PagerDispatcher> pager, fbl::RefPtr<PortDispatcher> port,
+                uint64_t key);
+    ~PagerSource() final;
+
+private:
+    // PageSource implementation.
+    zx_status_t SendRequest(uint64_t offset, uint64_t len) final;
+    void OnDetach() final;
+
+    zx_status_t QueuePacket(uint16_t command, uint64_t offset, uint64_t len);
+
+    const fbl::RefPtr<PagerDispatcher> pager_;
+    const fbl::RefPtr<PortDispatcher> port_;
+    const uint64_t key_;
+};
+
+class PagerDispatcher final : public SoloDispatcher<PagerDispatcher, ZX_DEFAULT_PAGER_RIGHTS> {
+public:
+    static zx_status_t Create(fbl::RefPtr<Dispatcher>* dispatcher, zx_rights_t* rights);
+
+    ~PagerDispatcher() final;
+    zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_PAGER; }
+    void on_zero_handles() final;
+
+    // Create the page source for a new vmo, whose page requests are queued on
+    // |port| with |key|.
+    zx_status_t CreateSource(fbl::RefPtr<PortDispatcher> port, uint64_t key,
+                             fbl::RefPtr<PageSource>* source);
+
+    // Move the pages in [aux_offset, aux_offset + len) of |aux| to
+    // [offset, offset + len) of |vmo|, which must have been created by this
+    // pager, waking the threads waiting for them.
+    zx_status_t SupplyPages(VmObject* vmo, uint64_t offset, uint64_t len,
+                            VmObject* aux, uint64_t aux_offset);
+
+private:
+    friend class PagerSource;
+
+    PagerDispatcher();
+
+    void RemoveSource(PagerSource* source);
+
+    fbl::Canary<fbl::magic("PGRD")> canary_;
+
+    // the sources of the vmos that are still alive
+    fbl::DoublyLinkedList<fbl::RefPtr<PagerSource>> sources_ TA_GUARDED(get_lock());
+    bool closed_ TA_GUARDED(get_lock()) = false;
+};
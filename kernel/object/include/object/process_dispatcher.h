@@ -274,6 +274,11 @@ private:
     ProcessDispatcher& operator=(const ProcessDispatcher&) = delete;
 
 
+    // Maps a handle value to a Handle owned by this process, without
+    // applying job policy. The result stays valid only while the caller is
+    // inside a Handle::ReadSection or holds handle_table_lock_.
+    Handle* LookupHandle(zx_handle_t handle_value) const;
+
     zx_status_t GetDispatcherInternal(zx_handle_t handle_value, fbl::RefPtr<Dispatcher>* dispatcher,
                                       zx_rights_t* rights);
 
@@ -317,6 +322,8 @@ private:
     fbl::RefPtr<VmAspace> aspace_;
 
     // our list of handles
+    // Lookups that only need a handle's dispatcher and rights skip this lock
+    // and use a Handle::ReadSection instead; see LookupHandle().
     mutable DECLARE_MUTEX(ProcessDispatcher) handle_table_lock_; // protects |handles_|.
     fbl::DoublyLinkedList<Handle*> handles_ TA_GUARDED(handle_table_lock_);
 
@@ -18,6 +18,7 @@
 #include <object/excp_port.h>
 #include <object/futex_node.h>
 #include <object/thread_state.h>
+#include <object/wait_state_observer.h>
 
 #include <zircon/compiler.h>
 #include <zircon/syscalls/debug.h>
@@ -95,6 +96,9 @@ public:
     // accessors
     ProcessDispatcher* process() const { return process_.get(); }
 
+    // The kernel thread, for priority inheritance through futexes.
+    thread_t* kernel_thread() { return &thread_; }
+
     zx_status_t set_name(const char* name, size_t len) final __NONNULL((2));
     void get_name(char out_name[ZX_MAX_NAME_LEN]) const final __NONNULL((2));
     uint64_t runtime_ns() const { return thread_runtime(&thread_); }
@@ -153,10 +157,16 @@ public:
                            size_t buffer_len);
     // Profile support
     zx_status_t SetPriority(int32_t priority);
+    zx_status_t SetFairWeight(uint32_t weight);
+    zx_status_t SetDeadline(zx_duration_t capacity, zx_duration_t relative_deadline,
+                            zx_duration_t period);
 
     // For ChannelDispatcher use.
     ChannelDispatcher::MessageWaiter* GetMessageWaiter() { return &channel_waiter_; }
 
+    // For zx_object_wait_many() use. Only the thread itself may touch it.
+    WaitManyCache* GetWaitManyCache() { return &wait_many_cache_; }
+
     // Blocking syscalls, once they commit to a path that will likely block the
     // thread, use this helper class to properly set/restore |blocked_reason_|.
     class AutoBlocked final {
@@ -255,6 +265,9 @@ private:
     // in order to suspend a thread.
     ChannelDispatcher::MessageWaiter channel_waiter_;
 
+    // Per-thread wait items and observers for zx_object_wait_many().
+    WaitManyCache wait_many_cache_;
+
     // LK thread structure
     // put last to ease debugging since this is a pretty large structure
     // (~1.5K on x86_64).
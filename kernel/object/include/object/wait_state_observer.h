@@ -13,6 +13,7 @@
 #include <object/state_observer.h>
 
 #include <zircon/types.h>
+#include <fbl/array.h>
 #include <fbl/canary.h>
 #include <fbl/ref_ptr.h>
 
@@ -49,3 +50,25 @@ private:
     zx_signals_t wakeup_reasons_;
     fbl::RefPtr<Dispatcher> dispatcher_;  // Non-null only between Begin() and End().
 };
+
+// Scratch space for zx_object_wait_many(). Each ThreadDispatcher owns one, so
+// that a thread only allocates when it waits on more handles than it has
+// before, rather than every call building its observers on the stack.
+class WaitManyCache {
+public:
+    WaitManyCache() = default;
+
+    // Makes room for at least |count| items. Returns false if the memory
+    // could not be allocated, in which case the cache is unchanged.
+    bool Reserve(size_t count);
+
+    zx_wait_item_t* items() { return items_.get(); }
+    WaitStateObserver* observers() { return observers_.get(); }
+
+private:
+    WaitManyCache(const WaitManyCache&) = delete;
+    WaitManyCache& operator=(const WaitManyCache&) = delete;
+
+    fbl::Array<zx_wait_item_t> items_;
+    fbl::Array<WaitStateObserver> observers_;
+};
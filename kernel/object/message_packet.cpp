@@ -8,6 +8,8 @@
 
 #include <err.h>
 #include <fbl/algorithm.h>
+#include <fbl/slab_allocator.h>
+#include <lib/counters.h>
 #include <new>
 #include <stdint.h>
 #include <string.h>
@@ -15,12 +17,101 @@
 // MessagePackets have special allocation requirements because they can contain a variable number of
 // handles and a variable size payload.
 //
-// To reduce heap fragmentation, MessagePackets are stored in a lists of fixed size buffers
-// (BufferChains) rather than a contiguous blocks of memory.  These lists and buffers are allocated
-// from the PMM.
+// Most messages are small, so packets that fit in MessagePacket::kMaxSlabPacketSize bytes are
+// carved from one of a few size-classed slabs.  The slab object holds the MessagePacket object,
+// followed by its handles (if any), and finally its payload data (if any).
 //
-// The first buffer in a MessagePacket's BufferChain contains the MessagePacket object, followed by
-// its handles (if any), and finally its payload data (if any).
+// To reduce heap fragmentation, larger MessagePackets are stored in a lists of fixed size buffers
+// (BufferChains) rather than a contiguous blocks of memory.  These lists and buffers are allocated
+// from the PMM.  The same layout applies, with the first buffer in a MessagePacket's BufferChain
+// holding the MessagePacket object and its handles.  Packets also fall back to a BufferChain when
+// their slab has reached its limit.
+
+KCOUNTER(msg_slab_alloc, "kernel.channel.msg.slab_alloc");
+KCOUNTER(msg_slab_full, "kernel.channel.msg.slab_full");
+KCOUNTER(msg_chain_alloc, "kernel.channel.msg.chain_alloc");
+
+namespace {
+
+// A slab object large enough to hold a packet of up to |Size| bytes.
+template <size_t Size>
+struct SlabPacket;
+
+template <size_t Size>
+using SlabPacketTraits = fbl::StaticSlabAllocatorTraits<SlabPacket<Size>*>;
+
+template <size_t Size>
+struct SlabPacket : public fbl::SlabAllocated<SlabPacketTraits<Size>> {
+    // User-provided so that New() leaves |data| uninitialized rather than zeroing it.
+    SlabPacket() {}
+
+    alignas(MessagePacket) char data[Size];
+};
+
+// The size classes, smallest first.  A slab's memory is never returned to the heap, so each class
+// is capped at kMaxSlabs 16KiB slabs (4MiB).
+constexpr size_t kSlabSizes[] = {256, 1024, MessagePacket::kMaxSlabPacketSize};
+constexpr size_t kMaxSlabs = 256;
+
+} // namespace
+
+DECLARE_STATIC_SLAB_ALLOCATOR_STORAGE(SlabPacketTraits<kSlabSizes[0]>, kMaxSlabs);
+DECLARE_STATIC_SLAB_ALLOCATOR_STORAGE(SlabPacketTraits<kSlabSizes[1]>, kMaxSlabs);
+DECLARE_STATIC_SLAB_ALLOCATOR_STORAGE(SlabPacketTraits<kSlabSizes[2]>, kMaxSlabs);
+
+namespace {
+
+template <size_t Size>
+char* SlabAlloc() {
+    SlabPacket<Size>* obj = fbl::SlabAllocator<SlabPacketTraits<Size>>::New();
+    if (unlikely(obj == nullptr)) {
+        return nullptr;
+    }
+    // The slab object has no other members, so the packet storage is the object itself.
+    DEBUG_ASSERT(static_cast<void*>(obj->data) == static_cast<void*>(obj));
+    return obj->data;
+}
+
+// Allocates storage for a packet of |size| bytes from the smallest slab that fits, returning
+// nullptr if it is too large for any of them or its slab is exhausted.
+char* SlabAlloc(size_t size, uint8_t* slab_class) {
+    static_assert(fbl::count_of(kSlabSizes) == 3, "");
+    char* storage;
+    if (size <= kSlabSizes[0]) {
+        *slab_class = 0;
+        storage = SlabAlloc<kSlabSizes[0]>();
+    } else if (size <= kSlabSizes[1]) {
+        *slab_class = 1;
+        storage = SlabAlloc<kSlabSizes[1]>();
+    } else if (size <= kSlabSizes[2]) {
+        *slab_class = 2;
+        storage = SlabAlloc<kSlabSizes[2]>();
+    } else {
+        return nullptr;
+    }
+    if (unlikely(storage == nullptr)) {
+        kcounter_add(msg_slab_full, 1);
+    }
+    return storage;
+}
+
+void SlabFree(char* storage, uint8_t slab_class) {
+    switch (slab_class) {
+    case 0:
+        delete reinterpret_cast<SlabPacket<kSlabSizes[0]>*>(storage);
+        break;
+    case 1:
+        delete reinterpret_cast<SlabPacket<kSlabSizes[1]>*>(storage);
+        break;
+    case 2:
+        delete reinterpret_cast<SlabPacket<kSlabSizes[2]>*>(storage);
+        break;
+    default:
+        panic("bad message packet slab class %u\n", slab_class);
+    }
+}
+
+} // namespace
 
 // The MessagePacket object, its handles and zx_txid_t must all fit in the first buffer.
 static constexpr size_t kContiguousBytes =
@@ -51,23 +142,32 @@ inline zx_status_t MessagePacket::CreateCommon(uint32_t data_size, uint32_t num_
 
     const uint32_t payload_offset = PayloadOffset(num_handles);
 
-    // MessagePackets lives *inside* a list of buffers.  The first buffer holds the MessagePacket
-    // object, followed by its handles (if any), and finally the payload data.
-    BufferChain* chain = BufferChain::Alloc(payload_offset + data_size);
-    if (unlikely(!chain)) {
-        return ZX_ERR_NO_MEMORY;
+    // Small packets live *inside* a single slab object.  Everything else lives *inside* a list of
+    // buffers, whose first buffer holds the MessagePacket object, its handles (if any), and the
+    // start of the payload data.
+    uint8_t slab_class = 0;
+    BufferChain* chain = nullptr;
+    char* data = SlabAlloc(payload_offset + data_size, &slab_class);
+    if (likely(data != nullptr)) {
+        kcounter_add(msg_slab_alloc, 1);
+    } else {
+        chain = BufferChain::Alloc(payload_offset + data_size);
+        if (unlikely(!chain)) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        DEBUG_ASSERT(!chain->buffers()->is_empty());
+        kcounter_add(msg_chain_alloc, 1);
+        data = chain->buffers()->front().data();
     }
-    DEBUG_ASSERT(!chain->buffers()->is_empty());
 
-    char* const data = chain->buffers()->front().data();
     Handle** const handles = reinterpret_cast<Handle**>(data + kHandlesOffset);
 
-    // Construct the MessagePacket into the first buffer.
+    // Construct the MessagePacket at the start of its storage.
     MessagePacket* const packet = reinterpret_cast<MessagePacket*>(data);
     static_assert(kMaxMessageHandles <= UINT16_MAX, "");
-    msg->reset(new (packet) MessagePacket(chain, data_size, payload_offset,
+    msg->reset(new (packet) MessagePacket(chain, slab_class, data_size, payload_offset,
                                           static_cast<uint16_t>(num_handles), handles));
-    // The MessagePacket now owns the BufferChain and msg owns the MessagePacket.
+    // The MessagePacket now owns its storage and msg owns the MessagePacket.
 
     return ZX_OK;
 }
@@ -80,7 +180,11 @@ zx_status_t MessagePacket::Create(user_in_ptr<const void> data, uint32_t data_si
     if (unlikely(status != ZX_OK)) {
         return status;
     }
-    status = new_msg->buffer_chain_->CopyIn(data, PayloadOffset(num_handles), data_size);
+    if (new_msg->buffer_chain_ == nullptr) {
+        status = data.copy_array_from_user(new_msg->payload(), data_size);
+    } else {
+        status = new_msg->buffer_chain_->CopyIn(data, PayloadOffset(num_handles), data_size);
+    }
     if (unlikely(status != ZX_OK)) {
         return status;
     }
@@ -96,7 +200,13 @@ zx_status_t MessagePacket::Create(const void* data, uint32_t data_size, uint32_t
     if (unlikely(status != ZX_OK)) {
         return status;
     }
-    status = new_msg->buffer_chain_->CopyInKernel(data, PayloadOffset(num_handles), data_size);
+    if (new_msg->buffer_chain_ == nullptr) {
+        if (data_size > 0) {
+            memcpy(new_msg->payload(), data, data_size);
+        }
+    } else {
+        status = new_msg->buffer_chain_->CopyInKernel(data, PayloadOffset(num_handles), data_size);
+    }
     if (unlikely(status != ZX_OK)) {
         return status;
     }
@@ -107,7 +217,13 @@ zx_status_t MessagePacket::Create(const void* data, uint32_t data_size, uint32_t
 void MessagePacket::fbl_recycle() {
     // This function invokes the destructor so be careful about taking any references to |this|.
     BufferChain* chain = buffer_chain_;
+    const uint8_t slab_class = slab_class_;
+    char* const storage = reinterpret_cast<char*>(this);
     this->~MessagePacket();
     // |this| has been destroyed.
-    BufferChain::Free(chain);
+    if (chain == nullptr) {
+        SlabFree(storage, slab_class);
+    } else {
+        BufferChain::Free(chain);
+    }
 }
@@ -141,6 +141,79 @@ static bool copy_bad_mem() {
     END_TEST;
 }
 
+// Small packets come from a slab and large ones from a BufferChain, with the switch happening
+// exactly when the packet, its handles and its data no longer fit in kMaxSlabPacketSize bytes.
+static bool create_slab_threshold() {
+    BEGIN_TEST;
+    constexpr uint32_t kNumHandles = 3;
+    constexpr uint32_t kMaxSlabSize = static_cast<uint32_t>(
+        MessagePacket::kMaxSlabPacketSize - sizeof(MessagePacket) - kNumHandles * sizeof(Handle*));
+    constexpr uint32_t kSize = kMaxSlabSize + 1;
+    fbl::unique_ptr<UserMemory> mem = UserMemory::Create(kSize);
+    auto mem_in = make_user_in_ptr(mem->in());
+    auto mem_out = make_user_out_ptr(mem->out());
+
+    fbl::AllocChecker ac;
+    auto buf = fbl::unique_ptr<char[]>(new (&ac) char[kSize]);
+    ASSERT_TRUE(ac.check(), "");
+    auto result_buf = fbl::unique_ptr<char[]>(new (&ac) char[kSize]);
+    ASSERT_TRUE(ac.check(), "");
+
+    const uint32_t sizes[] = {0u, 16u, kMaxSlabSize, kSize};
+    for (uint32_t size : sizes) {
+        memset(buf.get(), static_cast<int>('a' + size % 26), kSize);
+        ASSERT_EQ(ZX_OK, mem_out.copy_array_to_user(buf.get(), size), "");
+
+        fbl::unique_ptr<MessagePacket> mp;
+        ASSERT_EQ(ZX_OK, MessagePacket::Create(mem_in, size, kNumHandles, &mp), "");
+        EXPECT_EQ(size, mp->data_size(), "");
+        EXPECT_EQ(kNumHandles, mp->num_handles(), "");
+        EXPECT_EQ(size <= kMaxSlabSize, mp->is_slab_allocated(), "");
+
+        memset(result_buf.get(), 0, kSize);
+        ASSERT_EQ(ZX_OK, mem_out.copy_array_to_user(result_buf.get(), kSize), "");
+        ASSERT_EQ(ZX_OK, mp->CopyDataTo(mem_out), "");
+        ASSERT_EQ(ZX_OK, mem_in.copy_array_from_user(result_buf.get(), size), "");
+        EXPECT_EQ(0, memcmp(buf.get(), result_buf.get(), size), "");
+    }
+    END_TEST;
+}
+
+// Keep enough small packets alive at once to need several slabs, and make sure none of them
+// stomp on each other's handles or data.
+static bool slab_packets_are_distinct() {
+    BEGIN_TEST;
+    constexpr size_t kNumPackets = 256;
+    constexpr uint32_t kNumHandles = 2;
+
+    fbl::AllocChecker ac;
+    auto packets = fbl::unique_ptr<fbl::unique_ptr<MessagePacket>[]>(
+        new (&ac) fbl::unique_ptr<MessagePacket>[kNumPackets]);
+    ASSERT_TRUE(ac.check(), "");
+
+    for (size_t i = 0; i < kNumPackets; ++i) {
+        const zx_txid_t txid = static_cast<zx_txid_t>(i + 1);
+        ASSERT_EQ(ZX_OK, MessagePacket::Create(&txid, sizeof(txid), kNumHandles, &packets[i]),
+                  "");
+        EXPECT_TRUE(packets[i]->is_slab_allocated(), "");
+        Handle** handles = packets[i]->mutable_handles();
+        for (uint32_t h = 0; h < kNumHandles; ++h) {
+            handles[h] = reinterpret_cast<Handle*>(i * kNumHandles + h + 1);
+        }
+    }
+
+    for (size_t i = 0; i < kNumPackets; ++i) {
+        EXPECT_EQ(static_cast<zx_txid_t>(i + 1), packets[i]->get_txid(), "");
+        packets[i]->set_txid(0);
+        EXPECT_EQ(0U, packets[i]->get_txid(), "");
+        Handle* const* handles = packets[i]->handles();
+        for (uint32_t h = 0; h < kNumHandles; ++h) {
+            EXPECT_EQ(reinterpret_cast<Handle*>(i * kNumHandles + h + 1), handles[h], "");
+        }
+    }
+    END_TEST;
+}
+
 }  // namespace
 
 UNITTEST_START_TESTCASE(message_packet_tests)
@@ -150,4 +223,6 @@ UNITTEST("create_zero", create_zero)
 UNITTEST("create_too_many_handles", create_too_many_handles)
 UNITTEST("create_bad_mem", create_bad_mem)
 UNITTEST("copy_bad_mem", copy_bad_mem)
+UNITTEST("create_slab_threshold", create_slab_threshold)
+UNITTEST("slab_packets_are_distinct", slab_packets_are_distinct)
 UNITTEST_END_TESTCASE(message_packet_tests, "message_packet", "MessagePacket tests");
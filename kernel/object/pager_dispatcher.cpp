@@ -0,0 +1,162 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/pager_dispatcher.h>
+
+#include <err.h>
+#include <inttypes.h>
+#include <trace.h>
+
+#include <fbl/alloc_checker.h>
+#include <vm/pmm.h>
+#include <vm/vm.h>
+#include <zircon/rights.h>
+#include <zircon/syscalls/port.h>
+
+#define LOCAL_TRACE 0
+
+PagerSource::PagerSource(fbl::RefPtr<PagerDispatcher> pager, fbl::RefPtr<PortDispatcher> port,
+                         uint64_t key)
+    : pager_(fbl::move(pager)), port_(fbl::move(port)), key_(key) {}
+
+PagerSource::~PagerSource() {
+    DEBUG_ASSERT(!InContainer());
+}
+
+zx_status_t PagerSource::SendRequest(uint64_t offset, uint64_t len) {
+    zx_status_t status = QueuePacket(ZX_PAGER_VMO_READ, offset, len);
+    // a full port fails the fault rather than make the waiter wait for nothing
+    return status == ZX_ERR_SHOULD_WAIT ? ZX_ERR_NO_RESOURCES : status;
+}
+
+void PagerSource::OnDetach() {
+    // best effort; the pager only needs it to free what it kept for the vmo
+    QueuePacket(ZX_PAGER_VMO_COMPLETE, 0, 0);
+    pager_->RemoveSource(this);
+}
+
+zx_status_t PagerSource::QueuePacket(uint16_t command, uint64_t offset, uint64_t len) {
+    PortPacket* port_packet = PortDispatcher::DefaultPortAllocator()->Alloc();
+    if (!port_packet) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    port_packet->packet.key = key_;
+    port_packet->packet.type = ZX_PKT_TYPE_PAGE_REQUEST;
+    port_packet->packet.status = ZX_OK;
+    port_packet->packet.page_request.command = command;
+    port_packet->packet.page_request.offset = offset;
+    port_packet->packet.page_request.length = len;
+
+    LTRACEF("key %#" PRIx64 " command %u [%#" PRIx64 ", %#" PRIx64 ")\n", key_, command,
+            offset, offset + len);
+
+    zx_status_t status = port_->Queue(port_packet, 0, 0);
+    if (status != ZX_OK) {
+        port_packet->Free();
+    }
+    return status;
+}
+
+zx_status_t PagerDispatcher::Create(fbl::RefPtr<Dispatcher>* dispatcher, zx_rights_t* rights) {
+    fbl::AllocChecker ac;
+    auto disp = new (&ac) PagerDispatcher();
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    *rights = default_rights();
+    *dispatcher = fbl::AdoptRef<Dispatcher>(disp);
+    return ZX_OK;
+}
+
+PagerDispatcher::PagerDispatcher() = default;
+
+PagerDispatcher::~PagerDispatcher() {
+    DEBUG_ASSERT(sources_.is_empty());
+}
+
+void PagerDispatcher::on_zero_handles() {
+    canary_.Assert();
+
+    fbl::DoublyLinkedList<fbl::RefPtr<PagerSource>> sources;
+    {
+        Guard<fbl::Mutex> guard{get_lock()};
+        closed_ = true;
+        sources.swap(sources_);
+    }
+
+    // nobody is left to supply the pages, so fail whoever waits for them
+    while (!sources.is_empty()) {
+        sources.pop_front()->Close();
+    }
+}
+
+zx_status_t PagerDispatcher::CreateSource(fbl::RefPtr<PortDispatcher> port, uint64_t key,
+                                          fbl::RefPtr<PageSource>* source) {
+    canary_.Assert();
+
+    fbl::AllocChecker ac;
+    auto src = fbl::AdoptRef(new (&ac) PagerSource(fbl::WrapRefPtr(this), fbl::move(port), key));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    Guard<fbl::Mutex> guard{get_lock()};
+    if (closed_) {
+        return ZX_ERR_BAD_STATE;
+    }
+    sources_.push_back(src);
+    *source = fbl::move(src);
+    return ZX_OK;
+}
+
+void PagerDispatcher::RemoveSource(PagerSource* source) {
+    Guard<fbl::Mutex> guard{get_lock()};
+    if (source->InContainer()) {
+        sources_.erase(*source);
+    }
+}
+
+zx_status_t PagerDispatcher::SupplyPages(VmObject* vmo, uint64_t offset, uint64_t len,
+                                         VmObject* aux, uint64_t aux_offset) {
+    canary_.Assert();
+
+    // check what we can before any pages are taken from |aux|
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(len) || !IS_PAGE_ALIGNED(aux_offset)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (offset + len < offset || offset + len > vmo->size()) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    const fbl::RefPtr<PageSource> source = vmo->page_source();
+    if (!source) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    {
+        Guard<fbl::Mutex> guard{get_lock()};
+        bool found = false;
+        for (const auto& s : sources_) {
+            if (&s == source.get()) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+    }
+
+    list_node pages = LIST_INITIAL_VALUE(pages);
+    zx_status_t status = aux->TakePages(aux_offset, len, &pages);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    status = vmo->SupplyPages(offset, len, &pages);
+    // whatever wasn't supplied is lost to |aux| either way
+    pmm_free(&pages);
+    return status;
+}
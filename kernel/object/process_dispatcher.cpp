@@ -49,9 +49,8 @@ static zx_handle_t map_handle_to_value(const Handle* handle, uint32_t mixer) {
     return static_cast<zx_handle_t>(mixer ^ handle_id);
 }
 
-static Handle* map_value_to_handle(zx_handle_t value, uint32_t mixer) {
-    auto handle_id = (static_cast<uint32_t>(value) ^ mixer) >> 1;
-    return Handle::FromU32(handle_id);
+static uint32_t map_value_to_handle_id(zx_handle_t value, uint32_t mixer) {
+    return (static_cast<uint32_t>(value) ^ mixer) >> 1;
 }
 
 zx_status_t ProcessDispatcher::Create(
@@ -394,10 +393,24 @@ zx_handle_t ProcessDispatcher::MapHandleToValue(const HandleOwner& handle) const
     return map_handle_to_value(handle.get(), handle_rand_);
 }
 
+Handle* ProcessDispatcher::LookupHandle(zx_handle_t handle_value) const {
+    const uint32_t handle_id = map_value_to_handle_id(handle_value, handle_rand_);
+    auto handle = Handle::FromU32(handle_id);
+    if (!handle || handle->process_id() != get_koid())
+        return nullptr;
+    // Without handle_table_lock_, FromU32() may have matched the base value
+    // of an earlier Handle in this slot. Only what is read after the acquire
+    // in process_id() belongs to the Handle that made the pid match, so check
+    // the base value again.
+    if (handle->base_value() != handle_id)
+        return nullptr;
+    return handle;
+}
+
 Handle* ProcessDispatcher::GetHandleLocked(zx_handle_t handle_value,
                                            bool skip_policy) {
-    auto handle = map_value_to_handle(handle_value, handle_rand_);
-    if (handle && handle->process_id() == get_koid())
+    auto handle = LookupHandle(handle_value);
+    if (handle)
         return handle;
 
     // Handle lookup failed.  We potentially generate an exception,
@@ -470,44 +483,57 @@ zx_status_t ProcessDispatcher::RemoveHandles(user_in_ptr<const zx_handle_t> user
     return status;
 }
 
+// The lookups below only copy out of the Handle, so they use a
+// Handle::ReadSection rather than handle_table_lock_. Job policy for a bad
+// handle is applied after the section ends, since it can block.
+
 zx_koid_t ProcessDispatcher::GetKoidForHandle(zx_handle_t handle_value) {
-    Guard<fbl::Mutex> guard{&handle_table_lock_};
-    Handle* handle = GetHandleLocked(handle_value);
-    if (!handle)
-        return ZX_KOID_INVALID;
-    return handle->dispatcher()->get_koid();
+    {
+        Handle::ReadSection section;
+        Handle* handle = LookupHandle(handle_value);
+        if (handle)
+            return handle->dispatcher()->get_koid();
+    }
+    QueryPolicy(ZX_POL_BAD_HANDLE);
+    return ZX_KOID_INVALID;
 }
 
 zx_status_t ProcessDispatcher::GetDispatcherInternal(zx_handle_t handle_value,
                                                      fbl::RefPtr<Dispatcher>* dispatcher,
                                                      zx_rights_t* rights) {
-    Guard<fbl::Mutex> guard{&handle_table_lock_};
-    Handle* handle = GetHandleLocked(handle_value);
-    if (!handle)
-        return ZX_ERR_BAD_HANDLE;
-
-    *dispatcher = handle->dispatcher();
-    if (rights)
-        *rights = handle->rights();
-    return ZX_OK;
+    {
+        Handle::ReadSection section;
+        Handle* handle = LookupHandle(handle_value);
+        if (handle) {
+            *dispatcher = handle->dispatcher();
+            if (rights)
+                *rights = handle->rights();
+            return ZX_OK;
+        }
+    }
+    QueryPolicy(ZX_POL_BAD_HANDLE);
+    return ZX_ERR_BAD_HANDLE;
 }
 
 zx_status_t ProcessDispatcher::GetDispatcherWithRightsInternal(zx_handle_t handle_value,
                                                                zx_rights_t desired_rights,
                                                                fbl::RefPtr<Dispatcher>* dispatcher_out,
                                                                zx_rights_t* out_rights) {
-    Guard<fbl::Mutex> guard{&handle_table_lock_};
-    Handle* handle = GetHandleLocked(handle_value);
-    if (!handle)
-        return ZX_ERR_BAD_HANDLE;
-
-    if (!handle->HasRights(desired_rights))
-        return ZX_ERR_ACCESS_DENIED;
-
-    *dispatcher_out = handle->dispatcher();
-    if (out_rights)
-        *out_rights = handle->rights();
-    return ZX_OK;
+    {
+        Handle::ReadSection section;
+        Handle* handle = LookupHandle(handle_value);
+        if (handle) {
+            if (!handle->HasRights(desired_rights))
+                return ZX_ERR_ACCESS_DENIED;
+
+            *dispatcher_out = handle->dispatcher();
+            if (out_rights)
+                *out_rights = handle->rights();
+            return ZX_OK;
+        }
+    }
+    QueryPolicy(ZX_POL_BAD_HANDLE);
+    return ZX_ERR_BAD_HANDLE;
 }
 
 zx_status_t ProcessDispatcher::GetInfo(zx_info_process_t* info) {
@@ -554,6 +580,7 @@ zx_status_t ProcessDispatcher::GetStats(zx_info_task_stats_t* stats) {
     stats->mem_private_bytes = usage.private_pages * PAGE_SIZE;
     stats->mem_shared_bytes = usage.shared_pages * PAGE_SIZE;
     stats->mem_scaled_shared_bytes = usage.scaled_shared_bytes;
+    stats->page_faults = aspace_->page_faults();
     return ZX_OK;
 }
 
@@ -808,13 +835,15 @@ const char* StateToString(ProcessDispatcher::State state) {
 }
 
 bool ProcessDispatcher::IsHandleValid(zx_handle_t handle_value) {
-    Guard<fbl::Mutex> guard{&handle_table_lock_};
-    return (GetHandleLocked(handle_value) != nullptr);
+    if (IsHandleValidNoPolicyCheck(handle_value))
+        return true;
+    QueryPolicy(ZX_POL_BAD_HANDLE);
+    return false;
 }
 
 bool ProcessDispatcher::IsHandleValidNoPolicyCheck(zx_handle_t handle_value) {
-    Guard<fbl::Mutex> guard{&handle_table_lock_};
-    return (GetHandleLocked(handle_value, true) != nullptr);
+    Handle::ReadSection section;
+    return (LookupHandle(handle_value) != nullptr);
 }
 
 void ProcessDispatcher::OnProcessStartForJobDebugger(ThreadDispatcher *t) {
@@ -15,13 +15,32 @@
 
 #include <zircon/rights.h>
 
+static_assert(ZX_FAIR_WEIGHT_MIN == FAIR_WEIGHT_MIN &&
+              ZX_FAIR_WEIGHT_DEFAULT == FAIR_WEIGHT_DEFAULT &&
+              ZX_FAIR_WEIGHT_MAX == FAIR_WEIGHT_MAX, "");
+
 zx_status_t validate_profile(const zx_profile_info_t& info) {
-    if (info.type != ZX_PROFILE_INFO_SCHEDULER)
+    switch (info.type) {
+    case ZX_PROFILE_INFO_SCHEDULER:
+        if ((info.scheduler.priority < LOWEST_PRIORITY) ||
+            (info.scheduler.priority  > HIGHEST_PRIORITY))
+            return ZX_ERR_INVALID_ARGS;
+        return ZX_OK;
+    case ZX_PROFILE_INFO_FAIR:
+        if ((info.fair.weight < ZX_FAIR_WEIGHT_MIN) ||
+            (info.fair.weight > ZX_FAIR_WEIGHT_MAX))
+            return ZX_ERR_INVALID_ARGS;
+        return ZX_OK;
+    case ZX_PROFILE_INFO_DEADLINE:
+        if ((info.deadline.capacity <= 0) ||
+            (info.deadline.capacity >= ZX_SEC(1)) ||
+            (info.deadline.capacity > info.deadline.relative_deadline) ||
+            (info.deadline.relative_deadline > info.deadline.period))
+            return ZX_ERR_INVALID_ARGS;
+        return ZX_OK;
+    default:
         return ZX_ERR_NOT_SUPPORTED;
-    if ((info.scheduler.priority < LOWEST_PRIORITY) ||
-        (info.scheduler.priority  > HIGHEST_PRIORITY))
-        return ZX_ERR_INVALID_ARGS;
-    return ZX_OK;
+    }
 }
 
 zx_status_t ProfileDispatcher::Create(const zx_profile_info_t& info,
@@ -48,6 +67,15 @@ ProfileDispatcher::~ProfileDispatcher() {
 }
 
 zx_status_t ProfileDispatcher::ApplyProfile(fbl::RefPtr<ThreadDispatcher> thread) {
-    // At the moment, the only thing we support is the priority.
-    return thread->SetPriority(info_.scheduler.priority);
+    switch (info_.type) {
+    case ZX_PROFILE_INFO_FAIR:
+        return thread->SetFairWeight(info_.fair.weight);
+    case ZX_PROFILE_INFO_DEADLINE:
+        return thread->SetDeadline(info_.deadline.capacity,
+                                   info_.deadline.relative_deadline,
+                                   info_.deadline.period);
+    default:
+        // For the scheduler profile the only thing we support is the priority.
+        return thread->SetPriority(info_.scheduler.priority);
+    }
 }
@@ -970,6 +970,32 @@ zx_status_t ThreadDispatcher::SetPriority(int32_t priority) {
     return ZX_OK;
 }
 
+zx_status_t ThreadDispatcher::SetFairWeight(uint32_t weight) {
+    Guard<fbl::Mutex> guard{get_lock()};
+    if ((state_.lifecycle() == ThreadState::Lifecycle::INITIAL) ||
+        (state_.lifecycle() == ThreadState::Lifecycle::DYING) ||
+        (state_.lifecycle() == ThreadState::Lifecycle::DEAD)) {
+        return ZX_ERR_BAD_STATE;
+    }
+    // The weight was already validated by the Profile dispatcher.
+    thread_set_fair_weight(&thread_, weight);
+    return ZX_OK;
+}
+
+zx_status_t ThreadDispatcher::SetDeadline(zx_duration_t capacity,
+                                          zx_duration_t relative_deadline,
+                                          zx_duration_t period) {
+    Guard<fbl::Mutex> guard{get_lock()};
+    if ((state_.lifecycle() == ThreadState::Lifecycle::INITIAL) ||
+        (state_.lifecycle() == ThreadState::Lifecycle::DYING) ||
+        (state_.lifecycle() == ThreadState::Lifecycle::DEAD)) {
+        return ZX_ERR_BAD_STATE;
+    }
+    // The parameters were already validated by the Profile dispatcher.
+    thread_set_deadline(&thread_, capacity, relative_deadline, period);
+    return ZX_OK;
+}
+
 const char* ThreadLifecycleToString(ThreadState::Lifecycle lifecycle) {
     switch (lifecycle) {
     case ThreadState::Lifecycle::INITIAL:
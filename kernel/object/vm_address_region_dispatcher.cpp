@@ -79,6 +79,13 @@ zx_status_t split_syscall_flags(uint32_t flags, uint32_t* vmar_flags, uint* arch
         vmar |= VMAR_FLAG_REQUIRE_NON_RESIZABLE;
         flags &= ~ZX_VM_REQUIRE_NON_RESIZABLE;
     }
+    if (flags & ZX_VM_FAULT_AROUND_MASK) {
+        uint32_t fault_around = (flags & ZX_VM_FAULT_AROUND_MASK) >> ZX_VM_FAULT_AROUND_BASE;
+        if (fault_around > ZX_VM_FAULT_AROUND_MAX + 1)
+            return ZX_ERR_INVALID_ARGS;
+        vmar |= fault_around << VMAR_FLAG_FAULT_AROUND_SHIFT;
+        flags &= ~ZX_VM_FAULT_AROUND_MASK;
+    }
 
     if (flags != 0)
         return ZX_ERR_INVALID_ARGS;
@@ -111,6 +111,7 @@ zx_info_vmo_t VmoToInfoEntry(const VmObject* vmo,
         (vmo->is_cow_clone() ? ZX_INFO_VMO_IS_COW_CLONE : 0);
     entry.committed_bytes = vmo->AllocatedPages() * PAGE_SIZE;
     entry.cache_policy = vmo->GetMappingCachePolicy();
+    entry.zero_reclaimed_bytes = vmo->ReclaimedZeroPages() * PAGE_SIZE;
     if (is_handle) {
         entry.flags |= ZX_INFO_VMO_VIA_HANDLE;
         entry.handle_rights = handle_rights;
@@ -151,10 +152,28 @@ zx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t s
             auto status = vmo_->DecommitRange(offset, size);
             return status;
         }
-        case ZX_VMO_OP_LOCK:
-        case ZX_VMO_OP_UNLOCK:
-            // TODO: handle or remove
-            return ZX_ERR_NOT_SUPPORTED;
+        case ZX_VMO_OP_LOCK: {
+            if ((rights & ZX_RIGHT_WRITE) == 0) {
+                return ZX_ERR_ACCESS_DENIED;
+            }
+            bool discarded;
+            auto status = vmo_->LockRange(offset, size, &discarded);
+            if (status != ZX_OK) {
+                return status;
+            }
+            // optionally tell the caller whether the contents were lost
+            if (buffer && buffer_size >= sizeof(uint32_t)) {
+                uint32_t value = discarded ? 1 : 0;
+                status = buffer.reinterpret<uint32_t>().copy_to_user(value);
+            }
+            return status;
+        }
+        case ZX_VMO_OP_UNLOCK: {
+            if ((rights & ZX_RIGHT_WRITE) == 0) {
+                return ZX_ERR_ACCESS_DENIED;
+            }
+            return vmo_->UnlockRange(offset, size);
+        }
 
         case ZX_VMO_OP_CACHE_SYNC:
             if ((rights & ZX_RIGHT_READ) == 0) {
@@ -13,6 +13,9 @@
 #include <object/handle.h>
 #include <object/dispatcher.h>
 
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+
 WaitStateObserver::~WaitStateObserver() {
     DEBUG_ASSERT(!dispatcher_);
 }
@@ -92,3 +95,27 @@ StateObserver::Flags WaitStateObserver::OnCancel(const Handle* handle) {
         return 0;
     }
 }
+
+bool WaitManyCache::Reserve(size_t count) {
+    DEBUG_ASSERT(count <= ZX_WAIT_MANY_MAX_ITEMS);
+    if (count <= observers_.size())
+        return true;
+
+    // Grow geometrically, starting big enough for most callers, so that a
+    // thread whose wait set keeps growing doesn't reallocate on every call.
+    constexpr size_t kMinItems = 16u;
+    size_t capacity = fbl::max(kMinItems, observers_.size() * 2);
+    capacity = fbl::min(fbl::max(capacity, count), ZX_WAIT_MANY_MAX_ITEMS);
+
+    fbl::AllocChecker ac;
+    fbl::Array<zx_wait_item_t> items(new (&ac) zx_wait_item_t[capacity], capacity);
+    if (!ac.check())
+        return false;
+    fbl::Array<WaitStateObserver> observers(new (&ac) WaitStateObserver[capacity], capacity);
+    if (!ac.check())
+        return false;
+
+    items_ = fbl::move(items);
+    observers_ = fbl::move(observers);
+    return true;
+}
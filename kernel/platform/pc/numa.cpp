@@ -0,0 +1,149 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <zircon/compiler.h>
+
+#include <acpica/acpi.h>
+
+#include <arch/x86/mp.h>
+#include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <lk/init.h>
+#include <trace.h>
+#include <vm/pmm.h>
+#include <zircon/types.h>
+
+#define LOCAL_TRACE 0
+
+// Visit each subtable of the SRAT, if there is one.
+template <typename Func>
+static bool numa_for_each_srat_entry(Func func) {
+    ACPI_TABLE_HEADER* table = NULL;
+    ACPI_STATUS status = AcpiGetTable((char*)ACPI_SIG_SRAT, 1, &table);
+    if (status != AE_OK) {
+        return false;
+    }
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(table) + sizeof(ACPI_TABLE_SRAT);
+    uintptr_t end = reinterpret_cast<uintptr_t>(table) + table->Length;
+    while (start + sizeof(ACPI_SUBTABLE_HEADER) <= end) {
+        auto sub = reinterpret_cast<ACPI_SUBTABLE_HEADER*>(start);
+        if (sub->Length < sizeof(ACPI_SUBTABLE_HEADER) || start + sub->Length > end) {
+            TRACEF("malformed SRAT entry at %#" PRIxPTR "\n", start);
+            break;
+        }
+        func(sub);
+        start += sub->Length;
+    }
+    return true;
+}
+
+static uint32_t numa_cpu_domain(const ACPI_SRAT_CPU_AFFINITY* cpu) {
+    return cpu->ProximityDomainLo |
+           (uint32_t)cpu->ProximityDomainHi[0] << 8 |
+           (uint32_t)cpu->ProximityDomainHi[1] << 16 |
+           (uint32_t)cpu->ProximityDomainHi[2] << 24;
+}
+
+static bool numa_enabled;
+
+// Hand the memory ranges of each proximity domain to the pmm, along with the
+// distances between domains. This has to happen before the secondary cpus
+// start allocating.
+static void numa_init_memory(uint level) {
+    numa_enabled = cmdline_get_bool("kernel.pmm.numa", true);
+    if (!numa_enabled) {
+        return;
+    }
+
+    bool found = numa_for_each_srat_entry([](ACPI_SUBTABLE_HEADER* sub) {
+        if (sub->Type != ACPI_SRAT_TYPE_MEMORY_AFFINITY ||
+            sub->Length < sizeof(ACPI_SRAT_MEM_AFFINITY)) {
+            return;
+        }
+        auto mem = reinterpret_cast<ACPI_SRAT_MEM_AFFINITY*>(sub);
+        if (!(mem->Flags & ACPI_SRAT_MEM_ENABLED) || mem->Length == 0) {
+            return;
+        }
+        LTRACEF("domain %u: [%#" PRIx64 ", %#" PRIx64 ")\n", mem->ProximityDomain,
+                mem->BaseAddress, mem->BaseAddress + mem->Length);
+        zx_status_t status = pmm_numa_add_range(mem->ProximityDomain,
+                                                static_cast<paddr_t>(mem->BaseAddress),
+                                                static_cast<size_t>(mem->Length));
+        if (status != ZX_OK) {
+            TRACEF("could not add memory of domain %u: %d\n", mem->ProximityDomain, status);
+        }
+    });
+    if (!found) {
+        numa_enabled = false;
+        return;
+    }
+
+    ACPI_TABLE_HEADER* table = NULL;
+    if (AcpiGetTable((char*)ACPI_SIG_SLIT, 1, &table) != AE_OK) {
+        return;
+    }
+    auto slit = reinterpret_cast<ACPI_TABLE_SLIT*>(table);
+    uint64_t count = slit->LocalityCount;
+    if (count > UINT8_MAX || table->Length < sizeof(ACPI_TABLE_SLIT) - 1 + count * count) {
+        TRACEF("bad SLIT with %" PRIu64 " localities\n", count);
+        return;
+    }
+    for (uint64_t from = 0; from < count; from++) {
+        for (uint64_t to = 0; to < count; to++) {
+            pmm_numa_set_distance(static_cast<uint32_t>(from), static_cast<uint32_t>(to),
+                                  slit->Entry[from * count + to]);
+        }
+    }
+}
+
+// ACPI tables are initialized at LK_INIT_LEVEL_VM + 1.
+LK_INIT_HOOK(numa_memory, &numa_init_memory, LK_INIT_LEVEL_VM + 2);
+
+static void numa_set_cpu_domain(uint32_t apic_id, uint32_t domain) {
+    int cpu = x86_apic_id_to_cpu_num(apic_id);
+    if (cpu < 0) {
+        return;
+    }
+    LTRACEF("cpu %d (apic id %u): domain %u\n", cpu, apic_id, domain);
+    pmm_numa_set_cpu_domain(static_cast<cpu_num_t>(cpu), domain);
+}
+
+// Cpu numbers are only assigned once the secondary cpus are brought up, so
+// each cpu's local node is set afterwards. Until then they allocate from the
+// boot cpu's node.
+static void numa_init_cpus(uint level) {
+    if (!numa_enabled) {
+        return;
+    }
+
+    numa_for_each_srat_entry([](ACPI_SUBTABLE_HEADER* sub) {
+        switch (sub->Type) {
+        case ACPI_SRAT_TYPE_CPU_AFFINITY: {
+            if (sub->Length < sizeof(ACPI_SRAT_CPU_AFFINITY)) {
+                break;
+            }
+            auto cpu = reinterpret_cast<ACPI_SRAT_CPU_AFFINITY*>(sub);
+            if (cpu->Flags & ACPI_SRAT_CPU_USE_AFFINITY) {
+                numa_set_cpu_domain(cpu->ApicId, numa_cpu_domain(cpu));
+            }
+            break;
+        }
+        case ACPI_SRAT_TYPE_X2APIC_CPU_AFFINITY: {
+            if (sub->Length < sizeof(ACPI_SRAT_X2APIC_CPU_AFFINITY)) {
+                break;
+            }
+            auto cpu = reinterpret_cast<ACPI_SRAT_X2APIC_CPU_AFFINITY*>(sub);
+            if (cpu->Flags & ACPI_SRAT_CPU_ENABLED) {
+                numa_set_cpu_domain(cpu->ApicId, cpu->ProximityDomain);
+            }
+            break;
+        }
+        }
+    });
+}
+
+LK_INIT_HOOK(numa_cpus, &numa_init_cpus, LK_INIT_LEVEL_PLATFORM);
@@ -16,6 +16,7 @@
 #include <arch/x86/apic.h>
 #include <arch/x86/cpu_topology.h>
 #include <arch/x86/mmu.h>
+#include <arch/x86/mp.h>
 #include <assert.h>
 #if defined(WITH_KERNEL_PCIE)
 #include <dev/pcie_bus_driver.h>
@@ -24,6 +25,7 @@
 #include <err.h>
 #include <fbl/alloc_checker.h>
 #include <kernel/cmdline.h>
+#include <kernel/mp.h>
 #include <lib/debuglog.h>
 #include <libzbi/zbi-cpp.h>
 #include <lk/init.h>
@@ -882,6 +884,34 @@ static void platform_init_smp(void) {
 
     x86_init_smp(apic_ids.get(), num_cpus);
 
+    // tell the scheduler which cpus share a core and which share a die, so that
+    // load balancing prefers moving threads between nearby cpus
+    for (uint32_t i = 0; i < num_cpus; ++i) {
+        x86_cpu_topology_t topo;
+        x86_cpu_topology_decode(apic_ids[i], &topo);
+        int cpu = x86_apic_id_to_cpu_num(apic_ids[i]);
+        if (cpu < 0) {
+            continue;
+        }
+
+        cpu_mask_t smt_siblings = 0;
+        cpu_mask_t cache_siblings = 0;
+        for (uint32_t j = 0; j < num_cpus; ++j) {
+            x86_cpu_topology_t other;
+            x86_cpu_topology_decode(apic_ids[j], &other);
+            int other_cpu = x86_apic_id_to_cpu_num(apic_ids[j]);
+            if (other_cpu < 0 || other.package_id != topo.package_id ||
+                other.node_id != topo.node_id) {
+                continue;
+            }
+            cache_siblings |= cpu_num_to_mask(other_cpu);
+            if (other.core_id == topo.core_id) {
+                smt_siblings |= cpu_num_to_mask(other_cpu);
+            }
+        }
+        mp_set_cpu_topology(cpu, smt_siblings, cache_siblings);
+    }
+
     // trim the boot cpu out of the apic id list before passing to the AP booting routine
     for (uint i = 0; i < num_cpus - 1; ++i) {
         if (apic_ids[i] == bsp_apic_id) {
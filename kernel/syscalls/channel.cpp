@@ -15,6 +15,7 @@
 #include <object/handle.h>
 #include <object/message_packet.h>
 #include <object/process_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
 #include <zircon/syscalls/policy.h>
 #include <zircon/types.h>
 
@@ -51,17 +52,22 @@ static void record_recv_msg_sz(uint32_t size) {
 // zx_status_t zx_channel_create
 zx_status_t sys_channel_create(uint32_t options,
                                user_out_handle* out0, user_out_handle* out1) {
-    if (options != 0u)
+    if (options & ~ZX_CHANNEL_RING)
         return ZX_ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
     zx_status_t res = up->QueryPolicy(ZX_POL_NEW_CHANNEL);
     if (res != ZX_OK)
         return res;
+    if (options & ZX_CHANNEL_RING) {
+        res = up->QueryPolicy(ZX_POL_NEW_VMO);
+        if (res != ZX_OK)
+            return res;
+    }
 
     fbl::RefPtr<Dispatcher> mpd0, mpd1;
     zx_rights_t rights;
-    zx_status_t result = ChannelDispatcher::Create(&mpd0, &mpd1, &rights);
+    zx_status_t result = ChannelDispatcher::Create(options, &mpd0, &mpd1, &rights);
     if (result != ZX_OK)
         return result;
 
@@ -399,3 +405,41 @@ zx_status_t sys_channel_call_finish(zx_time_t deadline,
     return channel_call_epilogue(up, fbl::move(reply), &args, actual_bytes, actual_handles);
 
 }
+
+// zx_status_t zx_channel_get_ring
+zx_status_t sys_channel_get_ring(zx_handle_t handle_value, uint32_t options,
+                                 user_out_handle* vmo_out, user_out_ptr<uint32_t> side_out) {
+    LTRACEF("handle %x\n", handle_value);
+
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ChannelDispatcher> channel;
+    zx_status_t status = up->GetDispatcherWithRights(handle_value,
+                                                     ZX_RIGHT_READ | ZX_RIGHT_WRITE, &channel);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObject> vmo;
+    uint32_t side;
+    status = channel->GetRing(&vmo, &side);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    status = VmObjectDispatcher::Create(fbl::move(vmo), &dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    status = side_out.copy_to_user(side);
+    if (status != ZX_OK)
+        return status;
+
+    // The ring belongs to the channel; whoever holds an endpoint can ask for
+    // it again, so the VMO handle itself need not be transferable.
+    return vmo_out->make(fbl::move(dispatcher),
+                         rights & ~(ZX_RIGHT_TRANSFER | ZX_RIGHT_EXECUTE));
+}
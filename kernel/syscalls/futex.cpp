@@ -9,6 +9,7 @@
 #include <trace.h>
 
 #include <object/process_dispatcher.h>
+#include <object/thread_dispatcher.h>
 #include <zircon/types.h>
 
 #include "priv.h"
@@ -31,6 +32,37 @@ zx_status_t sys_futex_wake(user_in_ptr<const zx_futex_t> value_ptr, uint32_t cou
         value_ptr, count);
 }
 
+// zx_status_t zx_futex_wait_owner
+zx_status_t sys_futex_wait_owner(user_in_ptr<const zx_futex_t> value_ptr, int32_t current_value,
+                                 zx_handle_t owner, zx_time_t deadline) {
+    LTRACEF("futex %p current %d owner %x\n", value_ptr.get(), current_value, owner);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ThreadDispatcher> owner_thread;
+    if (owner != ZX_HANDLE_INVALID) {
+        zx_status_t status = up->GetDispatcher(owner, &owner_thread);
+        if (status != ZX_OK)
+            return status;
+        // only threads sharing the futex's address space can own it
+        if (owner_thread->process() != up || owner_thread.get() == ThreadDispatcher::GetCurrent())
+            return ZX_ERR_INVALID_ARGS;
+    }
+
+    // |owner_thread| keeps the kernel thread alive until after the boost is
+    // applied, which happens before this thread blocks.
+    return up->futex_context()->FutexWait(
+        value_ptr, current_value, deadline,
+        owner_thread ? owner_thread->kernel_thread() : nullptr);
+}
+
+// zx_status_t zx_futex_wake_owner
+zx_status_t sys_futex_wake_owner(user_in_ptr<const zx_futex_t> value_ptr) {
+    LTRACEF("futex %p\n", value_ptr.get());
+
+    return ProcessDispatcher::GetCurrent()->futex_context()->FutexWakeOwner(value_ptr);
+}
+
 // zx_status_t zx_futex_requeue
 zx_status_t sys_futex_requeue(user_in_ptr<const zx_futex_t> wake_ptr, uint32_t wake_count, int32_t current_value,
                               user_in_ptr<const zx_futex_t> requeue_ptr, uint32_t requeue_count) {
@@ -13,6 +13,7 @@
 #include <kernel/thread_lock.h>
 #include <lib/heap.h>
 #include <platform.h>
+#include <vm/compressed_store.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
 #include <zircon/time.h>
@@ -30,6 +31,7 @@
 #include <object/vm_address_region_dispatcher.h>
 #include <object/vm_object_dispatcher.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/ref_ptr.h>
 
 #include "priv.h"
@@ -531,6 +533,12 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
         stats.free_bytes = state_count[VM_PAGE_STATE_FREE] * PAGE_SIZE;
         other_bytes -= stats.free_bytes;
 
+        // the zeroed count is kept separately from the page states, so clamp it in case
+        // the two disagree while pages are moving around
+        stats.free_zeroed_bytes = fbl::min(pmm_count_free_zeroed_pages() * PAGE_SIZE,
+                                           stats.free_bytes);
+        stats.free_dirty_bytes = stats.free_bytes - stats.free_zeroed_bytes;
+
         stats.wired_bytes = state_count[VM_PAGE_STATE_WIRED] * PAGE_SIZE;
         other_bytes -= stats.wired_bytes;
 
@@ -550,6 +558,41 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
         // All other VM_PAGE_STATE_* counts get lumped into other_bytes.
         stats.other_bytes = other_bytes;
 
+        stats.node_count = static_cast<uint32_t>(
+            fbl::min(pmm_node_count(), static_cast<size_t>(ZX_INFO_KMEM_MAX_NODES)));
+        for (uint32_t i = 0; i < stats.node_count; i++) {
+            pmm_node_info_t node;
+            if (pmm_get_node_info(i, &node) == ZX_OK) {
+                stats.nodes[i].proximity_domain = node.domain;
+                stats.nodes[i].total_bytes = node.total_bytes;
+                stats.nodes[i].free_bytes = node.free_bytes;
+            }
+        }
+
+        return single_record_result(
+            _buffer, buffer_size, _actual, _avail, &stats, sizeof(stats));
+    }
+    case ZX_INFO_KMEM_COMPRESSION: {
+        auto status = validate_resource(handle, ZX_RSRC_KIND_ROOT);
+        if (status != ZX_OK)
+            return status;
+
+        static_assert(VM_COMPRESSION_LATENCY_BUCKETS == ZX_INFO_KMEM_LATENCY_BUCKETS, "");
+        vm_compression_info_t info;
+        VmCompressedStore::Get()->GetInfo(&info);
+
+        zx_info_kmem_compression_t stats = {};
+        stats.compressed_pages = info.compressed_pages;
+        stats.compressed_bytes = info.compressed_bytes;
+        stats.store_bytes = info.store_bytes;
+        stats.compressions = info.compressions;
+        stats.decompressions = info.decompressions;
+        stats.rejections = info.rejections;
+        for (size_t i = 0; i < ZX_INFO_KMEM_LATENCY_BUCKETS; i++) {
+            stats.compression_latency[i] = info.compression_latency[i];
+            stats.decompression_latency[i] = info.decompression_latency[i];
+        }
+
         return single_record_result(
             _buffer, buffer_size, _actual, _avail, &stats, sizeof(stats));
     }
@@ -30,8 +30,7 @@
 
 #define LOCAL_TRACE 0
 
-// TODO(ZX-1349) Re-lower this to 8.
-constexpr uint32_t kMaxWaitHandleCount = 16u;
+constexpr uint32_t kMaxWaitHandleCount = 1024u;
 
 // ensure public headers agree
 static_assert(ZX_WAIT_MANY_MAX_ITEMS == kMaxWaitHandleCount, "");
@@ -106,11 +105,17 @@ zx_status_t sys_object_wait_many(user_inout_ptr<zx_wait_item_t> user_items, size
     if (count > kMaxWaitHandleCount)
         return ZX_ERR_OUT_OF_RANGE;
 
-    zx_wait_item_t items[kMaxWaitHandleCount];
+    // The items and their observers are too big for the stack, so they live
+    // in the calling thread, which reuses them from one call to the next.
+    WaitManyCache* cache = ThreadDispatcher::GetCurrent()->GetWaitManyCache();
+    if (!cache->Reserve(count))
+        return ZX_ERR_NO_MEMORY;
+    zx_wait_item_t* items = cache->items();
+    WaitStateObserver* wait_state_observers = cache->observers();
+
     if (user_items.copy_array_from_user(items, count) != ZX_OK)
         return ZX_ERR_INVALID_ARGS;
 
-    WaitStateObserver wait_state_observers[kMaxWaitHandleCount];
     Event event;
 
     // We may need to unwind (which can be done outside the lock).
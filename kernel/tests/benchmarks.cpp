@@ -9,6 +9,7 @@
 
 #include <arch/ops.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <inttypes.h>
 #include <kernel/mp.h>
 #include <kernel/mutex.h>
@@ -21,6 +22,9 @@
 #include <string.h>
 #include <sys/types.h>
 #include <trace.h>
+#include <vm/physmap.h>
+#include <vm/pmm.h>
+#include <zircon/time.h>
 
 const size_t BUFSIZE = (3 * 1024 * 1024); // must be smaller than max allowed heap allocation
 const size_t ITER = (1UL * 1024 * 1024 * 1024 / BUFSIZE); // enough iterations to have to copy/set 1GB of memory
@@ -270,6 +274,168 @@ __NO_INLINE static void bench_mutex() {
     printf("%" PRIu64 " cycles to acquire/release uncontended mutex %u times (%" PRIu64 " cycles per)\n", c, count, c / count);
 }
 
+static int pmm_alloc_free_thread(void* arg) {
+    const size_t count = *static_cast<const size_t*>(arg);
+
+    for (size_t i = 0; i < count; i++) {
+        vm_page_t* page;
+        zx_status_t status = pmm_alloc_page(0, &page);
+        if (status != ZX_OK) {
+            return status;
+        }
+        pmm_free_page(page);
+    }
+
+    return 0;
+}
+
+// run |entry| on one thread pinned to each of the first |n| active cpus, all started at
+// once. returns how long they took, or -1 if a thread couldn't be created or any of them
+// returned an error.
+static zx_duration_t run_pinned_threads(const char* name, thread_start_routine entry,
+                                        size_t* count, uint n) {
+    thread_t* threads[SMP_MAX_CPUS] = {};
+
+    cpu_mask_t remaining = mp_get_active_mask();
+    uint created = 0;
+    for (; created < n; created++) {
+        cpu_num_t cpu = lowest_cpu_set(remaining);
+        remaining &= ~cpu_num_to_mask(cpu);
+
+        threads[created] = thread_create(name, entry, count, DEFAULT_PRIORITY);
+        if (!threads[created]) {
+            printf("error: failed to create %s thread\n", name);
+            break;
+        }
+        thread_set_cpu_affinity(threads[created], cpu_num_to_mask(cpu));
+    }
+
+    zx_time_t t = current_time();
+    for (uint i = 0; i < created; i++) {
+        thread_resume(threads[i]);
+    }
+
+    bool failed = created < n;
+    for (uint i = 0; i < created; i++) {
+        int retcode;
+        thread_join(threads[i], &retcode, ZX_TIME_INFINITE);
+        failed |= (retcode != 0);
+    }
+    t = current_time() - t;
+
+    return failed ? -1 : t;
+}
+
+// alloc and free single pages on 1..N cpus at once, to see how the pmm scales
+__NO_INLINE static void bench_pmm_alloc_free() {
+    static size_t count = 1024 * 1024;
+
+    const uint num_cpus = __builtin_popcount(mp_get_active_mask());
+    for (uint n = 1; n <= num_cpus; n++) {
+        zx_duration_t t = run_pinned_threads("pmm bench", &pmm_alloc_free_thread, &count, n);
+        if (t < 0) {
+            printf("error: pmm alloc failed with %u cpus\n", n);
+            return;
+        }
+
+        uint64_t total = count * n;
+        printf("%u cpus: took %" PRIi64 " nsecs to alloc/free a page %" PRIu64
+               " times (%" PRIu64 " per cpu per msec, %" PRIu64 " total per msec)\n",
+               n, t, total, count * ZX_MSEC(1) / t, total * ZX_MSEC(1) / t);
+    }
+}
+
+static int malloc_free_thread(void* arg) {
+    const size_t count = *static_cast<const size_t*>(arg);
+
+    // cycle through a few sizes so several of the heap's cache classes are used
+    static const size_t sizes[] = {24, 64, 200, 1024};
+    for (size_t i = 0; i < count; i++) {
+        void* ptr = malloc(sizes[i % fbl::count_of(sizes)]);
+        if (!ptr) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        free(ptr);
+    }
+
+    return 0;
+}
+
+// malloc and free small blocks on 1..N cpus at once, to see how the heap scales
+__NO_INLINE static void bench_malloc_free() {
+    static size_t count = 1024 * 1024;
+
+    const uint num_cpus = __builtin_popcount(mp_get_active_mask());
+    for (uint n = 1; n <= num_cpus; n++) {
+        zx_duration_t t = run_pinned_threads("malloc bench", &malloc_free_thread, &count, n);
+        if (t < 0) {
+            printf("error: malloc failed with %u cpus\n", n);
+            return;
+        }
+
+        uint64_t total = count * n;
+        printf("%u cpus: took %" PRIi64 " nsecs to malloc/free %" PRIu64
+               " times (%" PRIu64 " per cpu per msec, %" PRIu64 " total per msec)\n",
+               n, t, total, count * ZX_MSEC(1) / t, total * ZX_MSEC(1) / t);
+    }
+}
+
+// touch pages from each pmm node in turn from one cpu, to see what remote
+// memory costs
+static int numa_page_touch_thread(void*) {
+    static const size_t kPages = 1024;
+    static const size_t kPasses = 256;
+
+    uint self = arch_curr_cpu_num();
+    for (size_t node = 0; node < pmm_node_count(); node++) {
+        pmm_node_info_t info;
+        if (pmm_get_node_info(node, &info) != ZX_OK) {
+            return ZX_ERR_INTERNAL;
+        }
+
+        list_node list = LIST_INITIAL_VALUE(list);
+        zx_status_t status = pmm_alloc_pages_on_node(node, kPages, 0, &list);
+        if (status != ZX_OK) {
+            printf("node %zu (domain %u): could not allocate %zu pages\n",
+                   node, info.domain, kPages);
+            continue;
+        }
+
+        zx_time_t t = current_time();
+        for (size_t i = 0; i < kPasses; i++) {
+            vm_page_t* page;
+            list_for_every_entry (&list, page, vm_page_t, queue_node) {
+                memset(paddr_to_physmap(page->paddr()), static_cast<int>(i), PAGE_SIZE);
+            }
+        }
+        t = current_time() - t;
+        pmm_free(&list);
+
+        uint64_t bytes = kPages * kPasses * PAGE_SIZE;
+        printf("cpu %u, node %zu (domain %u): took %" PRIi64 " nsecs to touch %" PRIu64
+               " bytes, %" PRIu64 " MB/sec\n",
+               self, node, info.domain, t, bytes, bytes * ZX_SEC(1) / t / MB);
+    }
+
+    return 0;
+}
+
+__NO_INLINE static void bench_numa_page_touch() {
+    if (pmm_node_count() < 2) {
+        return;
+    }
+
+    thread_t* t = thread_create("numa bench", &numa_page_touch_thread, nullptr,
+                                DEFAULT_PRIORITY);
+    if (!t) {
+        printf("error: failed to create numa bench thread\n");
+        return;
+    }
+    thread_set_cpu_affinity(t, cpu_num_to_mask(lowest_cpu_set(mp_get_active_mask())));
+    thread_resume(t);
+    thread_join(t, nullptr, ZX_TIME_INFINITE);
+}
+
 int benchmarks(int, const cmd_args*, uint32_t) {
     bench_set_overhead();
     bench_memcpy();
@@ -287,5 +453,10 @@ int benchmarks(int, const cmd_args*, uint32_t) {
     bench_spinlock();
     bench_mutex();
 
+    bench_pmm_alloc_free();
+    bench_malloc_free();
+
+    bench_numa_page_touch();
+
     return 0;
 }
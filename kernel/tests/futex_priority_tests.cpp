@@ -0,0 +1,204 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <kernel/mutex.h>
+#include <kernel/sched.h>
+#include <kernel/thread.h>
+#include <kernel/thread_lock.h>
+#include <kernel/wait.h>
+#include <lib/unittest/unittest.h>
+
+// Tests for the priority that threads waiting on priority inheriting futexes
+// lend to the futex owner.
+
+static int noop_thread(void*) {
+    return 0;
+}
+
+static thread_t* create_idle_thread(int priority) {
+    return thread_create("futex prio tester", noop_thread, nullptr, priority);
+}
+
+static void join_idle_thread(thread_t* t) {
+    thread_resume(t);
+    thread_join(t, nullptr, ZX_TIME_INFINITE);
+}
+
+static void lend(thread_t* t, thread_t* owner) {
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+    bool local_resched = false;
+    sched_futex_lend_priority(t, owner, &local_resched);
+    if (local_resched) {
+        sched_reschedule();
+    }
+}
+
+static void unlend(thread_t* t) {
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+    bool local_resched = false;
+    sched_futex_unlend_priority(t, &local_resched);
+    if (local_resched) {
+        sched_reschedule();
+    }
+}
+
+// The owner runs at the highest priority lent to it, and drops back as the
+// waiters leave, whatever order they leave in.
+static bool lend_and_unlend() {
+    BEGIN_TEST;
+
+    thread_t* owner = create_idle_thread(LOW_PRIORITY);
+    thread_t* low = create_idle_thread(DEFAULT_PRIORITY);
+    thread_t* high = create_idle_thread(HIGH_PRIORITY);
+    ASSERT_NONNULL(owner, "");
+    ASSERT_NONNULL(low, "");
+    ASSERT_NONNULL(high, "");
+
+    lend(low, owner);
+    EXPECT_EQ(DEFAULT_PRIORITY, owner->effec_priority, "");
+    lend(high, owner);
+    EXPECT_EQ(HIGH_PRIORITY, owner->effec_priority, "");
+
+    // the lower waiter leaving doesn't change anything
+    unlend(low);
+    EXPECT_EQ(HIGH_PRIORITY, owner->effec_priority, "");
+
+    lend(low, owner);
+    unlend(high);
+    EXPECT_EQ(DEFAULT_PRIORITY, owner->effec_priority, "");
+    unlend(low);
+    EXPECT_EQ(LOW_PRIORITY, owner->effec_priority, "");
+    EXPECT_EQ(-1, owner->inherited_priority, "");
+
+    // lending to another owner takes the priority back from the first
+    thread_t* other = create_idle_thread(LOW_PRIORITY);
+    ASSERT_NONNULL(other, "");
+    lend(high, owner);
+    lend(high, other);
+    EXPECT_EQ(LOW_PRIORITY, owner->effec_priority, "");
+    EXPECT_EQ(HIGH_PRIORITY, other->effec_priority, "");
+    unlend(high);
+    EXPECT_EQ(LOW_PRIORITY, other->effec_priority, "");
+
+    join_idle_thread(high);
+    join_idle_thread(low);
+    join_idle_thread(other);
+    join_idle_thread(owner);
+
+    END_TEST;
+}
+
+// A boost from a kernel mutex held by the owner is not dropped when the
+// waiter leaves, but when the mutex is released.
+static bool unlend_while_holding_mutex() {
+    BEGIN_TEST;
+
+    thread_t* current = get_current_thread();
+    thread_t* waiter = create_idle_thread(HIGHEST_PRIORITY);
+    ASSERT_NONNULL(waiter, "");
+
+    mutex_t m;
+    mutex_init(&m);
+    mutex_acquire(&m);
+
+    lend(waiter, current);
+    EXPECT_EQ(HIGHEST_PRIORITY, current->effec_priority, "");
+    unlend(waiter);
+    EXPECT_EQ(-1, current->futex_inherited_priority, "");
+    EXPECT_EQ(HIGHEST_PRIORITY, current->effec_priority, "");
+
+    mutex_release(&m);
+    EXPECT_LT(current->effec_priority, HIGHEST_PRIORITY, "");
+    EXPECT_EQ(-1, current->inherited_priority, "");
+    mutex_destroy(&m);
+
+    join_idle_thread(waiter);
+
+    END_TEST;
+}
+
+struct blocked_waiter_args {
+    thread_t* owner;
+    wait_queue_t wq;
+    zx_status_t status;
+};
+
+// Block the way FutexNode::BlockThread() does.
+static int blocked_waiter_thread(void* arg) {
+    auto args = static_cast<blocked_waiter_args*>(arg);
+    thread_t* current = get_current_thread();
+
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+    bool unused;
+    sched_futex_lend_priority(current, args->owner, &unused);
+    args->status = wait_queue_block(&args->wq, ZX_TIME_INFINITE);
+    sched_futex_unlend_priority(current, &unused);
+    return 0;
+}
+
+// A waiter that times out takes its priority back.
+static bool waiter_times_out() {
+    BEGIN_TEST;
+
+    thread_t* owner = create_idle_thread(LOW_PRIORITY);
+    ASSERT_NONNULL(owner, "");
+
+    blocked_waiter_args args = {owner, WAIT_QUEUE_INITIAL_VALUE(args.wq), ZX_OK};
+    thread_t* waiter = thread_create("futex prio waiter", blocked_waiter_thread, &args,
+                                     HIGH_PRIORITY);
+    ASSERT_NONNULL(waiter, "");
+    thread_resume(waiter);
+
+    for (;;) {
+        {
+            Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+            if (waiter->state == THREAD_BLOCKED) {
+                EXPECT_EQ(HIGH_PRIORITY, owner->effec_priority, "");
+                wait_queue_unblock_thread(waiter, ZX_ERR_TIMED_OUT);
+                break;
+            }
+        }
+        thread_sleep_relative(ZX_MSEC(1));
+    }
+
+    thread_join(waiter, nullptr, ZX_TIME_INFINITE);
+    EXPECT_EQ(ZX_ERR_TIMED_OUT, args.status, "");
+    EXPECT_EQ(LOW_PRIORITY, owner->effec_priority, "");
+    EXPECT_TRUE(list_is_empty(&owner->futex_waiters), "");
+    wait_queue_destroy(&args.wq);
+
+    join_idle_thread(owner);
+
+    END_TEST;
+}
+
+// The waiters of an exiting owner stop lending to it.
+static bool owner_exits() {
+    BEGIN_TEST;
+
+    thread_t* owner = create_idle_thread(LOW_PRIORITY);
+    thread_t* waiter = create_idle_thread(HIGH_PRIORITY);
+    ASSERT_NONNULL(owner, "");
+    ASSERT_NONNULL(waiter, "");
+
+    lend(waiter, owner);
+    EXPECT_EQ(HIGH_PRIORITY, owner->effec_priority, "");
+    thread_resume(owner);
+    thread_join(owner, nullptr, ZX_TIME_INFINITE);
+    EXPECT_NULL(waiter->futex_owner, "");
+
+    join_idle_thread(waiter);
+
+    END_TEST;
+}
+
+UNITTEST_START_TESTCASE(futex_priority_tests)
+UNITTEST("lend_and_unlend", lend_and_unlend)
+UNITTEST("unlend_while_holding_mutex", unlend_while_holding_mutex)
+UNITTEST("waiter_times_out", waiter_times_out)
+UNITTEST("owner_exits", owner_exits)
+UNITTEST_END_TESTCASE(futex_priority_tests, "futex_priority_tests",
+                      "Priority inheritance through futexes");
@@ -297,6 +297,137 @@ int timer_stress(int argc, const cmd_args* argv, uint32_t) {
     return 0;
 }
 
+struct timer_scale_args {
+    uint cpu;
+    size_t count;
+    fbl::atomic<size_t> fired;
+    fbl::atomic<zx_time_t> first_fire;
+    fbl::atomic<zx_time_t> last_fire;
+    zx_duration_t set_time;
+    zx_duration_t cancel_time;
+    zx_duration_t fire_time;
+    bool failed;
+};
+
+static void timer_scale_cb(struct timer* t, zx_time_t now, void* void_arg) {
+    timer_scale_args* args = reinterpret_cast<timer_scale_args*>(void_arg);
+    zx_time_t time = current_time();
+    zx_time_t zero = 0;
+    args->first_fire.compare_exchange_strong(&zero, time, fbl::memory_order_relaxed,
+                                             fbl::memory_order_relaxed);
+    args->last_fire.store(time, fbl::memory_order_relaxed);
+    args->fired.fetch_add(1);
+}
+
+// Arms |args->count| timers on the current cpu, spread out over a second so
+// that they are not coalesced, then measures the cost of cancelling half of
+// them and of firing the other half with the queue still full.
+static int timer_scale_worker(void* void_arg) {
+    timer_scale_args* args = reinterpret_cast<timer_scale_args*>(void_arg);
+    DEBUG_ASSERT(arch_curr_cpu_num() == args->cpu);
+
+    timer_t* timers = static_cast<timer_t*>(malloc(sizeof(timer_t) * args->count));
+    if (timers == nullptr) {
+        args->failed = true;
+        return 0;
+    }
+    for (size_t i = 0; i < args->count; ++i) {
+        timer_init(&timers[i]);
+    }
+
+    // Far enough out that none of them fire while this runs.
+    const zx_time_t base = current_time() + ZX_SEC(60);
+    zx_time_t start = current_time();
+    for (size_t i = 0; i < args->count; ++i) {
+        zx_time_t deadline = base + rand_duration(ZX_SEC(1));
+        timer_set(&timers[i], deadline, TIMER_SLACK_CENTER, ZX_USEC(1), timer_scale_cb, args);
+    }
+    args->set_time = zx_time_sub_time(current_time(), start);
+
+    start = current_time();
+    for (size_t i = 0; i < args->count; i += 2) {
+        timer_cancel(&timers[i]);
+    }
+    args->cancel_time = zx_time_sub_time(current_time(), start);
+
+    // Re-arm the cancelled half to expire all at once, ahead of the others.
+    const size_t to_fire = (args->count + 1) / 2;
+    const zx_time_t deadline = current_time() + ZX_MSEC(10);
+    for (size_t i = 0; i < args->count; i += 2) {
+        timer_set(&timers[i], deadline, TIMER_SLACK_CENTER, 0, timer_scale_cb, args);
+    }
+    while (args->fired.load() != to_fire) {
+        thread_sleep_relative(ZX_MSEC(10));
+    }
+    args->fire_time = zx_time_sub_time(args->last_fire.load(), args->first_fire.load());
+
+    for (size_t i = 1; i < args->count; i += 2) {
+        timer_cancel(&timers[i]);
+    }
+    free(timers);
+    return 0;
+}
+
+// timer_scale measures the cost of setting, cancelling and firing timers when
+// every cpu has a large number of them queued.
+int timer_scale(int argc, const cmd_args* argv, uint32_t) {
+    size_t count = 100000;
+    if (argc >= 2) {
+        count = argv[1].u;
+    }
+    if (count < 2) {
+        printf("usage: %s [timers per cpu (default 100000)]\n", argv[0].str);
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    timer_scale_args args[SMP_MAX_CPUS] = {};
+    thread_t* threads[SMP_MAX_CPUS] = {};
+    cpu_mask_t online = mp_get_online_mask();
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; ++cpu) {
+        if (!(online & cpu_num_to_mask(cpu))) {
+            continue;
+        }
+        args[cpu].cpu = cpu;
+        args[cpu].count = count;
+        threads[cpu] = thread_create("timer-scale-worker", &timer_scale_worker, &args[cpu],
+                                     DEFAULT_PRIORITY);
+        if (threads[cpu] == nullptr) {
+            printf("failed to create worker thread for cpu %u\n", cpu);
+            continue;
+        }
+        thread_set_cpu_affinity(threads[cpu], cpu_num_to_mask(cpu));
+    }
+
+    printf("arming %zu timers per cpu\n", count);
+    for (const auto& thread : threads) {
+        if (thread != nullptr) {
+            thread_resume(thread);
+        }
+    }
+    for (const auto& thread : threads) {
+        if (thread != nullptr) {
+            thread_join(thread, nullptr, ZX_TIME_INFINITE);
+        }
+    }
+
+    printf("cpu  set ns/timer  cancel ns/timer  fire ns/timer\n");
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; ++cpu) {
+        if (threads[cpu] == nullptr) {
+            continue;
+        }
+        if (args[cpu].failed) {
+            printf("%3u  failed to allocate timers\n", cpu);
+            continue;
+        }
+        const size_t half = (count + 1) / 2;
+        printf("%3u  %12" PRIi64 "  %15" PRIi64 "  %13" PRIi64 "\n", cpu,
+               args[cpu].set_time / static_cast<zx_duration_t>(count),
+               args[cpu].cancel_time / static_cast<zx_duration_t>(half),
+               args[cpu].fire_time / static_cast<zx_duration_t>(half));
+    }
+    return 0;
+}
+
 struct timer_args {
     volatile int result;
     volatile int timer_fired;
@@ -485,6 +616,45 @@ static bool trylock_or_cancel_get_lock() {
     END_TEST;
 }
 
+static void timer_fired_at_cb(struct timer*, zx_time_t now, void* void_arg) {
+    auto fired_at = static_cast<fbl::atomic<zx_time_t>*>(void_arg);
+    fired_at->store(now);
+}
+
+// Set timers whose deadlines fall within each other's slack and see that they
+// fire from the same tick, while one outside the slack window fires on its own.
+static bool coalesce_within_slack() {
+    BEGIN_TEST;
+    fbl::atomic<zx_time_t> fired_at[3] = {{0}, {0}, {0}};
+    timer_t t[3];
+    for (auto& timer : t) {
+        timer_init(&timer);
+    }
+
+    // Keep all three on this cpu's queue, since only timers on the same queue
+    // are coalesced.
+    const zx_duration_t slack = ZX_USEC(100);
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
+    const zx_time_t when = current_time() + ZX_MSEC(10);
+    timer_set(&t[0], when, TIMER_SLACK_CENTER, slack, timer_fired_at_cb, &fired_at[0]);
+    timer_set(&t[1], when + slack / 2, TIMER_SLACK_CENTER, slack, timer_fired_at_cb,
+              &fired_at[1]);
+    timer_set(&t[2], when + ZX_MSEC(10), TIMER_SLACK_CENTER, slack, timer_fired_at_cb,
+              &fired_at[2]);
+    arch_interrupt_restore(state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
+
+    EXPECT_EQ(t[0].scheduled_time, t[1].scheduled_time, "timer within slack not coalesced");
+    EXPECT_NE(t[0].scheduled_time, t[2].scheduled_time, "timer outside slack coalesced");
+
+    while (fired_at[0].load() == 0 || fired_at[1].load() == 0 || fired_at[2].load() == 0) {
+        thread_sleep_relative(ZX_MSEC(1));
+    }
+    EXPECT_EQ(fired_at[0].load(), fired_at[1].load(), "coalesced timers fired apart");
+    EXPECT_NE(fired_at[0].load(), fired_at[2].load(), "");
+    END_TEST;
+}
+
 UNITTEST_START_TESTCASE(timer_tests)
 UNITTEST("cancel_before_deadline", cancel_before_deadline)
 UNITTEST("cancel_after_fired", cancel_after_fired)
@@ -492,4 +662,5 @@ UNITTEST("cancel_from_callback", cancel_from_callback)
 UNITTEST("set_from_callback", set_from_callback)
 UNITTEST("trylock_or_cancel_canceled", trylock_or_cancel_canceled)
 UNITTEST("trylock_or_cancel_get_lock", trylock_or_cancel_get_lock)
+UNITTEST("coalesce_within_slack", coalesce_within_slack)
 UNITTEST_END_TESTCASE(timer_tests, "timer", "timer tests");
@@ -0,0 +1,195 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/compressed_store.h>
+
+#include <inttypes.h>
+#include <lz4/lz4.h>
+#include <platform.h>
+#include <pow2.h>
+#include <string.h>
+#include <trace.h>
+#include <vm/physmap.h>
+#include <vm/pmm.h>
+#include <zircon/time.h>
+
+#include "vm_priv.h"
+
+#include <fbl/algorithm.h>
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+namespace {
+
+VmCompressedStore store;
+
+// LZ4's working state is too large for a kernel stack. Only used with the
+// store's lock held.
+LZ4_stream_t lz4_state;
+
+size_t LatencyBucket(zx_duration_t duration) {
+    const uint64_t us = duration / ZX_USEC(1);
+    if (us == 0) {
+        return 0;
+    }
+    return fbl::min(static_cast<size_t>(log2_ulong_floor(us)) + 1,
+                    static_cast<size_t>(VM_COMPRESSION_LATENCY_BUCKETS - 1));
+}
+
+} // namespace
+
+VmCompressedStore* VmCompressedStore::Get() {
+    return &store;
+}
+
+VmCompressedStore::VmCompressedStore() {
+    for (auto& list : partial_) {
+        list_initialize(&list);
+    }
+}
+
+// the class with the most slots per page that still fits |length|
+size_t VmCompressedStore::SizeClass(size_t length) {
+    DEBUG_ASSERT(length <= kMaxCompressedSize);
+    size_t c = kNumClasses - 1;
+    while (ClassSlotSize(c) < length) {
+        c--;
+    }
+    return c;
+}
+
+void* VmCompressedStore::SlotAddress(const vm_page_t* p, size_t c, size_t slot) {
+    return static_cast<uint8_t*>(paddr_to_physmap(p->paddr())) + slot * ClassSlotSize(c);
+}
+
+zx_status_t VmCompressedStore::Compress(const void* src, VmCompressedPage* cpage) {
+    DEBUG_ASSERT(!cpage->page_);
+
+    Guard<fbl::Mutex> guard{&lock_};
+    const zx_time_t start = current_time();
+
+    const int length = LZ4_compress_fast_extState(&lz4_state, static_cast<const char*>(src),
+                                                  scratch_, PAGE_SIZE,
+                                                  static_cast<int>(kMaxCompressedSize), 1);
+    if (length <= 0) {
+        rejections_++;
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+
+    const size_t c = SizeClass(length);
+    vm_page_t* p = list_peek_head_type(&partial_[c], vm_page_t, queue_node);
+    if (!p) {
+        paddr_t pa;
+        zx_status_t status = pmm_alloc_page(PMM_ALLOC_FLAG_ANY, &p, &pa);
+        if (status != ZX_OK) {
+            return status;
+        }
+        p->state = VM_PAGE_STATE_COMPRESSED;
+        p->compressed.used_slots = 0;
+        list_add_head(&partial_[c], &p->queue_node);
+        store_pages_++;
+    }
+
+    const uint32_t slot = __builtin_ctz(~p->compressed.used_slots);
+    DEBUG_ASSERT(slot < ClassSlots(c));
+    p->compressed.used_slots |= 1u << slot;
+    if (p->compressed.used_slots == ClassFullMask(c)) {
+        list_delete(&p->queue_node);
+    }
+    memcpy(SlotAddress(p, c, slot), scratch_, length);
+
+    cpage->page_ = p;
+    cpage->length_ = static_cast<uint16_t>(length);
+    cpage->slot_ = static_cast<uint8_t>(slot);
+    cpage->size_class_ = static_cast<uint8_t>(c);
+
+    compressed_pages_++;
+    compressed_bytes_ += length;
+    compressions_++;
+    compression_latency_[LatencyBucket(current_time() - start)]++;
+
+    LTRACEF("offset %#" PRIx64 ": %d bytes in page %p slot %u\n", cpage->offset(), length, p,
+            slot);
+    return ZX_OK;
+}
+
+zx_status_t VmCompressedStore::Decompress(const VmCompressedPage& cpage, void* dst) {
+    DEBUG_ASSERT(cpage.page_);
+
+    const zx_time_t start = current_time();
+
+    const void* src = SlotAddress(cpage.page_, cpage.size_class_, cpage.slot_);
+    const int length = LZ4_decompress_safe(static_cast<const char*>(src), static_cast<char*>(dst),
+                                           cpage.length_, PAGE_SIZE);
+    if (length != PAGE_SIZE) {
+        TRACEF("offset %#" PRIx64 " failed to decompress: %d\n", cpage.offset(), length);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    decompression_latency_[LatencyBucket(current_time() - start)].fetch_add(
+        1, fbl::memory_order_relaxed);
+    return ZX_OK;
+}
+
+void VmCompressedStore::Free(VmCompressedPage* cpage) {
+    vm_page_t* p = cpage->page_;
+    DEBUG_ASSERT(p);
+    const size_t c = cpage->size_class_;
+    const uint32_t bit = 1u << cpage->slot_;
+
+    Guard<fbl::Mutex> guard{&lock_};
+    DEBUG_ASSERT(p->state == VM_PAGE_STATE_COMPRESSED);
+    DEBUG_ASSERT(p->compressed.used_slots & bit);
+
+    if (p->compressed.used_slots == ClassFullMask(c)) {
+        list_add_head(&partial_[c], &p->queue_node);
+    }
+    p->compressed.used_slots &= ~bit;
+    if (p->compressed.used_slots == 0) {
+        list_delete(&p->queue_node);
+        pmm_free_page(p);
+        store_pages_--;
+    }
+
+    compressed_pages_--;
+    compressed_bytes_ -= cpage->length_;
+    cpage->page_ = nullptr;
+}
+
+void VmCompressedStore::GetInfo(vm_compression_info_t* info) {
+    Guard<fbl::Mutex> guard{&lock_};
+
+    info->compressed_pages = compressed_pages_;
+    info->compressed_bytes = compressed_bytes_;
+    info->store_bytes = store_pages_ * PAGE_SIZE;
+    info->compressions = compressions_;
+    info->rejections = rejections_;
+    info->decompressions = 0;
+    for (size_t i = 0; i < VM_COMPRESSION_LATENCY_BUCKETS; i++) {
+        info->compression_latency[i] = compression_latency_[i];
+        info->decompression_latency[i] =
+            decompression_latency_[i].load(fbl::memory_order_relaxed);
+        info->decompressions += info->decompression_latency[i];
+    }
+}
+
+void VmCompressedStore::Dump() {
+    vm_compression_info_t info;
+    GetInfo(&info);
+
+    printf("compressed store: %" PRIu64 " pages in %" PRIu64 " bytes (%" PRIu64
+           " bytes of data)\n",
+           info.compressed_pages, info.store_bytes, info.compressed_bytes);
+    printf("  %" PRIu64 " compressions, %" PRIu64 " rejected, %" PRIu64 " decompressions\n",
+           info.compressions, info.rejections, info.decompressions);
+    printf("  latency (us)   compress decompress\n");
+    for (size_t i = 0; i < VM_COMPRESSION_LATENCY_BUCKETS; i++) {
+        const bool last = i == VM_COMPRESSION_LATENCY_BUCKETS - 1;
+        printf("  %s %-10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n", last ? ">=" : "< ",
+               uint64_t{1} << (last ? i - 1 : i), info.compression_latency[i],
+               info.decompression_latency[i]);
+    }
+}
@@ -29,6 +29,9 @@ const uint ARCH_MMU_FLAG_INVALID = (1u << 7); // Indicates that flags are not sp
 const uint ARCH_ASPACE_FLAG_KERNEL = (1u << 0);
 const uint ARCH_ASPACE_FLAG_GUEST = (1u << 1);
 
+// Called by HarvestAccessed() for each page found accessed.
+typedef void (*arch_accessed_fn_t)(void* context, vaddr_t vaddr, paddr_t paddr);
+
 // per arch base class api to encapsulate the mmu routines on an aspace
 class ArchVmAspaceInterface {
 public:
@@ -56,8 +59,30 @@ public:
     // Change the page protections on the given virtual address range
     virtual zx_status_t Protect(vaddr_t vaddr, size_t count, uint mmu_flags) = 0;
 
+    // Between these calls, TLB invalidations for Protect() calls made by the
+    // calling thread may be deferred and coalesced, for architectures where
+    // invalidating involves interrupting other CPUs.  Every invalidation has
+    // been issued by the time EndTlbBatch() returns.
+    virtual void BeginTlbBatch() {}
+    virtual void EndTlbBatch() {}
+
     virtual zx_status_t Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) = 0;
 
+    // Returns how many bytes of [vaddr, vaddr + count * PAGE_SIZE) are mapped
+    // by pages larger than PAGE_SIZE.
+    virtual size_t LargePageBytes(vaddr_t vaddr, size_t count) = 0;
+
+    // Clear the accessed flag of every page mapped in [vaddr, vaddr + count * PAGE_SIZE),
+    // calling |accessed_fn| for each page that had it set. The callback runs with the
+    // page tables locked, so the pages stay mapped for its duration. The TLB is not
+    // flushed, so a page that stays in some TLB may not be seen accessed again until
+    // its entry is evicted. Returns ZX_ERR_NOT_SUPPORTED if the page tables don't track
+    // accesses.
+    virtual zx_status_t HarvestAccessed(vaddr_t vaddr, size_t count,
+                                        arch_accessed_fn_t accessed_fn, void* context) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     virtual vaddr_t PickSpot(vaddr_t base, uint prev_region_mmu_flags,
                              vaddr_t end, uint next_region_mmu_flags,
                              vaddr_t align, size_t size, uint mmu_flags) = 0;
@@ -0,0 +1,127 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <assert.h>
+#include <fbl/atomic.h>
+#include <fbl/intrusive_wavl_tree.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
+#include <kernel/lockdep.h>
+#include <list.h>
+#include <stdint.h>
+#include <vm/page.h>
+#include <vm/vm.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+// Bucket 0 counts operations that took less than 1us, bucket i > 0 those
+// that took [2^(i-1), 2^i) us, and the last bucket everything slower.
+#define VM_COMPRESSION_LATENCY_BUCKETS 16
+
+typedef struct vm_compression_info {
+    uint64_t compressed_pages;
+    uint64_t compressed_bytes;
+    uint64_t store_bytes;
+    uint64_t compressions;
+    uint64_t decompressions;
+    uint64_t rejections;
+    uint64_t compression_latency[VM_COMPRESSION_LATENCY_BUCKETS];
+    uint64_t decompression_latency[VM_COMPRESSION_LATENCY_BUCKETS];
+} vm_compression_info_t;
+
+// A page of a vm object whose contents are held compressed in the store,
+// keyed by its offset in the object.
+class VmCompressedPage : public fbl::WAVLTreeContainable<fbl::unique_ptr<VmCompressedPage>> {
+public:
+    explicit VmCompressedPage(uint64_t offset)
+        : offset_(offset) {}
+    ~VmCompressedPage() { DEBUG_ASSERT(!page_); }
+
+    uint64_t GetKey() const { return offset_; }
+    uint64_t offset() const { return offset_; }
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(VmCompressedPage);
+
+private:
+    friend class VmCompressedStore;
+
+    const uint64_t offset_;
+
+    // where the compressed contents are in the store
+    vm_page_t* page_ = nullptr;
+    uint16_t length_ = 0;
+    uint8_t slot_ = 0;
+    uint8_t size_class_ = 0;
+};
+
+// Packs LZ4 compressed pages into pages of its own. Each store page is split
+// into equal slots, with the slot size picked from a set of classes so that
+// little of a slot is left over. A compressed page is only ever touched by
+// the owner of its VmCompressedPage, so decompression doesn't take the
+// store's lock.
+class VmCompressedStore {
+public:
+    static VmCompressedStore* Get();
+
+    // Compress the page at |src| into the store, recording where it went in
+    // |cpage|. Returns ZX_ERR_BUFFER_TOO_SMALL if the page doesn't compress
+    // well enough to be worth storing.
+    zx_status_t Compress(const void* src, VmCompressedPage* cpage);
+
+    // Decompress |cpage| into the page at |dst|. It stays in the store.
+    zx_status_t Decompress(const VmCompressedPage& cpage, void* dst);
+
+    // Release the store's copy of |cpage|.
+    void Free(VmCompressedPage* cpage);
+
+    void GetInfo(vm_compression_info_t* info);
+    void Dump();
+
+    VmCompressedStore();
+    DISALLOW_COPY_ASSIGN_AND_MOVE(VmCompressedStore);
+
+private:
+    static constexpr size_t kMinSlotsPerPage = 2;
+    static constexpr size_t kMaxSlotsPerPage = 32;
+    static constexpr size_t kNumClasses = kMaxSlotsPerPage - kMinSlotsPerPage + 1;
+
+    // class |c| splits a page into kMinSlotsPerPage + c slots
+    static constexpr size_t ClassSlots(size_t c) { return kMinSlotsPerPage + c; }
+    static constexpr size_t ClassSlotSize(size_t c) {
+        return (PAGE_SIZE / ClassSlots(c)) & ~static_cast<size_t>(15);
+    }
+    static constexpr uint32_t ClassFullMask(size_t c) {
+        return ClassSlots(c) == 32 ? UINT32_MAX : (1u << ClassSlots(c)) - 1;
+    }
+
+    // anything larger would not share its store page
+    static constexpr size_t kMaxCompressedSize = ClassSlotSize(0);
+
+    static size_t SizeClass(size_t length);
+    static void* SlotAddress(const vm_page_t* p, size_t c, size_t slot);
+
+    DECLARE_MUTEX(VmCompressedStore) lock_;
+
+    // compression output, copied into a slot once its size is known
+    char scratch_[kMaxCompressedSize] TA_GUARDED(lock_);
+
+    // store pages of each class with at least one free slot
+    list_node partial_[kNumClasses] TA_GUARDED(lock_);
+
+    uint64_t compressed_pages_ TA_GUARDED(lock_) = 0;
+    uint64_t compressed_bytes_ TA_GUARDED(lock_) = 0;
+    uint64_t store_pages_ TA_GUARDED(lock_) = 0;
+    uint64_t compressions_ TA_GUARDED(lock_) = 0;
+    uint64_t rejections_ TA_GUARDED(lock_) = 0;
+    uint64_t compression_latency_[VM_COMPRESSION_LATENCY_BUCKETS] TA_GUARDED(lock_) = {};
+
+    // decompressions don't take the lock; their count is the histogram's sum
+    // so that a snapshot of the two always agrees
+    fbl::atomic<uint64_t> decompression_latency_[VM_COMPRESSION_LATENCY_BUCKETS] = {};
+};
@@ -22,13 +22,21 @@ enum vm_page_state {
     VM_PAGE_STATE_MMU,   // allocated to serve arch-specific mmu purposes
     VM_PAGE_STATE_IOMMU, // allocated for platform-specific iommu structures
     VM_PAGE_STATE_IPC,
+    VM_PAGE_STATE_COMPRESSED, // holds compressed pages for the vm compressed store
 
     VM_PAGE_STATE_COUNT_
 };
 
-#define VM_PAGE_STATE_BITS 3
+#define VM_PAGE_STATE_BITS 4
 static_assert((1u << VM_PAGE_STATE_BITS) >= VM_PAGE_STATE_COUNT_, "");
 
+// index of the pmm node that owns the page
+#define VM_PAGE_NODE_BITS 3
+
+// page flags
+#define VM_PAGE_FLAG_PMM_CACHED (1u << 0) // free, but held in a pmm per-cpu cache
+#define VM_PAGE_FLAG_ZEROED (1u << 1)     // free, and known to contain only zeros
+
 // core per page structure allocated at pmm arena creation time
 typedef struct vm_page {
     struct list_node queue_node;
@@ -38,6 +46,7 @@ typedef struct vm_page {
     struct {
         uint32_t flags : 8;
         uint32_t state : VM_PAGE_STATE_BITS;
+        uint32_t node : VM_PAGE_NODE_BITS;
     };
     // offset: 0x1c
 
@@ -47,7 +56,18 @@ typedef struct vm_page {
 #define VM_PAGE_OBJECT_MAX_PIN_COUNT ((1ul << VM_PAGE_OBJECT_PIN_COUNT_BITS) - 1)
 
             uint8_t pin_count : VM_PAGE_OBJECT_PIN_COUNT_BITS;
+
+            // number of vm scanner passes since the page was last seen in use,
+            // saturating at VM_PAGE_OBJECT_MAX_AGE. kept in its own byte since the
+            // scanner updates it without the object's lock held.
+#define VM_PAGE_OBJECT_MAX_AGE UINT8_MAX
+            uint8_t age;
         } object; // attached to a vm object
+
+        struct {
+            // bitmap of the slots of the page holding a compressed page
+            uint32_t used_slots;
+        } compressed; // in the vm compressed store
     };
 
     // helper routines
@@ -55,6 +75,16 @@ typedef struct vm_page {
         return state == VM_PAGE_STATE_FREE;
     }
 
+    // free pages parked in a pmm per-cpu cache are in the ALLOC state so that
+    // walkers of the free lists leave them alone
+    bool is_pmm_cached() const {
+        return flags & VM_PAGE_FLAG_PMM_CACHED;
+    }
+
+    bool is_zeroed() const {
+        return flags & VM_PAGE_FLAG_ZEROED;
+    }
+
     void dump() const;
 
     // return the physical address
@@ -0,0 +1,98 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/intrusive_double_list.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/ref_counted.h>
+#include <fbl/ref_ptr.h>
+#include <kernel/event.h>
+#include <kernel/lockdep.h>
+#include <stdint.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+class PageSource;
+
+// A thread waiting for a page source to supply a page. Page lookups that have
+// to wait return ZX_ERR_SHOULD_WAIT after queuing a request with the source;
+// the caller then drops its locks, calls Wait() and looks the page up again.
+class PageRequest : public fbl::DoublyLinkedListable<PageRequest*> {
+public:
+    PageRequest();
+    ~PageRequest();
+
+    // Block until the page is supplied, returning ZX_OK, or the source fails
+    // the request. A suspended thread keeps waiting, but a killed one stops.
+    zx_status_t Wait();
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PageRequest);
+
+private:
+    friend class PageSource;
+
+    // set while the request is queued with |source_|
+    fbl::RefPtr<PageSource> source_;
+    // the page waited for
+    uint64_t offset_ = 0;
+    // the part not yet supplied of the range the source was asked for on
+    // behalf of this request, if it was
+    uint64_t range_start_ = 0;
+    uint64_t range_end_ = 0;
+    zx_status_t status_ = ZX_OK;
+    event_t event_;
+};
+
+// Supplies the contents of the pages of a VmObjectPaged that it doesn't have
+// yet, in place of zeros. A thread waits for a single page, though it may ask
+// for the pages after it too, and the source is only asked for a page once
+// however many threads wait for it.
+class PageSource : public fbl::RefCounted<PageSource> {
+public:
+    PageSource();
+    virtual ~PageSource();
+
+    // Queue |request| to be completed once the page at |offset| is supplied,
+    // asking for the pages in [offset, offset + len) unless the page is in a
+    // range the source has already been asked for and has yet to supply.
+    // Returns ZX_ERR_SHOULD_WAIT, or an error if the source can't supply the
+    // pages. Called with the lock of the object the pages belong to held.
+    zx_status_t AddRequest(uint64_t offset, uint64_t len, PageRequest* request);
+
+    // Complete the requests for pages in [offset, offset + len), once the
+    // pages have been added to the object.
+    void OnPagesSupplied(uint64_t offset, uint64_t len);
+
+    // Fail all outstanding requests, and any made from now on.
+    void Close();
+
+    // Called when the object the pages are for is destroyed. Closes the source.
+    void Detach();
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PageSource);
+
+protected:
+    // Ask for the pages in [offset, offset + len) to be supplied.
+    virtual zx_status_t SendRequest(uint64_t offset, uint64_t len) = 0;
+
+    // Tell whoever supplies the pages that nothing will ask for them again.
+    virtual void OnDetach() {}
+
+private:
+    friend class PageRequest;
+
+    void CancelRequest(PageRequest* request);
+    void CompleteRequestLocked(PageRequest* request, zx_status_t status) TA_REQ(lock_);
+    void RemoveRequestLocked(PageRequest* request) TA_REQ(lock_);
+
+    DECLARE_MUTEX(PageSource) lock_;
+    bool closed_ TA_GUARDED(lock_) = false;
+    // the requests waiting for pages; between them they also hold the ranges
+    // still outstanding with the source
+    fbl::DoublyLinkedList<PageRequest*> requests_ TA_GUARDED(lock_);
+};
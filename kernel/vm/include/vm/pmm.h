@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <kernel/cpu.h>
 #include <sys/types.h>
 #include <vm/page.h>
 #include <zircon/compiler.h>
@@ -32,6 +33,8 @@ zx_status_t pmm_add_arena(const pmm_arena_info_t* arena) __NONNULL((1));
 // flags for allocation routines below
 #define PMM_ALLOC_FLAG_ANY (0x0)    // no restrictions on which arena to allocate from
 #define PMM_ALLOC_FLAG_LO_MEM (0x1) // allocate only from arenas marked LO_MEM
+#define PMM_ALLOC_FLAG_ZEROED (0x2) // return zeroed pages, from the pre-zeroed pool if possible.
+                                    // honored by pmm_alloc_page and pmm_alloc_pages.
 
 // Allocate count pages of physical memory, adding to the tail of the passed list.
 // The list must be initialized.
@@ -57,9 +60,16 @@ void pmm_free(list_node* list) __NONNULL((1));
 // Free a single page.
 void pmm_free_page(vm_page_t* page) __NONNULL((1));
 
+// Return the free pages parked in the per-cpu page caches to the free lists.
+// They count as free either way.
+void pmm_drain_cpu_caches();
+
 // Return count of unallocated physical pages in system.
 uint64_t pmm_count_free_pages();
 
+// Return count of unallocated physical pages that have already been zeroed.
+uint64_t pmm_count_free_zeroed_pages();
+
 // Return amount of physical memory in system, in bytes.
 uint64_t pmm_count_total_bytes();
 
@@ -68,6 +78,41 @@ uint64_t pmm_count_total_bytes();
 // |state_count|. Does not zero out the entries first.
 void pmm_count_total_states(size_t state_count[VM_PAGE_STATE_COUNT_]) __NONNULL((1));
 
+// NUMA support.
+//
+// All memory starts out on node 0. Platforms that know the memory topology
+// describe it once the heap is up, before the secondary cpus start, and the
+// pmm then keeps one node per proximity domain. Allocations try the node of
+// the calling cpu first and fall back to the others by distance.
+#define PMM_MAX_NODES (1u << VM_PAGE_NODE_BITS)
+
+// Move the memory in [base, base + size) to the node for proximity |domain|,
+// creating the node if needed. Parts of the range the pmm doesn't manage are
+// ignored.
+zx_status_t pmm_numa_add_range(uint32_t domain, paddr_t base, size_t size);
+
+// Set the relative distance between two proximity domains, on the ACPI SLIT
+// scale where 10 means local. Unset distances are 10 within a domain and 20
+// between domains.
+void pmm_numa_set_distance(uint32_t from_domain, uint32_t to_domain, uint8_t distance);
+
+// Make |domain| the local node of |cpu|.
+void pmm_numa_set_cpu_domain(cpu_num_t cpu, uint32_t domain);
+
+typedef struct pmm_node_info {
+    uint32_t domain;
+    uint64_t total_bytes;
+    uint64_t free_bytes;
+} pmm_node_info_t;
+
+// Return the number of pmm nodes, and describe node |index| of them.
+size_t pmm_node_count();
+zx_status_t pmm_get_node_info(size_t index, pmm_node_info_t* info) __NONNULL((2));
+
+// Allocate |count| pages from node |index| only. For tests and benchmarks.
+zx_status_t pmm_alloc_pages_on_node(size_t index, size_t count, uint alloc_flags,
+                                    list_node* list) __NONNULL((4));
+
 // virtual to physical
 paddr_t vaddr_to_paddr(const void* va);
 
@@ -0,0 +1,30 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The page scanner periodically ages every page committed to a paged VMO and
+// harvests the accessed bits of the user page tables, resetting the age of
+// the pages found accessed. A page's age is the number of scans since it was
+// last seen used. After each scan, once enough memory is in use, it also looks
+// at a limited number of pages for inactive pages that are all zeros, which
+// read back the same from the zero page, and frees them.
+
+// Pages at least this old are considered inactive and may be reclaimed.
+#define VM_SCANNER_INACTIVE_AGE 3
+
+// Looks at up to |max_scan| committed VMO pages, starting where the previous
+// call stopped, and frees those that are inactive and all zeros. Returns the
+// number of pages freed.
+size_t vm_scanner_dedup_zero_pages(size_t max_scan);
+
+// Tries to return |target_pages| pages to the pmm. The pages of discardable
+// VMOs go first, followed by inactive pages that are all zeros, and then other
+// inactive pages, which are compressed. Returns the number of pages freed.
+size_t vm_scanner_reclaim(size_t target_pages);
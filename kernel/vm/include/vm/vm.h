@@ -19,6 +19,11 @@
 #define ROUNDUP_PAGE_SIZE(x) ROUNDUP((x), PAGE_SIZE)
 #define IS_PAGE_ALIGNED(x) IS_ALIGNED((x), PAGE_SIZE)
 
+// large pages the VM may opportunistically back and map memory with
+#define LARGE_PAGE_SIZE_SHIFT 21
+#define LARGE_PAGE_SIZE (1UL << LARGE_PAGE_SIZE_SHIFT)
+#define LARGE_PAGE_COUNT (LARGE_PAGE_SIZE / PAGE_SIZE)
+
 // kernel address space
 static_assert(KERNEL_ASPACE_BASE + (KERNEL_ASPACE_SIZE - 1) > KERNEL_ASPACE_BASE, "");
 
@@ -69,6 +74,9 @@ typedef struct vmm_aspace vmm_aspace_t;
 
 // internal kernel routines below, do not call directly
 
+// returns true if paged vm objects may be backed by, and mapped with, LARGE_PAGE_SIZE pages
+bool vm_large_pages_enabled(void);
+
 // internal routine by the scheduler to swap mmu contexts
 void vmm_context_switch(vmm_aspace_t* oldspace, vmm_aspace_t* newaspace);
 
@@ -44,6 +44,10 @@
 #define VMAR_FLAG_CAN_MAP_EXECUTE (1 << 6)
 // Require that VMO backing the mapping is non-resizable.
 #define VMAR_FLAG_REQUIRE_NON_RESIZABLE (1 << 7)
+// On a VmMapping, one more than the log2 of the fault-around window in pages,
+// or 0 for the default window.
+#define VMAR_FLAG_FAULT_AROUND_SHIFT 8
+#define VMAR_FLAG_FAULT_AROUND_MASK (0xf << VMAR_FLAG_FAULT_AROUND_SHIFT)
 
 #define VMAR_CAN_RWX_FLAGS (VMAR_FLAG_CAN_MAP_READ |  \
                             VMAR_FLAG_CAN_MAP_WRITE | \
@@ -117,7 +121,11 @@ public:
 
     // Page fault in an address within the region.  Recursively traverses
     // the regions to find the target mapping, if it exists.
-    virtual zx_status_t PageFault(vaddr_t va, uint pf_flags) = 0;
+    // If the page has to come from a page source, |page_request| is queued
+    // with it and ZX_ERR_SHOULD_WAIT returned; the caller should drop the
+    // aspace lock, wait on the request and fault again. Faults that can't
+    // wait pass a null |page_request| and fail instead.
+    virtual zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) = 0;
 
     // WAVL tree key function
     vaddr_t GetKey() const { return base(); }
@@ -243,7 +251,7 @@ public:
     bool has_parent() const;
 
     void Dump(uint depth, bool verbose) const override;
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override;
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override;
 
 protected:
     // constructor for use in creating a VmAddressRegionDummy
@@ -384,7 +392,7 @@ public:
         return;
     }
 
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override {
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override {
         // We should never be trying to page fault on this...
         ASSERT(false);
         return ZX_ERR_BAD_STATE;
@@ -448,7 +456,7 @@ public:
     bool is_mapping() const override { return true; }
 
     void Dump(uint depth, bool verbose) const override;
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override;
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override;
 
 protected:
     ~VmMapping() override;
@@ -493,6 +501,24 @@ private:
     // in Clang around capability aliasing, we need to relax the analysis.
     void ActivateLocked();
 
+    // Number of pages in the aligned window around a faulting address that
+    // PageFault() may map in, as selected by the VMAR_FLAG_FAULT_AROUND bits.
+    size_t fault_around_pages() const;
+
+    // Called from PageFault() once |va| is mapped to opportunistically map the
+    // rest of its fault-around window. Only pages the object already has, or
+    // the zero page, are mapped, and never with write permission.
+    // Should be annotated TA_REQ(object_->lock()), see ActivateLocked().
+    void FaultAroundLocked(vaddr_t va, uint pf_flags);
+
+    // If the LARGE_PAGE_SIZE block containing |va| lies within this mapping and
+    // the object backs it with a single large page, replace whatever is mapped
+    // in the block with one large page mapping. If |commit| is set, an empty
+    // block is first committed with a large page. Returns true if the block is
+    // mapped with a large page on return.
+    // Should be annotated TA_REQ(object_->lock()), see ActivateLocked().
+    bool MapLargePageLocked(vaddr_t va, bool commit);
+
     // pointer and region of the object we are mapping
     fbl::RefPtr<VmObject> object_;
     uint64_t object_offset_ = 0;
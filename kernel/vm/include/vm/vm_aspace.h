@@ -120,6 +120,9 @@ public:
 
     size_t AllocatedPages() const;
 
+    // Number of page faults handled in this address space so far.
+    uint64_t page_faults() const;
+
     // Convenience method for traversing the tree of VMARs to find the deepest
     // VMAR in the tree that includes *va*.
     fbl::RefPtr<VmAddressRegionOrMapping> FindRegion(vaddr_t va);
@@ -198,6 +201,8 @@ private:
 
     mutable DECLARE_MUTEX(VmAspace) lock_;
 
+    uint64_t page_faults_ TA_GUARDED(lock_) = 0;
+
     // root of virtual address space
     // Access to this reference is guarded by lock_.
     fbl::RefPtr<VmAddressRegion> root_vmar_;
@@ -221,6 +226,10 @@ private:
 
 void DumpAllAspaces(bool verbose);
 
+// Harvest and clear the accessed bits of every user address space; see
+// ArchVmAspace::HarvestAccessed.
+void HarvestAllUserAccessed(arch_accessed_fn_t accessed_fn, void* context);
+
 // hack to convert from vmm_aspace_t to VmAspace
 static VmAspace* vmm_aspace_to_obj(vmm_aspace_t* aspace) {
     return reinterpret_cast<VmAspace*>(aspace);
@@ -12,7 +12,7 @@
 #include <fbl/intrusive_double_list.h>
 #include <fbl/macros.h>
 #include <fbl/name.h>
-#include <fbl/ref_counted.h>
+#include <fbl/ref_counted_upgradeable.h>
 #include <fbl/ref_ptr.h>
 #include <kernel/lockdep.h>
 #include <kernel/mutex.h>
@@ -20,6 +20,7 @@
 #include <list.h>
 #include <stdint.h>
 #include <vm/page.h>
+#include <vm/page_source.h>
 #include <vm/vm.h>
 #include <vm/vm_page_list.h>
 #include <zircon/thread_annotations.h>
@@ -39,7 +40,7 @@ public:
 //
 // Can be created without mapping and used as a container of data, or mappable
 // into an address space via VmAddressRegion::CreateVmMapping
-class VmObject : public fbl::RefCounted<VmObject>,
+class VmObject : public fbl::RefCountedUpgradeable<VmObject>,
                  public fbl::DoublyLinkedListable<VmObject*> {
 public:
     // public API
@@ -73,6 +74,12 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // commit the range like CommitRange() and pin it like Pin(), without letting memory
+    // reclaim take any of the committed pages back before they are pinned
+    virtual zx_status_t CommitRangePinned(uint64_t offset, uint64_t len) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     // free a range of the vmo back to the default state
     virtual zx_status_t DecommitRange(uint64_t offset, uint64_t len) {
         return ZX_ERR_NOT_SUPPORTED;
@@ -91,6 +98,56 @@ public:
         panic("Unpin should only be called on a pinned range");
     }
 
+    // Mark the object discardable (ZX_VMO_OP_UNLOCK), or not discardable again
+    // (ZX_VMO_OP_LOCK). The range must cover the whole object. While it is
+    // discardable, memory reclaim may decommit all of its pages. LockRange()
+    // sets |discarded| if that happened since the object was unlocked.
+    virtual zx_status_t LockRange(uint64_t offset, uint64_t len, bool* discarded) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    virtual zx_status_t UnlockRange(uint64_t offset, uint64_t len) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // Memory reclaim hooks, driven by the vm scanner. See vm/scanner.h.
+    //
+    // Age every page of the object by one scan.
+    virtual void AgePages() {}
+    // If the object is discardable, decommit all of its pages. Returns the
+    // number of pages freed.
+    virtual size_t DiscardPages() { return 0; }
+    // Free up to |max_pages| pages that are at least |min_age| scans old and
+    // contain only zeros, so that they read back the same once they are gone.
+    // If |max_scan| is set, only that many committed pages are looked at,
+    // starting where the previous such call left off, and it is reduced by the
+    // number looked at. Returns the number of pages freed.
+    virtual size_t ReclaimZeroPages(size_t max_pages, uint8_t min_age, size_t* max_scan) {
+        return 0;
+    }
+    // Returns the number of pages ReclaimZeroPages() has freed over the life
+    // of the object.
+    virtual uint64_t ReclaimedZeroPages() const { return 0; }
+    // Move up to |max_pages| pages that are at least |min_age| scans old into
+    // the compressed store, to be decompressed when they are next looked up.
+    // Returns the number of pages freed.
+    virtual size_t CompressPages(size_t max_pages, uint8_t min_age) { return 0; }
+
+    // Page transfer, for page sources. See vm/page_source.h.
+    //
+    // Move the pages in [offset, offset + len) out of the object into |pages|,
+    // committing any that are missing first. The range reads back as zeros.
+    virtual zx_status_t TakePages(uint64_t offset, uint64_t len, list_node* pages) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    // Put |pages| in the object at [offset, offset + len) and complete the
+    // requests waiting for them. Offsets that already have a page keep it and
+    // the supplied page is freed.
+    virtual zx_status_t SupplyPages(uint64_t offset, uint64_t len, list_node* pages) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    // The source that supplies the object's pages, if any.
+    virtual fbl::RefPtr<PageSource> page_source() const { return nullptr; }
+
     // read/write operators against kernel pointers only
     virtual zx_status_t Read(void* ptr, uint64_t offset, size_t len) {
         return ZX_ERR_NOT_SUPPORTED;
@@ -171,11 +228,37 @@ public:
 
     // get a pointer to the page structure and/or physical address at the specified offset.
     // valid flags are VMM_PF_FLAG_*
+    // if a new page is needed it is taken from |free_list| if non-null, whose pages must
+    // already be zeroed.
+    // returns ZX_ERR_SHOULD_WAIT if the page has to come from a page source first,
+    // see RequestPageLocked().
     virtual zx_status_t GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
                                       vm_page_t** page, paddr_t* pa) TA_REQ(lock_) {
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // after GetPageLocked() returned ZX_ERR_SHOULD_WAIT for |offset|, and without dropping
+    // the lock since, queue |request| with the page source the page is coming from. returns
+    // ZX_ERR_SHOULD_WAIT, after which the caller should drop its locks, wait on |request|
+    // and look the page up again, or an error.
+    virtual zx_status_t RequestPageLocked(uint64_t offset, PageRequest* request) TA_REQ(lock_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // try to commit the empty LARGE_PAGE_SIZE aligned block at |offset| with a single
+    // physically contiguous run of zeroed pages, so that it can be mapped with a large page.
+    // returns ZX_ERR_NOT_SUPPORTED if the object can't back the block that way.
+    virtual zx_status_t CommitLargePageLocked(uint64_t offset) TA_REQ(lock_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // if the LARGE_PAGE_SIZE aligned block at |offset| is backed by a single physically
+    // contiguous, LARGE_PAGE_SIZE aligned run of pages owned by this object, return its
+    // physical address in |pa|. the pages are not faulted in if they are not present.
+    virtual zx_status_t GetLargePageLocked(uint64_t offset, paddr_t* pa) TA_REQ(lock_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     Lock<fbl::Mutex>* lock() TA_RET_CAP(lock_) { return &lock_; }
     Lock<fbl::Mutex>& lock_ref() TA_RET_CAP(lock_) { return lock_; }
 
@@ -210,6 +293,86 @@ public:
         return ZX_OK;
     }
 
+    // Calls the provided |func(const fbl::RefPtr<VmObject>&)| on every live VMO
+    // in the system, from oldest to newest. Unlike ForEach(), the global VMO
+    // list isn't locked while |func| runs, so it may take VMO locks, and VMOs
+    // created or destroyed during the walk may or may not be visited.
+    template <typename T>
+    static void ForEachRef(T func) {
+        static constexpr size_t kBatchSize = 16;
+
+        // the last VMO visited; holding a reference keeps it, and so our
+        // place, in the global list
+        fbl::RefPtr<VmObject> cursor;
+        for (;;) {
+            fbl::RefPtr<VmObject> batch[kBatchSize];
+            size_t count = 0;
+            {
+                Guard<fbl::Mutex> guard{AllVmosLock::Get()};
+                auto iter = cursor ? ++all_vmos_.make_iterator(*cursor) : all_vmos_.begin();
+                for (; iter.IsValid() && count < kBatchSize; ++iter) {
+                    // skip objects whose destructor is already running
+                    auto ref = fbl::MakeRefPtrUpgradeFromRaw(&*iter, AllVmosLock::Get());
+                    if (ref) {
+                        batch[count++] = fbl::move(ref);
+                    }
+                }
+            }
+            if (count == 0) {
+                return;
+            }
+
+            // references are dropped outside the lock, as that may run a destructor
+            for (size_t i = 0; i < count; i++) {
+                func(batch[i]);
+            }
+            cursor = fbl::move(batch[count - 1]);
+        }
+    }
+
+    // Like ForEachRef(), but for a walk spread over several calls: starts at
+    // the VMO the previous call stopped at, and stops as soon as |func|
+    // returns false for a VMO, which the next call then starts at. Returns
+    // true once the newest VMO has been visited, after which the next call
+    // starts again from the oldest. The place is kept without a reference, so
+    // it doesn't keep a VMO alive between calls. There is only one such walk,
+    // the vm scanner's, so calls must not overlap.
+    template <typename T>
+    static bool ForEachRefResumable(T func) {
+        static constexpr size_t kBatchSize = 16;
+
+        fbl::RefPtr<VmObject> cursor;
+        for (;;) {
+            fbl::RefPtr<VmObject> batch[kBatchSize];
+            size_t count = 0;
+            {
+                Guard<fbl::Mutex> guard{AllVmosLock::Get()};
+                auto iter = cursor ? ++all_vmos_.make_iterator(*cursor)
+                                   : resume_vmo_ ? all_vmos_.make_iterator(*resume_vmo_)
+                                                 : all_vmos_.begin();
+                for (; iter.IsValid() && count < kBatchSize; ++iter) {
+                    auto ref = fbl::MakeRefPtrUpgradeFromRaw(&*iter, AllVmosLock::Get());
+                    if (ref) {
+                        batch[count++] = fbl::move(ref);
+                    }
+                }
+                if (count == 0) {
+                    resume_vmo_ = nullptr;
+                    return true;
+                }
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                if (!func(batch[i])) {
+                    Guard<fbl::Mutex> guard{AllVmosLock::Get()};
+                    resume_vmo_ = batch[i].get();
+                    return false;
+                }
+            }
+            cursor = fbl::move(batch[count - 1]);
+        }
+    }
+
 protected:
     // private constructor (use Create())
     explicit VmObject(fbl::RefPtr<VmObject> parent);
@@ -279,4 +442,7 @@ private:
     using GlobalList = fbl::DoublyLinkedList<VmObject*, GlobalListTraits>;
     DECLARE_SINGLETON_MUTEX(AllVmosLock);
     static GlobalList all_vmos_ TA_GUARDED(AllVmosLock::Get());
+    // where the next ForEachRefResumable() starts, or null for the oldest VMO;
+    // moved on to the next VMO if this one is destroyed first
+    static VmObject* resume_vmo_ TA_GUARDED(AllVmosLock::Get());
 };
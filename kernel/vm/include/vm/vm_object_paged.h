@@ -10,6 +10,7 @@
 #include <fbl/array.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
+#include <fbl/intrusive_wavl_tree.h>
 #include <fbl/macros.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
@@ -17,6 +18,7 @@
 #include <lib/user_copy/user_ptr.h>
 #include <list.h>
 #include <stdint.h>
+#include <vm/compressed_store.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
 #include <vm/vm_aspace.h>
@@ -44,6 +46,12 @@ public:
 
     static zx_status_t CreateFromROData(const void* data, size_t size, fbl::RefPtr<VmObject>* vmo);
 
+    // Create a VMO whose pages come from |src| rather than being zero filled.
+    // Looking up a page the VMO doesn't have yet blocks until |src| supplies
+    // it with SupplyPages().
+    static zx_status_t CreateExternal(fbl::RefPtr<PageSource> src, uint64_t size,
+                                      fbl::RefPtr<VmObject>* vmo);
+
     zx_status_t Resize(uint64_t size) override;
     zx_status_t ResizeLocked(uint64_t size) override TA_REQ(lock_);
     uint32_t create_options() const override { return options_; }
@@ -58,10 +66,23 @@ public:
     size_t AllocatedPagesInRange(uint64_t offset, uint64_t len) const override;
 
     zx_status_t CommitRange(uint64_t offset, uint64_t len) override;
+    zx_status_t CommitRangePinned(uint64_t offset, uint64_t len) override;
     zx_status_t DecommitRange(uint64_t offset, uint64_t len) override;
 
     zx_status_t Pin(uint64_t offset, uint64_t len) override;
     void Unpin(uint64_t offset, uint64_t len) override;
+    zx_status_t LockRange(uint64_t offset, uint64_t len, bool* discarded) override;
+    zx_status_t UnlockRange(uint64_t offset, uint64_t len) override;
+
+    void AgePages() override;
+    size_t DiscardPages() override;
+    size_t ReclaimZeroPages(size_t max_pages, uint8_t min_age, size_t* max_scan) override;
+    uint64_t ReclaimedZeroPages() const override;
+    size_t CompressPages(size_t max_pages, uint8_t min_age) override;
+
+    zx_status_t TakePages(uint64_t offset, uint64_t len, list_node* pages) override;
+    zx_status_t SupplyPages(uint64_t offset, uint64_t len, list_node* pages) override;
+    fbl::RefPtr<PageSource> page_source() const override { return page_source_; }
 
     zx_status_t Read(void* ptr, uint64_t offset, size_t len) override;
     zx_status_t Write(const void* ptr, uint64_t offset, size_t len) override;
@@ -83,6 +104,13 @@ public:
         // Calls a Locked method of the parent, which confuses analysis.
         TA_NO_THREAD_SAFETY_ANALYSIS;
 
+    zx_status_t RequestPageLocked(uint64_t offset, PageRequest* request) override
+        // Calls a Locked method of the parent, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    zx_status_t CommitLargePageLocked(uint64_t offset) override TA_REQ(lock_);
+    zx_status_t GetLargePageLocked(uint64_t offset, paddr_t* pa) override TA_REQ(lock_);
+
     zx_status_t CloneCOW(bool resizable, uint64_t offset, uint64_t size, bool copy_name,
                          fbl::RefPtr<VmObject>* clone_vmo) override
         // Calls a Locked method of the child, which confuses analysis.
@@ -101,7 +129,8 @@ public:
 private:
     // private constructor (use Create())
     VmObjectPaged(
-        uint32_t options, uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject> parent);
+        uint32_t options, uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject> parent,
+        fbl::RefPtr<PageSource> page_source);
 
     // private destructor, only called from refptr
     ~VmObjectPaged() override;
@@ -130,6 +159,26 @@ private:
     // internal check if any pages in a range are pinned
     bool AnyPagesPinnedLocked(uint64_t offset, size_t len) TA_REQ(lock_);
 
+    // true if any mapping of the object is outside of a user address space
+    bool IsMappedOutsideUserLocked() const TA_REQ(lock_);
+
+    // if the page at |offset| is compressed, decompress it into a page taken from
+    // |free_list| or the pmm and add it to the page list. ZX_ERR_NOT_FOUND otherwise.
+    zx_status_t DecompressPageLocked(uint64_t offset, list_node* free_list, vm_page_t** page_out)
+        TA_REQ(lock_);
+
+    // drop the compressed pages in [start, end)
+    void FreeCompressedPagesLocked(uint64_t start, uint64_t end) TA_REQ(lock_);
+
+    // true if the object has a page or a compressed page at |offset|
+    bool HasPageLocked(uint64_t offset) TA_REQ(lock_);
+
+    // commit the range, or queue |page_request| and return ZX_ERR_SHOULD_WAIT if a
+    // page has to come from a page source first
+    zx_status_t CommitRangeInternal(uint64_t offset, uint64_t len, bool pin);
+    zx_status_t CommitRangeLocked(uint64_t offset, uint64_t len, PageRequest* page_request)
+        TA_REQ(lock_);
+
     // internal read/write routine that takes a templated copy function to help share some code
     template <typename T>
     zx_status_t ReadWriteInternal(uint64_t offset, size_t len, bool write, T copyfunc);
@@ -144,6 +193,21 @@ private:
     uint32_t pmm_alloc_flags_ TA_GUARDED(lock_) = PMM_ALLOC_FLAG_ANY;
     uint32_t cache_policy_ TA_GUARDED(lock_) = ARCH_MMU_FLAG_CACHED;
 
+    // set between UnlockRange() and LockRange(), while reclaim may discard the pages
+    bool discardable_ TA_GUARDED(lock_) = false;
+    // set if the pages were discarded since the object was last unlocked
+    bool discarded_ TA_GUARDED(lock_) = false;
+    // zero pages freed by ReclaimZeroPages()
+    uint64_t reclaimed_zero_pages_ TA_GUARDED(lock_) = 0;
+    // where the next ReclaimZeroPages() with a scan limit starts looking
+    uint64_t zero_scan_offset_ TA_GUARDED(lock_) = 0;
+
+    // supplies the pages that aren't in page_list_ instead of zeros, if set
+    const fbl::RefPtr<PageSource> page_source_;
+
     // a tree of pages
     VmPageList page_list_ TA_GUARDED(lock_);
+
+    // pages moved out of page_list_ into the compressed store
+    fbl::WAVLTree<uint64_t, fbl::unique_ptr<VmCompressedPage>> compressed_pages_ TA_GUARDED(lock_);
 };
@@ -190,6 +190,9 @@ public:
 
     zx_status_t AddPage(vm_page*, uint64_t offset);
     vm_page* GetPage(uint64_t offset);
+    // remove the page at |offset| from the list without freeing it, returning it,
+    // or nullptr if there isn't one
+    vm_page* RemovePage(uint64_t offset);
     zx_status_t FreePage(uint64_t offset);
     size_t FreeAllPages();
     bool IsEmpty();
@@ -34,6 +34,8 @@ const char* page_state_to_string(unsigned int state) {
         return "mmu";
     case VM_PAGE_STATE_IPC:
         return "ipc";
+    case VM_PAGE_STATE_COMPRESSED:
+        return "compressed";
     default:
         return "unknown";
     }
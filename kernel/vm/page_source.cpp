@@ -0,0 +1,154 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/page_source.h>
+
+#include <assert.h>
+#include <fbl/algorithm.h>
+#include <inttypes.h>
+#include <kernel/thread.h>
+#include <trace.h>
+#include <vm/vm.h>
+
+#include "vm_priv.h"
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+PageRequest::PageRequest() {
+    event_init(&event_, false, EVENT_FLAG_AUTOUNSIGNAL);
+}
+
+PageRequest::~PageRequest() {
+    DEBUG_ASSERT(!source_);
+    event_destroy(&event_);
+}
+
+zx_status_t PageRequest::Wait() {
+    DEBUG_ASSERT(source_);
+
+    zx_status_t status = event_wait_with_mask(&event_, THREAD_SIGNAL_SUSPEND);
+    fbl::RefPtr<PageSource> source = fbl::move(source_);
+    if (status != ZX_OK) {
+        // killed, stop waiting for the page
+        source->CancelRequest(this);
+        return status;
+    }
+    return status_;
+}
+
+PageSource::PageSource() = default;
+
+PageSource::~PageSource() {
+    DEBUG_ASSERT(requests_.is_empty());
+}
+
+zx_status_t PageSource::AddRequest(uint64_t offset, uint64_t len, PageRequest* request) {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset) && IS_PAGE_ALIGNED(len) && len > 0);
+    DEBUG_ASSERT(!request->InContainer());
+
+    Guard<fbl::Mutex> guard{&lock_};
+    if (closed_) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    bool pending = false;
+    for (const auto& r : requests_) {
+        if (offset >= r.range_start_ && offset < r.range_end_) {
+            pending = true;
+            break;
+        }
+    }
+    if (!pending) {
+        LTRACEF("source %p requesting [%#" PRIx64 ", %#" PRIx64 ")\n", this, offset,
+                offset + len);
+        zx_status_t status = SendRequest(offset, len);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+
+    request->source_ = fbl::WrapRefPtr(this);
+    request->offset_ = offset;
+    request->range_start_ = pending ? 0 : offset;
+    request->range_end_ = pending ? 0 : offset + len;
+    request->status_ = ZX_OK;
+    requests_.push_back(request);
+    return ZX_ERR_SHOULD_WAIT;
+}
+
+void PageSource::OnPagesSupplied(uint64_t offset, uint64_t len) {
+    const uint64_t end = offset + len;
+
+    Guard<fbl::Mutex> guard{&lock_};
+
+    // Take the supplied pages out of the outstanding ranges. A range they
+    // split keeps only its start: asking again for a page that was asked for
+    // is harmless, but not asking for one that wasn't leaves its waiters
+    // waiting forever.
+    for (auto& r : requests_) {
+        if (r.range_start_ >= end || r.range_end_ <= offset) {
+            continue;
+        }
+        if (offset <= r.range_start_) {
+            r.range_start_ = fbl::min(end, r.range_end_);
+        } else {
+            r.range_end_ = offset;
+        }
+    }
+
+    for (auto iter = requests_.begin(); iter != requests_.end();) {
+        PageRequest* request = &*iter++;
+        if (request->offset_ >= offset && request->offset_ - offset < len) {
+            CompleteRequestLocked(request, ZX_OK);
+        }
+    }
+}
+
+void PageSource::Close() {
+    Guard<fbl::Mutex> guard{&lock_};
+    closed_ = true;
+    while (!requests_.is_empty()) {
+        CompleteRequestLocked(&requests_.front(), ZX_ERR_BAD_STATE);
+    }
+}
+
+void PageSource::Detach() {
+    Close();
+    OnDetach();
+}
+
+void PageSource::CancelRequest(PageRequest* request) {
+    Guard<fbl::Mutex> guard{&lock_};
+    if (request->InContainer()) {
+        RemoveRequestLocked(request);
+    }
+}
+
+void PageSource::CompleteRequestLocked(PageRequest* request, zx_status_t status) {
+    RemoveRequestLocked(request);
+    request->status_ = status;
+    // the waiter may return as soon as it is signaled, taking the request with it
+    event_signal(&request->event_, false);
+}
+
+void PageSource::RemoveRequestLocked(PageRequest* request) {
+    requests_.erase(*request);
+
+    // what is left of the range it asked for is still outstanding, so pass it
+    // on to somebody waiting for a page in it
+    if (request->range_start_ < request->range_end_) {
+        for (auto& r : requests_) {
+            if (r.range_start_ == r.range_end_ && r.offset_ >= request->range_start_ &&
+                r.offset_ < request->range_end_) {
+                r.range_start_ = request->range_start_;
+                r.range_end_ = request->range_end_;
+                break;
+            }
+        }
+    }
+    request->range_start_ = 0;
+    request->range_end_ = 0;
+}
@@ -10,9 +10,11 @@
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
 #include <kernel/mp.h>
 #include <kernel/timer.h>
 #include <lib/console.h>
+#include <lib/counters.h>
 #include <lk/init.h>
 #include <new>
 #include <platform.h>
@@ -28,6 +30,9 @@
 #include "pmm_node.h"
 #include "vm_priv.h"
 
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
@@ -37,42 +42,273 @@
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
-// The (currently) one and only pmm node
-static PmmNode pmm_node;
+KCOUNTER(pmm_alloc_local, "kernel.pmm.alloc.local");
+KCOUNTER(pmm_alloc_remote, "kernel.pmm.alloc.remote");
+
+// Node 0 gets all of memory at boot. Platforms with NUMA information later
+// move parts of it to further nodes, one per proximity domain, before the
+// secondary cpus are up; the node table doesn't change after that.
+static PmmNode boot_node(0);
+static PmmNode* nodes[PMM_MAX_NODES] = {&boot_node};
+static uint32_t node_domains[PMM_MAX_NODES];
+static size_t node_count = 1;
+
+// node_distance[i][j] is the SLIT style distance from node i to node j, and
+// node_order[i] lists every node by increasing distance from node i.
+static uint8_t node_distance[PMM_MAX_NODES][PMM_MAX_NODES];
+static uint8_t node_order[PMM_MAX_NODES][PMM_MAX_NODES];
+
+// the local node of each cpu
+static fbl::atomic<uint8_t> cpu_nodes[SMP_MAX_CPUS];
+
+static constexpr uint8_t kLocalDistance = 10;
+static constexpr uint8_t kRemoteDistance = 20;
+
+void pmm_numa_sort_nodes(const uint8_t distance[PMM_MAX_NODES][PMM_MAX_NODES], size_t count,
+                         size_t from, uint8_t order[PMM_MAX_NODES]) {
+    // insertion sort by distance from |from|, with |from| itself first
+    order[0] = static_cast<uint8_t>(from);
+    size_t sorted = 1;
+    for (size_t j = 0; j < count; j++) {
+        if (j == from) {
+            continue;
+        }
+        size_t k = sorted++;
+        while (k > 1 && distance[from][order[k - 1]] > distance[from][j]) {
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = static_cast<uint8_t>(j);
+    }
+}
+
+static void pmm_numa_update_order() {
+    for (size_t i = 0; i < node_count; i++) {
+        pmm_numa_sort_nodes(node_distance, node_count, i, node_order[i]);
+    }
+}
+
+// Find the node for |domain|, creating it if |create| is set. Node 0 takes the
+// first domain it is asked about. Returns PMM_MAX_NODES on failure.
+static size_t pmm_numa_domain_to_node(uint32_t domain, bool create) {
+    static bool boot_node_claimed = false;
+
+    for (size_t i = 0; i < node_count; i++) {
+        if ((i > 0 || boot_node_claimed) && node_domains[i] == domain) {
+            return i;
+        }
+    }
+    if (!create) {
+        return PMM_MAX_NODES;
+    }
+
+    if (!boot_node_claimed) {
+        boot_node_claimed = true;
+        node_domains[0] = domain;
+        node_distance[0][0] = kLocalDistance;
+        return 0;
+    }
+
+    if (node_count == PMM_MAX_NODES) {
+        printf("PMM: too many NUMA domains, leaving domain %u on node 0\n", domain);
+        return PMM_MAX_NODES;
+    }
+
+    fbl::AllocChecker ac;
+    PmmNode* node = new (&ac) PmmNode(static_cast<uint32_t>(node_count));
+    if (!ac.check()) {
+        return PMM_MAX_NODES;
+    }
+
+    size_t index = node_count;
+    nodes[index] = node;
+    node_domains[index] = domain;
+    for (size_t i = 0; i <= index; i++) {
+        node_distance[index][i] = (i == index) ? kLocalDistance : kRemoteDistance;
+        node_distance[i][index] = (i == index) ? kLocalDistance : kRemoteDistance;
+    }
+    node_count++;
+    pmm_numa_update_order();
+    return index;
+}
+
+zx_status_t pmm_numa_add_range(uint32_t domain, paddr_t base, size_t size) {
+    // the node table is read without locks once other cpus are running
+    DEBUG_ASSERT((mp_get_online_mask() & ~cpu_num_to_mask(0)) == 0);
+
+    size_t index = pmm_numa_domain_to_node(domain, true);
+    if (index == PMM_MAX_NODES) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    if (index == 0) {
+        // everything starts out on node 0 already
+        return ZX_OK;
+    }
+
+    paddr_t start = ROUNDUP(base, PAGE_SIZE);
+    paddr_t end = ROUNDDOWN(base + size, PAGE_SIZE);
+    if (start >= end) {
+        return ZX_OK;
+    }
+
+    size_t moved = boot_node.TransferRange(start, end - start, nodes[index]);
+    LTRACEF("domain %u: moved %#zx bytes to node %zu\n", domain, moved, index);
+    return ZX_OK;
+}
+
+void pmm_numa_set_distance(uint32_t from_domain, uint32_t to_domain, uint8_t distance) {
+    size_t from = pmm_numa_domain_to_node(from_domain, false);
+    size_t to = pmm_numa_domain_to_node(to_domain, false);
+    if (from == PMM_MAX_NODES || to == PMM_MAX_NODES) {
+        return;
+    }
+
+    node_distance[from][to] = distance;
+    pmm_numa_update_order();
+}
+
+void pmm_numa_set_cpu_domain(cpu_num_t cpu, uint32_t domain) {
+    size_t index = pmm_numa_domain_to_node(domain, false);
+    if (cpu >= SMP_MAX_CPUS || index == PMM_MAX_NODES) {
+        return;
+    }
+
+    cpu_nodes[cpu].store(static_cast<uint8_t>(index), fbl::memory_order_relaxed);
+}
+
+size_t pmm_node_count() {
+    return node_count;
+}
+
+zx_status_t pmm_get_node_info(size_t index, pmm_node_info_t* info) {
+    if (index >= node_count) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    info->domain = node_domains[index];
+    info->total_bytes = nodes[index]->CountTotalBytes();
+    info->free_bytes = nodes[index]->CountFreePages() * PAGE_SIZE;
+    return ZX_OK;
+}
+
+// Run |alloc| against each node in turn, nearest to the current cpu first,
+// until one of them has the memory.
+template <typename Alloc>
+static zx_status_t pmm_alloc_nearest(Alloc alloc) {
+    if (node_count == 1) {
+        return alloc(&boot_node);
+    }
+
+    uint8_t local = cpu_nodes[arch_curr_cpu_num()].load(fbl::memory_order_relaxed);
+    zx_status_t status = ZX_ERR_NO_MEMORY;
+    for (size_t i = 0; i < node_count; i++) {
+        status = alloc(nodes[node_order[local][i]]);
+        if (status == ZX_OK) {
+            kcounter_add(i == 0 ? pmm_alloc_local : pmm_alloc_remote, 1);
+            return status;
+        }
+        if (status != ZX_ERR_NO_MEMORY && status != ZX_ERR_NOT_FOUND) {
+            break;
+        }
+    }
+    return status;
+}
 
 #if PMM_ENABLE_FREE_FILL
 static void pmm_enforce_fill(uint level) {
-    pmm_node.EnforceFill();
+    for (size_t i = 0; i < node_count; i++) {
+        nodes[i]->EnforceFill();
+    }
 }
 LK_INIT_HOOK(pmm_fill, &pmm_enforce_fill, LK_INIT_LEVEL_VM);
 #endif
 
+static void pmm_start_zero_thread(uint level) {
+    uint64_t target_mb = cmdline_get_uint64("kernel.pmm.zero-pool-mb", 64);
+    bool nontemporal = cmdline_get_bool("kernel.pmm.zero-nontemporal", true);
+    // the pool is split evenly between the nodes
+    for (size_t i = 0; i < node_count; i++) {
+        nodes[i]->StartZeroThread(target_mb * MB / PAGE_SIZE / node_count, nontemporal);
+    }
+}
+LK_INIT_HOOK(pmm_zero, &pmm_start_zero_thread, LK_INIT_LEVEL_THREADING);
+
 vm_page_t* paddr_to_vm_page(paddr_t addr) {
-    return pmm_node.PaddrToPage(addr);
+    for (size_t i = 0; i < node_count; i++) {
+        vm_page_t* page = nodes[i]->PaddrToPage(addr);
+        if (page) {
+            return page;
+        }
+    }
+    return nullptr;
 }
 
 zx_status_t pmm_add_arena(const pmm_arena_info_t* info) {
-    return pmm_node.AddArena(info);
+    return boot_node.AddArena(info);
 }
 
 zx_status_t pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
-    return pmm_node.AllocPage(alloc_flags, nullptr, pa);
+    return pmm_alloc_nearest([&](PmmNode* node) {
+        return node->AllocPage(alloc_flags, nullptr, pa);
+    });
 }
 
 zx_status_t pmm_alloc_page(uint alloc_flags, vm_page_t** page) {
-    return pmm_node.AllocPage(alloc_flags, page, nullptr);
+    return pmm_alloc_nearest([&](PmmNode* node) {
+        return node->AllocPage(alloc_flags, page, nullptr);
+    });
 }
 
 zx_status_t pmm_alloc_page(uint alloc_flags, vm_page_t** page, paddr_t* pa) {
-    return pmm_node.AllocPage(alloc_flags, page, pa);
+    return pmm_alloc_nearest([&](PmmNode* node) {
+        return node->AllocPage(alloc_flags, page, pa);
+    });
 }
 
 zx_status_t pmm_alloc_pages(size_t count, uint alloc_flags, list_node* list) {
-    return pmm_node.AllocPages(count, alloc_flags, list);
+    zx_status_t status = pmm_alloc_nearest([&](PmmNode* node) {
+        return node->AllocPages(count, alloc_flags, list);
+    });
+    if (status != ZX_ERR_NO_MEMORY || node_count == 1) {
+        return status;
+    }
+
+    // no one node has enough, so take what each has, nearest first
+    list_node allocated = LIST_INITIAL_VALUE(allocated);
+    uint8_t local = cpu_nodes[arch_curr_cpu_num()].load(fbl::memory_order_relaxed);
+    size_t remaining = count;
+    for (size_t i = 0; i < node_count && remaining > 0; i++) {
+        PmmNode* node = nodes[node_order[local][i]];
+        size_t n = fbl::min(remaining, static_cast<size_t>(node->CountFreePages()));
+        if (n > 0 && node->AllocPages(n, alloc_flags, &allocated) == ZX_OK) {
+            remaining -= n;
+        }
+    }
+    if (remaining > 0) {
+        pmm_free(&allocated);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    list_splice_after(&allocated, list->prev);
+    return ZX_OK;
+}
+
+zx_status_t pmm_alloc_pages_on_node(size_t index, size_t count, uint alloc_flags,
+                                    list_node* list) {
+    if (index >= node_count) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    return nodes[index]->AllocPages(count, alloc_flags, list);
 }
 
 zx_status_t pmm_alloc_range(paddr_t address, size_t count, list_node* list) {
-    return pmm_node.AllocRange(address, count, list);
+    // the whole range has to be on one node
+    for (size_t i = 0; i < node_count; i++) {
+        if (nodes[i]->PaddrToPage(address)) {
+            return nodes[i]->AllocRange(address, count, list);
+        }
+    }
+    return ZX_ERR_NOT_FOUND;
 }
 
 zx_status_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_log2, paddr_t* pa,
@@ -80,7 +316,7 @@ zx_status_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignme
     // if we're called with a single page, just fall through to the regular allocation routine
     if (unlikely(count == 1 && alignment_log2 <= PAGE_SIZE_SHIFT)) {
         vm_page_t* page;
-        zx_status_t status = pmm_node.AllocPage(alloc_flags, &page, pa);
+        zx_status_t status = pmm_alloc_page(alloc_flags, &page, pa);
         if (status != ZX_OK) {
             return status;
         }
@@ -88,33 +324,79 @@ zx_status_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignme
         return ZX_OK;
     }
 
-    return pmm_node.AllocContiguous(count, alloc_flags, alignment_log2, pa, list);
+    return pmm_alloc_nearest([&](PmmNode* node) {
+        return node->AllocContiguous(count, alloc_flags, alignment_log2, pa, list);
+    });
 }
 
 void pmm_free(list_node* list) {
-    pmm_node.FreeList(list);
+    if (node_count == 1) {
+        boot_node.FreeList(list);
+        return;
+    }
+
+    // pages go back to the node they came from
+    list_node per_node[PMM_MAX_NODES];
+    for (size_t i = 0; i < node_count; i++) {
+        list_initialize(&per_node[i]);
+    }
+    vm_page* page;
+    while ((page = list_remove_head_type(list, vm_page, queue_node)) != nullptr) {
+        list_add_tail(&per_node[page->node], &page->queue_node);
+    }
+    for (size_t i = 0; i < node_count; i++) {
+        if (!list_is_empty(&per_node[i])) {
+            nodes[i]->FreeList(&per_node[i]);
+        }
+    }
 }
 
 void pmm_free_page(vm_page* page) {
-    pmm_node.FreePage(page);
+    nodes[page->node]->FreePage(page);
+}
+
+void pmm_drain_cpu_caches() {
+    for (size_t i = 0; i < node_count; i++) {
+        nodes[i]->DrainCpuCaches();
+    }
 }
 
 uint64_t pmm_count_free_pages() {
-    return pmm_node.CountFreePages();
+    uint64_t count = 0;
+    for (size_t i = 0; i < node_count; i++) {
+        count += nodes[i]->CountFreePages();
+    }
+    return count;
+}
+
+uint64_t pmm_count_free_zeroed_pages() {
+    uint64_t count = 0;
+    for (size_t i = 0; i < node_count; i++) {
+        count += nodes[i]->CountFreeZeroedPages();
+    }
+    return count;
 }
 
 uint64_t pmm_count_total_bytes() {
-    return pmm_node.CountTotalBytes();
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < node_count; i++) {
+        bytes += nodes[i]->CountTotalBytes();
+    }
+    return bytes;
 }
 
 void pmm_count_total_states(size_t state_count[VM_PAGE_STATE_COUNT_]) {
-    pmm_node.CountTotalStates(state_count);
+    for (size_t i = 0; i < node_count; i++) {
+        nodes[i]->CountTotalStates(state_count);
+    }
 }
 
 static void pmm_dump_timer(struct timer* t, zx_time_t now, void*) {
     zx_time_t deadline = zx_time_add_duration(now, ZX_SEC(1));
     timer_set_oneshot(t, deadline, &pmm_dump_timer, nullptr);
-    pmm_node.DumpFree();
+    for (size_t i = 0; i < node_count; i++) {
+        nodes[i]->DumpFree();
+    }
 }
 
 static int cmd_pmm(int argc, const cmd_args* argv, uint32_t flags) {
@@ -132,7 +414,12 @@ static int cmd_pmm(int argc, const cmd_args* argv, uint32_t flags) {
     }
 
     if (!strcmp(argv[1].str, "dump")) {
-        pmm_node.Dump(is_panic);
+        for (size_t i = 0; i < node_count; i++) {
+            if (node_count > 1) {
+                printf("domain %u:\n", node_domains[i]);
+            }
+            nodes[i]->Dump(is_panic);
+        }
     } else if (is_panic) {
         // No other operations will work during a panic.
         printf("Only the \"arenas\" command is available during a panic.\n");
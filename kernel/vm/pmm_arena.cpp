@@ -61,15 +61,34 @@ zx_status_t PmmArena::Init(const pmm_arena_info_t* info, PmmNode* node) {
 
     DEBUG_ASSERT(array_start_index < page_count && array_end_index <= page_count);
 
+    InitPages(node, array_start_index, array_end_index);
+
+    return ZX_OK;
+}
+
+void PmmArena::InitWithPageArray(const pmm_arena_info_t* info, vm_page_t* page_array,
+                                 PmmNode* node) {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(info->base));
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(info->size));
+
+    info_ = *info;
+    page_array_ = page_array;
+    memset(page_array_, 0, size() / PAGE_SIZE * sizeof(vm_page));
+
+    InitPages(node, 0, 0);
+}
+
+void PmmArena::InitPages(PmmNode* node, size_t wired_start_index, size_t wired_end_index) {
     // add all pages that aren't part of the page array to the free list
     // pages part of the free array go to the WIRED state
     list_node list;
     list_initialize(&list);
-    for (size_t i = 0; i < page_count; i++) {
+    for (size_t i = 0; i < size() / PAGE_SIZE; i++) {
         auto& p = page_array_[i];
 
         p.paddr_priv = base() + i * PAGE_SIZE;
-        if (i >= array_start_index && i < array_end_index) {
+        p.node = node->id() & ((1u << VM_PAGE_NODE_BITS) - 1);
+        if (i >= wired_start_index && i < wired_end_index) {
             p.state = VM_PAGE_STATE_WIRED;
         } else {
             p.state = VM_PAGE_STATE_FREE;
@@ -78,8 +97,20 @@ zx_status_t PmmArena::Init(const pmm_arena_info_t* info, PmmNode* node) {
     }
 
     node->AddFreePages(&list);
+}
 
-    return ZX_OK;
+void PmmArena::Split(paddr_t at, PmmArena* upper) {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(at));
+    DEBUG_ASSERT(at > base() && at < base() + size());
+    DEBUG_ASSERT(!upper->page_array_);
+
+    // the page array stays where it is; each half just indexes its own part of it
+    upper->info_ = info_;
+    upper->info_.base = at;
+    upper->info_.size = base() + size() - at;
+    upper->page_array_ = page_array_ + (at - base()) / PAGE_SIZE;
+
+    info_.size = at - base();
 }
 
 vm_page_t* PmmArena::FindSpecific(paddr_t pa) {
@@ -137,7 +168,9 @@ retry:
 
 void PmmArena::CountStates(size_t state_count[VM_PAGE_STATE_COUNT_]) const {
     for (size_t i = 0; i < size() / PAGE_SIZE; i++) {
-        state_count[page_array_[i].state]++;
+        const vm_page_t& p = page_array_[i];
+        // pages held in the pmm per-cpu caches are free as far as anyone else is concerned
+        state_count[p.is_pmm_cached() ? VM_PAGE_STATE_FREE : p.state]++;
     }
 }
 
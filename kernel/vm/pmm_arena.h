@@ -24,6 +24,14 @@ public:
     // initialize the arena and allocate memory for internal data structures
     zx_status_t Init(const pmm_arena_info_t* info, PmmNode* node);
 
+    // initialize the arena with its vm_page structures in |page_array|, which the caller
+    // owns, rather than in memory taken from the arena. lets tests build arenas after boot.
+    void InitWithPageArray(const pmm_arena_info_t* info, vm_page_t* page_array, PmmNode* node);
+
+    // hand the pages from |at| to the end of the arena to |upper|, which must be
+    // uninitialized, and shrink this arena to end at |at|
+    void Split(paddr_t at, PmmArena* upper);
+
     // accessors
     const pmm_arena_info_t& info() const { return info_; }
     const char* name() const { return info_.name; }
@@ -57,6 +65,10 @@ public:
     void Dump(bool dump_pages, bool dump_free_ranges) const;
 
 private:
+    // set up the page array and give the free pages to |node|, leaving the pages in
+    // [wired_start_index, wired_end_index) wired
+    void InitPages(PmmNode* node, size_t wired_start_index, size_t wired_end_index);
+
     pmm_arena_info_t info_ = {};
     vm_page_t* page_array_ = nullptr;
 };
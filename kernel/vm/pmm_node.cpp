@@ -5,8 +5,12 @@
 // https://opensource.org/licenses/MIT
 #include "pmm_node.h"
 
+#include <arch/ops.h>
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
 #include <inttypes.h>
 #include <kernel/mp.h>
+#include <kernel/spinlock.h>
 #include <new>
 #include <trace.h>
 #include <vm/bootalloc.h>
@@ -26,12 +30,40 @@ void set_state_alloc(vm_page* page) {
     page->state = VM_PAGE_STATE_ALLOC;
 }
 
+void zero_page(vm_page* page, bool nontemporal) {
+    void* ptr = paddr_to_physmap(page->paddr());
+    DEBUG_ASSERT(ptr);
+
+    if (nontemporal) {
+        arch_zero_page_nontemporal(ptr);
+    } else {
+        arch_zero_page(ptr);
+    }
+}
+
+// an allocated page is about to be handed out. zero it if the caller asked for a zeroed
+// page and the pool couldn't provide one, and drop the marker either way.
+void prepare_page_for_caller(vm_page* page, bool zeroed) {
+    if (zeroed && !page->is_zeroed()) {
+        zero_page(page, false);
+    }
+    page->flags &= ~VM_PAGE_FLAG_ZEROED;
+}
+
 } // namespace
 
-PmmNode::PmmNode() {
+PmmNode::PmmNode(uint32_t id)
+    : id_(id) {
+    DEBUG_ASSERT(id < PMM_MAX_NODES);
 }
 
 PmmNode::~PmmNode() {
+    // Only nodes made after boot are ever destroyed, and their arenas all come from the
+    // heap: either from AddArena() with a page array or from splits in TransferRange().
+    Guard<fbl::Mutex> guard{&lock_};
+    while (!arena_list_.is_empty()) {
+        delete arena_list_.pop_front();
+    }
 }
 
 // We disable thread safety analysis here, since this function is only called
@@ -60,23 +92,135 @@ zx_status_t PmmNode::AddArena(const pmm_arena_info_t* info) TA_NO_THREAD_SAFETY_
         return status;
     }
 
+    InsertArenaLocked(arena);
+    arena_cumulative_size_ += info->size;
+
+    return ZX_OK;
+}
+
+void PmmNode::InsertArenaLocked(PmmArena* arena) {
     // walk the arena list and add arena based on priority order
     for (auto& a : arena_list_) {
         if (a.priority() > arena->priority()) {
             arena_list_.insert(a, arena);
-            goto done_add;
+            return;
         }
     }
 
     // walked off the end, add it to the end of the list
     arena_list_.push_back(arena);
+}
+
+zx_status_t PmmNode::AddArena(const pmm_arena_info_t* info, vm_page_t* page_array) {
+    LTRACEF("arena %p name '%s' base %#" PRIxPTR " size %#zx\n", info, info->name, info->base, info->size);
 
-done_add:
+    fbl::AllocChecker ac;
+    PmmArena* arena = new (&ac) PmmArena();
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    Guard<fbl::Mutex> guard{&lock_};
+    arena->InitWithPageArray(info, page_array, this);
+    InsertArenaLocked(arena);
     arena_cumulative_size_ += info->size;
 
     return ZX_OK;
 }
 
+size_t PmmNode::TransferRange(paddr_t base, size_t size, PmmNode* target) {
+    LTRACEF("node %u -> %u base %#" PRIxPTR " size %#zx\n", id_, target->id_, base, size);
+
+    DEBUG_ASSERT(target != this);
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(base));
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(size));
+
+    const paddr_t end = base + size;
+
+    // pages parked in the cpu caches have to be on the free lists to be moved
+    DrainCpuCaches();
+
+    fbl::DoublyLinkedList<PmmArena*> moved;
+    list_node free_pages = LIST_INITIAL_VALUE(free_pages);
+    size_t moved_bytes = 0;
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+
+        // the zero thread would race with the free lists changing under it
+        DEBUG_ASSERT(!zero_thread_);
+
+        for (auto it = arena_list_.begin(); it != arena_list_.end();) {
+            PmmArena* a = &*it;
+            ++it;
+
+            const paddr_t overlap_base = fbl::max(a->base(), base);
+            const paddr_t overlap_end = fbl::min(a->base() + a->size(), end);
+            if (overlap_base >= overlap_end) {
+                continue;
+            }
+
+            // split off whatever lies on either side of the range and keep it here
+            fbl::AllocChecker ac;
+            if (overlap_base > a->base()) {
+                PmmArena* upper = new (&ac) PmmArena();
+                if (!ac.check()) {
+                    break;
+                }
+                a->Split(overlap_base, upper);
+                InsertArenaLocked(upper);
+                a = upper;
+            }
+            if (overlap_end < a->base() + a->size()) {
+                PmmArena* upper = new (&ac) PmmArena();
+                if (!ac.check()) {
+                    break;
+                }
+                a->Split(overlap_end, upper);
+                InsertArenaLocked(upper);
+            }
+
+            arena_list_.erase(*a);
+            arena_cumulative_size_ -= a->size();
+            moved_bytes += a->size();
+
+            for (size_t i = 0; i < a->size() / PAGE_SIZE; i++) {
+                vm_page* page = a->get_page(i);
+                page->node = target->id_ & ((1u << VM_PAGE_NODE_BITS) - 1);
+                if (page->is_free()) {
+                    UnlinkFreePageLocked(page);
+                    list_add_tail(&free_pages, &page->queue_node);
+                }
+            }
+            moved.push_back(a);
+        }
+    }
+
+    // hand everything over outside of our lock, so the two node locks never nest
+    target->AdoptArenas(&moved, &free_pages);
+
+    return moved_bytes;
+}
+
+void PmmNode::AdoptArenas(fbl::DoublyLinkedList<PmmArena*>* arenas, list_node* free_pages) {
+    Guard<fbl::Mutex> guard{&lock_};
+
+    while (!arenas->is_empty()) {
+        PmmArena* arena = arenas->pop_front();
+        InsertArenaLocked(arena);
+        arena_cumulative_size_ += arena->size();
+    }
+
+    while (!list_is_empty(free_pages)) {
+        vm_page* page = list_remove_head_type(free_pages, vm_page, queue_node);
+
+        DEBUG_ASSERT(page->node == id_);
+        page->state = VM_PAGE_STATE_FREE;
+        page->flags &= ~VM_PAGE_FLAG_ZEROED;
+        list_add_tail(&free_list_, &page->queue_node);
+        free_count_++;
+    }
+}
+
 // called at boot time as arenas are brought online, no locks are acquired
 void PmmNode::AddFreePages(list_node* list) TA_NO_THREAD_SAFETY_ANALYSIS {
     LTRACEF("list %p\n", list);
@@ -91,25 +235,144 @@ void PmmNode::AddFreePages(list_node* list) TA_NO_THREAD_SAFETY_ANALYSIS {
     LTRACEF("free count now %" PRIu64 "\n", free_count_);
 }
 
-zx_status_t PmmNode::AllocPage(uint alloc_flags, vm_page_t** page_out, paddr_t* pa_out) {
-    Guard<fbl::Mutex> guard{&lock_};
+vm_page* PmmNode::RemoveFreePageLocked(bool zeroed) {
+    list_node* first = zeroed ? &zeroed_list_ : &free_list_;
+    list_node* second = zeroed ? &free_list_ : &zeroed_list_;
 
-    vm_page* page = list_remove_head_type(&free_list_, vm_page, queue_node);
+    vm_page* page = list_peek_head_type(first, vm_page, queue_node);
     if (!page) {
-        return ZX_ERR_NO_MEMORY;
+        page = list_peek_head_type(second, vm_page, queue_node);
+        if (!page) {
+            return nullptr;
+        }
     }
 
-    DEBUG_ASSERT(free_count_ > 0);
-    free_count_--;
+    UnlinkFreePageLocked(page);
+    return page;
+}
 
+void PmmNode::UnlinkFreePageLocked(vm_page* page) {
     DEBUG_ASSERT(page->is_free());
+    DEBUG_ASSERT(list_in_list(&page->queue_node));
+
+    list_delete(&page->queue_node);
+
+    DEBUG_ASSERT(free_count_ > 0);
+    free_count_--;
+    if (page->is_zeroed()) {
+        DEBUG_ASSERT(zeroed_count_ > 0);
+        zeroed_count_--;
+    }
 
     set_state_alloc(page);
+}
+
+vm_page* PmmNode::PopCachedPage(CachedPages* cached) {
+    vm_page* page = list_remove_head_type(&cached->pages, vm_page, queue_node);
+    if (!page) {
+        return nullptr;
+    }
+
+    DEBUG_ASSERT(page->is_pmm_cached());
+    cached->count--;
+    cached_count_.fetch_sub(1);
+    if (page->is_zeroed()) {
+        cached_zeroed_count_.fetch_sub(1);
+    }
+
+    page->flags &= ~VM_PAGE_FLAG_PMM_CACHED;
+    return page;
+}
+
+// take a page from the current cpu's cache, refilling the cache from the free lists if
+// it has nothing suitable
+zx_status_t PmmNode::AllocPageFromCache(bool zeroed, vm_page_t** page_out) {
+    {
+        CpuCache* cache = &cpu_caches_[arch_curr_cpu_num()];
+        Guard<SpinLock, IrqSave> guard{&cache->lock};
+
+        // a zeroed page serves a request for a dirty one just as well, but not the other
+        // way around
+        vm_page* page = PopCachedPage(zeroed ? &cache->zeroed : &cache->dirty);
+        if (!page && !zeroed) {
+            page = PopCachedPage(&cache->zeroed);
+        }
+        if (page) {
+            *page_out = page;
+            return ZX_OK;
+        }
+    }
+
+    list_node dirty_batch = LIST_INITIAL_VALUE(dirty_batch);
+    list_node zeroed_batch = LIST_INITIAL_VALUE(zeroed_batch);
+    size_t dirty_refilled = 0;
+    size_t zeroed_refilled = 0;
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+
+        vm_page* page = RemoveFreePageLocked(zeroed);
+        if (!page) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        *page_out = page;
+
+        while (dirty_refilled + zeroed_refilled < kPmmCacheBatch - 1) {
+            page = RemoveFreePageLocked(zeroed);
+            if (!page) {
+                break;
+            }
+
+            page->flags |= VM_PAGE_FLAG_PMM_CACHED;
+            if (page->is_zeroed()) {
+                list_add_tail(&zeroed_batch, &page->queue_node);
+                zeroed_refilled++;
+            } else {
+                list_add_tail(&dirty_batch, &page->queue_node);
+                dirty_refilled++;
+            }
+        }
+        cached_count_.fetch_add(dirty_refilled + zeroed_refilled);
+        cached_zeroed_count_.fetch_add(zeroed_refilled);
+
+        MaybeWakeZeroThreadLocked();
+    }
+
+    // we may have migrated since looking at the cache above, which only costs a little
+    // balance between the caches
+    if (dirty_refilled + zeroed_refilled > 0) {
+        CpuCache* cache = &cpu_caches_[arch_curr_cpu_num()];
+        Guard<SpinLock, IrqSave> guard{&cache->lock};
+
+        list_splice_after(&dirty_batch, &cache->dirty.pages);
+        cache->dirty.count += dirty_refilled;
+        list_splice_after(&zeroed_batch, &cache->zeroed.pages);
+        cache->zeroed.count += zeroed_refilled;
+    }
+
+    return ZX_OK;
+}
+
+zx_status_t PmmNode::AllocPage(uint alloc_flags, vm_page_t** page_out, paddr_t* pa_out) {
+    const bool zeroed = alloc_flags & PMM_ALLOC_FLAG_ZEROED;
+
+    vm_page* page;
+    zx_status_t status = AllocPageFromCache(zeroed, &page);
+    if (status == ZX_ERR_NO_MEMORY && DrainCpuCaches()) {
+        // the last free pages were sitting in other cpus' caches
+        Guard<fbl::Mutex> guard{&lock_};
+        page = RemoveFreePageLocked(zeroed);
+        status = page ? ZX_OK : ZX_ERR_NO_MEMORY;
+    }
+    if (status != ZX_OK) {
+        return status;
+    }
 
 #if PMM_ENABLE_FREE_FILL
     CheckFreeFill(page);
 #endif
 
+    prepare_page_for_caller(page, zeroed);
+
     if (pa_out) {
         *pa_out = page->paddr();
     }
@@ -133,10 +396,38 @@ zx_status_t PmmNode::AllocPages(size_t count, uint alloc_flags, list_node* list)
         return ZX_OK;
     }
 
-    Guard<fbl::Mutex> guard{&lock_};
+    const bool zeroed = alloc_flags & PMM_ALLOC_FLAG_ZEROED;
+    list_node allocated = LIST_INITIAL_VALUE(allocated);
+    zx_status_t status;
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+        status = AllocPagesLocked(count, zeroed, &allocated);
+    }
+
+    if (status == ZX_ERR_NO_MEMORY && DrainCpuCaches()) {
+        // the cpu caches held enough pages to make up the difference
+        Guard<fbl::Mutex> guard{&lock_};
+        status = AllocPagesLocked(count, zeroed, &allocated);
+    }
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // zero any pages the pool couldn't cover outside of the lock
+    vm_page* page;
+    list_for_every_entry (&allocated, page, vm_page, queue_node) {
+        prepare_page_for_caller(page, zeroed);
+    }
 
+    // append to the caller's list
+    list_splice_after(&allocated, list->prev);
+
+    return ZX_OK;
+}
+
+zx_status_t PmmNode::AllocPagesLocked(size_t count, bool zeroed, list_node* list) {
     while (count > 0) {
-        vm_page* page = list_remove_head_type(&free_list_, vm_page, queue_node);
+        vm_page* page = RemoveFreePageLocked(zeroed);
         if (unlikely(!page)) {
             // free pages that have already been allocated
             FreeListLocked(list);
@@ -145,21 +436,17 @@ zx_status_t PmmNode::AllocPages(size_t count, uint alloc_flags, list_node* list)
 
         LTRACEF("allocating page %p, pa %#" PRIxPTR "\n", page, page->paddr());
 
-        DEBUG_ASSERT(free_count_ > 0);
-
-        free_count_--;
-
-        DEBUG_ASSERT(page->is_free());
 #if PMM_ENABLE_FREE_FILL
         CheckFreeFill(page);
 #endif
 
-        page->state = VM_PAGE_STATE_ALLOC;
         list_add_tail(list, &page->queue_node);
 
         count--;
     }
 
+    MaybeWakeZeroThreadLocked();
+
     return ZX_OK;
 }
 
@@ -169,14 +456,31 @@ zx_status_t PmmNode::AllocRange(paddr_t address, size_t count, list_node* list)
     // list must be initialized prior to calling this
     DEBUG_ASSERT(list);
 
-    size_t allocated = 0;
     if (count == 0) {
         return ZX_OK;
     }
 
     address = ROUNDDOWN(address, PAGE_SIZE);
 
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+        zx_status_t status = AllocRangeLocked(address, count, list);
+        if (status != ZX_ERR_NOT_FOUND) {
+            return status;
+        }
+    }
+
+    // some of the pages may be sitting in the cpu caches
+    if (!DrainCpuCaches()) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
     Guard<fbl::Mutex> guard{&lock_};
+    return AllocRangeLocked(address, count, list);
+}
+
+zx_status_t PmmNode::AllocRangeLocked(paddr_t address, size_t count, list_node* list) {
+    size_t allocated = 0;
 
     // walk through the arenas, looking to see if the physical page belongs to it
     for (auto& a : arena_list_) {
@@ -190,15 +494,13 @@ zx_status_t PmmNode::AllocRange(paddr_t address, size_t count, list_node* list)
                 break;
             }
 
-            list_delete(&page->queue_node);
-
-            page->state = VM_PAGE_STATE_ALLOC;
+            UnlinkFreePageLocked(page);
+            page->flags &= ~VM_PAGE_FLAG_ZEROED;
 
             list_add_tail(list, &page->queue_node);
 
             allocated++;
             address += PAGE_SIZE;
-            free_count_--;
         }
 
         if (allocated == count) {
@@ -230,8 +532,25 @@ zx_status_t PmmNode::AllocContiguous(const size_t count, uint alloc_flags, uint8
     DEBUG_ASSERT(pa);
     DEBUG_ASSERT(list);
 
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+        zx_status_t status = AllocContiguousLocked(count, alignment_log2, pa, list);
+        if (status != ZX_ERR_NOT_FOUND) {
+            return status;
+        }
+    }
+
+    // pages in the cpu caches may be breaking up the run we need
+    if (!DrainCpuCaches()) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
     Guard<fbl::Mutex> guard{&lock_};
+    return AllocContiguousLocked(count, alignment_log2, pa, list);
+}
 
+zx_status_t PmmNode::AllocContiguousLocked(size_t count, uint8_t alignment_log2, paddr_t* pa,
+                                           list_node* list) {
     for (auto& a : arena_list_) {
         vm_page_t* p = a.FindFreeContiguous(count, alignment_log2);
         if (!p) {
@@ -243,14 +562,9 @@ zx_status_t PmmNode::AllocContiguous(const size_t count, uint alloc_flags, uint8
         // remove the pages from the run out of the free list
         for (size_t i = 0; i < count; i++, p++) {
             DEBUG_ASSERT_MSG(p->is_free(), "p %p state %u\n", p, p->state);
-            DEBUG_ASSERT(list_in_list(&p->queue_node));
 
-            list_delete(&p->queue_node);
-            p->state = VM_PAGE_STATE_ALLOC;
-
-            DEBUG_ASSERT(free_count_ > 0);
-
-            free_count_--;
+            UnlinkFreePageLocked(p);
+            p->flags &= ~VM_PAGE_FLAG_ZEROED;
 
 #if PMM_ENABLE_FREE_FILL
             CheckFreeFill(p);
@@ -281,8 +595,9 @@ void PmmNode::FreePageLocked(vm_page* page) {
         list_delete(&page->queue_node);
     }
 
-    // mark it free
+    // mark it free. whatever it held, it has to be zeroed again before reuse
     page->state = VM_PAGE_STATE_FREE;
+    page->flags &= ~VM_PAGE_FLAG_ZEROED;
 
     // add it to the free queue
     list_add_head(&free_list_, &page->queue_node);
@@ -290,10 +605,96 @@ void PmmNode::FreePageLocked(vm_page* page) {
     free_count_++;
 }
 
-void PmmNode::FreePage(vm_page* page) {
+// put a page being freed in the current cpu's cache, giving the oldest pages in the cache
+// back to the free list if it has grown too large
+void PmmNode::FreePageToCache(vm_page* page) {
+    LTRACEF("page %p state %u paddr %#" PRIxPTR "\n", page, page->state, page->paddr());
+
+    DEBUG_ASSERT(page->state != VM_PAGE_STATE_OBJECT || page->object.pin_count == 0);
+    DEBUG_ASSERT(!page->is_free());
+    DEBUG_ASSERT(!page->is_pmm_cached());
+
+#if PMM_ENABLE_FREE_FILL
+    FreeFill(page);
+#endif
+
+    // remove it from its old queue
+    if (list_in_list(&page->queue_node)) {
+        list_delete(&page->queue_node);
+    }
+
+    page->state = VM_PAGE_STATE_ALLOC;
+    page->flags |= VM_PAGE_FLAG_PMM_CACHED;
+    page->flags &= ~VM_PAGE_FLAG_ZEROED;
+
+    list_node excess = LIST_INITIAL_VALUE(excess);
+    {
+        CpuCache* cache = &cpu_caches_[arch_curr_cpu_num()];
+        Guard<SpinLock, IrqSave> guard{&cache->lock};
+
+        list_add_head(&cache->dirty.pages, &page->queue_node);
+        cache->dirty.count++;
+        cached_count_.fetch_add(1);
+
+        if (cache->dirty.count <= kPmmCacheMax) {
+            return;
+        }
+
+        while (cache->dirty.count > kPmmCacheBatch) {
+            list_add_tail(&excess, list_remove_tail(&cache->dirty.pages));
+            cache->dirty.count--;
+            cached_count_.fetch_sub(1);
+        }
+    }
+
+    Guard<fbl::Mutex> guard{&lock_};
+    ReturnCachedPagesLocked(&excess);
+}
+
+void PmmNode::ReturnCachedPagesLocked(list_node* list) {
+    while (!list_is_empty(list)) {
+        vm_page* page = list_remove_head_type(list, vm_page, queue_node);
+
+        DEBUG_ASSERT(page->is_pmm_cached());
+        page->flags &= ~VM_PAGE_FLAG_PMM_CACHED;
+        page->state = VM_PAGE_STATE_FREE;
+
+        if (page->is_zeroed()) {
+            list_add_head(&zeroed_list_, &page->queue_node);
+            zeroed_count_++;
+        } else {
+            list_add_head(&free_list_, &page->queue_node);
+        }
+        free_count_++;
+    }
+
+    MaybeWakeZeroThreadLocked();
+}
+
+bool PmmNode::DrainCpuCaches() {
+    list_node drained = LIST_INITIAL_VALUE(drained);
+    for (auto& cache : cpu_caches_) {
+        Guard<SpinLock, IrqSave> guard{&cache.lock};
+
+        list_splice_after(&cache.dirty.pages, &drained);
+        list_splice_after(&cache.zeroed.pages, &drained);
+        cached_count_.fetch_sub(cache.dirty.count + cache.zeroed.count);
+        cached_zeroed_count_.fetch_sub(cache.zeroed.count);
+        cache.dirty.count = 0;
+        cache.zeroed.count = 0;
+    }
+
+    if (list_is_empty(&drained)) {
+        return false;
+    }
+
     Guard<fbl::Mutex> guard{&lock_};
+    ReturnCachedPagesLocked(&drained);
+    return true;
+}
 
-    FreePageLocked(page);
+void PmmNode::FreePage(vm_page* page) {
+    FreePageToCache(page);
 }
 
 void PmmNode::FreeListLocked(list_node* list) {
@@ -310,11 +711,101 @@ void PmmNode::FreeList(list_node* list) {
     Guard<fbl::Mutex> guard{&lock_};
 
     FreeListLocked(list);
+    MaybeWakeZeroThreadLocked();
+}
+
+void PmmNode::MaybeWakeZeroThreadLocked() {
+    if (zero_thread_ && zeroed_count_ < zero_target_ && free_count_ > zeroed_count_) {
+        event_signal(&zero_event_, false);
+    }
+}
+
+// Zero pages from the tail of the dirty free list, which holds the pages freed longest
+// ago, and move them to the zeroed list until the pool reaches its target. Pages are
+// allocated while they are being zeroed so nothing else touches them.
+int PmmNode::ZeroThreadLoop() {
+    for (;;) {
+        event_wait(&zero_event_);
+
+        for (;;) {
+            list_node batch = LIST_INITIAL_VALUE(batch);
+            {
+                Guard<fbl::Mutex> guard{&lock_};
+
+                for (size_t i = 0; i < kZeroBatch && zeroed_count_ < zero_target_; i++) {
+                    vm_page* page = list_peek_tail_type(&free_list_, vm_page, queue_node);
+                    if (!page) {
+                        break;
+                    }
+                    UnlinkFreePageLocked(page);
+                    list_add_tail(&batch, &page->queue_node);
+                }
+            }
+
+            if (list_is_empty(&batch)) {
+                break;
+            }
+
+            vm_page* page;
+            list_for_every_entry (&batch, page, vm_page, queue_node) {
+                zero_page(page, zero_nontemporal_);
+            }
+
+            Guard<fbl::Mutex> guard{&lock_};
+            while ((page = list_remove_head_type(&batch, vm_page, queue_node)) != nullptr) {
+                page->state = VM_PAGE_STATE_FREE;
+                page->flags |= VM_PAGE_FLAG_ZEROED;
+                list_add_tail(&zeroed_list_, &page->queue_node);
+                free_count_++;
+                zeroed_count_++;
+            }
+        }
+    }
+
+    return 0;
+}
+
+void PmmNode::StartZeroThread(uint64_t target_pages, bool nontemporal) {
+#if PMM_ENABLE_FREE_FILL
+    // zeroed pages would fail the free fill checks
+    printf("PMM: zeroed page pool disabled by PMM_ENABLE_FREE_FILL\n");
+    return;
+#endif
+
+    if (target_pages == 0) {
+        return;
+    }
+
+    zero_nontemporal_ = nontemporal;
+
+    auto zero_thread = [](void* arg) -> int {
+        return static_cast<PmmNode*>(arg)->ZeroThreadLoop();
+    };
+    // only run when the cpus would otherwise be idle
+    thread_t* t = thread_create("pmm-zero", zero_thread, this, LOWEST_PRIORITY + 1);
+    if (!t) {
+        printf("PMM: failed to create zero thread\n");
+        return;
+    }
+
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+        DEBUG_ASSERT(!zero_thread_);
+        zero_thread_ = t;
+        zero_target_ = target_pages;
+        MaybeWakeZeroThreadLocked();
+    }
+
+    thread_detach_and_resume(t);
 }
 
 // okay if accessed outside of a lock
 uint64_t PmmNode::CountFreePages() const TA_NO_THREAD_SAFETY_ANALYSIS {
-    return free_count_;
+    return free_count_ + cached_count_.load();
+}
+
+uint64_t PmmNode::CountFreeZeroedPages() const TA_NO_THREAD_SAFETY_ANALYSIS {
+    return zeroed_count_ + cached_zeroed_count_.load();
 }
 
 uint64_t PmmNode::CountTotalBytes() const TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -338,8 +829,11 @@ void PmmNode::DumpFree() const TA_NO_THREAD_SAFETY_ANALYSIS {
 void PmmNode::Dump(bool is_panic) const {
     // No lock analysis here, as we want to just go for it in the panic case without the lock.
     auto dump = [this]() TA_NO_THREAD_SAFETY_ANALYSIS {
-        printf("pmm node %p: free_count %zu (%zu bytes), total size %zu\n",
-               this, free_count_, free_count_ * PAGE_SIZE, arena_cumulative_size_);
+        printf("pmm node %u (%p): free_count %zu (%zu bytes), total size %zu\n",
+               id_, this, free_count_, free_count_ * PAGE_SIZE, arena_cumulative_size_);
+        printf("\tzeroed %" PRIu64 " (target %" PRIu64 "), per-cpu caches %" PRIu64
+               " (%" PRIu64 " zeroed)\n",
+               zeroed_count_, zero_target_, cached_count_.load(), cached_zeroed_count_.load());
         for (auto& a : arena_list_) {
             a.Dump(false, false);
         }
@@ -357,6 +851,9 @@ void PmmNode::Dump(bool is_panic) const {
 void PmmNode::EnforceFill() {
     DEBUG_ASSERT(!enforce_fill_);
 
+    // pages in the cpu caches were never filled, put them where the loop below finds them
+    DrainCpuCaches();
+
     vm_page* page;
     list_for_every_entry (&free_list_, page, vm_page, queue_node) {
         FreeFill(page);
@@ -372,6 +869,10 @@ void PmmNode::FreeFill(vm_page_t* page) {
 }
 
 void PmmNode::CheckFreeFill(vm_page_t* page) {
+    if (page->is_zeroed()) {
+        return;
+    }
+
     uint8_t* kvaddr = static_cast<uint8_t*>(paddr_to_physmap(page->paddr()));
     for (size_t j = 0; j < PAGE_SIZE; ++j) {
         ASSERT(!enforce_fill_ || *(kvaddr + j) == PMM_FREE_FILL_BYTE);
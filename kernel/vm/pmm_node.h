@@ -5,11 +5,16 @@
 // https://opensource.org/licenses/MIT
 #pragma once
 
+#include <fbl/atomic.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
 
+#include <kernel/align.h>
+#include <kernel/event.h>
 #include <kernel/lockdep.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
 #include <vm/pmm.h>
 
 #include "pmm_arena.h"
@@ -20,7 +25,8 @@
 // per numa node collection of pmm arenas and worker threads
 class PmmNode {
 public:
-    PmmNode();
+    // |id| is the node's index in the pmm, which its pages are tagged with
+    explicit PmmNode(uint32_t id);
     ~PmmNode();
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(PmmNode);
@@ -36,7 +42,12 @@ public:
     void FreePage(vm_page* page);
     void FreeList(list_node* list);
 
+    // return all pages held in the per-cpu caches to the free lists.
+    // returns true if any pages were returned.
+    bool DrainCpuCaches() TA_EXCL(lock_);
+
     uint64_t CountFreePages() const;
+    uint64_t CountFreeZeroedPages() const;
     uint64_t CountTotalBytes() const;
     void CountTotalStates(uint64_t state_count[VM_PAGE_STATE_COUNT_]) const;
 
@@ -51,30 +62,109 @@ public:
 #endif
 
     zx_status_t AddArena(const pmm_arena_info_t* info);
+    // add an arena after boot, with its vm_page structures in |page_array|, which must
+    // outlive the node. used by tests.
+    zx_status_t AddArena(const pmm_arena_info_t* info, vm_page_t* page_array);
+
+    // Move the memory of this node that falls in [base, base + size) to |target|,
+    // splitting arenas as needed. Free pages move over right away; allocated ones
+    // go to |target| when they are freed. Returns the number of bytes moved.
+    size_t TransferRange(paddr_t base, size_t size, PmmNode* target);
+
+    uint32_t id() const { return id_; }
 
     // add new pages to the free queue. used when boostrapping a PmmArena
     void AddFreePages(list_node* list);
 
+    // start the thread that keeps the zeroed page pool topped up to |target_pages|
+    void StartZeroThread(uint64_t target_pages, bool nontemporal);
+
 private:
+    void InsertArenaLocked(PmmArena* arena) TA_REQ(lock_);
+    // take over arenas split off from another node, along with their free pages
+    void AdoptArenas(fbl::DoublyLinkedList<PmmArena*>* arenas, list_node* free_pages);
+
     void FreePageLocked(vm_page* page) TA_REQ(lock_);
     void FreeListLocked(list_node* list) TA_REQ(lock_);
 
+    // take a page off the free lists, preferring the zeroed list if |zeroed| is set and
+    // the dirty list otherwise. returns nullptr if both are empty.
+    vm_page* RemoveFreePageLocked(bool zeroed) TA_REQ(lock_);
+    // take a specific free page off whichever free list it is on
+    void UnlinkFreePageLocked(vm_page* page) TA_REQ(lock_);
+
+    zx_status_t AllocPagesLocked(size_t count, bool zeroed, list_node* list) TA_REQ(lock_);
+    zx_status_t AllocRangeLocked(paddr_t address, size_t count, list_node* list) TA_REQ(lock_);
+    zx_status_t AllocContiguousLocked(size_t count, uint8_t alignment_log2, paddr_t* pa,
+                                      list_node* list) TA_REQ(lock_);
+    zx_status_t AllocPageFromCache(bool zeroed, vm_page_t** page);
+    void FreePageToCache(vm_page* page);
+    void ReturnCachedPagesLocked(list_node* list) TA_REQ(lock_);
+
+    // wake the zero thread if the zeroed pool is below target and there are dirty pages
+    void MaybeWakeZeroThreadLocked() TA_REQ(lock_);
+    int ZeroThreadLoop();
+
+    // Per-cpu caches of free pages, so that single page allocs and frees usually avoid
+    // lock_. A cache refills from the free lists kPmmCacheBatch pages at a time when it
+    // runs dry, and gives back all but kPmmCacheBatch dirty pages once it holds more than
+    // kPmmCacheMax of them.
+    //
+    // A thread may migrate after picking its cpu's cache, so each cache has its own
+    // spinlock. lock_ is never taken while holding one, since it is a mutex.
+    static constexpr size_t kPmmCacheBatch = 32;
+    static constexpr size_t kPmmCacheMax = 2 * kPmmCacheBatch;
+
+    struct CachedPages {
+        list_node pages = LIST_INITIAL_VALUE(pages);
+        size_t count = 0;
+    };
+
+    struct __CPU_ALIGN CpuCache {
+        DECLARE_SPINLOCK(PmmNode::CpuCache) lock;
+        // pages freed on this cpu or taken from the dirty free list
+        CachedPages dirty TA_GUARDED(lock);
+        // pages taken from the zeroed free list
+        CachedPages zeroed TA_GUARDED(lock);
+    };
+    CpuCache cpu_caches_[SMP_MAX_CPUS];
+
+    vm_page* PopCachedPage(CachedPages* cached);
+
+    // pages held across all of the cpu caches, so the counting routines don't need their locks
+    fbl::atomic<uint64_t> cached_count_{0};
+    fbl::atomic<uint64_t> cached_zeroed_count_{0};
+
     fbl::Canary<fbl::magic("PNOD")> canary_;
 
+    const uint32_t id_;
+
     mutable DECLARE_MUTEX(PmmNode) lock_;
 
     uint64_t arena_cumulative_size_ TA_GUARDED(lock_) = 0;
+    // pages on free_list_ and zeroed_list_
     uint64_t free_count_ TA_GUARDED(lock_) = 0;
+    // pages on zeroed_list_
+    uint64_t zeroed_count_ TA_GUARDED(lock_) = 0;
 
     fbl::DoublyLinkedList<PmmArena*> arena_list_ TA_GUARDED(lock_);
 
     // page queues
     list_node free_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(free_list_);
+    list_node zeroed_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(zeroed_list_);
     list_node inactive_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(inactive_list_);
     list_node active_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(active_list_);
     list_node modified_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(modified_list_);
     list_node wired_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(wired_list_);
 
+    // The zero thread moves pages from free_list_ to zeroed_list_ in the background, so
+    // that PMM_ALLOC_FLAG_ZEROED allocations don't have to zero pages inline.
+    static constexpr size_t kZeroBatch = 16;
+    thread_t* zero_thread_ TA_GUARDED(lock_) = nullptr;
+    uint64_t zero_target_ TA_GUARDED(lock_) = 0;
+    bool zero_nontemporal_ = false;
+    event_t zero_event_ = EVENT_INITIAL_VALUE(zero_event_, false, EVENT_FLAG_AUTOUNSIGNAL);
+
 #if PMM_ENABLE_FREE_FILL
     void FreeFill(vm_page_t* page);
     void CheckFreeFill(vm_page_t* page);
@@ -0,0 +1,220 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/scanner.h>
+
+#include <fbl/mutex.h>
+#include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <kernel/thread.h>
+#include <lib/console.h>
+#include <lib/counters.h>
+#include <lk/init.h>
+#include <platform.h>
+#include <stdlib.h>
+#include <string.h>
+#include <trace.h>
+#include <vm/compressed_store.h>
+#include <vm/pmm.h>
+#include <vm/vm.h>
+#include <vm/vm_aspace.h>
+#include <vm/vm_object.h>
+#include <zircon/time.h>
+#include <zircon/types.h>
+
+#include "vm_priv.h"
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+KCOUNTER(scanner_scans, "kernel.vm.scanner.scans");
+KCOUNTER(scanner_accessed, "kernel.vm.scanner.accessed");
+KCOUNTER(scanner_zero_pages, "kernel.vm.scanner.zero_pages");
+KCOUNTER(reclaim_runs, "kernel.vm.reclaim.runs");
+KCOUNTER(reclaim_discarded_pages, "kernel.vm.reclaim.discarded_pages");
+KCOUNTER(reclaim_zero_pages, "kernel.vm.reclaim.zero_pages");
+KCOUNTER(reclaim_compressed_pages, "kernel.vm.reclaim.compressed_pages");
+
+// Whether reclaim may move inactive pages into the compressed store.
+static bool compression_enabled;
+
+// The most committed pages each scan looks at for zero pages outside of
+// reclaim, and the percentage of memory that must be in use before it does.
+static uint64_t zero_pages_per_scan;
+static uint64_t zero_pages_used_percent;
+
+// Serializes scans, and the zero page passes that resume where the last one
+// stopped.
+static DECLARE_MUTEX(VmScanner) scanner_lock;
+
+static void scanner_accessed(void* context, vaddr_t vaddr, paddr_t paddr) {
+    vm_page_t* p = paddr_to_vm_page(paddr);
+    // the page stays mapped, and so owned by its object, while the page
+    // tables are locked
+    if (!p || p->state != VM_PAGE_STATE_OBJECT) {
+        return;
+    }
+    p->object.age = 0;
+    (*static_cast<size_t*>(context))++;
+}
+
+static void scanner_scan() {
+    LTRACE_ENTRY;
+
+    Guard<fbl::Mutex> guard{&scanner_lock};
+
+    VmObject::ForEachRef([](const fbl::RefPtr<VmObject>& vmo) {
+        vmo->AgePages();
+    });
+
+    size_t accessed = 0;
+    HarvestAllUserAccessed(&scanner_accessed, &accessed);
+
+    kcounter_add(scanner_scans, 1);
+    kcounter_add(scanner_accessed, static_cast<int64_t>(accessed));
+    LTRACEF("%zu pages accessed since the last scan\n", accessed);
+}
+
+size_t vm_scanner_dedup_zero_pages(size_t max_scan) {
+    Guard<fbl::Mutex> guard{&scanner_lock};
+
+    const size_t scan_limit = max_scan;
+    size_t freed = 0;
+    VmObject::ForEachRefResumable([&](const fbl::RefPtr<VmObject>& vmo) {
+        freed += vmo->ReclaimZeroPages(SIZE_MAX, VM_SCANNER_INACTIVE_AGE, &max_scan);
+        return max_scan > 0;
+    });
+
+    kcounter_add(scanner_zero_pages, static_cast<int64_t>(freed));
+    LTRACEF("looked at %zu pages, freed %zu zero pages\n", scan_limit - max_scan, freed);
+    return freed;
+}
+
+// Each page freed is unmapped first, which takes a TLB shootdown, so the pass
+// is skipped while there is plenty of memory free.
+static bool scanner_should_dedup_zero_pages() {
+    if (zero_pages_per_scan == 0) {
+        return false;
+    }
+    const uint64_t total = pmm_count_total_bytes() / PAGE_SIZE;
+    const uint64_t used = total - pmm_count_free_pages();
+    return used * 100 >= total * zero_pages_used_percent;
+}
+
+static int scanner_thread(void* arg) {
+    const zx_duration_t period = *static_cast<zx_duration_t*>(arg);
+
+    for (;;) {
+        thread_sleep_relative(period);
+        scanner_scan();
+        if (scanner_should_dedup_zero_pages()) {
+            vm_scanner_dedup_zero_pages(zero_pages_per_scan);
+        }
+    }
+    return 0;
+}
+
+size_t vm_scanner_reclaim(size_t target_pages) {
+    kcounter_add(reclaim_runs, 1);
+
+    // the owners of discardable objects have said that they can do without
+    size_t discarded = 0;
+    VmObject::ForEachRef([&](const fbl::RefPtr<VmObject>& vmo) {
+        if (discarded < target_pages) {
+            discarded += vmo->DiscardPages();
+        }
+    });
+    kcounter_add(reclaim_discarded_pages, static_cast<int64_t>(discarded));
+
+    size_t zero = 0;
+    VmObject::ForEachRef([&](const fbl::RefPtr<VmObject>& vmo) {
+        if (discarded + zero < target_pages) {
+            zero += vmo->ReclaimZeroPages(target_pages - discarded - zero,
+                                          VM_SCANNER_INACTIVE_AGE, nullptr);
+        }
+    });
+    kcounter_add(reclaim_zero_pages, static_cast<int64_t>(zero));
+
+    // each compressed page still takes up part of a store page
+    size_t compressed = 0;
+    if (compression_enabled) {
+        VmObject::ForEachRef([&](const fbl::RefPtr<VmObject>& vmo) {
+            if (discarded + zero + compressed < target_pages) {
+                compressed += vmo->CompressPages(target_pages - discarded - zero - compressed,
+                                                 VM_SCANNER_INACTIVE_AGE);
+            }
+        });
+        kcounter_add(reclaim_compressed_pages, static_cast<int64_t>(compressed));
+    }
+
+    LTRACEF("reclaimed %zu discarded, %zu zero and %zu compressed pages of %zu\n", discarded,
+            zero, compressed, target_pages);
+    return discarded + zero + compressed;
+}
+
+static void scanner_init(uint level) {
+    compression_enabled = cmdline_get_bool("kernel.vm.compression", true);
+    zero_pages_per_scan = cmdline_get_uint64("kernel.vm.zero-pages-per-scan", 4096);
+    zero_pages_used_percent = cmdline_get_uint64("kernel.vm.zero-pages-used-percent", 50);
+
+    static zx_duration_t period;
+    period = ZX_SEC(cmdline_get_uint64("kernel.vm.scan-period-sec", 10));
+    if (period == 0) {
+        return;
+    }
+
+    thread_t* t = thread_create("vm-scanner", scanner_thread, &period, LOW_PRIORITY);
+    if (!t) {
+        printf("VM: failed to create scanner thread\n");
+        return;
+    }
+    thread_detach_and_resume(t);
+}
+
+LK_INIT_HOOK(vm_scanner, &scanner_init, LK_INIT_LEVEL_THREADING);
+
+static int cmd_scanner(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc < 2) {
+    notenoughargs:
+        printf("not enough arguments\n");
+    usage:
+        printf("usage:\n");
+        printf("%s scan            : age pages and harvest accessed bits now\n", argv[0].str);
+        printf("%s dedup <pages>   : look at <pages> pages for zero pages to free\n",
+               argv[0].str);
+        printf("%s reclaim <pages> : try to reclaim <pages> pages\n", argv[0].str);
+        printf("%s compression     : dump the compressed page store\n", argv[0].str);
+        return ZX_ERR_INTERNAL;
+    }
+
+    if (!strcmp(argv[1].str, "scan")) {
+        scanner_scan();
+    } else if (!strcmp(argv[1].str, "dedup")) {
+        if (argc < 3) {
+            goto notenoughargs;
+        }
+        size_t freed = vm_scanner_dedup_zero_pages(argv[2].u);
+        printf("freed %zu zero pages\n", freed);
+    } else if (!strcmp(argv[1].str, "reclaim")) {
+        if (argc < 3) {
+            goto notenoughargs;
+        }
+        size_t reclaimed = vm_scanner_reclaim(argv[2].u);
+        printf("reclaimed %zu pages\n", reclaimed);
+    } else if (!strcmp(argv[1].str, "compression")) {
+        VmCompressedStore::Get()->Dump();
+    } else {
+        printf("unknown command\n");
+        goto usage;
+    }
+
+    return ZX_OK;
+}
+
+STATIC_COMMAND_START
+#if LK_DEBUGLEVEL > 0
+STATIC_COMMAND("scanner", "page scanner", &cmd_scanner)
+#endif
+STATIC_COMMAND_END(scanner);
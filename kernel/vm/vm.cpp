@@ -12,6 +12,7 @@
 #include <err.h>
 #include <fbl/algorithm.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
 #include <kernel/thread.h>
 #include <lib/console.h>
 #include <lib/crypto/global_prng.h>
@@ -34,6 +35,14 @@ paddr_t zero_page_paddr;
 // set early in arch code to record the start address of the kernel
 paddr_t kernel_base_phys;
 
+// Only the x86 page tables split a large page when part of it is unmapped or
+// protected, so other architectures keep mapping user memory with small pages.
+#if ARCH_X86
+static bool large_pages_enabled = true;
+#else
+static bool large_pages_enabled = false;
+#endif
+
 namespace {
 
 // mark a range of physical pages as WIRED
@@ -117,6 +126,8 @@ void vm_init_preheap() {
 void vm_init() {
     LTRACE_ENTRY;
 
+    large_pages_enabled = large_pages_enabled && cmdline_get_bool("kernel.vm.large-pages", true);
+
     VmAspace* aspace = VmAspace::kernel_aspace();
 
     // we expect the kernel to be in a temporary mapping, define permanent
@@ -183,6 +194,10 @@ void vm_init() {
 #endif
 }
 
+bool vm_large_pages_enabled() {
+    return large_pages_enabled;
+}
+
 paddr_t vaddr_to_paddr(const void* ptr) {
     if (is_physmap_addr(ptr)) {
         return physmap_to_paddr(ptr);
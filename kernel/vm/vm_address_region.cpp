@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <err.h>
 #include <fbl/alloc_checker.h>
+#include <fbl/auto_call.h>
 #include <inttypes.h>
 #include <lib/vdso.h>
 #include <pow2.h>
@@ -143,7 +144,17 @@ zx_status_t VmAddressRegion::CreateSubVmarInternal(size_t offset, size_t size, u
         }
     } else {
         // If we're not mapping to a specific place, search for an opening.
-        zx_status_t status = AllocSpotLocked(size, align_pow2, arch_mmu_flags, &new_base);
+        zx_status_t status = ZX_ERR_NO_MEMORY;
+        if (vmo && vmo->is_paged() && vm_large_pages_enabled() &&
+            align_pow2 < LARGE_PAGE_SIZE_SHIFT && size >= LARGE_PAGE_SIZE &&
+            IS_ALIGNED(vmo_offset, LARGE_PAGE_SIZE)) {
+            // Line the mapping up with the vmo's large pages if there is room,
+            // so that they can be mapped as large pages.
+            status = AllocSpotLocked(size, LARGE_PAGE_SIZE_SHIFT, arch_mmu_flags, &new_base);
+        }
+        if (status != ZX_OK) {
+            status = AllocSpotLocked(size, align_pow2, arch_mmu_flags, &new_base);
+        }
         if (status != ZX_OK) {
             return status;
         }
@@ -218,7 +229,8 @@ zx_status_t VmAddressRegion::CreateVmMapping(size_t mapping_offset, size_t size,
     LTRACEF("%p %#zx %#zx %x\n", this, mapping_offset, size, vmar_flags);
 
     // Check that only allowed flags have been set
-    if (vmar_flags & ~(VMAR_FLAG_SPECIFIC | VMAR_FLAG_SPECIFIC_OVERWRITE | VMAR_CAN_RWX_FLAGS)) {
+    if (vmar_flags & ~(VMAR_FLAG_SPECIFIC | VMAR_FLAG_SPECIFIC_OVERWRITE | VMAR_CAN_RWX_FLAGS |
+                       VMAR_FLAG_FAULT_AROUND_MASK)) {
         return ZX_ERR_INVALID_ARGS;
     }
 
@@ -378,14 +390,14 @@ size_t VmAddressRegion::AllocatedPagesLocked() const {
     return sum;
 }
 
-zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags) {
+zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) {
     canary_.Assert();
     DEBUG_ASSERT(aspace_->lock()->lock().IsHeld());
 
     auto vmar = WrapRefPtr(this);
     while (auto next = vmar->FindRegionLocked(va)) {
         if (next->is_mapping()) {
-            return next->PageFault(va, pf_flags);
+            return next->PageFault(va, pf_flags, page_request);
         }
         vmar = next->as_vm_address_region();
     }
@@ -822,6 +834,10 @@ zx_status_t VmAddressRegion::Protect(vaddr_t base, size_t size, uint new_arch_mm
         return ZX_ERR_NOT_FOUND;
     }
 
+    // Let the mappings share a single TLB shootdown.
+    aspace_->arch_aspace().BeginTlbBatch();
+    auto end_batch = fbl::MakeAutoCall([this]() { aspace_->arch_aspace().EndTlbBatch(); });
+
     for (auto itr = begin; itr != end;) {
         DEBUG_ASSERT(itr->is_mapping());
 
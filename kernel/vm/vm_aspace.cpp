@@ -555,7 +555,24 @@ zx_status_t VmAspace::PageFault(vaddr_t va, uint flags) {
     // the region out from underneath it
     Guard<fbl::Mutex> guard{&lock_};
 
-    return root_vmar_->PageFault(va, flags);
+    page_faults_++;
+    PageRequest page_request;
+    for (;;) {
+        zx_status_t status = root_vmar_->PageFault(va, flags, &page_request);
+        if (status != ZX_ERR_SHOULD_WAIT) {
+            return status;
+        }
+
+        // wait for a page source to supply the page without holding the lock.
+        // the mappings may change in the meantime, so the fault starts over
+        guard.CallUnlocked([&page_request, &status]() { status = page_request.Wait(); });
+        if (status != ZX_OK) {
+            return status;
+        }
+        if (aspace_destroyed_) {
+            return ZX_ERR_BAD_STATE;
+        }
+    }
 }
 
 void VmAspace::Dump(bool verbose) const {
@@ -593,6 +610,22 @@ void DumpAllAspaces(bool verbose) {
     }
 }
 
+void HarvestAllUserAccessed(arch_accessed_fn_t accessed_fn, void* context) {
+    Guard<fbl::Mutex> guard{&aspace_list_lock};
+
+    // the arch aspace is only destroyed once the aspace leaves the list
+    for (auto& a : aspaces) {
+        if (!a.is_user()) {
+            continue;
+        }
+        zx_status_t status = a.arch_aspace().HarvestAccessed(a.base(), a.size() / PAGE_SIZE,
+                                                             accessed_fn, context);
+        if (status == ZX_ERR_NOT_SUPPORTED) {
+            return;
+        }
+    }
+}
+
 VmAspace* VmAspace::vaddr_to_aspace(uintptr_t address) {
     if (is_kernel_address(address)) {
         return kernel_aspace();
@@ -611,6 +644,13 @@ size_t VmAspace::AllocatedPages() const {
     return root_vmar_->AllocatedPagesLocked();
 }
 
+uint64_t VmAspace::page_faults() const {
+    canary_.Assert();
+
+    Guard<fbl::Mutex> guard{&lock_};
+    return page_faults_;
+}
+
 void VmAspace::InitializeAslr() {
     aslr_enabled_ = is_user() && !cmdline_get_bool("aslr.disable", false);
 
@@ -9,9 +9,11 @@
 #include "vm_priv.h"
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
 #include <inttypes.h>
+#include <lib/counters.h>
 #include <trace.h>
 #include <vm/fault.h>
 #include <vm/vm.h>
@@ -21,6 +23,19 @@
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+KCOUNTER(vm_fault_around_pages, "kernel.vm.fault.around_pages");
+KCOUNTER(vm_large_page_mappings, "kernel.vm.large_page.mappings");
+
+namespace {
+
+// log2 of the fault-around window, in pages, for mappings that did not pick one
+constexpr uint kDefaultFaultAroundShift = 4;
+
+// most pages handed to the arch aspace in one Map() call while faulting around
+constexpr size_t kFaultAroundBatch = 16;
+
+} // namespace
+
 VmMapping::VmMapping(VmAddressRegion& parent, vaddr_t base, size_t size, uint32_t vmar_flags,
                      fbl::RefPtr<VmObject> vmo, uint64_t vmo_offset, uint arch_mmu_flags)
     : VmAddressRegionOrMapping(base, size, vmar_flags,
@@ -506,11 +521,25 @@ zx_status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
         uint64_t vmo_offset = object_offset_ + o;
 
         zx_status_t status;
+
+        // map whole large page blocks directly, skipping past the rest of the block
+        if (IS_ALIGNED(base_ + o, LARGE_PAGE_SIZE) && offset + len - o >= LARGE_PAGE_SIZE) {
+            status = coalescer.Flush();
+            if (status != ZX_OK) {
+                return status;
+            }
+            if (MapLargePageLocked(base_ + o, commit)) {
+                o += LARGE_PAGE_SIZE - PAGE_SIZE;
+                continue;
+            }
+        }
+
         paddr_t pa;
         status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, nullptr, &pa);
         if (status != ZX_OK) {
-            // no page to map
-            if (commit) {
+            // no page to map. pages a page source hasn't supplied yet are left to be
+            // faulted in, even when committing
+            if (commit && status != ZX_ERR_SHOULD_WAIT) {
                 // fail when we can't commit every requested page
                 coalescer.Abort();
                 return status;
@@ -596,7 +625,7 @@ zx_status_t VmMapping::DestroyLocked() {
     return ZX_OK;
 }
 
-zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
+zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags, PageRequest* page_request) {
     canary_.Assert();
     DEBUG_ASSERT(aspace_->lock()->lock().IsHeld());
 
@@ -643,10 +672,24 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
     currently_faulting_ = true;
     auto ac = fbl::MakeAutoCall([&]() { currently_faulting_ = false; });
 
+    // if the page is part of a large page the object owns, map the whole block at once.
+    // only writes back an empty block with a new large page, reads of it still get the
+    // zero page.
+    if (MapLargePageLocked(va, pf_flags & VMM_PF_FLAG_WRITE)) {
+        return ZX_OK;
+    }
+
     // fault in or grab an existing page
     paddr_t new_pa;
     vm_page_t* page;
     zx_status_t status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, &page, &new_pa);
+    if (status == ZX_ERR_SHOULD_WAIT) {
+        // the page has to come from a page source first
+        if (!page_request) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        return object_->RequestPageLocked(vmo_offset, page_request);
+    }
     if (status != ZX_OK) {
         // TODO(cpu): This trace was originally TRACEF() always on, but it fires if the
         // VMO was resized, rather than just when the system is running out of memory.
@@ -740,9 +783,158 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
         arch_sync_cache_range(va, PAGE_SIZE);
     }
 #endif
+
+    // like the page cache read-around in other kernels, only read faults pull in their
+    // neighbours. a write fault is usually the first of a run of write faults, each of
+    // which would have to replace a read-only neighbour again.
+    if (!(pf_flags & VMM_PF_FLAG_WRITE)) {
+        FaultAroundLocked(va, pf_flags);
+    }
     return ZX_OK;
 }
 
+bool VmMapping::MapLargePageLocked(vaddr_t va, bool commit) TA_NO_THREAD_SAFETY_ANALYSIS {
+    if (!vm_large_pages_enabled() || size_ < LARGE_PAGE_SIZE ||
+        !(arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_RWX_MASK)) {
+        return false;
+    }
+
+    const vaddr_t block = ROUNDDOWN(va, LARGE_PAGE_SIZE);
+    if (block < base_ || block - base_ > size_ - LARGE_PAGE_SIZE) {
+        return false;
+    }
+    const uint64_t block_offset = block - base_ + object_offset_;
+    if (!IS_ALIGNED(block_offset, LARGE_PAGE_SIZE)) {
+        return false;
+    }
+
+    // committing tries to unmap the block from every mapping but this one, which is
+    // taken care of below
+    if (commit) {
+        object_->CommitLargePageLocked(block_offset);
+    }
+
+    paddr_t pa;
+    if (object_->GetLargePageLocked(block_offset, &pa) != ZX_OK) {
+        return false;
+    }
+
+    // another thread may have beaten us to it
+    ArchVmAspace& arch_aspace = aspace_->arch_aspace();
+    if (arch_aspace.LargePageBytes(block, LARGE_PAGE_COUNT) == LARGE_PAGE_SIZE) {
+        return true;
+    }
+
+    // the pages belong to the object, so unlike the single page path there is no
+    // copy-on-write or zero page to protect and the block gets the full permissions
+    zx_status_t status = arch_aspace.Unmap(block, LARGE_PAGE_COUNT, nullptr);
+    if (status != ZX_OK) {
+        TRACEF("failed to unmap small pages before mapping large page\n");
+        return false;
+    }
+
+    size_t mapped;
+    status = arch_aspace.MapContiguous(block, pa, LARGE_PAGE_COUNT, arch_mmu_flags_, &mapped);
+    if (status != ZX_OK) {
+        // the pages will be mapped individually as they fault
+        TRACEF("failed to map large page at va %#" PRIxPTR "\n", block);
+        return false;
+    }
+    DEBUG_ASSERT(mapped == LARGE_PAGE_COUNT);
+
+    kcounter_add(vm_large_page_mappings, 1);
+    LTRACEF("mapped large page pa %#" PRIxPTR " at va %#" PRIxPTR "\n", pa, block);
+    return true;
+}
+
+size_t VmMapping::fault_around_pages() const {
+    uint32_t field = (flags_ & VMAR_FLAG_FAULT_AROUND_MASK) >> VMAR_FLAG_FAULT_AROUND_SHIFT;
+    uint shift = (field != 0) ? field - 1 : kDefaultFaultAroundShift;
+    return 1ul << shift;
+}
+
+void VmMapping::FaultAroundLocked(vaddr_t va, uint pf_flags) TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(!(pf_flags & VMM_PF_FLAG_WRITE));
+
+    const size_t window = fault_around_pages() * PAGE_SIZE;
+    if (window <= PAGE_SIZE) {
+        return;
+    }
+
+    // clip the aligned window around the fault to the mapping
+    const vaddr_t window_base = ROUNDDOWN(va, window);
+    const vaddr_t start = fbl::max(window_base, base_);
+    const vaddr_t last = fbl::min(window_base + (window - 1), base_ + (size_ - 1));
+    const size_t num_pages = (last - start) / PAGE_SIZE + 1;
+
+    // neighbours get the same read-only permissions as the page that faulted
+    const uint mmu_flags = arch_mmu_flags_ & ~ARCH_MMU_FLAG_PERM_WRITE;
+
+    paddr_t batch[kFaultAroundBatch];
+    size_t batch_count = 0;
+    vaddr_t batch_base = 0;
+
+    auto flush = [&]() {
+        if (batch_count == 0) {
+            return;
+        }
+        size_t mapped;
+        zx_status_t status = aspace_->arch_aspace().Map(batch_base, batch, batch_count,
+                                                        mmu_flags, &mapped);
+        if (status != ZX_OK) {
+            // fault-around is only an optimization, the pages will fault on their own
+            LTRACEF("failed to map %zu pages at %#" PRIxPTR ": %d\n",
+                    batch_count, batch_base, status);
+        } else {
+            kcounter_add(vm_fault_around_pages, mapped);
+#if ARCH_ARM64
+            if (!(pf_flags & VMM_PF_FLAG_GUEST) && (mmu_flags & ARCH_MMU_FLAG_PERM_EXECUTE)) {
+                arch_sync_cache_range(batch_base, batch_count * PAGE_SIZE);
+            }
+#endif
+        }
+        batch_count = 0;
+    };
+
+    for (size_t i = 0; i < num_pages; i++) {
+        const vaddr_t addr = start + i * PAGE_SIZE;
+        if (addr == va) {
+            flush();
+            continue;
+        }
+
+        // leave anything that is already mapped alone
+        paddr_t pa;
+        uint page_flags;
+        if (aspace_->arch_aspace().Query(addr, &pa, &page_flags) == ZX_OK) {
+            flush();
+            continue;
+        }
+
+        // a read lookup only allocates to decompress a page: it returns a page the
+        // object or one of its ancestors already has, or the zero page
+        const uint64_t vmo_offset = addr - base_ + object_offset_;
+        zx_status_t status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, nullptr, &pa);
+        if (status != ZX_OK) {
+            flush();
+            if (status == ZX_ERR_OUT_OF_RANGE) {
+                // past the end of the vmo
+                break;
+            }
+            continue;
+        }
+
+        if (batch_count == 0) {
+            batch_base = addr;
+        }
+        batch[batch_count++] = pa;
+        if (batch_count == kFaultAroundBatch) {
+            flush();
+        }
+    }
+    flush();
+}
+
 // We disable thread safety analysis here because one of the common uses of this
 // function is for splitting one mapping object into several that will be backed
 // by the same VmObject.  In that case, object_->lock() gets aliased across all
@@ -27,6 +27,7 @@
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
 VmObject::GlobalList VmObject::all_vmos_ = {};
+VmObject* VmObject::resume_vmo_ = nullptr;
 
 VmObject::VmObject(fbl::RefPtr<VmObject> parent)
     : lock_(parent ? parent->lock_ref() : local_lock_),
@@ -67,6 +68,10 @@ VmObject::~VmObject() {
     {
         Guard<fbl::Mutex> guard{AllVmosLock::Get()};
         DEBUG_ASSERT(global_list_state_.InContainer() == true);
+        if (resume_vmo_ == this) {
+            auto next = ++all_vmos_.make_iterator(*this);
+            resume_vmo_ = next.IsValid() ? &*next : nullptr;
+        }
         all_vmos_.erase(*this);
     }
 }
@@ -12,9 +12,12 @@
 #include <assert.h>
 #include <err.h>
 #include <fbl/alloc_checker.h>
+#include <fbl/atomic.h>
 #include <fbl/auto_call.h>
+#include <fbl/unique_ptr.h>
 #include <inttypes.h>
 #include <lib/console.h>
+#include <lib/counters.h>
 #include <stdlib.h>
 #include <string.h>
 #include <trace.h>
@@ -26,8 +29,18 @@
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+KCOUNTER(vm_large_page_commits, "kernel.vm.large_page.commits");
+KCOUNTER(vm_large_page_failures, "kernel.vm.large_page.failures");
+KCOUNTER(vm_compressed_pages, "kernel.vm.compression.compressed");
+KCOUNTER(vm_decompressed_pages, "kernel.vm.compression.decompressed");
+
 namespace {
 
+// after a failed contiguous allocation, this many large page commits are skipped
+// before trying again, so a fragmented pmm isn't searched on every fault
+constexpr uint32_t kLargePageBackoff = 64;
+fbl::atomic<uint32_t> large_page_backoff{0};
+
 void ZeroPage(paddr_t pa) {
     void* ptr = paddr_to_physmap(pa);
     DEBUG_ASSERT(ptr);
@@ -44,6 +57,19 @@ void InitializeVmPage(vm_page_t* p) {
     DEBUG_ASSERT(p->state == VM_PAGE_STATE_ALLOC);
     p->state = VM_PAGE_STATE_OBJECT;
     p->object.pin_count = 0;
+    p->object.age = 0;
+}
+
+bool IsZeroPage(const vm_page_t* p) {
+    const uint64_t* words = static_cast<const uint64_t*>(paddr_to_physmap(p->paddr()));
+    DEBUG_ASSERT(words);
+
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(*words); i++) {
+        if (words[i] != 0) {
+            return false;
+        }
+    }
+    return true;
 }
 
 // round up the size to the next page size boundary and make sure we dont wrap
@@ -64,11 +90,13 @@ zx_status_t RoundSize(uint64_t size, uint64_t* out_size) {
 } // namespace
 
 VmObjectPaged::VmObjectPaged(
-    uint32_t options, uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject> parent)
+    uint32_t options, uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject> parent,
+    fbl::RefPtr<PageSource> page_source)
     : VmObject(fbl::move(parent)),
       options_(options),
       size_(size),
-      pmm_alloc_flags_(pmm_alloc_flags) {
+      pmm_alloc_flags_(pmm_alloc_flags),
+      page_source_(fbl::move(page_source)) {
     LTRACEF("%p\n", this);
 
     DEBUG_ASSERT(IS_PAGE_ALIGNED(size_));
@@ -90,6 +118,15 @@ VmObjectPaged::~VmObjectPaged() {
 
     // free all of the pages attached to us
     page_list_.FreeAllPages();
+
+    // and any held compressed
+    while (auto cpage = compressed_pages_.pop_front()) {
+        VmCompressedStore::Get()->Free(cpage.get());
+    }
+
+    if (page_source_) {
+        page_source_->Detach();
+    }
 }
 
 zx_status_t VmObjectPaged::Create(uint32_t pmm_alloc_flags,
@@ -108,7 +145,7 @@ zx_status_t VmObjectPaged::Create(uint32_t pmm_alloc_flags,
 
     fbl::AllocChecker ac;
     auto vmo = fbl::AdoptRef<VmObject>(
-        new (&ac) VmObjectPaged(options, pmm_alloc_flags, size, nullptr));
+        new (&ac) VmObjectPaged(options, pmm_alloc_flags, size, nullptr, nullptr));
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
@@ -129,7 +166,7 @@ zx_status_t VmObjectPaged::CreateContiguous(uint32_t pmm_alloc_flags, uint64_t s
 
     fbl::AllocChecker ac;
     auto vmo = fbl::AdoptRef<VmObject>(
-        new (&ac) VmObjectPaged(kContiguous, pmm_alloc_flags, size, nullptr));
+        new (&ac) VmObjectPaged(kContiguous, pmm_alloc_flags, size, nullptr, nullptr));
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
@@ -235,6 +272,26 @@ zx_status_t VmObjectPaged::CreateFromROData(const void* data, size_t size, fbl::
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::CreateExternal(fbl::RefPtr<PageSource> src, uint64_t size,
+                                          fbl::RefPtr<VmObject>* obj) {
+    // make sure size is page aligned
+    zx_status_t status = RoundSize(size, &size);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    fbl::AllocChecker ac;
+    auto vmo = fbl::AdoptRef<VmObject>(
+        new (&ac) VmObjectPaged(0u, PMM_ALLOC_FLAG_ANY, size, nullptr, fbl::move(src)));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    *obj = fbl::move(vmo);
+
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::CloneCOW(bool resizable, uint64_t offset, uint64_t size,
                                     bool copy_name, fbl::RefPtr<VmObject>* clone_vmo) {
     LTRACEF("vmo %p offset %#" PRIx64 " size %#" PRIx64 "\n", this, offset, size);
@@ -252,7 +309,8 @@ zx_status_t VmObjectPaged::CloneCOW(bool resizable, uint64_t offset, uint64_t si
     // allocate the clone up front outside of our lock
     fbl::AllocChecker ac;
     auto vmo = fbl::AdoptRef<VmObjectPaged>(
-        new (&ac) VmObjectPaged(options, pmm_alloc_flags_, size, fbl::WrapRefPtr(this)));
+        new (&ac) VmObjectPaged(options, pmm_alloc_flags_, size, fbl::WrapRefPtr(this),
+                                nullptr));
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
@@ -372,6 +430,9 @@ zx_status_t VmObjectPaged::AddPageLocked(vm_page_t* p, uint64_t offset) {
 // this function may allocate from.  This function will need at most one entry,
 // and will not fail if |free_list| is a non-empty list, faulting in was requested,
 // and offset is in range.
+//
+// If the page has to be supplied by the page source of this VMO or of an ancestor, returns
+// ZX_ERR_SHOULD_WAIT whatever |pf_flags| are; see RequestPageLocked().
 zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
                                          vm_page_t** const page_out, paddr_t* const pa_out) {
     canary_.Assert();
@@ -387,6 +448,7 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     // see if we already have a page at that offset
     p = page_list_.GetPage(offset);
     if (p) {
+        p->object.age = 0;
         if (page_out) {
             *page_out = p;
         }
@@ -396,6 +458,22 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         return ZX_OK;
     }
 
+    // a page moved to the compressed store is still ours, whatever the fault flags
+    if (!compressed_pages_.is_empty()) {
+        zx_status_t status = DecompressPageLocked(offset, free_list, &p);
+        if (status != ZX_ERR_NOT_FOUND) {
+            if (status == ZX_OK) {
+                if (page_out) {
+                    *page_out = p;
+                }
+                if (pa_out) {
+                    *pa_out = p->paddr();
+                }
+            }
+            return status;
+        }
+    }
+
     __UNUSED char pf_string[5];
     LTRACEF("vmo %p, offset %#" PRIx64 ", pf_flags %#x (%s)\n", this, offset, pf_flags,
             vmm_pf_flags_to_string(pf_flags, pf_string));
@@ -411,6 +489,10 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
 
         zx_status_t status = parent_->GetPageLocked(parent_offset, parent_pf_flags,
                                                     nullptr, &p, &pa);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            // the parent's page source hasn't supplied it yet
+            return status;
+        }
         if (status == ZX_OK) {
             // we have a page from them. if we're read-only faulting, return that page so they can map
             // or read from it directly
@@ -471,6 +553,11 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         }
     }
 
+    // a page source has to supply the page first, however it was asked for
+    if (page_source_) {
+        return ZX_ERR_SHOULD_WAIT;
+    }
+
     // if we're not being asked to sw or hw fault in the page, return not found
     if ((pf_flags & VMM_PF_FLAG_FAULT_MASK) == 0) {
         return ZX_ERR_NOT_FOUND;
@@ -489,7 +576,8 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         return ZX_OK;
     }
 
-    // allocate a page
+    // allocate a zeroed page, either from the caller's list which only holds zeroed pages,
+    // or from the pmm's pre-zeroed pool
     if (free_list) {
         p = list_remove_head_type(free_list, vm_page, queue_node);
         if (p) {
@@ -497,7 +585,7 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         }
     }
     if (!p) {
-        pmm_alloc_page(pmm_alloc_flags_, &p, &pa);
+        pmm_alloc_page(pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED, &p, &pa);
     }
     if (!p) {
         return ZX_ERR_NO_MEMORY;
@@ -505,9 +593,6 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
 
     InitializeVmPage(p);
 
-    // TODO: remove once pmm returns zeroed pages
-    ZeroPage(pa);
-
 // if ARM and not fully cached, clean/invalidate the page after zeroing it
 #if ARCH_ARM64
     if (cache_policy_ != ARCH_MMU_FLAG_CACHED) {
@@ -533,12 +618,171 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::RequestPageLocked(uint64_t offset, PageRequest* request) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.lock().IsHeld());
+
+    if (offset >= size_) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    offset = ROUNDDOWN(offset, PAGE_SIZE);
+
+    // follow the lookup GetPageLocked() made to the object with the page source
+    DEBUG_ASSERT(!HasPageLocked(offset));
+    if (parent_) {
+        uint64_t parent_offset;
+        bool overflowed = add_overflow(parent_offset_, offset, &parent_offset);
+        ASSERT(!overflowed);
+        return parent_->RequestPageLocked(parent_offset, request);
+    }
+    if (!page_source_) {
+        return ZX_ERR_BAD_STATE;
+    }
+    return page_source_->AddRequest(offset, PAGE_SIZE, request);
+}
+
+bool VmObjectPaged::HasPageLocked(uint64_t offset) {
+    return page_list_.GetPage(offset) || compressed_pages_.find(offset).IsValid();
+}
+
+zx_status_t VmObjectPaged::CommitLargePageLocked(uint64_t offset) {
+    canary_.Assert();
+    DEBUG_ASSERT(IS_ALIGNED(offset, LARGE_PAGE_SIZE));
+
+    // clones would have to copy from their parent, pages of a page source come one at a
+    // time, and contiguous vmos are already committed
+    if (!vm_large_pages_enabled() || parent_ || page_source_ || (options_ & kContiguous) ||
+        cache_policy_ != ARCH_MMU_FLAG_CACHED) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (offset >= size_ || size_ - offset < LARGE_PAGE_SIZE) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // only take over blocks that are completely empty
+    bool empty = true;
+    page_list_.ForEveryPageInRange(
+        [&empty](const auto p, uint64_t off) {
+            empty = false;
+            return ZX_ERR_STOP;
+        },
+        offset, offset + LARGE_PAGE_SIZE);
+    auto compressed = compressed_pages_.lower_bound(offset);
+    if (!empty || (compressed.IsValid() && compressed->offset() < offset + LARGE_PAGE_SIZE)) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    uint32_t backoff = large_page_backoff.load(fbl::memory_order_relaxed);
+    if (backoff > 0) {
+        large_page_backoff.compare_exchange_strong(&backoff, backoff - 1,
+                                                   fbl::memory_order_relaxed,
+                                                   fbl::memory_order_relaxed);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    list_node page_list = LIST_INITIAL_VALUE(page_list);
+    paddr_t pa;
+    zx_status_t status = pmm_alloc_contiguous(LARGE_PAGE_COUNT, pmm_alloc_flags_,
+                                              LARGE_PAGE_SIZE_SHIFT, &pa, &page_list);
+    if (status != ZX_OK) {
+        kcounter_add(vm_large_page_failures, 1);
+        large_page_backoff.store(kLargePageBackoff, fbl::memory_order_relaxed);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // contiguous runs don't come from the pre-zeroed pool
+    memset(paddr_to_physmap(pa), 0, LARGE_PAGE_SIZE);
+
+    // the run is handed back in physical address order
+    uint64_t o = offset;
+    vm_page_t* p;
+    while ((p = list_remove_head_type(&page_list, vm_page, queue_node))) {
+        DEBUG_ASSERT(p->paddr() == pa + (o - offset));
+        InitializeVmPage(p);
+        status = AddPageLocked(p, o);
+        DEBUG_ASSERT(status == ZX_OK);
+        o += PAGE_SIZE;
+    }
+
+    // other mappings may have covered this block with the zero page, so unmap those ranges
+    RangeChangeUpdateLocked(offset, LARGE_PAGE_SIZE);
+
+    kcounter_add(vm_large_page_commits, 1);
+    LTRACEF("committed large page at offset %#" PRIx64 ", pa %#" PRIxPTR "\n", offset, pa);
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::GetLargePageLocked(uint64_t offset, paddr_t* pa) {
+    canary_.Assert();
+    DEBUG_ASSERT(IS_ALIGNED(offset, LARGE_PAGE_SIZE));
+
+    if (offset >= size_ || size_ - offset < LARGE_PAGE_SIZE) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    // quickly reject blocks whose first page can't start a large page
+    vm_page_t* first = page_list_.GetPage(offset);
+    if (!first || !IS_ALIGNED(first->paddr(), LARGE_PAGE_SIZE)) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    const paddr_t base = first->paddr();
+    size_t count = 0;
+    page_list_.ForEveryPageInRange(
+        [base, offset, &count](const auto p, uint64_t off) {
+            if (p->paddr() - base != off - offset) {
+                return ZX_ERR_STOP;
+            }
+            count++;
+            return ZX_ERR_NEXT;
+        },
+        offset, offset + LARGE_PAGE_SIZE);
+    if (count != LARGE_PAGE_COUNT) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    *pa = base;
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len) {
+    return CommitRangeInternal(offset, len, false);
+}
+
+zx_status_t VmObjectPaged::CommitRangePinned(uint64_t offset, uint64_t len) {
+    return CommitRangeInternal(offset, len, true);
+}
+
+zx_status_t VmObjectPaged::CommitRangeInternal(uint64_t offset, uint64_t len, bool pin) {
     canary_.Assert();
-    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 ", pin %d\n", offset, len, pin);
 
     Guard<fbl::Mutex> guard{&lock_};
 
+    for (;;) {
+        PageRequest page_request;
+        zx_status_t status = CommitRangeLocked(offset, len, &page_request);
+        if (status == ZX_OK && pin) {
+            // the scanner could reclaim, discard or compress the pages as soon as the
+            // lock is dropped, so they have to be pinned before that
+            return PinLocked(offset, len);
+        }
+        if (status != ZX_ERR_SHOULD_WAIT) {
+            return status;
+        }
+        guard.CallUnlocked([&page_request, &status]() { status = page_request.Wait(); });
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+}
+
+zx_status_t VmObjectPaged::CommitRangeLocked(uint64_t offset, uint64_t len,
+                                             PageRequest* page_request) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.lock().IsHeld());
+
     // trim the size
     uint64_t new_len;
     if (!TrimRange(offset, len, size_, &new_len)) {
@@ -555,6 +799,30 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len) {
     DEBUG_ASSERT(end > offset);
     offset = ROUNDDOWN(offset, PAGE_SIZE);
 
+    // ask the page source for the first run of pages we don't have, and wait for them.
+    // once it has supplied them all, only compressed pages are left to commit
+    if (page_source_) {
+        uint64_t start = offset;
+        while (start < end && HasPageLocked(start)) {
+            start += PAGE_SIZE;
+        }
+        if (start < end) {
+            uint64_t run_end = start + PAGE_SIZE;
+            while (run_end < end && !HasPageLocked(run_end)) {
+                run_end += PAGE_SIZE;
+            }
+            return page_source_->AddRequest(start, run_end - start, page_request);
+        }
+    }
+
+    // commit any empty large page blocks that the range fully covers in one go
+    for (uint64_t o = ROUNDUP(offset, LARGE_PAGE_SIZE);
+         o >= offset && o < end && end - o >= LARGE_PAGE_SIZE; o += LARGE_PAGE_SIZE) {
+        if (CommitLargePageLocked(o) == ZX_ERR_NO_MEMORY) {
+            break;
+        }
+    }
+
     // make a pass through the list, counting the number of pages we need to allocate
     size_t count = 0;
     uint64_t expected_next_off = offset;
@@ -579,7 +847,9 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len) {
     list_node page_list;
     list_initialize(&page_list);
 
-    zx_status_t status = pmm_alloc_pages(count, pmm_alloc_flags_, &page_list);
+    // GetPageLocked() expects the pages it is handed to be zeroed already
+    zx_status_t status = pmm_alloc_pages(count, pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED,
+                                         &page_list);
     if (status != ZX_OK) {
         return status;
     }
@@ -599,8 +869,13 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len) {
         paddr_t pa;
         const uint flags = VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE;
         // Should not be able to fail, since we're providing it memory and the
-        // range should be valid.
+        // range should be valid, unless the page has to come from a page source
+        // of one of our ancestors.
         zx_status_t status = GetPageLocked(o, flags, &page_list, &p, &pa);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            pmm_free(&page_list);
+            return RequestPageLocked(o, page_request);
+        }
         ASSERT(status == ZX_OK);
     }
 
@@ -650,6 +925,8 @@ zx_status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len) {
     // unmap all of the pages in this range on all the mapping regions
     RangeChangeUpdateLocked(start, page_aligned_len);
 
+    FreeCompressedPagesLocked(start, end);
+
     // iterate through the pages, freeing them
     // TODO: use page_list iterator, move pages to list, free at once
     while (start < end) {
@@ -773,6 +1050,376 @@ bool VmObjectPaged::AnyPagesPinnedLocked(uint64_t offset, size_t len) {
     return found_pinned;
 }
 
+bool VmObjectPaged::IsMappedOutsideUserLocked() const {
+    for (const auto& m : mapping_list_) {
+        if (!m.aspace()->is_user()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+zx_status_t VmObjectPaged::LockRange(uint64_t offset, uint64_t len, bool* discarded) {
+    canary_.Assert();
+
+    Guard<fbl::Mutex> guard{&lock_};
+    if (offset != 0 || len != size_) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    *discarded = discarded_;
+    discardable_ = false;
+    discarded_ = false;
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::UnlockRange(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+
+    if (options_ & kContiguous) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    Guard<fbl::Mutex> guard{&lock_};
+    // discarding a clone's pages would expose its parent's rather than zeros,
+    // and discarding a parent's would take them out from under its clones
+    if (parent_ || children_list_len_ > 0) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (offset != 0 || len != size_) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    discardable_ = true;
+    return ZX_OK;
+}
+
+void VmObjectPaged::AgePages() {
+    canary_.Assert();
+
+    Guard<fbl::Mutex> guard{&lock_};
+    page_list_.ForEveryPage([](auto p, uint64_t) {
+        if (p->object.age < VM_PAGE_OBJECT_MAX_AGE) {
+            p->object.age++;
+        }
+        return ZX_ERR_NEXT;
+    });
+}
+
+size_t VmObjectPaged::DiscardPages() {
+    canary_.Assert();
+
+    Guard<fbl::Mutex> guard{&lock_};
+    // the vmo may have been cloned since it was unlocked
+    if (!discardable_ || children_list_len_ > 0 || AnyPagesPinnedLocked(0, size_)) {
+        return 0;
+    }
+
+    // unmap everything, then free all of the pages at once
+    RangeChangeUpdateLocked(0, size_);
+    size_t freed = page_list_.FreeAllPages();
+    if (freed > 0 || !compressed_pages_.is_empty()) {
+        discarded_ = true;
+    }
+    FreeCompressedPagesLocked(0, size_);
+
+    LTRACEF("vmo %p discarded %zu pages\n", this, freed);
+    return freed;
+}
+
+size_t VmObjectPaged::ReclaimZeroPages(size_t max_pages, uint8_t min_age, size_t* max_scan) {
+    canary_.Assert();
+
+    if (options_ & kContiguous) {
+        return 0;
+    }
+
+    Guard<fbl::Mutex> guard{&lock_};
+
+    // a missing page reads as zeros only if there is no parent to read through
+    // to or page source to supply it, and only user mappings are expected to
+    // fault pages back in
+    if (parent_ || page_source_ || cache_policy_ != ARCH_MMU_FLAG_CACHED ||
+        IsMappedOutsideUserLocked()) {
+        return 0;
+    }
+
+    list_node freed_list = LIST_INITIAL_VALUE(freed_list);
+    size_t freed = 0;
+
+    // the page list can't change while it is walked, so find candidates a batch
+    // at a time and free them between walks
+    static constexpr size_t kBatchSize = 16;
+    uint64_t start = (max_scan && zero_scan_offset_ < size_) ? zero_scan_offset_ : 0;
+    while (freed < max_pages && start < size_ && (!max_scan || *max_scan > 0)) {
+        uint64_t candidates[kBatchSize];
+        size_t count = 0;
+        uint64_t next = size_;
+        page_list_.ForEveryPageInRange(
+            [&](const auto p, uint64_t off) {
+                if (max_scan) {
+                    if (*max_scan == 0) {
+                        next = off;
+                        return ZX_ERR_STOP;
+                    }
+                    (*max_scan)--;
+                }
+                if (p->object.pin_count == 0 && p->object.age >= min_age && IsZeroPage(p)) {
+                    candidates[count++] = off;
+                    if (count == kBatchSize) {
+                        next = off + PAGE_SIZE;
+                        return ZX_ERR_STOP;
+                    }
+                }
+                return ZX_ERR_NEXT;
+            },
+            start, size_);
+
+        for (size_t i = 0; i < count && freed < max_pages; i++) {
+            // the page may have been written through a mapping since it was
+            // checked, so check again once nothing maps it
+            RangeChangeUpdateLocked(candidates[i], PAGE_SIZE);
+            vm_page_t* p = page_list_.GetPage(candidates[i]);
+            if (!IsZeroPage(p)) {
+                continue;
+            }
+            page_list_.RemovePage(candidates[i]);
+            list_add_tail(&freed_list, &p->queue_node);
+            freed++;
+        }
+        start = next;
+    }
+    if (max_scan) {
+        zero_scan_offset_ = start < size_ ? start : 0;
+    }
+
+    pmm_free(&freed_list);
+    reclaimed_zero_pages_ += freed;
+
+    LTRACEF("vmo %p reclaimed %zu zero pages\n", this, freed);
+    return freed;
+}
+
+uint64_t VmObjectPaged::ReclaimedZeroPages() const {
+    canary_.Assert();
+    Guard<fbl::Mutex> guard{&lock_};
+    return reclaimed_zero_pages_;
+}
+
+size_t VmObjectPaged::CompressPages(size_t max_pages, uint8_t min_age) {
+    canary_.Assert();
+
+    if (options_ & kContiguous) {
+        return 0;
+    }
+
+    Guard<fbl::Mutex> guard{&lock_};
+
+    // kernel mappings may not expect to fault
+    if (cache_policy_ != ARCH_MMU_FLAG_CACHED || IsMappedOutsideUserLocked()) {
+        return 0;
+    }
+
+    VmCompressedStore* store = VmCompressedStore::Get();
+    list_node freed_list = LIST_INITIAL_VALUE(freed_list);
+    size_t freed = 0;
+
+    static constexpr size_t kBatchSize = 16;
+    uint64_t start = 0;
+    while (freed < max_pages && start < size_) {
+        uint64_t candidates[kBatchSize];
+        size_t count = 0;
+        uint64_t next = size_;
+        page_list_.ForEveryPageInRange(
+            [&](const auto p, uint64_t off) {
+                if (p->object.pin_count == 0 && p->object.age >= min_age) {
+                    candidates[count++] = off;
+                    if (count == kBatchSize) {
+                        next = off + PAGE_SIZE;
+                        return ZX_ERR_STOP;
+                    }
+                }
+                return ZX_ERR_NEXT;
+            },
+            start, size_);
+
+        for (size_t i = 0; i < count && freed < max_pages; i++) {
+            fbl::AllocChecker ac;
+            fbl::unique_ptr<VmCompressedPage> cpage(new (&ac) VmCompressedPage(candidates[i]));
+            if (!ac.check()) {
+                next = size_;
+                break;
+            }
+
+            // nothing may write to the page once its contents are compressed
+            RangeChangeUpdateLocked(candidates[i], PAGE_SIZE);
+            vm_page_t* p = page_list_.GetPage(candidates[i]);
+            zx_status_t status = store->Compress(paddr_to_physmap(p->paddr()), cpage.get());
+            if (status == ZX_ERR_BUFFER_TOO_SMALL) {
+                // don't try again until it has gone unused for another while
+                p->object.age = 0;
+                continue;
+            }
+            if (status != ZX_OK) {
+                next = size_;
+                break;
+            }
+
+            page_list_.RemovePage(candidates[i]);
+            compressed_pages_.insert(fbl::move(cpage));
+            list_add_tail(&freed_list, &p->queue_node);
+            freed++;
+        }
+        start = next;
+    }
+
+    pmm_free(&freed_list);
+    kcounter_add(vm_compressed_pages, static_cast<int64_t>(freed));
+
+    LTRACEF("vmo %p compressed %zu pages\n", this, freed);
+    return freed;
+}
+
+zx_status_t VmObjectPaged::DecompressPageLocked(uint64_t offset, list_node* free_list,
+                                                vm_page_t** page_out) {
+    auto iter = compressed_pages_.find(offset);
+    if (!iter.IsValid()) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    vm_page_t* p = nullptr;
+    paddr_t pa;
+    if (free_list) {
+        p = list_remove_head_type(free_list, vm_page, queue_node);
+        if (p) {
+            pa = p->paddr();
+        }
+    }
+    if (!p) {
+        pmm_alloc_page(pmm_alloc_flags_, &p, &pa);
+    }
+    if (!p) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    zx_status_t status = VmCompressedStore::Get()->Decompress(*iter, paddr_to_physmap(pa));
+    if (status != ZX_OK) {
+        // the caller's list only holds zeroed pages
+        pmm_free_page(p);
+        return status;
+    }
+
+    InitializeVmPage(p);
+    status = AddPageLocked(p, offset);
+    DEBUG_ASSERT(status == ZX_OK);
+
+    auto cpage = compressed_pages_.erase(iter);
+    VmCompressedStore::Get()->Free(cpage.get());
+    kcounter_add(vm_decompressed_pages, 1);
+
+    LTRACEF("decompressed page %p, pa %#" PRIxPTR " at offset %#" PRIx64 "\n", p, pa, offset);
+
+    *page_out = p;
+    return ZX_OK;
+}
+
+void VmObjectPaged::FreeCompressedPagesLocked(uint64_t start, uint64_t end) {
+    auto iter = compressed_pages_.lower_bound(start);
+    while (iter.IsValid() && iter->offset() < end) {
+        auto cpage = compressed_pages_.erase(iter++);
+        VmCompressedStore::Get()->Free(cpage.get());
+    }
+}
+
+zx_status_t VmObjectPaged::TakePages(uint64_t offset, uint64_t len, list_node* pages) {
+    canary_.Assert();
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
+
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(len)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (options_ & kContiguous) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    Guard<fbl::Mutex> guard{&lock_};
+
+    if (!InRange(offset, len, size_)) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    // only pages that are the object's alone can be given away: a clone shares
+    // its parent's and the pages of a page source may be asked for again, and
+    // children would see the pages vanish
+    if (parent_ || page_source_ || children_list_len_ > 0) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (cache_policy_ != ARCH_MMU_FLAG_CACHED || AnyPagesPinnedLocked(offset, len)) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    zx_status_t status = CommitRangeLocked(offset, len, nullptr);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // pages wired into the object by the kernel stay where they are
+    zx_status_t wired = page_list_.ForEveryPageInRange(
+        [](const auto p, uint64_t off) {
+            return p->state == VM_PAGE_STATE_OBJECT ? ZX_ERR_NEXT : ZX_ERR_NOT_SUPPORTED;
+        },
+        offset, offset + len);
+    if (wired != ZX_OK) {
+        return wired;
+    }
+
+    RangeChangeUpdateLocked(offset, len);
+
+    for (uint64_t o = offset; o < offset + len; o += PAGE_SIZE) {
+        vm_page_t* p = page_list_.RemovePage(o);
+        DEBUG_ASSERT(p);
+        list_add_tail(pages, &p->queue_node);
+    }
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::SupplyPages(uint64_t offset, uint64_t len, list_node* pages) {
+    canary_.Assert();
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
+
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(len)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (!page_source_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    Guard<fbl::Mutex> guard{&lock_};
+
+    if (!InRange(offset, len, size_)) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    list_node duplicates = LIST_INITIAL_VALUE(duplicates);
+    for (uint64_t o = offset; o < offset + len; o += PAGE_SIZE) {
+        vm_page_t* p = list_remove_head_type(pages, vm_page_t, queue_node);
+        DEBUG_ASSERT(p && p->state == VM_PAGE_STATE_OBJECT && p->object.pin_count == 0);
+
+        // the page may have been supplied already, and written to since
+        if (HasPageLocked(o)) {
+            list_add_tail(&duplicates, &p->queue_node);
+            continue;
+        }
+        p->object.age = 0;
+        zx_status_t status = AddPageLocked(p, o);
+        DEBUG_ASSERT(status == ZX_OK);
+    }
+    pmm_free(&duplicates);
+
+    page_source_->OnPagesSupplied(offset, len);
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::ResizeLocked(uint64_t s) {
     canary_.Assert();
     DEBUG_ASSERT(lock_.lock().IsHeld());
@@ -808,6 +1455,8 @@ zx_status_t VmObjectPaged::ResizeLocked(uint64_t s) {
         // unmap all of the pages in this range on all the mapping regions
         RangeChangeUpdateLocked(start, len);
 
+        FreeCompressedPagesLocked(start, end);
+
         // iterate through the pages, freeing them
         // TODO: use page_list iterator, move pages to list, free at once
         while (start < end) {
@@ -889,6 +1538,26 @@ zx_status_t VmObjectPaged::ReadWriteInternal(uint64_t offset, size_t len, bool w
         auto status = GetPageLocked(src_offset,
                                     VMM_PF_FLAG_SW_FAULT | (write ? VMM_PF_FLAG_WRITE : 0),
                                     nullptr, nullptr, &pa);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            // wait for the page source without the lock, then look again
+            PageRequest page_request;
+            status = RequestPageLocked(src_offset, &page_request);
+            if (status != ZX_ERR_SHOULD_WAIT) {
+                return status;
+            }
+            guard.CallUnlocked([&page_request, &status]() { status = page_request.Wait(); });
+            if (status != ZX_OK) {
+                return status;
+            }
+            // the object may have changed in the meantime
+            if (cache_policy_ != ARCH_MMU_FLAG_CACHED) {
+                return ZX_ERR_BAD_STATE;
+            }
+            if (end_offset > size_) {
+                return ZX_ERR_OUT_OF_RANGE;
+            }
+            continue;
+        }
         if (status != ZX_OK) {
             return status;
         }
@@ -963,87 +1632,152 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
     const uint64_t start_page_offset = ROUNDDOWN(offset, PAGE_SIZE);
     const uint64_t end_page_offset = ROUNDUP(offset + len, PAGE_SIZE);
 
-    uint64_t expected_next_off = start_page_offset;
-    zx_status_t status = page_list_.ForEveryPageInRange(
-        [&expected_next_off, this, pf_flags, lookup_fn, context,
-         start_page_offset](const auto p, uint64_t off) {
-
-            // If some page was missing from our list, run the more expensive
-            // GetPageLocked to see if our parent has it.
-            for (uint64_t missing_off = expected_next_off; missing_off < off;
-                 missing_off += PAGE_SIZE) {
+    // Looks up a page missing from our list with the more expensive
+    // GetPageLocked, to see if our parent or page source has it.
+    auto lookup_missing = [this, pf_flags, lookup_fn, context,
+                           start_page_offset](uint64_t missing_off) -> zx_status_t {
+        paddr_t pa;
+        zx_status_t status = this->GetPageLocked(missing_off, pf_flags, nullptr, nullptr, &pa);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            return status;
+        }
+        if (status != ZX_OK) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        const size_t index = (missing_off - start_page_offset) / PAGE_SIZE;
+        status = lookup_fn(context, missing_off, index, pa);
+        if (status != ZX_OK) {
+            if (unlikely(status == ZX_ERR_NEXT || status == ZX_ERR_STOP ||
+                         status == ZX_ERR_SHOULD_WAIT)) {
+                status = ZX_ERR_INTERNAL;
+            }
+        }
+        return status;
+    };
 
-                paddr_t pa;
-                zx_status_t status = this->GetPageLocked(missing_off, pf_flags, nullptr,
-                                                         nullptr, &pa);
-                if (status != ZX_OK) {
-                    return ZX_ERR_NO_MEMORY;
+    uint64_t expected_next_off = start_page_offset;
+    for (;;) {
+        zx_status_t status = page_list_.ForEveryPageInRange(
+            [&expected_next_off, &lookup_missing, lookup_fn, context,
+             start_page_offset](const auto p, uint64_t off) {
+                for (; expected_next_off < off; expected_next_off += PAGE_SIZE) {
+                    zx_status_t status = lookup_missing(expected_next_off);
+                    if (status != ZX_OK) {
+                        return status;
+                    }
                 }
+
                 const size_t index = (off - start_page_offset) / PAGE_SIZE;
-                status = lookup_fn(context, missing_off, index, pa);
+                paddr_t pa = p->paddr();
+                zx_status_t status = lookup_fn(context, off, index, pa);
                 if (status != ZX_OK) {
-                    if (unlikely(status == ZX_ERR_NEXT || status == ZX_ERR_STOP)) {
+                    if (unlikely(status == ZX_ERR_NEXT || status == ZX_ERR_STOP ||
+                                 status == ZX_ERR_SHOULD_WAIT)) {
                         status = ZX_ERR_INTERNAL;
                     }
                     return status;
                 }
-            }
 
-            const size_t index = (off - start_page_offset) / PAGE_SIZE;
-            paddr_t pa = p->paddr();
-            zx_status_t status = lookup_fn(context, off, index, pa);
-            if (status != ZX_OK) {
-                if (unlikely(status == ZX_ERR_NEXT || status == ZX_ERR_STOP)) {
-                    status = ZX_ERR_INTERNAL;
-                }
-                return status;
-            }
+                expected_next_off = off + PAGE_SIZE;
+                return ZX_ERR_NEXT;
+            },
+            expected_next_off, end_page_offset);
 
-            expected_next_off = off + PAGE_SIZE;
-            return ZX_ERR_NEXT;
-        },
-        start_page_offset, end_page_offset);
-    if (status != ZX_OK) {
-        return status;
-    }
+        // If expected_next_off isn't at the end, there's a gap to process
+        while (status == ZX_OK && expected_next_off < end_page_offset) {
+            status = lookup_missing(expected_next_off);
+            if (status == ZX_OK) {
+                expected_next_off += PAGE_SIZE;
+            }
+        }
+        if (status != ZX_ERR_SHOULD_WAIT) {
+            return status;
+        }
 
-    // If expected_next_off isn't at the end, there's a gap to process
-    for (uint64_t off = expected_next_off; off < end_page_offset; off += PAGE_SIZE) {
-        paddr_t pa;
-        zx_status_t status = GetPageLocked(off, pf_flags, nullptr, nullptr, &pa);
-        if (status != ZX_OK) {
-            return ZX_ERR_NO_MEMORY;
+        // A page source has yet to supply the page at expected_next_off. Wait
+        // for it without the lock, then carry on from there, as the pages
+        // before it have already been passed to lookup_fn.
+        PageRequest page_request;
+        status = RequestPageLocked(expected_next_off, &page_request);
+        if (status != ZX_ERR_SHOULD_WAIT) {
+            return status;
         }
-        const size_t index = (off - start_page_offset) / PAGE_SIZE;
-        status = lookup_fn(context, off, index, pa);
+        guard.CallUnlocked([&page_request, &status]() { status = page_request.Wait(); });
         if (status != ZX_OK) {
             return status;
         }
+        // the object may have shrunk in the meantime
+        if (unlikely(!InRange(offset, len, size_))) {
+            return ZX_ERR_OUT_OF_RANGE;
+        }
     }
-
-    return ZX_OK;
 }
 
+// User copies go through a kernel buffer a page at a time, so that lock_ is
+// never held while user memory is touched. A fault on the user buffer may need
+// a page source to supply the page, and waiting for that with lock_ held would
+// stall everything else that needs this object, or deadlock if the buffer is
+// mapped from this object or its page source needs it.
 zx_status_t VmObjectPaged::ReadUser(user_out_ptr<void> ptr, uint64_t offset, size_t len) {
     canary_.Assert();
 
-    // read routine that uses copy_to_user
-    auto read_routine = [ptr](const void* src, size_t offset, size_t len) -> zx_status_t {
-        return ptr.byte_offset(offset).copy_array_to_user(src, len);
-    };
+    if (len == 0) {
+        // nothing to copy, but the range is still checked
+        uint8_t unused;
+        return Read(&unused, offset, 0);
+    }
 
-    return ReadWriteInternal(offset, len, false, read_routine);
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[MIN(len, PAGE_SIZE)]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    size_t done = 0;
+    while (done < len) {
+        size_t tocopy = MIN(PAGE_SIZE - (offset + done) % PAGE_SIZE, len - done);
+        zx_status_t status = Read(buf.get(), offset + done, tocopy);
+        if (status != ZX_OK) {
+            return status;
+        }
+        status = ptr.byte_offset(done).copy_array_to_user(buf.get(), tocopy);
+        if (status != ZX_OK) {
+            return status;
+        }
+        done += tocopy;
+    }
+    return ZX_OK;
 }
 
 zx_status_t VmObjectPaged::WriteUser(user_in_ptr<const void> ptr, uint64_t offset, size_t len) {
     canary_.Assert();
 
-    // write routine that uses copy_from_user
-    auto write_routine = [ptr](void* dst, size_t offset, size_t len) -> zx_status_t {
-        return ptr.byte_offset(offset).copy_array_from_user(dst, len);
-    };
+    if (len == 0) {
+        // nothing to copy, but the range is still checked
+        const uint8_t unused = 0;
+        return Write(&unused, offset, 0);
+    }
 
-    return ReadWriteInternal(offset, len, true, write_routine);
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[MIN(len, PAGE_SIZE)]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    size_t done = 0;
+    while (done < len) {
+        size_t tocopy = MIN(PAGE_SIZE - (offset + done) % PAGE_SIZE, len - done);
+        zx_status_t status = ptr.byte_offset(done).copy_array_from_user(buf.get(), tocopy);
+        if (status != ZX_OK) {
+            return status;
+        }
+        status = Write(buf.get(), offset + done, tocopy);
+        if (status != ZX_OK) {
+            return status;
+        }
+        done += tocopy;
+    }
+    return ZX_OK;
 }
 
 zx_status_t VmObjectPaged::InvalidateCache(const uint64_t offset, const uint64_t len) {
@@ -1144,7 +1878,7 @@ zx_status_t VmObjectPaged::SetMappingCachePolicy(const uint32_t cache_policy) {
     // 2) vmo has no mappings
     // 3) vmo has no clones
     // 4) vmo is not a clone
-    if (!page_list_.IsEmpty()) {
+    if (!page_list_.IsEmpty() || !compressed_pages_.is_empty()) {
         return ZX_ERR_BAD_STATE;
     }
     if (!mapping_list_.is_empty()) {
@@ -115,7 +115,7 @@ vm_page* VmPageList::GetPage(uint64_t offset) {
     return pln->GetPage(index);
 }
 
-zx_status_t VmPageList::FreePage(uint64_t offset) {
+vm_page* VmPageList::RemovePage(uint64_t offset) {
     uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
     size_t index = (offset >> PAGE_SIZE_SHIFT) % VmPageListNode::kPageFanOut;
 
@@ -125,10 +125,9 @@ zx_status_t VmPageList::FreePage(uint64_t offset) {
     // lookup the tree node that holds this page
     auto pln = list_.find(node_offset);
     if (!pln.IsValid()) {
-        return ZX_ERR_NOT_FOUND;
+        return nullptr;
     }
 
-    // free this page
     auto page = pln->RemovePage(index);
     if (page) {
         // if it was the last page in the node, remove the node from the tree
@@ -136,7 +135,22 @@ zx_status_t VmPageList::FreePage(uint64_t offset) {
             LTRACEF_LEVEL(2, "%p freeing the list node\n", this);
             list_.erase(*pln);
         }
+    }
+
+    return page;
+}
+
+zx_status_t VmPageList::FreePage(uint64_t offset) {
+    uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
+
+    // lookup the tree node that holds this page
+    if (!list_.find(node_offset).IsValid()) {
+        return ZX_ERR_NOT_FOUND;
+    }
 
+    // free this page
+    auto page = RemovePage(offset);
+    if (page) {
         pmm_free_page(page);
     }
 
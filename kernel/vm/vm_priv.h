@@ -11,6 +11,7 @@
 #include <kernel/range_check.h>
 #include <stdint.h>
 #include <sys/types.h>
+#include <vm/pmm.h>
 #include <vm/vm.h>
 #include <vm/vm_aspace.h>
 
@@ -28,3 +29,9 @@ static inline paddr_t vm_get_zero_page_paddr(void) {
 
     return zero_page_paddr;
 }
+
+// Fill |order| with nodes [0, count) sorted by increasing distance from node |from|, which
+// always comes first. Nodes at the same distance keep their index order. |distance| is
+// indexed [from][to], on the ACPI SLIT scale.
+void pmm_numa_sort_nodes(const uint8_t distance[PMM_MAX_NODES][PMM_MAX_NODES], size_t count,
+                         size_t from, uint8_t order[PMM_MAX_NODES]);
@@ -4,12 +4,20 @@
 // license that can be found in the LICENSE file or at
 // https://opensource.org/licenses/MIT
 
+#include "pmm_node.h"
+#include "vm_priv.h"
 #include <assert.h>
 #include <err.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/array.h>
+#include <fbl/atomic.h>
+#include <fbl/unique_ptr.h>
+#include <kernel/thread.h>
 #include <lib/unittest/unittest.h>
+#include <vm/compressed_store.h>
+#include <vm/page_source.h>
 #include <vm/physmap.h>
+#include <vm/scanner.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
 #include <vm/vm_aspace.h>
@@ -84,6 +92,243 @@ static bool pmm_alloc_contiguous_one_test() {
     END_TEST;
 }
 
+// Allocates and frees enough single pages to refill and overflow the per-cpu page cache.
+static bool pmm_cpu_cache_test() {
+    BEGIN_TEST;
+    static const size_t alloc_count = 256;
+    fbl::AllocChecker ac;
+    fbl::Array<vm_page_t*> pages(new (&ac) vm_page_t*[alloc_count], alloc_count);
+    ASSERT_TRUE(ac.check(), "");
+
+    for (size_t i = 0; i < alloc_count; i++) {
+        zx_status_t status = pmm_alloc_page(0, &pages[i]);
+        ASSERT_EQ(ZX_OK, status, "pmm_alloc single page");
+        EXPECT_EQ(VM_PAGE_STATE_ALLOC, pages[i]->state, "allocated page state");
+        EXPECT_FALSE(pages[i]->is_pmm_cached(), "allocated page still marked cached");
+    }
+
+    // every page handed out must be distinct
+    for (size_t i = 0; i < alloc_count; i++) {
+        for (size_t j = i + 1; j < alloc_count; j++) {
+            EXPECT_NE(pages[i], pages[j], "duplicate page");
+        }
+    }
+
+    for (size_t i = 0; i < alloc_count; i++) {
+        pmm_free_page(pages[i]);
+    }
+
+    // cached pages already count as free, so draining them must not change the free count
+    uint64_t free_before = pmm_count_free_pages();
+    pmm_drain_cpu_caches();
+    uint64_t free_after = pmm_count_free_pages();
+    EXPECT_EQ(free_before, free_after, "free count changed across drain");
+    END_TEST;
+}
+
+static bool page_is_zero(vm_page_t* page) {
+    auto ptr = static_cast<const uint64_t*>(paddr_to_physmap(page->paddr()));
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(*ptr); i++) {
+        if (ptr[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Dirties some pages, frees them, and makes sure zeroed allocations come back zeroed
+// whether or not they came from the pre-zeroed pool.
+static bool pmm_alloc_zeroed_test() {
+    BEGIN_TEST;
+    list_node list = LIST_INITIAL_VALUE(list);
+
+    static const size_t alloc_count = 64;
+
+    zx_status_t status = pmm_alloc_pages(alloc_count, 0, &list);
+    ASSERT_EQ(ZX_OK, status, "pmm_alloc_pages");
+    vm_page_t* page;
+    list_for_every_entry (&list, page, vm_page_t, queue_node) {
+        memset(paddr_to_physmap(page->paddr()), 0xa5, PAGE_SIZE);
+    }
+    pmm_free(&list);
+
+    status = pmm_alloc_pages(alloc_count, PMM_ALLOC_FLAG_ZEROED, &list);
+    ASSERT_EQ(ZX_OK, status, "pmm_alloc_pages zeroed");
+    list_for_every_entry (&list, page, vm_page_t, queue_node) {
+        EXPECT_TRUE(page_is_zero(page), "page from pmm_alloc_pages not zeroed");
+        EXPECT_FALSE(page->is_zeroed(), "allocated page still marked zeroed");
+    }
+    pmm_free(&list);
+
+    for (size_t i = 0; i < alloc_count; i++) {
+        status = pmm_alloc_page(PMM_ALLOC_FLAG_ZEROED, &page);
+        ASSERT_EQ(ZX_OK, status, "pmm_alloc_page zeroed");
+        EXPECT_TRUE(page_is_zero(page), "page from pmm_alloc_page not zeroed");
+        list_add_tail(&list, &page->queue_node);
+    }
+    pmm_free(&list);
+    END_TEST;
+}
+
+// Moves parts of an arena between two nodes built over pages taken from the pmm, and
+// checks that the arena is split at the range boundaries and that each node accounts
+// for the pages it ends up with.
+static bool pmm_node_transfer_range_test() {
+    BEGIN_TEST;
+    static const size_t page_count = 16;
+
+    list_node backing = LIST_INITIAL_VALUE(backing);
+    paddr_t base;
+    zx_status_t status = pmm_alloc_contiguous(page_count, 0, PAGE_SIZE_SHIFT, &base, &backing);
+    ASSERT_EQ(ZX_OK, status, "pmm_alloc_contiguous");
+
+    fbl::AllocChecker ac;
+    fbl::Array<vm_page_t> page_array(new (&ac) vm_page_t[page_count], page_count);
+    ASSERT_TRUE(ac.check(), "");
+
+    {
+        // the nodes are too big for the stack
+        fbl::unique_ptr<PmmNode> a(new (&ac) PmmNode(PMM_MAX_NODES - 2));
+        ASSERT_TRUE(ac.check(), "");
+        fbl::unique_ptr<PmmNode> b(new (&ac) PmmNode(PMM_MAX_NODES - 1));
+        ASSERT_TRUE(ac.check(), "");
+        PmmNode& node_a = *a;
+        PmmNode& node_b = *b;
+
+        pmm_arena_info_t info = {};
+        strlcpy(info.name, "test", sizeof(info.name));
+        info.base = base;
+        info.size = page_count * PAGE_SIZE;
+        ASSERT_EQ(ZX_OK, node_a.AddArena(&info, page_array.get()), "");
+        EXPECT_EQ(page_count * PAGE_SIZE, node_a.CountTotalBytes(), "");
+        EXPECT_EQ(page_count, node_a.CountFreePages(), "");
+
+        // an allocated page moves along with the free ones around it
+        list_node held = LIST_INITIAL_VALUE(held);
+        ASSERT_EQ(ZX_OK, node_a.AllocRange(base + 6 * PAGE_SIZE, 1, &held), "");
+        EXPECT_EQ(page_count - 1, node_a.CountFreePages(), "");
+
+        // the middle of the arena: split off both sides
+        size_t moved = node_a.TransferRange(base + 4 * PAGE_SIZE, 4 * PAGE_SIZE, &node_b);
+        EXPECT_EQ(4 * PAGE_SIZE, moved, "");
+        EXPECT_EQ((page_count - 4) * PAGE_SIZE, node_a.CountTotalBytes(), "");
+        EXPECT_EQ(4 * PAGE_SIZE, node_b.CountTotalBytes(), "");
+        EXPECT_EQ(page_count - 4, node_a.CountFreePages(), "");
+        EXPECT_EQ(3u, node_b.CountFreePages(), "");
+
+        // the allocated page is returned to the node it moved to
+        node_b.FreeList(&held);
+        EXPECT_EQ(4u, node_b.CountFreePages(), "");
+
+        // the top of the arena: split off the bottom only. the range reaches past the
+        // end of the node's memory.
+        moved = node_a.TransferRange(base + 12 * PAGE_SIZE, 8 * PAGE_SIZE, &node_b);
+        EXPECT_EQ(4 * PAGE_SIZE, moved, "");
+        EXPECT_EQ(8 * PAGE_SIZE, node_a.CountTotalBytes(), "");
+        EXPECT_EQ(8 * PAGE_SIZE, node_b.CountTotalBytes(), "");
+        EXPECT_EQ(8u, node_a.CountFreePages(), "");
+        EXPECT_EQ(8u, node_b.CountFreePages(), "");
+
+        // nothing is left to move in a range that was already moved
+        moved = node_a.TransferRange(base + 4 * PAGE_SIZE, 4 * PAGE_SIZE, &node_b);
+        EXPECT_EQ(0u, moved, "");
+
+        auto on_b = [](size_t i) { return (i >= 4 && i < 8) || i >= 12; };
+        for (size_t i = 0; i < page_count; i++) {
+            const paddr_t pa = base + i * PAGE_SIZE;
+            EXPECT_EQ(on_b(i) ? node_b.id() : node_a.id(),
+                      static_cast<uint32_t>(page_array[i].node), "page node");
+            EXPECT_EQ(on_b(i) ? &page_array[i] : nullptr, node_b.PaddrToPage(pa), "");
+            EXPECT_EQ(on_b(i) ? nullptr : &page_array[i], node_a.PaddrToPage(pa), "");
+        }
+
+        // allocations only come out of the node's own memory
+        list_node list = LIST_INITIAL_VALUE(list);
+        ASSERT_EQ(ZX_OK, node_b.AllocPages(8, 0, &list), "");
+        EXPECT_EQ(0u, node_b.CountFreePages(), "");
+        EXPECT_EQ(8u, node_a.CountFreePages(), "");
+        vm_page_t* page;
+        list_for_every_entry (&list, page, vm_page_t, queue_node) {
+            EXPECT_TRUE(on_b((page->paddr() - base) / PAGE_SIZE), "page from the wrong node");
+        }
+        list_node more = LIST_INITIAL_VALUE(more);
+        EXPECT_EQ(ZX_ERR_NO_MEMORY, node_b.AllocPages(1, 0, &more), "");
+        node_b.FreeList(&list);
+        EXPECT_EQ(8u, node_b.CountFreePages(), "");
+
+        node_a.DrainCpuCaches();
+        node_b.DrainCpuCaches();
+    }
+
+    pmm_free(&backing);
+    END_TEST;
+}
+
+// Checks that allocations fall back to the nearest node first.
+static bool pmm_numa_sort_nodes_test() {
+    BEGIN_TEST;
+
+    uint8_t distance[PMM_MAX_NODES][PMM_MAX_NODES] = {};
+    // node 0 is further from 1 than from 2, node 2 is as far from 0 as from 1, and node 1
+    // has a (bogus) shorter distance to 0 than to itself
+    distance[0][0] = 10; distance[0][1] = 30; distance[0][2] = 20;
+    distance[1][0] = 5;  distance[1][1] = 10; distance[1][2] = 20;
+    distance[2][0] = 15; distance[2][1] = 15; distance[2][2] = 10;
+
+    uint8_t order[PMM_MAX_NODES];
+    pmm_numa_sort_nodes(distance, 3, 0, order);
+    EXPECT_EQ(0u, order[0], "");
+    EXPECT_EQ(2u, order[1], "");
+    EXPECT_EQ(1u, order[2], "");
+
+    // the local node always comes first
+    pmm_numa_sort_nodes(distance, 3, 1, order);
+    EXPECT_EQ(1u, order[0], "");
+    EXPECT_EQ(0u, order[1], "");
+    EXPECT_EQ(2u, order[2], "");
+
+    // ties keep index order
+    pmm_numa_sort_nodes(distance, 3, 2, order);
+    EXPECT_EQ(2u, order[0], "");
+    EXPECT_EQ(0u, order[1], "");
+    EXPECT_EQ(1u, order[2], "");
+
+    pmm_numa_sort_nodes(distance, 1, 0, order);
+    EXPECT_EQ(0u, order[0], "");
+    END_TEST;
+}
+
+// Checks that the nodes of the running system add up to the whole pmm.
+static bool pmm_node_info_test() {
+    BEGIN_TEST;
+
+    const size_t count = pmm_node_count();
+    ASSERT_GE(count, 1u, "");
+    ASSERT_LE(count, static_cast<size_t>(PMM_MAX_NODES), "");
+
+    uint64_t total_bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        pmm_node_info_t info;
+        ASSERT_EQ(ZX_OK, pmm_get_node_info(i, &info), "");
+        EXPECT_LE(info.free_bytes, info.total_bytes, "");
+        total_bytes += info.total_bytes;
+    }
+    EXPECT_EQ(pmm_count_total_bytes(), total_bytes, "");
+
+    pmm_node_info_t info;
+    EXPECT_EQ(ZX_ERR_OUT_OF_RANGE, pmm_get_node_info(count, &info), "");
+
+    // pages allocated from a node come off its free count
+    list_node list = LIST_INITIAL_VALUE(list);
+    ASSERT_EQ(ZX_OK, pmm_alloc_pages_on_node(0, 4, 0, &list), "");
+    vm_page_t* page;
+    list_for_every_entry (&list, page, vm_page_t, queue_node) {
+        EXPECT_EQ(0u, static_cast<uint32_t>(page->node), "page from the wrong node");
+    }
+    pmm_free(&list);
+    END_TEST;
+}
+
 static uint32_t test_rand(uint32_t seed) {
     return (seed = seed * 1664525 + 1013904223);
 }
@@ -625,6 +870,404 @@ static bool vmo_demand_paged_map_test() {
     END_TEST;
 }
 
+// Creates a vm object, maps it with a fault-around window, and checks which
+// pages read and write faults map in.
+static bool vmo_fault_around_test() {
+    BEGIN_TEST;
+    static const uint window_shift = 3;
+    static const size_t window = PAGE_SIZE << window_shift;
+    static const size_t alloc_size = window * 4;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+    ASSERT_TRUE(vmo, "vmobject creation\n");
+
+    // commit every other page, the rest read as the zero page
+    for (size_t off = 0; off < alloc_size; off += 2 * PAGE_SIZE) {
+        status = vmo->CommitRange(off, PAGE_SIZE);
+        ASSERT_EQ(ZX_OK, status, "committing page\n");
+    }
+
+    // align the mapping to the window so the windows line up with the vmo
+    auto ka = VmAspace::kernel_aspace();
+    fbl::RefPtr<VmMapping> mapping;
+    status = ka->RootVmar()->CreateVmMapping(
+        0, alloc_size, static_cast<uint8_t>(PAGE_SIZE_SHIFT + window_shift),
+        (window_shift + 1) << VMAR_FLAG_FAULT_AROUND_SHIFT, vmo, 0, kArchRwFlags, "test",
+        &mapping);
+    ASSERT_EQ(ZX_OK, status, "mapping object");
+
+    const vaddr_t base = mapping->base();
+    volatile uint8_t* ptr = reinterpret_cast<volatile uint8_t*>(base);
+
+    // a read fault in the second window maps all of it, without write permission
+    EXPECT_EQ(0u, ptr[window + 3 * PAGE_SIZE], "reading page");
+    for (size_t off = 0; off < alloc_size; off += PAGE_SIZE) {
+        paddr_t pa;
+        uint mmu_flags;
+        status = ka->arch_aspace().Query(base + off, &pa, &mmu_flags);
+        if (off < window || off >= 2 * window) {
+            EXPECT_EQ(ZX_ERR_NOT_FOUND, status, "page outside the window mapped");
+            continue;
+        }
+        EXPECT_EQ(ZX_OK, status, "page inside the window not mapped");
+        EXPECT_FALSE(mmu_flags & ARCH_MMU_FLAG_PERM_WRITE, "fault-around page is writable");
+        if ((off / PAGE_SIZE) % 2) {
+            EXPECT_EQ(vm_get_zero_page_paddr(), pa, "uncommitted page is not the zero page");
+        }
+    }
+
+    // a write fault only maps the page itself
+    ptr[2 * window + 2 * PAGE_SIZE] = 1;
+    EXPECT_EQ(ZX_OK, ka->arch_aspace().Query(base + 2 * window + 2 * PAGE_SIZE, nullptr, nullptr),
+              "written page not mapped");
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, ka->arch_aspace().Query(base + 2 * window + PAGE_SIZE,
+                                                        nullptr, nullptr),
+              "write fault mapped a neighbour");
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, ka->arch_aspace().Query(base + 2 * window + 3 * PAGE_SIZE,
+                                                        nullptr, nullptr),
+              "write fault mapped a neighbour");
+
+    // writing to a zero page mapped by fault-around gives it a real page
+    ptr[window + PAGE_SIZE] = 1;
+    paddr_t pa;
+    uint mmu_flags;
+    status = ka->arch_aspace().Query(base + window + PAGE_SIZE, &pa, &mmu_flags);
+    EXPECT_EQ(ZX_OK, status, "written page not mapped");
+    EXPECT_NE(vm_get_zero_page_paddr(), pa, "written page is the zero page");
+    EXPECT_TRUE(mmu_flags & ARCH_MMU_FLAG_PERM_WRITE, "written page is not writable");
+    EXPECT_EQ(1u, ptr[window + PAGE_SIZE], "reading back page");
+
+    status = mapping->Destroy();
+    EXPECT_EQ(ZX_OK, status, "unmapping object");
+    END_TEST;
+}
+
+// Checks that only inactive pages that are all zeros are reclaimed.
+static bool vmo_reclaim_zero_pages_test() {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+
+    status = vmo->CommitRange(0, alloc_size);
+    ASSERT_EQ(ZX_OK, status, "committing vm object\n");
+    const uint8_t value = 0x5a;
+    status = vmo->Write(&value, PAGE_SIZE, sizeof(value));
+    ASSERT_EQ(ZX_OK, status, "writing vm object\n");
+
+    EXPECT_EQ(0u, vmo->ReclaimZeroPages(SIZE_MAX, VM_SCANNER_INACTIVE_AGE, nullptr),
+              "reclaimed active pages\n");
+
+    for (int i = 0; i < VM_SCANNER_INACTIVE_AGE; i++) {
+        vmo->AgePages();
+    }
+    EXPECT_EQ(1u, vmo->ReclaimZeroPages(1, VM_SCANNER_INACTIVE_AGE, nullptr),
+              "reclaim limit\n");
+    EXPECT_EQ(2u, vmo->ReclaimZeroPages(SIZE_MAX, VM_SCANNER_INACTIVE_AGE, nullptr),
+              "reclaiming zero pages\n");
+    EXPECT_EQ(1u, vmo->AllocatedPages(), "written page was reclaimed\n");
+    EXPECT_EQ(3u, vmo->ReclaimedZeroPages(), "reclaimed page count\n");
+
+    uint8_t buf[2];
+    status = vmo->Read(buf, PAGE_SIZE - 1, sizeof(buf));
+    EXPECT_EQ(ZX_OK, status, "reading vm object\n");
+    EXPECT_EQ(0u, buf[0], "reclaimed page is not zero\n");
+    EXPECT_EQ(value, buf[1], "written page lost its contents\n");
+    END_TEST;
+}
+
+// Checks that a scan limit is honored and that the next limited scan resumes
+// where the last one stopped.
+static bool vmo_reclaim_zero_pages_scan_limit_test() {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+
+    status = vmo->CommitRange(0, alloc_size);
+    ASSERT_EQ(ZX_OK, status, "committing vm object\n");
+    for (int i = 0; i < VM_SCANNER_INACTIVE_AGE; i++) {
+        vmo->AgePages();
+    }
+
+    size_t max_scan = 3;
+    EXPECT_EQ(3u, vmo->ReclaimZeroPages(SIZE_MAX, VM_SCANNER_INACTIVE_AGE, &max_scan),
+              "reclaiming first pages\n");
+    EXPECT_EQ(0u, max_scan, "scan limit used up\n");
+    EXPECT_EQ(0u, vmo->ReclaimZeroPages(SIZE_MAX, VM_SCANNER_INACTIVE_AGE, &max_scan),
+              "reclaimed past the scan limit\n");
+
+    // the first page is committed again, but the next scan starts at the last
+    max_scan = 3;
+    status = vmo->CommitRange(0, PAGE_SIZE);
+    ASSERT_EQ(ZX_OK, status, "committing first page\n");
+    for (int i = 0; i < VM_SCANNER_INACTIVE_AGE; i++) {
+        vmo->AgePages();
+    }
+    EXPECT_EQ(1u, vmo->ReclaimZeroPages(SIZE_MAX, VM_SCANNER_INACTIVE_AGE, &max_scan),
+              "reclaiming last page\n");
+    EXPECT_EQ(2u, max_scan, "only the last page was looked at\n");
+
+    // having reached the end, it starts over
+    EXPECT_EQ(1u, vmo->ReclaimZeroPages(SIZE_MAX, VM_SCANNER_INACTIVE_AGE, &max_scan),
+              "reclaiming first page again\n");
+    EXPECT_EQ(0u, vmo->AllocatedPages(), "pages left committed\n");
+    EXPECT_EQ(5u, vmo->ReclaimedZeroPages(), "reclaimed page count\n");
+    END_TEST;
+}
+
+// Checks that the scanner's zero page pass gets through every VMO a limited
+// number of pages at a time.
+static bool vm_scanner_dedup_zero_pages_test() {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+
+    status = vmo->CommitRange(0, alloc_size);
+    ASSERT_EQ(ZX_OK, status, "committing vm object\n");
+    const uint8_t value = 0x5a;
+    status = vmo->Write(&value, 0, sizeof(value));
+    ASSERT_EQ(ZX_OK, status, "writing vm object\n");
+    for (int i = 0; i < VM_SCANNER_INACTIVE_AGE; i++) {
+        vmo->AgePages();
+    }
+
+    // the pass resumes wherever the last one stopped, and this VMO is the
+    // newest, so enough passes to look at every page in the system reach it
+    static const size_t max_scan = 16;
+    const size_t max_passes = pmm_count_total_bytes() / PAGE_SIZE / max_scan + 2;
+    size_t passes = 0;
+    while (vmo->ReclaimedZeroPages() < 3u && passes < max_passes) {
+        vm_scanner_dedup_zero_pages(max_scan);
+        passes++;
+    }
+    EXPECT_EQ(3u, vmo->ReclaimedZeroPages(), "reclaimed page count\n");
+    EXPECT_EQ(1u, vmo->AllocatedPages(), "written page was reclaimed\n");
+
+    uint8_t buf;
+    status = vmo->Read(&buf, 0, sizeof(buf));
+    EXPECT_EQ(ZX_OK, status, "reading vm object\n");
+    EXPECT_EQ(value, buf, "written page lost its contents\n");
+    END_TEST;
+}
+
+// Checks that pages committed and pinned together can't be reclaimed until they
+// are unpinned.
+static bool vmo_commit_pinned_test() {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+
+    status = vmo->CommitRangePinned(0, alloc_size);
+    ASSERT_EQ(ZX_OK, status, "committing and pinning vm object\n");
+    EXPECT_EQ(alloc_size / PAGE_SIZE, vmo->AllocatedPages(), "pages committed\n");
+    EXPECT_EQ(0u, vmo->ReclaimZeroPages(SIZE_MAX, 0, nullptr), "reclaimed pinned pages\n");
+    EXPECT_EQ(0u, vmo->CompressPages(SIZE_MAX, 0), "compressed pinned pages\n");
+
+    vmo->Unpin(0, alloc_size);
+    EXPECT_EQ(alloc_size / PAGE_SIZE, vmo->ReclaimZeroPages(SIZE_MAX, 0, nullptr),
+              "reclaiming unpinned pages\n");
+
+    EXPECT_EQ(ZX_ERR_OUT_OF_RANGE, vmo->CommitRangePinned(alloc_size, PAGE_SIZE),
+              "committing and pinning out of range\n");
+    END_TEST;
+}
+
+// Checks that compressed pages read back the same, and leave the store when
+// they are decompressed or decommitted.
+static bool vmo_compress_test() {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[alloc_size]);
+    ASSERT_TRUE(ac.check(), "allocating buffer\n");
+    for (size_t i = 0; i < alloc_size; i++) {
+        buf[i] = static_cast<uint8_t>(i / 16);
+    }
+    status = vmo->Write(buf.get(), 0, alloc_size);
+    ASSERT_EQ(ZX_OK, status, "writing vm object\n");
+
+    EXPECT_EQ(0u, vmo->CompressPages(SIZE_MAX, VM_SCANNER_INACTIVE_AGE),
+              "compressed active pages\n");
+    for (int i = 0; i < VM_SCANNER_INACTIVE_AGE; i++) {
+        vmo->AgePages();
+    }
+
+    vm_compression_info_t before;
+    VmCompressedStore::Get()->GetInfo(&before);
+    EXPECT_EQ(alloc_size / PAGE_SIZE, vmo->CompressPages(SIZE_MAX, VM_SCANNER_INACTIVE_AGE),
+              "compressing pages\n");
+    EXPECT_EQ(0u, vmo->AllocatedPages(), "compressed pages still committed\n");
+    vm_compression_info_t info;
+    VmCompressedStore::Get()->GetInfo(&info);
+    EXPECT_EQ(before.compressed_pages + alloc_size / PAGE_SIZE, info.compressed_pages,
+              "pages not in the store\n");
+
+    // reading the first page decompresses it
+    uint8_t check[PAGE_SIZE];
+    status = vmo->Read(check, 0, PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, status, "reading vm object\n");
+    EXPECT_EQ(0, memcmp(check, buf.get(), PAGE_SIZE), "decompressed page differs\n");
+    EXPECT_EQ(1u, vmo->AllocatedPages(), "page not decompressed\n");
+
+    // decommitting the second drops it from the store
+    status = vmo->DecommitRange(PAGE_SIZE, PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, status, "decommitting page\n");
+    status = vmo->Read(check, PAGE_SIZE, PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, status, "reading vm object\n");
+    EXPECT_EQ(0u, check[0], "decommitted page is not zero\n");
+
+    // committing the rest decompresses them
+    status = vmo->CommitRange(0, alloc_size);
+    EXPECT_EQ(ZX_OK, status, "committing vm object\n");
+    status = vmo->Read(check, 2 * PAGE_SIZE, PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, status, "reading vm object\n");
+    EXPECT_EQ(0, memcmp(check, buf.get() + 2 * PAGE_SIZE, PAGE_SIZE),
+              "decompressed page differs\n");
+
+    VmCompressedStore::Get()->GetInfo(&info);
+    EXPECT_EQ(before.compressed_pages, info.compressed_pages, "pages left in the store\n");
+    END_TEST;
+}
+
+// Checks that an unlocked vmo can be discarded, and that locking it reports it.
+static bool vmo_discard_test() {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+
+    status = vmo->CommitRange(0, alloc_size);
+    ASSERT_EQ(ZX_OK, status, "committing vm object\n");
+    EXPECT_EQ(0u, vmo->DiscardPages(), "discarded a locked vmo\n");
+
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, vmo->UnlockRange(0, PAGE_SIZE), "unlocking part of a vmo\n");
+    EXPECT_EQ(ZX_OK, vmo->UnlockRange(0, alloc_size), "unlocking vmo\n");
+    EXPECT_EQ(alloc_size / PAGE_SIZE, vmo->DiscardPages(), "discarding vmo\n");
+    EXPECT_EQ(0u, vmo->AllocatedPages(), "discarded vmo has pages\n");
+
+    bool discarded = false;
+    EXPECT_EQ(ZX_OK, vmo->LockRange(0, alloc_size, &discarded), "locking vmo\n");
+    EXPECT_TRUE(discarded, "discard not reported\n");
+
+    // an unlock and lock with no discard in between reports nothing
+    EXPECT_EQ(ZX_OK, vmo->UnlockRange(0, alloc_size), "unlocking vmo\n");
+    EXPECT_EQ(ZX_OK, vmo->LockRange(0, alloc_size, &discarded), "locking vmo\n");
+    EXPECT_FALSE(discarded, "spurious discard reported\n");
+    END_TEST;
+}
+
+// Checks that cloning an unlocked vmo keeps reclaim from discarding the pages
+// the clone reads through to.
+static bool vmo_discard_clone_test() {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[alloc_size]);
+    ASSERT_TRUE(ac.check(), "allocating buffer\n");
+    for (size_t i = 0; i < alloc_size; i++) {
+        buf[i] = static_cast<uint8_t>(i / 16);
+    }
+    status = vmo->Write(buf.get(), 0, alloc_size);
+    ASSERT_EQ(ZX_OK, status, "writing vm object\n");
+    EXPECT_EQ(ZX_OK, vmo->UnlockRange(0, alloc_size), "unlocking vmo\n");
+
+    fbl::RefPtr<VmObject> clone;
+    status = vmo->CloneCOW(false, 0, alloc_size, false, &clone);
+    ASSERT_EQ(ZX_OK, status, "cloning vm object\n");
+
+    EXPECT_EQ(0u, vmo->DiscardPages(), "discarded a cloned vmo\n");
+    EXPECT_EQ(alloc_size / PAGE_SIZE, vmo->AllocatedPages(), "cloned vmo lost pages\n");
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, vmo->UnlockRange(0, alloc_size), "unlocking cloned vmo\n");
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, clone->UnlockRange(0, alloc_size), "unlocking clone\n");
+
+    fbl::unique_ptr<uint8_t[]> check(new (&ac) uint8_t[alloc_size]);
+    ASSERT_TRUE(ac.check(), "allocating buffer\n");
+    status = clone->Read(check.get(), 0, alloc_size);
+    EXPECT_EQ(ZX_OK, status, "reading clone\n");
+    EXPECT_EQ(0, memcmp(check.get(), buf.get(), alloc_size), "clone contents changed\n");
+    END_TEST;
+}
+
+// Checks that a written, aligned block of a vmo gets mapped with a large page,
+// and is split back into small pages when part of it is protected.
+static bool vmo_large_page_test() {
+    BEGIN_TEST;
+    if (!vm_large_pages_enabled()) {
+        unittest_printf("large pages disabled, skipping\n");
+        END_TEST;
+    }
+
+    static const size_t alloc_size = LARGE_PAGE_SIZE * 2;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+    ASSERT_TRUE(vmo, "vmobject creation\n");
+
+    auto ka = VmAspace::kernel_aspace();
+    fbl::RefPtr<VmMapping> mapping;
+    status = ka->RootVmar()->CreateVmMapping(0, alloc_size, LARGE_PAGE_SIZE_SHIFT, 0, vmo, 0,
+                                             kArchRwFlags, "test", &mapping);
+    ASSERT_EQ(ZX_OK, status, "mapping object");
+
+    const vaddr_t base = mapping->base();
+    volatile uint8_t* ptr = reinterpret_cast<volatile uint8_t*>(base);
+
+    // a write fault commits the whole first block at once, if the pmm has a free run
+    ptr[PAGE_SIZE] = 1;
+    if (vmo->AllocatedPagesInRange(0, LARGE_PAGE_SIZE) != LARGE_PAGE_COUNT) {
+        unittest_printf("no contiguous run available, skipping\n");
+        ka->RootVmar()->Unmap(base, alloc_size);
+        END_TEST;
+    }
+    EXPECT_EQ(LARGE_PAGE_SIZE, ka->arch_aspace().LargePageBytes(base, LARGE_PAGE_COUNT),
+              "block not mapped with a large page");
+    for (size_t off = 0; off < LARGE_PAGE_SIZE; off += PAGE_SIZE) {
+        ptr[off] = static_cast<uint8_t>(off / PAGE_SIZE);
+    }
+
+    // reads of the empty second block still get the zero page
+    EXPECT_EQ(0u, ptr[LARGE_PAGE_SIZE], "reading page");
+    EXPECT_EQ(0u, vmo->AllocatedPagesInRange(LARGE_PAGE_SIZE, LARGE_PAGE_SIZE),
+              "read fault committed pages");
+    EXPECT_EQ(0u, ka->arch_aspace().LargePageBytes(base + LARGE_PAGE_SIZE, LARGE_PAGE_COUNT),
+              "zero page mapped with a large page");
+
+    // protecting one page demotes the block, leaving the rest of it mapped
+    status = ka->RootVmar()->Protect(base + PAGE_SIZE, PAGE_SIZE, ARCH_MMU_FLAG_PERM_READ);
+    EXPECT_EQ(ZX_OK, status, "protecting page");
+    EXPECT_EQ(0u, ka->arch_aspace().LargePageBytes(base, LARGE_PAGE_COUNT),
+              "block still mapped with a large page");
+    for (size_t off = 0; off < LARGE_PAGE_SIZE; off += PAGE_SIZE) {
+        uint mmu_flags;
+        status = ka->arch_aspace().Query(base + off, nullptr, &mmu_flags);
+        EXPECT_EQ(ZX_OK, status, "page of demoted block not mapped");
+        EXPECT_EQ(off != PAGE_SIZE, !!(mmu_flags & ARCH_MMU_FLAG_PERM_WRITE),
+                  "wrong permissions after demotion");
+        EXPECT_EQ(static_cast<uint8_t>(off / PAGE_SIZE), ptr[off], "reading back page");
+    }
+
+    status = ka->RootVmar()->Unmap(base, alloc_size);
+    EXPECT_EQ(ZX_OK, status, "unmapping object");
+    END_TEST;
+}
+
 // Creates a vm object, maps it, drops ref before unmapping.
 static bool vmo_dropped_ref_test() {
     BEGIN_TEST;
@@ -961,6 +1604,114 @@ static bool vmo_lookup_test() {
     END_TEST;
 }
 
+// A page source that counts the requests sent to it, for the pages to be
+// supplied by hand.
+class TestPageSource final : public PageSource {
+public:
+    size_t requests_sent() const { return requests_sent_.load(); }
+
+private:
+    zx_status_t SendRequest(uint64_t offset, uint64_t len) final {
+        requests_sent_.fetch_add(1);
+        return ZX_OK;
+    }
+
+    fbl::atomic<size_t> requests_sent_{0};
+};
+
+// Checks that a page source is only asked for a page once, whichever range
+// it was asked for as part of.
+static bool page_source_request_range_test() {
+    BEGIN_TEST;
+    fbl::AllocChecker ac;
+    fbl::RefPtr<TestPageSource> source = fbl::AdoptRef(new (&ac) TestPageSource());
+    ASSERT_TRUE(ac.check(), "allocating page source\n");
+
+    PageRequest first, inside, outside, later;
+    EXPECT_EQ(ZX_ERR_SHOULD_WAIT, source->AddRequest(0, 4 * PAGE_SIZE, &first),
+              "requesting range\n");
+    EXPECT_EQ(1u, source->requests_sent(), "requesting range\n");
+    EXPECT_EQ(ZX_ERR_SHOULD_WAIT, source->AddRequest(2 * PAGE_SIZE, PAGE_SIZE, &inside),
+              "requesting page in range\n");
+    EXPECT_EQ(1u, source->requests_sent(), "page in range requested again\n");
+    EXPECT_EQ(ZX_ERR_SHOULD_WAIT, source->AddRequest(4 * PAGE_SIZE, PAGE_SIZE, &outside),
+              "requesting page past range\n");
+    EXPECT_EQ(2u, source->requests_sent(), "page past range not requested\n");
+
+    // the rest of the range stays outstanding once the first waiter is done
+    source->OnPagesSupplied(0, PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, first.Wait(), "waiting for first page\n");
+    EXPECT_EQ(ZX_ERR_SHOULD_WAIT, source->AddRequest(3 * PAGE_SIZE, PAGE_SIZE, &later),
+              "requesting page in rest of range\n");
+    EXPECT_EQ(2u, source->requests_sent(), "page in rest of range requested again\n");
+
+    // but a page that was supplied is asked for again
+    PageRequest again;
+    EXPECT_EQ(ZX_ERR_SHOULD_WAIT, source->AddRequest(0, PAGE_SIZE, &again),
+              "requesting supplied page\n");
+    EXPECT_EQ(3u, source->requests_sent(), "supplied page not requested again\n");
+
+    source->OnPagesSupplied(2 * PAGE_SIZE, 2 * PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, inside.Wait(), "waiting for page in range\n");
+    EXPECT_EQ(ZX_OK, later.Wait(), "waiting for page in rest of range\n");
+
+    source->Close();
+    EXPECT_EQ(ZX_ERR_BAD_STATE, outside.Wait(), "waiting on closed source\n");
+    EXPECT_EQ(ZX_ERR_BAD_STATE, again.Wait(), "waiting on closed source\n");
+    END_TEST;
+}
+
+struct lookup_thread_args {
+    fbl::RefPtr<VmObject> vmo;
+    size_t pages_seen;
+    zx_status_t status;
+};
+
+static int lookup_thread(void* arg) {
+    auto args = static_cast<lookup_thread_args*>(arg);
+    auto lookup_fn = [](void* context, size_t offset, size_t index, paddr_t pa) {
+        (*static_cast<size_t*>(context))++;
+        return ZX_OK;
+    };
+    args->status = args->vmo->Lookup(0, args->vmo->size(), 0, lookup_fn, &args->pages_seen);
+    return 0;
+}
+
+// Checks that a lookup waits for the page source to supply the pages.
+static bool vmo_lookup_page_source_test() {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 2;
+    fbl::AllocChecker ac;
+    fbl::RefPtr<TestPageSource> source = fbl::AdoptRef(new (&ac) TestPageSource());
+    ASSERT_TRUE(ac.check(), "allocating page source\n");
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::CreateExternal(source, alloc_size, &vmo);
+    ASSERT_EQ(ZX_OK, status, "vmobject creation\n");
+
+    lookup_thread_args args = {vmo, 0, ZX_ERR_INTERNAL};
+    thread_t* t = thread_create("lookup", lookup_thread, &args, DEFAULT_PRIORITY);
+    ASSERT_NONNULL(t, "creating lookup thread\n");
+    thread_resume(t);
+    while (source->requests_sent() == 0) {
+        thread_sleep_relative(ZX_MSEC(1));
+    }
+
+    fbl::RefPtr<VmObject> aux;
+    status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &aux);
+    ASSERT_EQ(ZX_OK, status, "vmobject creation\n");
+    list_node pages = LIST_INITIAL_VALUE(pages);
+    status = aux->TakePages(0, alloc_size, &pages);
+    ASSERT_EQ(ZX_OK, status, "taking pages\n");
+    status = vmo->SupplyPages(0, alloc_size, &pages);
+    EXPECT_EQ(ZX_OK, status, "supplying pages\n");
+    pmm_free(&pages);
+
+    thread_join(t, nullptr, ZX_TIME_INFINITE);
+    EXPECT_EQ(ZX_OK, args.status, "lookup\n");
+    EXPECT_EQ(alloc_size / PAGE_SIZE, args.pages_seen, "lookup\n");
+    END_TEST;
+}
+
 // TODO(ZX-1431): The ARM code's error codes are always ZX_ERR_INTERNAL, so
 // special case that.
 #if ARCH_ARM64
@@ -1037,6 +1788,65 @@ static bool arch_noncontiguous_map() {
     END_TEST;
 }
 
+// Protects and unmaps pages within a TLB batch and makes sure the page tables
+// reflect each change immediately, even though invalidations may be deferred.
+static bool arch_tlb_batch_test() {
+    BEGIN_TEST;
+
+    paddr_t phys[4];
+    struct list_node phys_list = LIST_INITIAL_VALUE(phys_list);
+    zx_status_t status = pmm_alloc_pages(fbl::count_of(phys), 0, &phys_list);
+    ASSERT_EQ(ZX_OK, status, "tlb batch alloc");
+    {
+        size_t i = 0;
+        vm_page_t* p;
+        list_for_every_entry (&phys_list, p, vm_page_t, queue_node) {
+            phys[i] = p->paddr();
+            ++i;
+        }
+    }
+
+    {
+        ArchVmAspace aspace;
+        status = aspace.Init(USER_ASPACE_BASE, USER_ASPACE_SIZE, 0);
+        ASSERT_EQ(ZX_OK, status, "failed to init aspace\n");
+
+        size_t mapped;
+        vaddr_t base = USER_ASPACE_BASE + 10 * PAGE_SIZE;
+        status = aspace.Map(base, phys, fbl::count_of(phys), kArchRwFlags, &mapped);
+        ASSERT_EQ(ZX_OK, status, "failed to map\n");
+
+        aspace.BeginTlbBatch();
+        for (size_t i = 0; i < fbl::count_of(phys) - 1; ++i) {
+            status = aspace.Protect(base + i * PAGE_SIZE, 1, ARCH_MMU_FLAG_PERM_READ);
+            EXPECT_EQ(ZX_OK, status, "failed to protect\n");
+        }
+        status = aspace.Unmap(base + 3 * PAGE_SIZE, 1, nullptr);
+        EXPECT_EQ(ZX_OK, status, "failed to unmap\n");
+
+        for (size_t i = 0; i < fbl::count_of(phys) - 1; ++i) {
+            paddr_t paddr;
+            uint mmu_flags;
+            status = aspace.Query(base + i * PAGE_SIZE, &paddr, &mmu_flags);
+            EXPECT_EQ(ZX_OK, status, "bad protect\n");
+            EXPECT_EQ(phys[i], paddr, "bad protect\n");
+            EXPECT_EQ(ARCH_MMU_FLAG_PERM_READ, mmu_flags, "bad protect\n");
+        }
+        status = aspace.Query(base + 3 * PAGE_SIZE, nullptr, nullptr);
+        EXPECT_EQ(ZX_ERR_NOT_FOUND, status, "bad unmap\n");
+        aspace.EndTlbBatch();
+
+        status = aspace.Unmap(base, fbl::count_of(phys), nullptr);
+        EXPECT_EQ(ZX_OK, status, "failed to unmap\n");
+        status = aspace.Destroy();
+        EXPECT_EQ(ZX_OK, status, "failed to destroy aspace\n");
+    }
+
+    pmm_free(&phys_list);
+
+    END_TEST;
+}
+
 // Use the function name as the test name
 #define VM_UNITTEST(fname) UNITTEST(#fname, fname)
 
@@ -1060,13 +1870,25 @@ VM_UNITTEST(vmo_create_contiguous_test)
 VM_UNITTEST(vmo_contiguous_decommit_test)
 VM_UNITTEST(vmo_precommitted_map_test)
 VM_UNITTEST(vmo_demand_paged_map_test)
+VM_UNITTEST(vmo_fault_around_test)
+VM_UNITTEST(vmo_reclaim_zero_pages_test)
+VM_UNITTEST(vmo_reclaim_zero_pages_scan_limit_test)
+VM_UNITTEST(vm_scanner_dedup_zero_pages_test)
+VM_UNITTEST(vmo_commit_pinned_test)
+VM_UNITTEST(vmo_discard_test)
+VM_UNITTEST(vmo_discard_clone_test)
+VM_UNITTEST(vmo_compress_test)
+VM_UNITTEST(vmo_large_page_test)
 VM_UNITTEST(vmo_dropped_ref_test)
 VM_UNITTEST(vmo_remap_test)
 VM_UNITTEST(vmo_double_remap_test)
 VM_UNITTEST(vmo_read_write_smoke_test)
 VM_UNITTEST(vmo_cache_test)
 VM_UNITTEST(vmo_lookup_test)
+VM_UNITTEST(page_source_request_range_test)
+VM_UNITTEST(vmo_lookup_page_source_test)
 VM_UNITTEST(arch_noncontiguous_map)
+VM_UNITTEST(arch_tlb_batch_test)
 // Uncomment for debugging
 // VM_UNITTEST(dump_all_aspaces)  // Run last
 UNITTEST_END_TESTCASE(vm_tests, "vm", "Virtual memory tests");
@@ -1075,6 +1897,11 @@ UNITTEST_START_TESTCASE(pmm_tests)
 VM_UNITTEST(pmm_smoke_test)
 VM_UNITTEST(pmm_alloc_contiguous_one_test)
 VM_UNITTEST(pmm_multi_alloc_test)
+VM_UNITTEST(pmm_cpu_cache_test)
+VM_UNITTEST(pmm_alloc_zeroed_test)
+VM_UNITTEST(pmm_node_transfer_range_test)
+VM_UNITTEST(pmm_numa_sort_nodes_test)
+VM_UNITTEST(pmm_node_info_test)
 // runs the system out of memory, uncomment for debugging
 //VM_UNITTEST(pmm_oversized_alloc_test)
 UNITTEST_END_TESTCASE(pmm_tests, "pmm", "Physical memory manager tests");
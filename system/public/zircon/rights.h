@@ -120,4 +120,7 @@ typedef uint32_t zx_rights_t;
 #define ZX_DEFAULT_SUSPEND_TOKEN_RIGHTS \
     (ZX_RIGHT_TRANSFER | ZX_RIGHT_INSPECT)
 
+#define ZX_DEFAULT_PAGER_RIGHTS \
+    (ZX_RIGHT_TRANSFER | ZX_RIGHT_INSPECT)
+
 #endif // ZIRCON_RIGHTS_H_
@@ -36,6 +36,7 @@ typedef uint32_t zx_object_info_topic_t;
 #define ZX_INFO_PROCESS_HANDLE_STATS    ((zx_object_info_topic_t) 21u) // zx_info_process_handle_stats_t[1]
 #define ZX_INFO_SOCKET                  ((zx_object_info_topic_t) 22u) // zx_info_socket_t[1]
 #define ZX_INFO_VMO                     ((zx_object_info_topic_t) 23u) // zx_info_vmo_t[1]
+#define ZX_INFO_KMEM_COMPRESSION        ((zx_object_info_topic_t) 24u) // zx_info_kmem_compression_t[1]
 
 typedef uint32_t zx_obj_props_t;
 #define ZX_OBJ_PROP_NONE                ((zx_obj_props_t)0u)
@@ -136,6 +137,9 @@ typedef struct zx_info_task_stats {
     //
     // This number is strictly smaller than mem_shared_bytes.
     size_t mem_scaled_shared_bytes;
+
+    // The number of page faults the kernel has handled for the task.
+    uint64_t page_faults;
 } zx_info_task_stats_t;
 
 typedef struct zx_info_vmar {
@@ -206,6 +210,9 @@ typedef struct zx_info_maps_mapping {
     // The number of PAGE_SIZE pages in the mapped region of the VMO
     // that are backed by physical memory.
     size_t committed_pages;
+    // The number of bytes of the mapping that are currently mapped
+    // with large pages by the MMU.
+    size_t large_page_bytes;
 } zx_info_maps_mapping_t;
 
 // Types of entries represented by zx_info_maps_t.
@@ -317,6 +324,11 @@ typedef struct zx_info_vmo {
 
     // VMO mapping cache policy. One of ZX_CACHE_POLICY_*
     uint32_t cache_policy;
+
+    // If |ZX_INFO_VMO_TYPE(flags) == ZX_INFO_VMO_TYPE_PAGED|, the amount of
+    // memory the kernel has decommitted from this VMO because it held only
+    // zeros. Undefined otherwise.
+    uint64_t zero_reclaimed_bytes;
 } zx_info_vmo_t;
 
 // kernel statistics per cpu
@@ -347,6 +359,21 @@ typedef struct zx_info_cpu_stats {
     uint64_t generic_ipis;
 } zx_info_cpu_stats_t;
 
+// Physical memory of one NUMA node, as reported in zx_info_kmem_stats_t.
+typedef struct zx_info_kmem_node {
+    // The ACPI proximity domain of the node, or 0 if the system has no NUMA
+    // information.
+    uint32_t proximity_domain;
+
+    // The amount of physical memory in the node.
+    uint64_t total_bytes;
+
+    // The portion of |total_bytes| that is unallocated.
+    uint64_t free_bytes;
+} zx_info_kmem_node_t;
+
+#define ZX_INFO_KMEM_MAX_NODES 8u
+
 // Information about kernel memory usage.
 // Can be expensive to gather.
 typedef struct zx_info_kmem_stats {
@@ -385,8 +412,52 @@ typedef struct zx_info_kmem_stats {
 
     // Non-free memory that isn't accounted for in any other field.
     uint64_t other_bytes;
+
+    // The portion of |free_bytes| that the kernel has already zeroed, and can
+    // hand out without zeroing it first.
+    uint64_t free_zeroed_bytes;
+
+    // The portion of |free_bytes| that still needs zeroing before it can be
+    // handed out. |free_zeroed_bytes| + |free_dirty_bytes| == |free_bytes|.
+    uint64_t free_dirty_bytes;
+
+    // The number of valid entries in |nodes|. At least 1.
+    uint32_t node_count;
+
+    // Physical memory broken down by NUMA node. Allocations are satisfied
+    // from the node of the allocating cpu when it has free memory.
+    zx_info_kmem_node_t nodes[ZX_INFO_KMEM_MAX_NODES];
 } zx_info_kmem_stats_t;
 
+#define ZX_INFO_KMEM_LATENCY_BUCKETS 16u
+
+// Information about the kernel's store of compressed VMO pages.
+typedef struct zx_info_kmem_compression {
+    // The number of VMO pages held compressed.
+    uint64_t compressed_pages;
+
+    // The total size of their compressed contents.
+    uint64_t compressed_bytes;
+
+    // The memory the store takes up, including the unused space in it.
+    // |compressed_pages| * page size / |store_bytes| is the effective
+    // compression ratio.
+    uint64_t store_bytes;
+
+    // The number of pages compressed and decompressed since boot, and of
+    // pages that didn't compress well enough to be stored.
+    uint64_t compressions;
+    uint64_t decompressions;
+    uint64_t rejections;
+
+    // Histograms of how long each compression and decompression took.
+    // Bucket 0 counts those that took less than 1us, bucket i > 0 those that
+    // took at least 2^(i-1)us and less than 2^i us, and the last bucket
+    // everything slower.
+    uint64_t compression_latency[ZX_INFO_KMEM_LATENCY_BUCKETS];
+    uint64_t decompression_latency[ZX_INFO_KMEM_LATENCY_BUCKETS];
+} zx_info_kmem_compression_t;
+
 typedef struct zx_info_resource {
     // The resource kind; resource object kinds are detailed in the resource.md
     uint32_t kind;
@@ -12,6 +12,8 @@ __BEGIN_CDECLS
 // clang-format off
 
 #define ZX_PROFILE_INFO_SCHEDULER   1
+#define ZX_PROFILE_INFO_FAIR        2
+#define ZX_PROFILE_INFO_DEADLINE    3
 
 typedef struct zx_profile_scheduler {
     int32_t priority;
@@ -20,6 +22,25 @@ typedef struct zx_profile_scheduler {
     uint32_t quantum;
 } zx_profile_scheduler_t;
 
+// Weighted fair share: runnable fair threads on a cpu get cpu time in
+// proportion to their weights.
+typedef struct zx_profile_fair {
+    uint32_t weight;
+} zx_profile_fair_t;
+
+#define ZX_FAIR_WEIGHT_MIN              1
+#define ZX_FAIR_WEIGHT_DEFAULT          100
+#define ZX_FAIR_WEIGHT_MAX              1000
+
+// Deadline: up to |capacity| of cpu time in every |period|, delivered within
+// |relative_deadline| of the start of the period.
+// Requires 0 < capacity <= relative_deadline <= period and capacity < 1s.
+typedef struct zx_profile_deadline {
+    zx_duration_t capacity;
+    zx_duration_t relative_deadline;
+    zx_duration_t period;
+} zx_profile_deadline_t;
+
 #define ZX_PRIORITY_LOWEST              0
 #define ZX_PRIORITY_LOW                 8
 #define ZX_PRIORITY_DEFAULT             16
@@ -30,6 +51,8 @@ typedef struct zx_profile_info {
     uint32_t type;                  // one of ZX_PROFILE_INFO_
     union {
         zx_profile_scheduler_t scheduler;
+        zx_profile_fair_t fair;
+        zx_profile_deadline_t deadline;
     };
 } zx_profile_info_t;
 
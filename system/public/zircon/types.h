@@ -193,8 +193,7 @@ typedef struct zx_channel_call_args {
 } zx_channel_call_args_t;
 
 // Maximum number of wait items allowed for zx_object_wait_many()
-// TODO(ZX-1349) Re-lower this.
-#define ZX_WAIT_MANY_MAX_ITEMS ((size_t)16)
+#define ZX_WAIT_MANY_MAX_ITEMS ((size_t)1024)
 
 // Structure for zx_object_wait_many():
 typedef struct zx_wait_item {
@@ -235,6 +234,13 @@ typedef uint32_t zx_vm_option_t;
 #define ZX_VM_CAN_MAP_EXECUTE       ((zx_vm_option_t)(1u << 9))
 #define ZX_VM_MAP_RANGE             ((zx_vm_option_t)(1u << 10))
 #define ZX_VM_REQUIRE_NON_RESIZABLE ((zx_vm_option_t)(1u << 11))
+// Size of the window of neighbouring pages that a page fault in a mapping may
+// map in at once. A value of 0 selects the kernel default, otherwise use
+// ZX_VM_FAULT_AROUND(n) for a window of 2^n pages (n <= 9).
+#define ZX_VM_FAULT_AROUND_BASE     ((zx_vm_option_t)24u)
+#define ZX_VM_FAULT_AROUND_MASK     ((zx_vm_option_t)(0xfu << ZX_VM_FAULT_AROUND_BASE))
+#define ZX_VM_FAULT_AROUND(n)       ((zx_vm_option_t)(((n) + 1u) << ZX_VM_FAULT_AROUND_BASE))
+#define ZX_VM_FAULT_AROUND_MAX      ((zx_vm_option_t)9u)
 
 
 // virtual address
@@ -282,6 +288,15 @@ typedef uint64_t zx_off_t;
 #define ZX_CHANNEL_MAX_MSG_BYTES            ((uint32_t)65536u)
 #define ZX_CHANNEL_MAX_MSG_HANDLES          ((uint32_t)64u)
 
+// Option for zx_channel_create(): also create a ring VMO that both endpoints
+// can map with zx_channel_get_ring().  The VMO holds a control area followed
+// by one data area per direction; the endpoint given side 0 writes into the
+// first data area and reads from the second.
+#define ZX_CHANNEL_RING                     ((uint32_t)1u)
+
+#define ZX_CHANNEL_RING_CONTROL_SIZE        ((uint32_t)4096u)
+#define ZX_CHANNEL_RING_SIZE                ((uint32_t)65536u)
+
 // Socket options and limits.
 // These options can be passed to zx_socket_shutdown()
 #define ZX_SOCKET_SHUTDOWN_WRITE            ((uint32_t)1u << 0)
@@ -348,7 +363,8 @@ typedef uint32_t zx_obj_type_t;
 #define ZX_OBJ_TYPE_PROFILE         ((zx_obj_type_t)25u)
 #define ZX_OBJ_TYPE_PMT             ((zx_obj_type_t)26u)
 #define ZX_OBJ_TYPE_SUSPEND_TOKEN   ((zx_obj_type_t)27u)
-#define ZX_OBJ_TYPE_LAST            ((zx_obj_type_t)28u)
+#define ZX_OBJ_TYPE_PAGER           ((zx_obj_type_t)28u)
+#define ZX_OBJ_TYPE_LAST            ((zx_obj_type_t)29u)
 
 typedef struct zx_handle_info {
     zx_handle_t handle;
@@ -12,6 +12,8 @@
 
 #include <fbl/algorithm.h>
 #include <fbl/unique_ptr.h>
+#include <lib/fzl/channel-ring.h>
+#include <lib/zx/channel.h>
 #include <zircon/compiler.h>
 #include <zircon/syscalls.h>
 #include <zircon/time.h>
@@ -34,6 +36,56 @@ struct TestArgs {
     uint32_t size;
     uint32_t handles;
     uint32_t queue;
+    // Exchange messages through the channel's shared ring (ZX_CHANNEL_RING).
+    bool ring = false;
+};
+
+// Writes to |mp[0]| and reads from |mp[1]|, either directly or through their
+// rings.
+class Endpoints {
+public:
+    explicit Endpoints(bool ring) : ring_(ring) {
+        __UNUSED zx_status_t status =
+            zx_channel_create(ring ? ZX_CHANNEL_RING : 0u, &mp_[0], &mp_[1]);
+        assert(status == ZX_OK);
+        if (ring_) {
+            status = rings_[0].Init(zx::channel(mp_[0]));
+            assert(status == ZX_OK);
+            status = rings_[1].Init(zx::channel(mp_[1]));
+            assert(status == ZX_OK);
+        }
+    }
+
+    ~Endpoints() {
+        if (!ring_) {
+            __UNUSED zx_status_t status = zx_handle_close(mp_[0]);
+            assert(status == ZX_OK);
+            status = zx_handle_close(mp_[1]);
+            assert(status == ZX_OK);
+        }
+    }
+
+    zx_status_t Write(const void* bytes, uint32_t num_bytes,
+                      const zx_handle_t* handles, uint32_t num_handles) {
+        if (ring_)
+            return rings_[0].Write(bytes, num_bytes, handles, num_handles);
+        return zx_channel_write(mp_[0], 0u, bytes, num_bytes, handles, num_handles);
+    }
+
+    zx_status_t Read(void* bytes, zx_handle_t* handles, uint32_t num_bytes, uint32_t num_handles,
+                     uint32_t* actual_bytes, uint32_t* actual_handles) {
+        if (ring_)
+            return rings_[1].Read(bytes, handles, num_bytes, num_handles,
+                                  actual_bytes, actual_handles);
+        return zx_channel_read(mp_[1], 0u, bytes, handles, num_bytes, num_handles,
+                               actual_bytes, actual_handles);
+    }
+
+private:
+    const bool ring_;
+    // Owned by |rings_| in ring mode.
+    zx_handle_t mp_[2] = {ZX_HANDLE_INVALID, ZX_HANDLE_INVALID};
+    fzl::ChannelRing rings_[2];
 };
 
 void do_test(uint32_t duration_sec, const TestArgs& test_args) {
@@ -41,10 +93,7 @@ void do_test(uint32_t duration_sec, const TestArgs& test_args) {
 
     zx_duration_t duration_ns = ZX_SEC(duration_sec);
 
-    // We'll write to mp[0] (and read from mp[1]).
-    zx_handle_t mp[2] = {ZX_HANDLE_INVALID, ZX_HANDLE_INVALID};
-    status = zx_channel_create(0u, &mp[0], &mp[1]);
-    assert(status == ZX_OK);
+    Endpoints mp(test_args.ring);
 
     // We'll send/receive duplicates of this handle.
     zx_handle_t event;
@@ -65,8 +114,7 @@ void do_test(uint32_t duration_sec, const TestArgs& test_args) {
     // Pre-queue |test_args.queue| messages (there'll always be this many messages in the queue).
     for (uint32_t i = 0; i < test_args.queue; i++) {
         duplicate_handles(test_args.handles, event, handles.get());
-        status = zx_channel_write(mp[0], 0u, data.get(), test_args.size,
-                                  handles.get(), test_args.handles);
+        status = mp.Write(data.get(), test_args.size, handles.get(), test_args.handles);
         assert(status == ZX_OK);
     }
 
@@ -79,14 +127,12 @@ void do_test(uint32_t duration_sec, const TestArgs& test_args) {
     for (;;) {
         big_its++;
         for (uint32_t i = 0; i < big_it_size; i++) {
-            status = zx_channel_write(mp[0], 0, data.get(), test_args.size,
-                                      handles.get(), test_args.handles);
+            status = mp.Write(data.get(), test_args.size, handles.get(), test_args.handles);
             assert(status == ZX_OK);
 
             uint32_t r_size = test_args.size;
             uint32_t r_handles = test_args.handles;
-            status = zx_channel_read(mp[1], 0u, data.get(), handles.get(), r_size,
-                                     r_handles, &r_size, &r_handles);
+            status = mp.Read(data.get(), handles.get(), r_size, r_handles, &r_size, &r_handles);
             assert(status == ZX_OK);
             assert(r_size == test_args.size);
             assert(r_handles == test_args.handles);
@@ -103,16 +149,14 @@ void do_test(uint32_t duration_sec, const TestArgs& test_args) {
     }
     status = zx_handle_close(event);
     assert(status == ZX_OK);
-    status = zx_handle_close(mp[0]);
-    assert(status == ZX_OK);
-    status = zx_handle_close(mp[1]);
-    assert(status == ZX_OK);
 
     double real_duration = static_cast<double>(zx_time_sub_time(end_ns, start_ns)) / 1000000000.0;
     double its_per_second = static_cast<double>(big_its) * big_it_size / real_duration;
-    printf("write/read %" PRIu32 " bytes, %" PRIu32 " handles (%" PRIu32 " pre-queued): "
-               "%.0f iterations/second\n",
-           test_args.size, test_args.handles, test_args.queue, its_per_second);
+    printf("write/read %" PRIu32 " bytes, %" PRIu32 " handles (%" PRIu32 " pre-queued%s): "
+               "%.0f iterations/second (%.0f ns/iteration)\n",
+           test_args.size, test_args.handles, test_args.queue, test_args.ring ? ", ring" : "",
+           its_per_second,
+           1000000000.0 / its_per_second);
 }
 
 }  // namespace
@@ -124,12 +168,13 @@ int main(int argc, char** argv) {
         "Options:\n"
         "  -h    show help (this)\n"
         "  -o    run single test (default)\n"
-        "  -s    run suite (ignores -S/-H/-Q)\n"
+        "  -s    run suite (ignores -S/-H/-Q/-r)\n"
         "  -n N  set test repetition count to N (default: 1)\n"
         "  -d N  set test duration to N seconds (default: 5)\n"
         "  -S N  set message size to N bytes (default: 10)\n"
         "  -H N  set message handle count to N handles (default: 0)\n"
-        "  -Q N  set message pre-queue count to N messages (default: 0)\n";
+        "  -Q N  set message pre-queue count to N messages (default: 0)\n"
+        "  -r    use the channel's shared ring (default: off)\n";
 
     bool run_suite = false;  // -o/-s
     uint32_t duration = 5;   // -d
@@ -138,11 +183,12 @@ int main(int argc, char** argv) {
     TestArgs test_args = {
         10,                  // -S (size)
         0,                   // -H (handles)
-        0                    // -Q (queue)
+        0,                   // -Q (queue)
+        false                // -r (ring)
     };
 
     int opt;
-    while ((opt = getopt(argc, argv, "+hosn:d:S:H:Q:")) != -1) {
+    while ((opt = getopt(argc, argv, "+hosrn:d:S:H:Q:")) != -1) {
         // Our option values are always unsigned numbers.
         uint32_t value = 0;
         if (optarg) {
@@ -164,6 +210,9 @@ int main(int argc, char** argv) {
             case 's':
                 run_suite = true;
                 break;
+            case 'r':
+                test_args.ring = true;
+                break;
             case 'n':
                 assert(optarg);
                 repeats = value;
@@ -201,6 +250,9 @@ int main(int argc, char** argv) {
         }
 
         if (run_suite) {
+            // The kernel keeps messages of up to about 2000 bytes (less 8 bytes per handle) in
+            // slab objects and larger ones in whole pages, so 1900 and 2100 byte messages
+            // straddle the two allocation paths.
             static constexpr TestArgs suite[] = {
                 {10, 0, 0},
                 {100, 0, 0},
@@ -217,6 +269,20 @@ int main(int argc, char** argv) {
                 {10, 0, 1},
                 {100, 0, 1},
                 {1000, 0, 1},
+                {1900, 0, 0},
+                {2100, 0, 0},
+                {1900, 0, 1},
+                {2100, 0, 1},
+                // Small and medium messages through the shared ring, and one
+                // with a handle, which still has to go through the channel.
+                {10, 0, 0, true},
+                {100, 0, 0, true},
+                {1000, 0, 0, true},
+                {4000, 0, 0, true},
+                {16000, 0, 0, true},
+                {10, 0, 1, true},
+                {1000, 0, 1, true},
+                {10, 1, 0, true},
             };
             for (size_t i = 0; i < fbl::count_of(suite); i++)
                 do_test(duration, suite[i]);
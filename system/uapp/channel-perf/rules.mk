@@ -13,6 +13,6 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/main.cpp \
 
 MODULE_LIBS := system/ulib/zircon system/ulib/fdio system/ulib/c
-MODULE_STATIC_LIBS := system/ulib/zxcpp system/ulib/fbl
+MODULE_STATIC_LIBS := system/ulib/zxcpp system/ulib/fbl system/ulib/fzl system/ulib/zx
 
 include make/module.mk
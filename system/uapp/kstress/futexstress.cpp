@@ -0,0 +1,228 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/algorithm.h>
+#include <fbl/unique_ptr.h>
+#include <lib/zx/time.h>
+#include <zircon/status.h>
+#include <zircon/syscalls.h>
+
+#include <assert.h>
+#include <atomic>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "stress_test.h"
+
+namespace {
+
+// number of waiting threads (and futexes) per cpu, and the overall cap
+constexpr uint32_t kFutexesPerCpu = 16;
+constexpr uint32_t kMaxFutexes = 1024;
+
+// upper bound on the number of waking threads
+constexpr uint32_t kMaxWakers = 32;
+
+} // namespace
+
+class FutexStressTest : public StressTest {
+public:
+    FutexStressTest() = default;
+    virtual ~FutexStressTest() = default;
+
+    virtual zx_status_t Start();
+    virtual zx_status_t Stop();
+
+    virtual const char* name() const { return "Futex Stress"; }
+
+private:
+    // one futex with a single thread blocked on it; the waker stamps the time
+    // just before waking so the waiter can measure how long the wakeup took
+    struct alignas(64) Futex {
+        std::atomic<int> state{0};
+        std::atomic<zx_time_t> wake_time{0};
+        std::atomic<uint64_t> wakeups{0};
+        std::atomic<uint64_t> total_latency{0};
+        std::atomic<uint64_t> max_latency{0};
+        thrd_t thread{};
+    };
+
+    int waiter_thread(uint32_t index);
+    int waker_thread(uint32_t index);
+    int control_thread();
+
+    Futex futexes_[kMaxFutexes]{};
+    uint32_t num_futexes_{};
+    thrd_t wakers_[kMaxWakers]{};
+    uint32_t num_wakers_{};
+    thrd_t control_thread_{};
+
+    // used by the worker threads at runtime
+    std::atomic<bool> shutdown_{false};
+};
+
+// our singleton
+FutexStressTest futexstress;
+
+// Futex Stresser
+//
+// Blocks one thread on each of N distinct futexes while a smaller set of waker
+// threads, one per pair of cpus, sweeps across them waking every futex whose
+// thread has gone back to sleep. Every futex is only ever touched by its own
+// waiter and one waker, so the kernel's futex table is the only shared state.
+//
+// Reports the aggregate wakeup rate along with the average and worst latency
+// from zx_futex_wake() to the woken thread running again.
+
+int FutexStressTest::waiter_thread(uint32_t index) {
+    Futex& f = futexes_[index];
+    auto futex = reinterpret_cast<zx_futex_t*>(&f.state);
+
+    while (!shutdown_.load()) {
+        if (f.state.load() == 0) {
+            // bounded wait so we notice the shutdown
+            zx_futex_wait(futex, 0, zx_deadline_after(ZX_MSEC(10)));
+            continue;
+        }
+
+        uint64_t latency = zx_clock_get_monotonic() - f.wake_time.load();
+        f.total_latency.fetch_add(latency, std::memory_order_relaxed);
+        uint64_t max = f.max_latency.load(std::memory_order_relaxed);
+        while (latency > max &&
+               !f.max_latency.compare_exchange_weak(max, latency, std::memory_order_relaxed)) {
+        }
+        f.wakeups.fetch_add(1, std::memory_order_relaxed);
+
+        // go back to sleep
+        f.state.store(0);
+    }
+
+    return 0;
+}
+
+int FutexStressTest::waker_thread(uint32_t index) {
+    while (!shutdown_.load()) {
+        // each waker owns every num_wakers_'th futex
+        for (uint32_t i = index; i < num_futexes_; i += num_wakers_) {
+            Futex& f = futexes_[i];
+            if (f.state.load() != 0) {
+                continue;
+            }
+
+            f.wake_time.store(zx_clock_get_monotonic());
+            f.state.store(1);
+            zx_futex_wake(reinterpret_cast<zx_futex_t*>(&f.state), 1);
+        }
+    }
+
+    return 0;
+}
+
+int FutexStressTest::control_thread() {
+    uint64_t last_wakeups = 0;
+    uint64_t last_latency = 0;
+
+    while (!shutdown_.load()) {
+        zx::time start = zx::clock::get_monotonic();
+        zx::nanosleep(zx::deadline_after(zx::sec(2)));
+        zx::duration elapsed = zx::clock::get_monotonic() - start;
+
+        if (shutdown_.load()) {
+            break;
+        }
+
+        uint64_t wakeups = 0;
+        uint64_t latency = 0;
+        uint64_t max_latency = 0;
+        for (uint32_t i = 0; i < num_futexes_; i++) {
+            wakeups += futexes_[i].wakeups.load(std::memory_order_relaxed);
+            latency += futexes_[i].total_latency.load(std::memory_order_relaxed);
+            max_latency = fbl::max(max_latency, futexes_[i].max_latency.exchange(0));
+        }
+
+        uint64_t count = wakeups - last_wakeups;
+        uint64_t avg = count ? (latency - last_latency) / count : 0;
+        last_wakeups = wakeups;
+        last_latency = latency;
+
+        PrintfAlways("futex stress: %u futexes, %" PRIu64 " wakeups/sec, "
+                     "wake latency avg %" PRIu64 " ns, max %" PRIu64 " ns\n",
+                     num_futexes_, count * ZX_SEC(1) / elapsed.get(), avg, max_latency);
+    }
+
+    return 0;
+}
+
+zx_status_t FutexStressTest::Start() {
+    num_futexes_ = fbl::min(num_cpus_ * kFutexesPerCpu, kMaxFutexes);
+    num_wakers_ = fbl::clamp(num_cpus_ / 2, 1u, kMaxWakers);
+
+    PrintfAlways("Futex stress test: %u waiting threads, %u waking threads\n",
+                 num_futexes_, num_wakers_);
+
+    struct WorkerArgs {
+        FutexStressTest* test;
+        uint32_t index;
+    };
+
+    auto waiter = [](void* arg) -> int {
+        fbl::unique_ptr<WorkerArgs> args(static_cast<WorkerArgs*>(arg));
+
+        return args->test->waiter_thread(args->index);
+    };
+
+    for (uint32_t i = 0; i < num_futexes_; i++) {
+        auto args = new WorkerArgs{this, i};
+        if (thrd_create_with_name(&futexes_[i].thread, waiter, args,
+                                  "futexstress_waiter") != thrd_success) {
+            delete args;
+            return ZX_ERR_NO_RESOURCES;
+        }
+    }
+
+    auto waker = [](void* arg) -> int {
+        fbl::unique_ptr<WorkerArgs> args(static_cast<WorkerArgs*>(arg));
+
+        return args->test->waker_thread(args->index);
+    };
+
+    for (uint32_t i = 0; i < num_wakers_; i++) {
+        auto args = new WorkerArgs{this, i};
+        if (thrd_create_with_name(&wakers_[i], waker, args,
+                                  "futexstress_waker") != thrd_success) {
+            delete args;
+            return ZX_ERR_NO_RESOURCES;
+        }
+    }
+
+    auto control = [](void* arg) -> int {
+        FutexStressTest* test = static_cast<FutexStressTest*>(arg);
+
+        return test->control_thread();
+    };
+
+    if (thrd_create_with_name(&control_thread_, control, this,
+                              "futexstress_control") != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+
+    return ZX_OK;
+}
+
+zx_status_t FutexStressTest::Stop() {
+    shutdown_.store(true);
+
+    thrd_join(control_thread_, nullptr);
+    for (uint32_t i = 0; i < num_wakers_; i++) {
+        thrd_join(wakers_[i], nullptr);
+    }
+    for (uint32_t i = 0; i < num_futexes_; i++) {
+        thrd_join(futexes_[i].thread, nullptr);
+    }
+
+    return ZX_OK;
+}
@@ -10,6 +10,7 @@ MODULE_TYPE := userapp
 MODULE_GROUP := misc
 
 MODULE_SRCS += \
+    $(LOCAL_DIR)/futexstress.cpp \
     $(LOCAL_DIR)/main.cpp \
     $(LOCAL_DIR)/stress_test.cpp \
     $(LOCAL_DIR)/vmstress.cpp
@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <zircon/assert.h>
 #include <zircon/listnode.h>
@@ -26,6 +27,9 @@
 // The port wait key associated with the dispatcher's control messages.
 #define KEY_CONTROL (0u)
 
+// The most packets read from the port by a single |zx_port_wait_many| call.
+#define PORT_BATCH_SIZE (16u)
+
 static zx_time_t async_loop_now(async_dispatcher_t* dispatcher);
 static zx_status_t async_loop_begin_wait(async_dispatcher_t* dispatcher, async_wait_t* wait);
 static zx_status_t async_loop_cancel_wait(async_dispatcher_t* dispatcher, async_wait_t* wait);
@@ -90,6 +94,11 @@ typedef struct async_loop {
     list_node_t due_list; // due tasks, earliest deadline first
     list_node_t thread_list; // earliest created thread first
     list_node_t exception_list; // most recently added first
+
+    // Packets read from the port but not yet dispatched, earliest first.
+    zx_port_packet_t pending_packets[PORT_BATCH_SIZE];
+    size_t pending_head; // index of the next packet to dispatch
+    size_t pending_count; // number of packets after |pending_head|
 } async_loop_t;
 
 static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline);
@@ -109,6 +118,9 @@ static zx_status_t async_loop_dispatch_exception(async_loop_t* loop,
                                                  zx_status_t status,
                                                  const zx_port_packet_t* report);
 static void async_loop_wake_threads(async_loop_t* loop);
+static zx_status_t async_loop_read_packet(async_loop_t* loop, zx_time_t deadline,
+                                          zx_port_packet_t* out_packet);
+static bool async_loop_drop_pending_wait_locked(async_loop_t* loop, async_wait_t* wait);
 static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task);
 static void async_loop_restart_timer_locked(async_loop_t* loop);
 static void async_loop_invoke_prologue(async_loop_t* loop);
@@ -259,7 +271,7 @@ static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
         return ZX_ERR_CANCELED;
 
     zx_port_packet_t packet;
-    zx_status_t status = zx_port_wait(loop->port, deadline, &packet);
+    zx_status_t status = async_loop_read_packet(loop, deadline, &packet);
     if (status != ZX_OK)
         return status;
 
@@ -308,6 +320,74 @@ static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
     return ZX_ERR_INTERNAL;
 }
 
+// Reads the next packet to dispatch.  A loop being run by a single thread
+// reads up to PORT_BATCH_SIZE packets from the port at a time and hands out
+// the surplus on later calls, saving a syscall per packet when busy.  Loops
+// being run by several threads read one packet at a time so that the
+// packets are spread between the threads.
+static zx_status_t async_loop_read_packet(async_loop_t* loop, zx_time_t deadline,
+                                          zx_port_packet_t* out_packet) {
+    mtx_lock(&loop->lock);
+    if (loop->pending_count) {
+        *out_packet = loop->pending_packets[loop->pending_head];
+        loop->pending_head++;
+        loop->pending_count--;
+        mtx_unlock(&loop->lock);
+        return ZX_OK;
+    }
+    mtx_unlock(&loop->lock);
+
+    if (atomic_load_explicit(&loop->active_threads, memory_order_acquire) > 1u)
+        return zx_port_wait(loop->port, deadline, out_packet);
+
+    zx_port_packet_t packets[PORT_BATCH_SIZE];
+    size_t actual;
+    zx_status_t status = zx_port_wait_many(loop->port, deadline, packets,
+                                           PORT_BATCH_SIZE, &actual);
+    if (status != ZX_OK)
+        return status;
+    *out_packet = packets[0];
+    if (actual == 1u)
+        return ZX_OK;
+
+    // Nothing else can have filled the stash while we waited: any thread
+    // which started reading since then saw us in |active_threads| and read a
+    // single packet instead.
+    mtx_lock(&loop->lock);
+    ZX_DEBUG_ASSERT(loop->pending_count == 0u);
+    memcpy(loop->pending_packets, packets + 1, (actual - 1u) * sizeof(zx_port_packet_t));
+    loop->pending_head = 0u;
+    loop->pending_count = actual - 1u;
+    mtx_unlock(&loop->lock);
+
+    // A thread which joined while we were waiting may now be blocked on the
+    // port, unaware of the packets we are holding.  Wake it so it can help.
+    if (atomic_load_explicit(&loop->active_threads, memory_order_acquire) > 1u) {
+        zx_port_packet_t packet = {
+            .key = KEY_CONTROL,
+            .type = ZX_PKT_TYPE_USER,
+            .status = ZX_OK};
+        zx_status_t status = zx_port_queue(loop->port, &packet);
+        ZX_ASSERT_MSG(status == ZX_OK, "zx_port_queue: status=%d", status);
+    }
+    return ZX_OK;
+}
+
+// Removes |wait|'s completion packet from the packets read from the port but
+// not yet dispatched, if it is there.
+static bool async_loop_drop_pending_wait_locked(async_loop_t* loop, async_wait_t* wait) {
+    for (size_t i = 0; i < loop->pending_count; i++) {
+        zx_port_packet_t* packet = &loop->pending_packets[loop->pending_head + i];
+        if (packet->key != (uintptr_t)wait || packet->type != ZX_PKT_TYPE_SIGNAL_ONE)
+            continue;
+        memmove(packet, packet + 1,
+                (loop->pending_count - i - 1u) * sizeof(zx_port_packet_t));
+        loop->pending_count--;
+        return true;
+    }
+    return false;
+}
+
 async_dispatcher_t* async_loop_get_dispatcher(async_loop_t* loop) {
     // Note: The loop's implementation inherits from async_t so we can upcast to it.
     return (async_dispatcher_t*)loop;
@@ -533,6 +613,13 @@ static zx_status_t async_loop_cancel_wait(async_dispatcher_t* async, async_wait_
     } else {
         ZX_ASSERT_MSG(status == ZX_ERR_NOT_FOUND,
                       "zx_port_cancel: status=%d", status);
+        // The packet may have been read from the port along with others
+        // which have not all been dispatched yet, in which case it is still
+        // ours to cancel.
+        if (async_loop_drop_pending_wait_locked(loop, wait)) {
+            list_delete(node);
+            status = ZX_OK;
+        }
     }
 
     mtx_unlock(&loop->lock);
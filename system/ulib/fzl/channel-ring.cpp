@@ -0,0 +1,295 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/fzl/channel-ring.h>
+
+#include <atomic>
+#include <string.h>
+#include <utility>
+
+#include <fbl/algorithm.h>
+#include <lib/zx/vmo.h>
+#include <zircon/syscalls.h>
+
+namespace fzl {
+
+namespace {
+
+constexpr uint32_t kRingSize = ZX_CHANNEL_RING_SIZE;
+static_assert(fbl::is_pow2(kRingSize), "ring indices wrap modulo the ring size");
+
+// Every record starts with a header and is padded to a multiple of its size,
+// so a header always fits in front of the end of the ring.
+struct RecordHeader {
+    uint32_t size;
+    uint32_t flags;
+};
+
+// The rest of the ring, up to its end, is padding.
+constexpr uint32_t kRecordWrap = 1u << 0;
+// The message is the next one queued on the channel.
+constexpr uint32_t kRecordOnChannel = 1u << 1;
+
+constexpr uint32_t RecordSize(uint32_t num_bytes) {
+    return static_cast<uint32_t>(sizeof(RecordHeader) +
+                                 fbl::round_up(num_bytes, sizeof(RecordHeader)));
+}
+
+// Ring bytes needed to append a record of |size| bytes at |head|, including
+// any padding to wrap back to the start.
+uint32_t Needed(uint32_t head, uint32_t size) {
+    uint32_t contiguous = kRingSize - head % kRingSize;
+    return size > contiguous ? contiguous + size : size;
+}
+
+// Even a padded maximum-size record fits once this much is free.
+constexpr uint32_t kWritableSpace = 2 * RecordSize(ChannelRing::kMaxInlineBytes);
+static_assert(kWritableSpace <= kRingSize, "");
+
+constexpr zx_signals_t kWakeSignal = ZX_USER_SIGNAL_0;
+
+} // namespace
+
+// Head and tail are free-running byte counts. Only the producer writes |head|
+// and only the consumer writes |tail|, so they get a cache line each.
+struct ChannelRing::Ring {
+    alignas(64) std::atomic<uint32_t> head;
+    alignas(64) std::atomic<uint32_t> tail;
+};
+
+// Lives at the start of the ring VMO. Ring i carries the messages written by
+// the endpoint on side i.
+struct ChannelRing::Control {
+    Ring rings[2];
+    // Set by the endpoint on side i while it is, or is about to be, blocked
+    // in Wait(); whoever clears it must signal that endpoint.
+    alignas(64) std::atomic<uint32_t> waiting[2];
+};
+
+zx_status_t ChannelRing::Init(zx::channel channel) {
+    static_assert(sizeof(Control) <= ZX_CHANNEL_RING_CONTROL_SIZE, "");
+
+    if (control_ != nullptr) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    zx::vmo vmo;
+    uint32_t side;
+    zx_status_t status = zx_channel_get_ring(channel.get(), 0, vmo.reset_and_get_address(),
+                                             &side);
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (side > 1) {
+        return ZX_ERR_INTERNAL;
+    }
+
+    status = mapping_.Map(vmo, 0, ZX_CHANNEL_RING_CONTROL_SIZE + 2 * uint64_t{kRingSize},
+                          ZX_VM_PERM_READ | ZX_VM_PERM_WRITE);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    channel_ = std::move(channel);
+    control_ = static_cast<Control*>(mapping_.start());
+    side_ = side;
+    return ZX_OK;
+}
+
+ChannelRing::Ring* ChannelRing::ring(uint32_t side) const {
+    return &control_->rings[side];
+}
+
+uint8_t* ChannelRing::data(uint32_t side) const {
+    return static_cast<uint8_t*>(mapping_.start()) + ZX_CHANNEL_RING_CONTROL_SIZE +
+           side * kRingSize;
+}
+
+bool ChannelRing::Fits(uint32_t num_bytes) const {
+    Ring* r = ring(side_);
+    uint32_t head = r->head.load(std::memory_order_relaxed);
+    uint32_t tail = r->tail.load(std::memory_order_acquire);
+    return kRingSize - (head - tail) >= Needed(head, RecordSize(num_bytes));
+}
+
+bool ChannelRing::Ready(bool readable) const {
+    if (readable) {
+        Ring* r = ring(1 - side_);
+        return r->head.load(std::memory_order_acquire) != r->tail.load(std::memory_order_relaxed);
+    }
+    Ring* r = ring(side_);
+    return kRingSize - (r->head.load(std::memory_order_relaxed) -
+                        r->tail.load(std::memory_order_acquire)) >= kWritableSpace;
+}
+
+zx_status_t ChannelRing::Push(uint32_t flags, const void* bytes, uint32_t num_bytes) {
+    if (!Fits(num_bytes)) {
+        return ZX_ERR_SHOULD_WAIT;
+    }
+
+    Ring* r = ring(side_);
+    uint8_t* base = data(side_);
+    uint32_t head = r->head.load(std::memory_order_relaxed);
+    uint32_t size = RecordSize(num_bytes);
+    uint32_t offset = head % kRingSize;
+    if (size > kRingSize - offset) {
+        const RecordHeader wrap = {0, kRecordWrap};
+        memcpy(base + offset, &wrap, sizeof(wrap));
+        head += kRingSize - offset;
+        offset = 0;
+    }
+
+    const RecordHeader header = {num_bytes, flags};
+    memcpy(base + offset, &header, sizeof(header));
+    if (num_bytes > 0) {
+        memcpy(base + offset + sizeof(header), bytes, num_bytes);
+    }
+    r->head.store(head + size, std::memory_order_release);
+
+    WakePeer();
+    return ZX_OK;
+}
+
+zx_status_t ChannelRing::Write(const void* bytes, uint32_t num_bytes,
+                               const zx_handle_t* handles, uint32_t num_handles) {
+    if (control_ == nullptr) {
+        return ZX_ERR_BAD_STATE;
+    }
+    if (num_handles == 0 && num_bytes <= kMaxInlineBytes) {
+        return Push(0, bytes, num_bytes);
+    }
+
+    // Reserve the ring record first so that a message never sits on the
+    // channel without its place in the ring.
+    if (!Fits(0)) {
+        return ZX_ERR_SHOULD_WAIT;
+    }
+    zx_status_t status = channel_.write(0, bytes, num_bytes, handles, num_handles);
+    if (status != ZX_OK) {
+        return status;
+    }
+    return Push(kRecordOnChannel, nullptr, 0);
+}
+
+zx_status_t ChannelRing::Read(void* bytes, zx_handle_t* handles,
+                              uint32_t num_bytes, uint32_t num_handles,
+                              uint32_t* actual_bytes, uint32_t* actual_handles) {
+    if (control_ == nullptr) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    Ring* r = ring(1 - side_);
+    const uint8_t* base = data(1 - side_);
+    uint32_t tail = r->tail.load(std::memory_order_relaxed);
+    uint32_t head = r->head.load(std::memory_order_acquire);
+
+    // The peer may be in another process, so nothing read from the ring is
+    // trusted beyond what it takes to stay inside the mapping.
+    RecordHeader header;
+    uint32_t offset;
+    for (;;) {
+        if (head == tail) {
+            return ZX_ERR_SHOULD_WAIT;
+        }
+        offset = tail % kRingSize;
+        memcpy(&header, base + offset, sizeof(header));
+        if (header.flags != kRecordWrap) {
+            break;
+        }
+        if (head - tail < kRingSize - offset) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        tail += kRingSize - offset;
+    }
+    if (header.size > kMaxInlineBytes ||
+        RecordSize(header.size) > kRingSize - offset ||
+        RecordSize(header.size) > head - tail) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    switch (header.flags) {
+    case 0:
+        if (actual_bytes) {
+            *actual_bytes = header.size;
+        }
+        if (actual_handles) {
+            *actual_handles = 0;
+        }
+        if (header.size > num_bytes) {
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        if (header.size > 0) {
+            memcpy(bytes, base + offset + sizeof(header), header.size);
+        }
+        break;
+    case kRecordOnChannel: {
+        zx_status_t status = channel_.read(0, bytes, handles, num_bytes, num_handles,
+                                           actual_bytes, actual_handles);
+        if (status != ZX_OK) {
+            return status;
+        }
+        break;
+    }
+    default:
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    r->tail.store(tail + RecordSize(header.size), std::memory_order_release);
+
+    WakePeer();
+    return ZX_OK;
+}
+
+zx_status_t ChannelRing::WaitReadable(zx::time deadline) {
+    return Wait(true, deadline);
+}
+
+zx_status_t ChannelRing::WaitWritable(zx::time deadline) {
+    return Wait(false, deadline);
+}
+
+zx_status_t ChannelRing::Wait(bool readable, zx::time deadline) {
+    if (control_ == nullptr) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    std::atomic<uint32_t>& waiting = control_->waiting[side_];
+    for (;;) {
+        if (Ready(readable)) {
+            return ZX_OK;
+        }
+
+        // Clear any stale wakeup before advertising that we are about to
+        // block, and check again afterwards: the fence pairs with the one in
+        // WakePeer(), so either we see the peer's update or it sees |waiting|.
+        channel_.signal(kWakeSignal, 0);
+        waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (Ready(readable)) {
+            waiting.store(0, std::memory_order_relaxed);
+            return ZX_OK;
+        }
+
+        zx_signals_t observed = 0;
+        zx_status_t status = channel_.wait_one(kWakeSignal | ZX_CHANNEL_PEER_CLOSED,
+                                               deadline, &observed);
+        waiting.store(0, std::memory_order_relaxed);
+        if (status != ZX_OK) {
+            return status;
+        }
+        if (observed & ZX_CHANNEL_PEER_CLOSED) {
+            return readable && Ready(readable) ? ZX_OK : ZX_ERR_PEER_CLOSED;
+        }
+    }
+}
+
+void ChannelRing::WakePeer() {
+    std::atomic<uint32_t>& waiting = control_->waiting[1 - side_];
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed) && waiting.exchange(0)) {
+        // Fails only if the peer is gone, which it will notice by itself.
+        channel_.signal_peer(0, kWakeSignal);
+    }
+}
+
+} // namespace fzl
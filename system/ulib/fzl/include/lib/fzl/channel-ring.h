@@ -0,0 +1,71 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <fbl/macros.h>
+#include <lib/fzl/vmo-mapper.h>
+#include <lib/zx/channel.h>
+#include <lib/zx/time.h>
+#include <zircon/types.h>
+
+namespace fzl {
+
+// One endpoint of a channel created with ZX_CHANNEL_RING, exchanging messages
+// through the channel's ring VMO instead of zx_channel_write/zx_channel_read.
+//
+// Each direction of the ring has a single producer and a single consumer, so
+// an endpoint must only be used by one thread at a time, and both endpoints
+// must be driven through a ChannelRing. A write that fits in the ring and
+// carries no handles is a copy into shared memory; the kernel is only entered
+// to wake a peer that is blocked in Wait*(). Messages with handles, or larger
+// than kMaxInlineBytes, are written to the channel itself and the ring only
+// records their place in the message order.
+class ChannelRing {
+public:
+    static constexpr uint32_t kMaxInlineBytes = ZX_CHANNEL_RING_SIZE / 4;
+
+    ChannelRing() = default;
+    ~ChannelRing() = default;
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ChannelRing);
+
+    // Takes ownership of |channel| and maps its ring.
+    zx_status_t Init(zx::channel channel);
+
+    // Returns ZX_ERR_SHOULD_WAIT if the ring is full. Does not notice that the
+    // peer has gone away; WaitWritable() reports that if it has to block.
+    zx_status_t Write(const void* bytes, uint32_t num_bytes,
+                      const zx_handle_t* handles, uint32_t num_handles);
+
+    // Same contract as zx_channel_read() without ZX_CHANNEL_READ_MAY_DISCARD,
+    // except that an empty ring always returns ZX_ERR_SHOULD_WAIT.
+    zx_status_t Read(void* bytes, zx_handle_t* handles, uint32_t num_bytes, uint32_t num_handles,
+                     uint32_t* actual_bytes, uint32_t* actual_handles);
+
+    // Block until Read() or Write() can make progress. Return
+    // ZX_ERR_PEER_CLOSED once the peer is gone and nothing is left to do.
+    zx_status_t WaitReadable(zx::time deadline);
+    zx_status_t WaitWritable(zx::time deadline);
+
+    const zx::channel& channel() const { return channel_; }
+
+private:
+    struct Control;
+    struct Ring;
+
+    Ring* ring(uint32_t side) const;
+    uint8_t* data(uint32_t side) const;
+    bool Fits(uint32_t num_bytes) const;
+    bool Ready(bool readable) const;
+    zx_status_t Push(uint32_t flags, const void* bytes, uint32_t num_bytes);
+    zx_status_t Wait(bool readable, zx::time deadline);
+    void WakePeer();
+
+    zx::channel channel_;
+    VmoMapper mapping_;
+    Control* control_ = nullptr;
+    uint32_t side_ = 0;
+};
+
+} // namespace fzl
@@ -11,6 +11,7 @@ MODULE_TYPE := userlib
 MODULE_COMPILEFLAGS += -fvisibility=hidden
 
 MODULE_SRCS += \
+    $(LOCAL_DIR)/channel-ring.cpp \
     $(LOCAL_DIR)/memory-probe.cpp \
     $(LOCAL_DIR)/owned-vmo-mapper.cpp \
     $(LOCAL_DIR)/pinned-vmo.cpp \
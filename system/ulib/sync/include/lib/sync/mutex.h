@@ -22,16 +22,37 @@ __BEGIN_CDECLS
 typedef struct __TA_CAPABILITY("mutex") sync_mutex {
     zx_futex_t futex;
 
+    // How long a contended lock spins before sleeping; see
+    // |sync_mutex_set_spin_count|.
+    uint32_t spin_count;
+
 #ifdef __cplusplus
     sync_mutex()
-        : futex(0) {}
+        : futex(0), spin_count(0) {}
+
+    explicit sync_mutex(uint32_t spin_count)
+        : futex(0), spin_count(spin_count) {}
 #endif
 } sync_mutex_t;
 
 #if !defined(__cplusplus)
 #define SYNC_MUTEX_INIT ((sync_mutex_t){0})
+#define SYNC_MUTEX_INIT_WITH_SPIN(n) ((sync_mutex_t){.futex = 0, .spin_count = (n)})
 #endif
 
+// A spin budget that suits mutexes held for a few hundred cycles at a time.
+#define SYNC_MUTEX_SHORT_SPIN_COUNT 256u
+
+// Sets how many pauses a lock of |mutex| spends waiting for the holder to
+// release it before sleeping.
+//
+// Mutexes start with a budget of 0 and sleep right away. Spinning only pays
+// off when the holder is running on another cpu and about to release the
+// mutex, and otherwise burns cpu time the holder might need, so only mutexes
+// known to guard short critical sections should spin. Set the budget before
+// the mutex is shared with other threads.
+void sync_mutex_set_spin_count(sync_mutex_t* mutex, uint32_t spin_count);
+
 // Locks the mutex.
 //
 // The current thread will block until the mutex is acquired. The mutex is
@@ -67,6 +88,29 @@ zx_status_t sync_mutex_trylock(sync_mutex_t* mutex);
 // Does nothing if the mutex is already unlocked.
 void sync_mutex_unlock(sync_mutex_t* mutex) __TA_RELEASE(mutex);
 
+// Priority inheriting locking.
+//
+// These lock and unlock the mutex like the functions above, except that while
+// a thread is blocked waiting for the mutex, the thread holding it runs at no
+// less than the waiter's priority. This avoids priority inversion when threads
+// of different priorities share the mutex.
+//
+// The mutex records the handle of the thread holding it, so a mutex used with
+// these functions must only ever be locked and unlocked with them, and cannot
+// be used with a |sync_condition_t|.
+
+// Locks the mutex, with priority inheritance.
+void sync_mutex_lock_pi(sync_mutex_t* mutex) __TA_ACQUIRE(mutex);
+
+// Attempts to lock the mutex until |deadline|, with priority inheritance.
+//
+// Returns |ZX_OK| if the lock is acquired, |ZX_ERR_TIMED_OUT| if the deadline
+// passes, and |ZX_ERR_INVALID_ARGS| if the calling thread already holds it.
+zx_status_t sync_mutex_timedlock_pi(sync_mutex_t* mutex, zx_time_t deadline);
+
+// Unlocks a mutex locked with |sync_mutex_lock_pi| or |sync_mutex_timedlock_pi|.
+void sync_mutex_unlock_pi(sync_mutex_t* mutex) __TA_RELEASE(mutex);
+
 __END_CDECLS
 
 #endif // LIB_SYNC_MUTEX_H_
@@ -4,8 +4,10 @@
 
 #include <lib/sync/mutex.h>
 
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <stdatomic.h>
+#include <stdbool.h>
 
 // This mutex implementation is based on Ulrich Drepper's paper "Futexes
 // Are Tricky" (dated November 5, 2011; see
@@ -21,6 +23,66 @@ enum {
     LOCKED_WITH_WAITERS = 2
 };
 
+// The longest run of pauses between looks at the mutex while spinning.
+#define MAX_BACKOFF 32u
+
+static inline void spin(void) {
+#if defined(__x86_64__)
+    __asm__ __volatile__("pause"
+                         :
+                         :
+                         : "memory");
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield"
+                         :
+                         :
+                         : "memory");
+#else
+#error Please define spin() for your architecture
+#endif
+}
+
+// Before sleeping on a contended mutex, spend up to |spin_count| pauses
+// waiting for the holder to release it, on the bet that a short critical
+// section will end sooner than a futex wait and wakeup would take. The
+// pauses between looks at the mutex double each time, so a long wait doesn't
+// hammer the cache line. Only once the budget is spent is the cpu yielded,
+// in case the holder is waiting to run here, before one last look.
+//
+// Returns true if the mutex was acquired. Otherwise |*old_state| holds the
+// last state seen.
+static bool spin_lock(sync_mutex_t* mutex, uint32_t spin_count, int* old_state) {
+    uint32_t backoff = 1;
+    uint32_t spins = 0;
+    bool yielded = false;
+    for (;;) {
+        if (*old_state == UNLOCKED) {
+            if (atomic_compare_exchange_strong(&mutex->futex, old_state,
+                                               LOCKED_WITHOUT_WAITERS)) {
+                return true;
+            }
+            continue;
+        }
+
+        if (spins < spin_count) {
+            for (uint32_t i = 0; i < backoff; i++) {
+                spin();
+            }
+            spins += backoff;
+            if (backoff < MAX_BACKOFF) {
+                backoff <<= 1;
+            }
+        } else if (!yielded) {
+            _zx_nanosleep(0);
+            yielded = true;
+        } else {
+            return false;
+        }
+
+        *old_state = atomic_load_explicit(&mutex->futex, memory_order_relaxed);
+    }
+}
+
 // On success, this will leave the mutex in the LOCKED_WITH_WAITERS state.
 static zx_status_t lock_slow_path(sync_mutex_t* mutex, zx_time_t deadline,
                                   int old_state) {
@@ -58,6 +120,10 @@ zx_status_t sync_mutex_trylock(sync_mutex_t* mutex) {
     return ZX_ERR_BAD_STATE;
 }
 
+void sync_mutex_set_spin_count(sync_mutex_t* mutex, uint32_t spin_count) {
+    mutex->spin_count = spin_count;
+}
+
 zx_status_t sync_mutex_timedlock(sync_mutex_t* mutex, zx_time_t deadline) {
     // Try to claim the mutex.  This compare-and-swap executes the full
     // memory barrier that locking a mutex is required to execute.
@@ -66,6 +132,9 @@ zx_status_t sync_mutex_timedlock(sync_mutex_t* mutex, zx_time_t deadline) {
                                        LOCKED_WITHOUT_WAITERS)) {
         return ZX_OK;
     }
+    if (mutex->spin_count > 0 && spin_lock(mutex, mutex->spin_count, &old_state)) {
+        return ZX_OK;
+    }
     return lock_slow_path(mutex, deadline, old_state);
 }
 
@@ -122,3 +191,82 @@ void sync_mutex_unlock(sync_mutex_t* mutex) __TA_NO_THREAD_SAFETY_ANALYSIS {
             break;
     }
 }
+
+// Priority inheriting mutexes store the handle of the thread that holds them
+// instead of LOCKED_WITHOUT_WAITERS, so that waiters can tell the kernel which
+// thread to boost.  Handle values always have their low bit set; clearing it
+// takes the place of LOCKED_WITH_WAITERS.
+#define PI_NO_WAITERS_BIT 1
+
+zx_status_t sync_mutex_timedlock_pi(sync_mutex_t* mutex, zx_time_t deadline) {
+    const zx_handle_t self = _zx_thread_self();
+
+    int old_state = UNLOCKED;
+    if (atomic_compare_exchange_strong(&mutex->futex, &old_state, (int)self)) {
+        return ZX_OK;
+    }
+
+    for (;;) {
+        if (old_state == UNLOCKED) {
+            // As in lock_slow_path(), claim the mutex as contested, since
+            // other threads may still be waiting.
+            if (atomic_compare_exchange_strong(&mutex->futex, &old_state,
+                                               (int)self & ~PI_NO_WAITERS_BIT)) {
+                return ZX_OK;
+            }
+            continue;
+        }
+
+        if (old_state & PI_NO_WAITERS_BIT) {
+            if (!atomic_compare_exchange_strong(&mutex->futex, &old_state,
+                                                old_state & ~PI_NO_WAITERS_BIT)) {
+                continue;
+            }
+            old_state &= ~PI_NO_WAITERS_BIT;
+        }
+
+        zx_handle_t owner = (zx_handle_t)(old_state | PI_NO_WAITERS_BIT);
+        zx_status_t status = _zx_futex_wait_owner(&mutex->futex, old_state, owner, deadline);
+        if (status == ZX_ERR_BAD_HANDLE || status == ZX_ERR_WRONG_TYPE) {
+            // The owner's handle was closed, which happens when the thread
+            // exits, and its value may since have been reused for some other
+            // kind of object.  Wait without priority inheritance instead.
+            status = _zx_futex_wait(&mutex->futex, old_state, deadline);
+        }
+        if (status != ZX_OK && status != ZX_ERR_BAD_STATE) {
+            // ZX_ERR_TIMED_OUT, or ZX_ERR_INVALID_ARGS if this thread
+            // already holds the mutex.
+            return status;
+        }
+
+        old_state = atomic_load(&mutex->futex);
+    }
+}
+
+void sync_mutex_lock_pi(sync_mutex_t* mutex) __TA_NO_THREAD_SAFETY_ANALYSIS {
+    zx_status_t status = sync_mutex_timedlock_pi(mutex, ZX_TIME_INFINITE);
+    if (status != ZX_OK) {
+        __builtin_trap();
+    }
+}
+
+void sync_mutex_unlock_pi(sync_mutex_t* mutex) __TA_NO_THREAD_SAFETY_ANALYSIS {
+    int old_state = atomic_exchange(&mutex->futex, UNLOCKED);
+
+    // As in sync_mutex_unlock(), |mutex| must not be dereferenced from here on.
+
+    if (old_state == UNLOCKED) {
+        __builtin_trap();
+    }
+    if (!(old_state & PI_NO_WAITERS_BIT)) {
+        // Wake a waiter and make it the futex's owner, so the other waiters
+        // lend their priority to it rather than to this thread.  The mutex
+        // is already unlocked, though, so another thread can take it before
+        // the woken waiter gets to run.  Until that thread unlocks it, the
+        // waiters boost the woken waiter, not the thread holding the mutex.
+        zx_status_t status = _zx_futex_wake_owner(&mutex->futex);
+        if (status != ZX_OK) {
+            __builtin_trap();
+        }
+    }
+}
@@ -58,6 +58,7 @@ KTRACE_DEF(0x151,32B,WAIT_ONE_DONE,IPC) // id, status, pending
 KTRACE_DEF(0x160,32B,KWAIT_BLOCK,SCHEDULER) // queue_hi, queue_hi
 KTRACE_DEF(0x161,32B,KWAIT_WAKE,SCHEDULER) // queue_hi, queue_hi, is_mutex
 KTRACE_DEF(0x162,32B,KWAIT_UNBLOCK,SCHEDULER) // queue_hi, queue_hi, blocked_status
+KTRACE_DEF(0x163,32B,SCHED_DECISION,SCHEDULER) // (class << 8) | cpu, pick_ticks, run_queue_bitmap
 
 KTRACE_DEF(0x170,32B,VCPU_ENTER,TASKS)
 KTRACE_DEF(0x171,32B,VCPU_EXIT,TASKS) // meta, exit_address_hi, exit_address_lo
@@ -110,6 +110,23 @@ protected:
     }
 };
 
+class CancelOtherWait : public TestWait {
+public:
+    CancelOtherWait(zx_handle_t object, zx_signals_t trigger, TestWait* other)
+        : TestWait(object, trigger), other_(other) {}
+
+    zx_status_t cancel_result = ZX_ERR_INTERNAL;
+
+protected:
+    TestWait* other_;
+
+    void Handle(async_dispatcher_t* dispatcher, zx_status_t status,
+                const zx_packet_signal_t* signal) override {
+        TestWait::Handle(dispatcher, status, signal);
+        cancel_result = other_->Cancel(dispatcher);
+    }
+};
+
 class TestTask : public async_task_t {
 public:
     TestTask()
@@ -601,6 +618,34 @@ bool wait_test() {
     END_TEST;
 }
 
+// Both waits' packets are read from the port together, so the second is
+// canceled after its packet has left the port but before it is dispatched.
+bool wait_cancel_read_packet_test() {
+    BEGIN_TEST;
+
+    async::Loop loop(&kAsyncLoopConfigNoAttachToThread);
+    zx::event event;
+    EXPECT_EQ(ZX_OK, zx::event::create(0u, &event), "create event");
+
+    TestWait wait2(event.get(), ZX_USER_SIGNAL_2);
+    CancelOtherWait wait1(event.get(), ZX_USER_SIGNAL_1, &wait2);
+    EXPECT_EQ(ZX_OK, wait1.Begin(loop.dispatcher()), "wait 1");
+    EXPECT_EQ(ZX_OK, wait2.Begin(loop.dispatcher()), "wait 2");
+
+    // Signal 1 is raised first, so |wait1| is notified first.
+    EXPECT_EQ(ZX_OK, event.signal(0u, ZX_USER_SIGNAL_1), "signal 1");
+    EXPECT_EQ(ZX_OK, event.signal(0u, ZX_USER_SIGNAL_2), "signal 2");
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    EXPECT_EQ(1u, wait1.run_count, "run count 1");
+    EXPECT_EQ(ZX_OK, wait1.cancel_result, "cancel result");
+    EXPECT_EQ(0u, wait2.run_count, "run count 2");
+
+    // Canceling it again finds nothing.
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, wait2.Cancel(loop.dispatcher()), "cancel 2");
+
+    END_TEST;
+}
+
 bool wait_unwaitable_handle_test() {
     BEGIN_TEST;
 
@@ -1377,6 +1422,7 @@ RUN_TEST(make_default_true_test)
 RUN_TEST(quit_test)
 RUN_TEST(time_test)
 RUN_TEST(wait_test)
+RUN_TEST(wait_cancel_read_packet_test)
 RUN_TEST(wait_unwaitable_handle_test)
 RUN_TEST(wait_shutdown_test)
 RUN_TEST(task_test)
@@ -1025,6 +1025,61 @@ static bool channel_write_different_sizes(void) {
     END_TEST;
 }
 
+// Both endpoints of a ZX_CHANNEL_RING channel get the same ring VMO, on
+// opposite sides.
+static bool channel_get_ring(void) {
+    BEGIN_TEST;
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(ZX_CHANNEL_RING, &channel[0], &channel[1]), ZX_OK, "");
+
+    zx_handle_t vmo[2];
+    uint32_t side[2];
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_EQ(zx_channel_get_ring(channel[i], 0u, &vmo[i], &side[i]), ZX_OK, "");
+        uint64_t size;
+        ASSERT_EQ(zx_vmo_get_size(vmo[i], &size), ZX_OK, "");
+        EXPECT_EQ(size, ZX_CHANNEL_RING_CONTROL_SIZE + 2 * (uint64_t)ZX_CHANNEL_RING_SIZE, "");
+
+        zx_info_handle_basic_t info;
+        ASSERT_EQ(zx_object_get_info(vmo[i], ZX_INFO_HANDLE_BASIC, &info, sizeof(info),
+                                     NULL, NULL), ZX_OK, "");
+        EXPECT_EQ(info.rights & ZX_RIGHT_TRANSFER, 0u, "");
+        EXPECT_NE(info.rights & ZX_RIGHT_MAP, 0u, "");
+    }
+    EXPECT_EQ(side[0] + side[1], 1u, "");
+
+    uint32_t data = 0x12345678;
+    ASSERT_EQ(zx_vmo_write(vmo[0], &data, ZX_CHANNEL_RING_CONTROL_SIZE, sizeof(data)), ZX_OK, "");
+    data = 0;
+    ASSERT_EQ(zx_vmo_read(vmo[1], &data, ZX_CHANNEL_RING_CONTROL_SIZE, sizeof(data)), ZX_OK, "");
+    EXPECT_EQ(data, 0x12345678u, "");
+
+    zx_handle_t unused;
+    uint32_t unused_side;
+    EXPECT_EQ(zx_channel_get_ring(channel[0], 1u, &unused, &unused_side),
+              ZX_ERR_INVALID_ARGS, "");
+
+    // The ring outlives the endpoints as long as it has handles.
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK, "");
+    data = 0;
+    ASSERT_EQ(zx_vmo_read(vmo[1], &data, ZX_CHANNEL_RING_CONTROL_SIZE, sizeof(data)), ZX_OK, "");
+    EXPECT_EQ(data, 0x12345678u, "");
+    EXPECT_EQ(zx_handle_close(vmo[0]), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(vmo[1]), ZX_OK, "");
+
+    // Plain channels have no ring.
+    ASSERT_EQ(zx_channel_create(0u, &channel[0], &channel[1]), ZX_OK, "");
+    EXPECT_EQ(zx_channel_get_ring(channel[0], 0u, &unused, &unused_side),
+              ZX_ERR_NOT_SUPPORTED, "");
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK, "");
+
+    EXPECT_EQ(zx_channel_create(~ZX_CHANNEL_RING, &channel[0], &channel[1]),
+              ZX_ERR_INVALID_ARGS, "");
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(channel_tests)
 RUN_TEST(channel_test)
 RUN_TEST(channel_read_error_test)
@@ -1042,6 +1097,7 @@ RUN_TEST(channel_nest)
 RUN_TEST(channel_disallow_write_to_self)
 RUN_TEST(channel_read_etc)
 RUN_TEST(channel_write_different_sizes)
+RUN_TEST(channel_get_ring)
 END_TEST_CASE(channel_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -12,6 +12,7 @@
 #include <time.h>
 #include <unistd.h>
 #include <unittest/unittest.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <zircon/threads.h>
 #include <zircon/time.h>
@@ -249,6 +250,33 @@ bool TestFutexWakeupAddress() {
     END_TEST;
 }
 
+// Check that futex_wake() only wakes the thread blocked on its own address
+// while many threads are blocked on distinct futexes.  This is enough active
+// futexes for the kernel to grow its futex table while they are queued.
+bool TestFutexWakeupManyAddresses() {
+    BEGIN_TEST;
+    constexpr int kNumFutexes = 128;
+    volatile int32_t futex_values[kNumFutexes];
+    TestThread* threads[kNumFutexes];
+    for (int i = 0; i < kNumFutexes; i++) {
+        futex_values[i] = 1;
+        threads[i] = new TestThread(&futex_values[i]);
+    }
+
+    for (int i = kNumFutexes - 1; i >= 0; i--) {
+        check_futex_wake(&futex_values[i], INT_MAX);
+        threads[i]->assert_thread_woken();
+        if (i > 0) {
+            threads[i - 1]->assert_thread_not_woken();
+        }
+    }
+
+    for (int i = 0; i < kNumFutexes; i++) {
+        delete threads[i];
+    }
+    END_TEST;
+}
+
 // Check that when futex_wait() times out, it removes the thread from
 // the futex wait queue.
 bool TestFutexUnqueuedOnTimeout() {
@@ -436,6 +464,73 @@ static bool TestFutexThreadSuspended() {
     END_TEST;
 }
 
+// Check the owner handle passed to futex_wait_owner().
+static bool TestFutexWaitOwnerBadOwner() {
+    BEGIN_TEST;
+    int32_t futex_value = 1;
+
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0, &event), ZX_OK);
+    EXPECT_EQ(zx_futex_wait_owner(&futex_value, 1, event, 0), ZX_ERR_WRONG_TYPE);
+    ASSERT_EQ(zx_handle_close(event), ZX_OK);
+    EXPECT_EQ(zx_futex_wait_owner(&futex_value, 1, event, 0), ZX_ERR_BAD_HANDLE);
+
+    // A thread can't wait for a lock it owns itself.
+    EXPECT_EQ(zx_futex_wait_owner(&futex_value, 1, zx_thread_self(), 0),
+              ZX_ERR_INVALID_ARGS);
+
+    // Without an owner it is a plain wait.
+    EXPECT_EQ(zx_futex_wait_owner(&futex_value, 1, ZX_HANDLE_INVALID, 0), ZX_ERR_TIMED_OUT);
+    EXPECT_EQ(zx_futex_wait_owner(&futex_value, 2, ZX_HANDLE_INVALID, 0), ZX_ERR_BAD_STATE);
+    END_TEST;
+}
+
+struct OwnerWaiterArgs {
+    volatile int32_t* futex_addr;
+    zx_handle_t owner;
+    volatile bool woken;
+};
+
+static int owner_waiter_thread(void* arg) {
+    auto args = static_cast<OwnerWaiterArgs*>(arg);
+    zx_status_t rc = zx_futex_wait_owner(const_cast<int32_t*>(args->futex_addr),
+                                         *args->futex_addr, args->owner, ZX_TIME_INFINITE);
+    EXPECT_EQ(rc, ZX_OK, "Error while wait");
+    args->woken = true;
+    return 0;
+}
+
+// Test that futex_wake_owner() wakes one thread blocked in futex_wait_owner()
+// at a time, in the order they blocked.
+static bool TestFutexWakeOwner() {
+    BEGIN_TEST;
+    volatile int32_t futex_value = 1;
+
+    OwnerWaiterArgs args[2] = {
+        {&futex_value, zx_thread_self(), false},
+        {&futex_value, zx_thread_self(), false},
+    };
+    thrd_t threads[2];
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(thrd_create_with_name(&threads[i], owner_waiter_thread, &args[i],
+                                        "owner_waiter_thread"), thrd_success);
+        ASSERT_TRUE(wait_until_blocked_on_some_futex(thrd_get_zx_handle(threads[i])));
+    }
+
+    ASSERT_EQ(zx_futex_wake_owner(const_cast<int32_t*>(&futex_value)), ZX_OK);
+    ASSERT_EQ(thrd_join(threads[0], nullptr), thrd_success);
+    EXPECT_TRUE(args[0].woken);
+    EXPECT_FALSE(args[1].woken);
+
+    ASSERT_EQ(zx_futex_wake_owner(const_cast<int32_t*>(&futex_value)), ZX_OK);
+    ASSERT_EQ(thrd_join(threads[1], nullptr), thrd_success);
+    EXPECT_TRUE(args[1].woken);
+
+    // With nobody waiting it only gives up ownership.
+    EXPECT_EQ(zx_futex_wake_owner(const_cast<int32_t*>(&futex_value)), ZX_OK);
+    END_TEST;
+}
+
 // Test that misaligned pointers cause futex syscalls to return a failure.
 static bool TestFutexMisaligned() {
     BEGIN_TEST;
@@ -547,6 +642,7 @@ RUN_TEST(TestFutexWaitBadAddress);
 RUN_TEST(TestFutexWakeup);
 RUN_TEST(TestFutexWakeupLimit);
 RUN_TEST(TestFutexWakeupAddress);
+RUN_TEST(TestFutexWakeupManyAddresses);
 RUN_TEST(TestFutexUnqueuedOnTimeout);
 RUN_TEST(TestFutexUnqueuedOnTimeout_2);
 RUN_TEST(TestFutexUnqueuedOnTimeout_3);
@@ -556,6 +652,8 @@ RUN_TEST(TestFutexRequeue);
 RUN_TEST(TestFutexRequeueUnqueuedOnTimeout);
 RUN_TEST(TestFutexThreadKilled);
 RUN_TEST(TestFutexThreadSuspended);
+RUN_TEST(TestFutexWaitOwnerBadOwner);
+RUN_TEST(TestFutexWakeOwner);
 RUN_TEST(TestFutexMisaligned);
 RUN_TEST(TestEventSignaling);
 END_TEST_CASE(futex_tests)
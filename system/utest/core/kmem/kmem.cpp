@@ -0,0 +1,156 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/zx/event.h>
+#include <lib/zx/resource.h>
+#include <lib/zx/vmo.h>
+#include <string.h>
+#include <unittest/unittest.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+
+extern "C" zx_handle_t get_root_resource();
+
+namespace {
+
+uint64_t sum(const uint64_t* buckets) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < ZX_INFO_KMEM_LATENCY_BUCKETS; i++) {
+        total += buckets[i];
+    }
+    return total;
+}
+
+bool check_compression_info(const zx_info_kmem_compression_t& info) {
+    BEGIN_HELPER;
+
+    // every compression and decompression lands in exactly one bucket
+    EXPECT_EQ(sum(info.compression_latency), info.compressions);
+    EXPECT_EQ(sum(info.decompression_latency), info.decompressions);
+
+    // pages leave the store when they are decompressed for good or freed,
+    // so only what was compressed can still be in it
+    EXPECT_LE(info.compressed_pages, info.compressions);
+
+    // a page is only stored if it got smaller, and it is stored in full
+    EXPECT_LE(info.compressed_bytes, info.compressed_pages * PAGE_SIZE);
+    EXPECT_LE(info.compressed_bytes, info.store_bytes);
+    EXPECT_EQ(info.store_bytes % PAGE_SIZE, 0u);
+    if (info.compressed_pages == 0) {
+        EXPECT_EQ(info.compressed_bytes, 0u);
+    } else {
+        EXPECT_GT(info.store_bytes, 0u);
+    }
+
+    END_HELPER;
+}
+
+bool kmem_compression_test() {
+    BEGIN_TEST;
+
+    zx::unowned_resource root(get_root_resource());
+    if (!root->is_valid()) {
+        unittest_printf("no root resource. skipping test\n");
+    } else {
+        zx_info_kmem_compression_t info;
+        size_t actual, avail;
+        ASSERT_EQ(root->get_info(ZX_INFO_KMEM_COMPRESSION, &info, sizeof(info), &actual, &avail),
+                  ZX_OK);
+        EXPECT_EQ(actual, 1u);
+        EXPECT_EQ(avail, 1u);
+        EXPECT_TRUE(check_compression_info(info));
+
+        // the event counts only go up
+        zx_info_kmem_compression_t later;
+        ASSERT_EQ(root->get_info(ZX_INFO_KMEM_COMPRESSION, &later, sizeof(later),
+                                 nullptr, nullptr),
+                  ZX_OK);
+        EXPECT_TRUE(check_compression_info(later));
+        EXPECT_GE(later.compressions, info.compressions);
+        EXPECT_GE(later.decompressions, info.decompressions);
+        EXPECT_GE(later.rejections, info.rejections);
+        for (size_t i = 0; i < ZX_INFO_KMEM_LATENCY_BUCKETS; i++) {
+            EXPECT_GE(later.compression_latency[i], info.compression_latency[i]);
+            EXPECT_GE(later.decompression_latency[i], info.decompression_latency[i]);
+        }
+
+        // a buffer too small for the record
+        EXPECT_EQ(root->get_info(ZX_INFO_KMEM_COMPRESSION, &info, sizeof(info) - 1,
+                                 &actual, &avail),
+                  ZX_ERR_BUFFER_TOO_SMALL);
+        EXPECT_EQ(actual, 0u);
+        EXPECT_EQ(avail, 1u);
+    }
+
+    END_TEST;
+}
+
+bool kmem_compression_needs_root_test() {
+    BEGIN_TEST;
+
+    zx_info_kmem_compression_t info;
+    EXPECT_EQ(zx_object_get_info(ZX_HANDLE_INVALID, ZX_INFO_KMEM_COMPRESSION,
+                                 &info, sizeof(info), nullptr, nullptr),
+              ZX_ERR_BAD_HANDLE);
+
+    zx::event event;
+    ASSERT_EQ(zx::event::create(0, &event), ZX_OK);
+    EXPECT_EQ(event.get_info(ZX_INFO_KMEM_COMPRESSION, &info, sizeof(info), nullptr, nullptr),
+              ZX_ERR_WRONG_TYPE);
+
+    END_TEST;
+}
+
+zx_status_t send_command(const zx::resource& root, const char* command) {
+    return zx_debug_send_command(root.get(), command, strlen(command));
+}
+
+bool vmo_zero_reclaim_test() {
+    BEGIN_TEST;
+
+    zx::unowned_resource root(get_root_resource());
+    if (!root->is_valid()) {
+        unittest_printf("no root resource. skipping test\n");
+    } else {
+        const size_t kSize = PAGE_SIZE * 4;
+        zx::vmo vmo;
+        ASSERT_EQ(zx::vmo::create(kSize, 0, &vmo), ZX_OK);
+
+        // commit every page, but only put anything in the first
+        ASSERT_EQ(vmo.op_range(ZX_VMO_OP_COMMIT, 0, kSize, nullptr, 0), ZX_OK);
+        const uint8_t value = 0x5a;
+        ASSERT_EQ(vmo.write(&value, 0, sizeof(value)), ZX_OK);
+
+        zx_info_vmo_t info;
+        ASSERT_EQ(vmo.get_info(ZX_INFO_VMO, &info, sizeof(info), nullptr, nullptr), ZX_OK);
+        EXPECT_EQ(info.committed_bytes, kSize);
+        EXPECT_EQ(info.zero_reclaimed_bytes, 0u);
+
+        // the zero pages are freed once enough scans have found them unused
+        for (int i = 0; i < 10 && info.zero_reclaimed_bytes == 0; i++) {
+            ASSERT_EQ(send_command(*root, "scanner scan"), ZX_OK);
+            ASSERT_EQ(send_command(*root, "scanner dedup 1000000000"), ZX_OK);
+            ASSERT_EQ(vmo.get_info(ZX_INFO_VMO, &info, sizeof(info), nullptr, nullptr), ZX_OK);
+        }
+        EXPECT_EQ(info.zero_reclaimed_bytes, kSize - PAGE_SIZE);
+        EXPECT_EQ(info.committed_bytes, PAGE_SIZE);
+
+        uint8_t data[2];
+        ASSERT_EQ(vmo.read(data, PAGE_SIZE - 1, sizeof(data)), ZX_OK);
+        EXPECT_EQ(data[0], 0u);
+        EXPECT_EQ(data[1], 0u);
+        ASSERT_EQ(vmo.read(data, 0, 1), ZX_OK);
+        EXPECT_EQ(data[0], value);
+    }
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(kmem_tests)
+RUN_TEST(kmem_compression_test)
+RUN_TEST(kmem_compression_needs_root_test)
+RUN_TEST(vmo_zero_reclaim_test)
+END_TEST_CASE(kmem_tests)
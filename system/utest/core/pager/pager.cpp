@@ -0,0 +1,296 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <limits.h>
+#include <string.h>
+#include <threads.h>
+
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+#include <unittest/unittest.h>
+
+namespace {
+
+constexpr uint64_t kKey = 0x5150u;
+
+struct Reader {
+    zx_handle_t vmo;
+    uint64_t offset;
+    // set when |addr| is 0 to read with zx_vmo_read()
+    uintptr_t addr;
+    zx_status_t status;
+    uint8_t data[PAGE_SIZE];
+};
+
+int reader_thread(void* arg) {
+    auto reader = static_cast<Reader*>(arg);
+    if (reader->addr) {
+        memcpy(reader->data, reinterpret_cast<const void*>(reader->addr), PAGE_SIZE);
+        reader->status = ZX_OK;
+    } else {
+        reader->status = zx_vmo_read(reader->vmo, reader->data, reader->offset, PAGE_SIZE);
+    }
+    return 0;
+}
+
+bool wait_for_request(zx_handle_t port, uint16_t command, uint64_t offset) {
+    BEGIN_HELPER;
+    zx_port_packet_t packet = {};
+    ASSERT_EQ(zx_port_wait(port, zx_deadline_after(ZX_SEC(5)), &packet), ZX_OK);
+    EXPECT_EQ(packet.key, kKey);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_PAGE_REQUEST);
+    EXPECT_EQ(packet.page_request.command, command);
+    if (command == ZX_PAGER_VMO_READ) {
+        EXPECT_EQ(packet.page_request.offset, offset);
+        EXPECT_EQ(packet.page_request.length, PAGE_SIZE);
+    }
+    END_HELPER;
+}
+
+// Fills a page of a new vmo with |value| and supplies it to |offset| of |vmo|.
+bool supply_page(zx_handle_t pager, zx_handle_t vmo, uint64_t offset, uint8_t value) {
+    BEGIN_HELPER;
+    zx_handle_t aux;
+    ASSERT_EQ(zx_vmo_create(PAGE_SIZE, 0, &aux), ZX_OK);
+    uint8_t data[PAGE_SIZE];
+    memset(data, value, sizeof(data));
+    ASSERT_EQ(zx_vmo_write(aux, data, 0, sizeof(data)), ZX_OK);
+
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, offset, PAGE_SIZE, aux, 0), ZX_OK);
+
+    // the page was moved, not copied
+    ASSERT_EQ(zx_vmo_read(aux, data, 0, sizeof(data)), ZX_OK);
+    EXPECT_EQ(data[0], 0u);
+    EXPECT_EQ(zx_handle_close(aux), ZX_OK);
+    END_HELPER;
+}
+
+bool check_page(const uint8_t* data, uint8_t value) {
+    BEGIN_HELPER;
+    for (size_t i = 0; i < PAGE_SIZE; i++) {
+        if (data[i] != value) {
+            ASSERT_EQ(data[i], value, "unexpected page contents");
+        }
+    }
+    END_HELPER;
+}
+
+bool read_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, 2 * PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    Reader reader = {vmo, PAGE_SIZE, 0, ZX_ERR_INTERNAL, {}};
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, reader_thread, &reader), thrd_success);
+
+    ASSERT_TRUE(wait_for_request(port, ZX_PAGER_VMO_READ, PAGE_SIZE));
+    ASSERT_TRUE(supply_page(pager, vmo, PAGE_SIZE, 0xab));
+
+    EXPECT_EQ(thrd_join(thread, nullptr), thrd_success);
+    EXPECT_EQ(reader.status, ZX_OK);
+    EXPECT_TRUE(check_page(reader.data, 0xab));
+
+    // the page stays in the vmo
+    uint8_t data[PAGE_SIZE];
+    EXPECT_EQ(zx_vmo_read(vmo, data, PAGE_SIZE, sizeof(data)), ZX_OK);
+    EXPECT_TRUE(check_page(data, 0xab));
+
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+    ASSERT_TRUE(wait_for_request(port, ZX_PAGER_VMO_COMPLETE, 0));
+
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK);
+
+    END_TEST;
+}
+
+bool fault_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    uintptr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), ZX_VM_PERM_READ, 0, vmo, 0, PAGE_SIZE, &addr),
+              ZX_OK);
+
+    Reader reader = {vmo, 0, addr, ZX_ERR_INTERNAL, {}};
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, reader_thread, &reader), thrd_success);
+
+    ASSERT_TRUE(wait_for_request(port, ZX_PAGER_VMO_READ, 0));
+    ASSERT_TRUE(supply_page(pager, vmo, 0, 0x5a));
+
+    EXPECT_EQ(thrd_join(thread, nullptr), thrd_success);
+    EXPECT_EQ(reader.status, ZX_OK);
+    EXPECT_TRUE(check_page(reader.data, 0x5a));
+
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), addr, PAGE_SIZE), ZX_OK);
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK);
+
+    END_TEST;
+}
+
+struct MappedReader {
+    zx_handle_t vmo;
+    // where to read the vmo's first page to
+    uintptr_t addr;
+    zx_status_t status;
+};
+
+int mapped_reader_thread(void* arg) {
+    auto reader = static_cast<MappedReader*>(arg);
+    reader->status = zx_vmo_read(reader->vmo, reinterpret_cast<void*>(reader->addr), 0,
+                                 PAGE_SIZE);
+    return 0;
+}
+
+// Checks that zx_vmo_read() into a buffer mapped from a pager vmo waits for the
+// pager without holding on to the vmo being read.
+bool read_to_pager_mapping_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo, src;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK);
+    ASSERT_EQ(zx_vmo_create(PAGE_SIZE, 0, &src), ZX_OK);
+    uint8_t data[PAGE_SIZE];
+    memset(data, 0x3c, sizeof(data));
+    ASSERT_EQ(zx_vmo_write(src, data, 0, sizeof(data)), ZX_OK);
+
+    uintptr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, 0, vmo, 0,
+                          PAGE_SIZE, &addr),
+              ZX_OK);
+
+    MappedReader reader = {src, addr, ZX_ERR_INTERNAL};
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, mapped_reader_thread, &reader), thrd_success);
+
+    // the copy out faults on the pager vmo, and the vmo being read stays usable
+    // while the pager gets around to it
+    ASSERT_TRUE(wait_for_request(port, ZX_PAGER_VMO_READ, 0));
+    memset(data, 0, sizeof(data));
+    EXPECT_EQ(zx_vmo_read(src, data, 0, sizeof(data)), ZX_OK);
+    EXPECT_TRUE(check_page(data, 0x3c));
+    ASSERT_TRUE(supply_page(pager, vmo, 0, 0));
+
+    EXPECT_EQ(thrd_join(thread, nullptr), thrd_success);
+    EXPECT_EQ(reader.status, ZX_OK);
+    EXPECT_TRUE(check_page(reinterpret_cast<const uint8_t*>(addr), 0x3c));
+
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), addr, PAGE_SIZE), ZX_OK);
+    EXPECT_EQ(zx_handle_close(src), ZX_OK);
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK);
+
+    END_TEST;
+}
+
+bool close_pager_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    Reader reader = {vmo, 0, 0, ZX_ERR_INTERNAL, {}};
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, reader_thread, &reader), thrd_success);
+
+    ASSERT_TRUE(wait_for_request(port, ZX_PAGER_VMO_READ, 0));
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK);
+
+    // nobody is left to supply the page
+    EXPECT_EQ(thrd_join(thread, nullptr), thrd_success);
+    EXPECT_EQ(reader.status, ZX_ERR_BAD_STATE);
+
+    uint8_t data[PAGE_SIZE];
+    EXPECT_EQ(zx_vmo_read(vmo, data, 0, sizeof(data)), ZX_ERR_BAD_STATE);
+
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+
+    END_TEST;
+}
+
+bool supply_invalid_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, other_pager, port, vmo, aux;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_pager_create(0, &other_pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK);
+    ASSERT_EQ(zx_vmo_create(PAGE_SIZE, 0, &aux), ZX_OK);
+
+    // not a pager vmo, or not this pager's
+    EXPECT_EQ(zx_pager_supply_pages(pager, aux, 0, PAGE_SIZE, aux, 0), ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_supply_pages(other_pager, vmo, 0, PAGE_SIZE, aux, 0),
+              ZX_ERR_INVALID_ARGS);
+
+    // unaligned or out of range
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 1, PAGE_SIZE, aux, 0), ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, PAGE_SIZE, PAGE_SIZE, aux, 0),
+              ZX_ERR_OUT_OF_RANGE);
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 0, PAGE_SIZE, aux, PAGE_SIZE),
+              ZX_ERR_OUT_OF_RANGE);
+
+    // the pages of a pager vmo can't be moved out again
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 0, PAGE_SIZE, vmo, 0), ZX_ERR_NOT_SUPPORTED);
+
+    zx_handle_t clone;
+    ASSERT_EQ(zx_vmo_clone(aux, ZX_VMO_CLONE_COPY_ON_WRITE, 0, PAGE_SIZE, &clone), ZX_OK);
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 0, PAGE_SIZE, aux, 0), ZX_ERR_NOT_SUPPORTED);
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 0, PAGE_SIZE, clone, 0), ZX_ERR_NOT_SUPPORTED);
+    EXPECT_EQ(zx_handle_close(clone), ZX_OK);
+
+    zx_handle_t ro_aux;
+    ASSERT_EQ(zx_handle_duplicate(aux, ZX_RIGHT_READ, &ro_aux), ZX_OK);
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 0, PAGE_SIZE, ro_aux, 0),
+              ZX_ERR_ACCESS_DENIED);
+    EXPECT_EQ(zx_handle_close(ro_aux), ZX_OK);
+
+    EXPECT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 1, &clone),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_create_vmo(pager, port, kKey, UINT64_MAX, 0, &clone),
+              ZX_ERR_OUT_OF_RANGE);
+
+    EXPECT_EQ(zx_handle_close(aux), ZX_OK);
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+    EXPECT_EQ(zx_handle_close(other_pager), ZX_OK);
+    EXPECT_EQ(zx_handle_close(pager), ZX_OK);
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(pager_tests)
+RUN_TEST(read_test)
+RUN_TEST(fault_test)
+RUN_TEST(read_to_pager_mapping_test)
+RUN_TEST(close_pager_test)
+RUN_TEST(supply_invalid_test)
+END_TEST_CASE(pager_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
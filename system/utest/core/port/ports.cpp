@@ -108,6 +108,60 @@ static bool queue_too_many(void) {
     END_TEST;
 }
 
+static bool wait_many_test(void) {
+    BEGIN_TEST;
+    zx_status_t status;
+
+    zx_handle_t port;
+    status = zx_port_create(0, &port);
+    EXPECT_EQ(status, ZX_OK, "could not create port");
+
+    zx_port_packet_t out[64] = {};
+    size_t actual = 0u;
+
+    status = zx_port_wait_many(port, 0, out, 0u, &actual);
+    EXPECT_EQ(status, ZX_ERR_INVALID_ARGS);
+
+    status = zx_port_wait_many(port, zx_deadline_after(ZX_USEC(1)), out, 1u, &actual);
+    EXPECT_EQ(status, ZX_ERR_TIMED_OUT);
+
+    // Queue more packets than the kernel stages at once, but fewer than we ask for.
+    constexpr size_t kQueued = 40u;
+    for (size_t ix = 0; ix != kQueued; ++ix) {
+        const zx_port_packet_t in = {
+            ix,
+            ZX_PKT_TYPE_USER,
+            0,
+            { {} }
+        };
+        status = zx_port_queue(port, &in);
+        EXPECT_EQ(status, ZX_OK);
+    }
+
+    status = zx_port_wait_many(port, ZX_TIME_INFINITE, out, 3u, &actual);
+    EXPECT_EQ(status, ZX_OK);
+    EXPECT_EQ(actual, 3u);
+
+    status = zx_port_wait_many(port, ZX_TIME_INFINITE, out + 3, fbl::count_of(out) - 3,
+                               &actual);
+    EXPECT_EQ(status, ZX_OK);
+    EXPECT_EQ(actual, kQueued - 3u);
+
+    // Packets come out in FIFO order.
+    for (size_t ix = 0; ix != kQueued; ++ix) {
+        EXPECT_EQ(out[ix].key, ix);
+        EXPECT_EQ(out[ix].type, ZX_PKT_TYPE_USER);
+    }
+
+    status = zx_port_wait_many(port, 0, out, fbl::count_of(out), &actual);
+    EXPECT_EQ(status, ZX_ERR_TIMED_OUT);
+
+    status = zx_handle_close(port);
+    EXPECT_EQ(status, ZX_OK);
+
+    END_TEST;
+}
+
 static bool async_wait_channel_test(void) {
     BEGIN_TEST;
     zx_status_t status;
@@ -681,6 +735,7 @@ BEGIN_TEST_CASE(port_tests)
 RUN_TEST(basic_test)
 RUN_TEST(queue_and_close_test)
 RUN_TEST(queue_too_many)
+RUN_TEST(wait_many_test)
 RUN_TEST(async_wait_channel_test)
 RUN_TEST(async_wait_event_test_single)
 RUN_TEST(async_wait_event_test_repeat)
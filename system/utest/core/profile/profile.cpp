@@ -5,6 +5,8 @@
 #include <unittest/unittest.h>
 #include <lib/zx/profile.h>
 #include <lib/zx/thread.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
 
 extern "C" zx_handle_t get_root_resource();
 
@@ -57,7 +59,129 @@ static bool profile_priority_test(void) {
     END_TEST;
 }
 
+static bool profile_fair_test(void) {
+    BEGIN_TEST;
+
+    zx::unowned_resource rrh(get_root_resource());
+    if (!rrh->is_valid()) {
+        unittest_printf("no root resource. skipping test\n");
+    } else {
+        zx_profile_info_t profile_info = {};
+        profile_info.type = ZX_PROFILE_INFO_FAIR;
+
+        zx::profile profile;
+        profile_info.fair.weight = ZX_FAIR_WEIGHT_MIN - 1;
+        ASSERT_EQ(zx::profile::create(*rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
+        profile_info.fair.weight = ZX_FAIR_WEIGHT_MAX + 1;
+        ASSERT_EQ(zx::profile::create(*rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
+
+        profile_info.fair.weight = ZX_FAIR_WEIGHT_DEFAULT;
+        ASSERT_EQ(zx::profile::create(*rrh, &profile_info, &profile), ZX_OK, "");
+
+        zx::profile default_profile;
+        profile_info = {};
+        profile_info.type = ZX_PROFILE_INFO_SCHEDULER;
+        profile_info.scheduler.priority = ZX_PRIORITY_DEFAULT;
+        ASSERT_EQ(zx::profile::create(*rrh, &profile_info, &default_profile), ZX_OK, "");
+
+        ASSERT_EQ(zx::thread::self()->set_profile(profile, 0), ZX_OK, "");
+        zx_nanosleep(ZX_USEC(100));
+        ASSERT_EQ(zx::thread::self()->set_profile(default_profile, 0), ZX_OK, "");
+    }
+
+    END_TEST;
+}
+
+static bool profile_deadline_test(void) {
+    BEGIN_TEST;
+
+    zx::unowned_resource rrh(get_root_resource());
+    if (!rrh->is_valid()) {
+        unittest_printf("no root resource. skipping test\n");
+    } else {
+        zx_profile_info_t profile_info = {};
+        profile_info.type = ZX_PROFILE_INFO_DEADLINE;
+
+        zx::profile profile;
+        profile_info.deadline.capacity = 0;
+        profile_info.deadline.relative_deadline = ZX_MSEC(5);
+        profile_info.deadline.period = ZX_MSEC(10);
+        ASSERT_EQ(zx::profile::create(*rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
+
+        // capacity must fit within the deadline, and the deadline within the period
+        profile_info.deadline.capacity = ZX_MSEC(6);
+        ASSERT_EQ(zx::profile::create(*rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
+        profile_info.deadline.capacity = ZX_MSEC(1);
+        profile_info.deadline.relative_deadline = ZX_MSEC(11);
+        ASSERT_EQ(zx::profile::create(*rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
+
+        profile_info.deadline.relative_deadline = ZX_MSEC(5);
+        ASSERT_EQ(zx::profile::create(*rrh, &profile_info, &profile), ZX_OK, "");
+    }
+
+    END_TEST;
+}
+
+static zx_duration_t thread_runtime() {
+    zx_info_thread_stats_t stats = {};
+    if (zx::thread::self()->get_info(ZX_INFO_THREAD_STATS, &stats, sizeof(stats),
+                                     nullptr, nullptr) != ZX_OK) {
+        return -1;
+    }
+    return stats.total_runtime;
+}
+
+// A deadline thread that never blocks gets no more than its capacity in each period.
+static bool profile_deadline_share_test(void) {
+    BEGIN_TEST;
+
+    zx::unowned_resource rrh(get_root_resource());
+    if (!rrh->is_valid()) {
+        unittest_printf("no root resource. skipping test\n");
+    } else {
+        const zx_duration_t capacity = ZX_MSEC(1);
+        const zx_duration_t period = ZX_MSEC(10);
+        const zx_duration_t spin = ZX_MSEC(200);
+
+        zx_profile_info_t profile_info = {};
+        profile_info.type = ZX_PROFILE_INFO_DEADLINE;
+        profile_info.deadline.capacity = capacity;
+        profile_info.deadline.relative_deadline = period;
+        profile_info.deadline.period = period;
+        zx::profile profile;
+        ASSERT_EQ(zx::profile::create(*rrh, &profile_info, &profile), ZX_OK, "");
+
+        zx::profile default_profile;
+        profile_info = {};
+        profile_info.type = ZX_PROFILE_INFO_SCHEDULER;
+        profile_info.scheduler.priority = ZX_PRIORITY_DEFAULT;
+        ASSERT_EQ(zx::profile::create(*rrh, &profile_info, &default_profile), ZX_OK, "");
+
+        ASSERT_EQ(zx::thread::self()->set_profile(profile, 0), ZX_OK, "");
+        zx_duration_t runtime_start = thread_runtime();
+        zx_time_t start = zx_clock_get_monotonic();
+        zx_time_t now;
+        do {
+            now = zx_clock_get_monotonic();
+        } while (now - start < spin);
+        zx_duration_t runtime = thread_runtime() - runtime_start;
+        ASSERT_EQ(zx::thread::self()->set_profile(default_profile, 0), ZX_OK, "");
+
+        // the spin overlaps at most elapsed / period + 2 periods, and allow for the time
+        // charged around the profile and clock calls
+        zx_duration_t elapsed = now - start;
+        zx_duration_t limit = (elapsed / period + 2) * capacity + ZX_MSEC(2);
+        EXPECT_GE(runtime_start, 0, "");
+        EXPECT_LE(runtime, limit, "deadline thread ran past its budget");
+    }
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(profile_cpp_tests)
 RUN_TEST(profile_failures_test)
 RUN_TEST(profile_priority_test)
+RUN_TEST(profile_fair_test)
+RUN_TEST(profile_deadline_test)
+RUN_TEST(profile_deadline_share_test)
 END_TEST_CASE(profile_cpp_tests)
@@ -204,10 +204,90 @@ static bool test_timeout_elapsed(void) {
     END_TEST;
 }
 
+#define SPIN_THREADS 4
+#define SPIN_ITERATIONS 10000
+
+typedef struct {
+    sync_mutex_t mutex;
+    uint64_t counter;
+} spin_args;
+
+static int spin_thread(void* ctx) TA_NO_THREAD_SAFETY_ANALYSIS {
+    spin_args* args = ctx;
+    for (int i = 0; i < SPIN_ITERATIONS; i++) {
+        sync_mutex_lock(&args->mutex);
+        args->counter++;
+        sync_mutex_unlock(&args->mutex);
+    }
+    return 0;
+}
+
+// Checks that the mutex still excludes other threads with spin budgets from
+// none at all to big enough that contended locks hardly ever sleep.
+static bool test_spin_counts(void) {
+    BEGIN_TEST;
+
+    static const uint32_t kSpinCounts[] = {0, 1, SYNC_MUTEX_SHORT_SPIN_COUNT, 100000};
+    for (size_t i = 0; i < sizeof(kSpinCounts) / sizeof(kSpinCounts[0]); i++) {
+        spin_args args = {
+            .mutex = SYNC_MUTEX_INIT_WITH_SPIN(kSpinCounts[i]),
+            .counter = 0,
+        };
+
+        thrd_t threads[SPIN_THREADS];
+        for (int j = 0; j < SPIN_THREADS; j++) {
+            ASSERT_EQ(thrd_create(&threads[j], spin_thread, &args), thrd_success, "");
+        }
+        for (int j = 0; j < SPIN_THREADS; j++) {
+            ASSERT_EQ(thrd_join(threads[j], NULL), thrd_success, "failed to join");
+        }
+
+        EXPECT_EQ(args.counter, (uint64_t)SPIN_THREADS * SPIN_ITERATIONS, "lost an update");
+    }
+
+    END_TEST;
+}
+
+static int pi_thread(void* ctx) TA_NO_THREAD_SAFETY_ANALYSIS {
+    spin_args* args = ctx;
+    for (int i = 0; i < SPIN_ITERATIONS; i++) {
+        sync_mutex_lock_pi(&args->mutex);
+        args->counter++;
+        sync_mutex_unlock_pi(&args->mutex);
+    }
+    return 0;
+}
+
+// Checks that priority inheriting locking excludes other threads, and that
+// the mutex is left unlocked afterwards.
+static bool test_pi_mutex(void) {
+    BEGIN_TEST;
+
+    spin_args args = {
+        .mutex = SYNC_MUTEX_INIT,
+        .counter = 0,
+    };
+
+    thrd_t threads[SPIN_THREADS];
+    for (int j = 0; j < SPIN_THREADS; j++) {
+        ASSERT_EQ(thrd_create(&threads[j], pi_thread, &args), thrd_success, "");
+    }
+    for (int j = 0; j < SPIN_THREADS; j++) {
+        ASSERT_EQ(thrd_join(threads[j], NULL), thrd_success, "failed to join");
+    }
+
+    EXPECT_EQ(args.counter, (uint64_t)SPIN_THREADS * SPIN_ITERATIONS, "lost an update");
+    EXPECT_EQ(args.mutex.futex, 0, "mutex left locked");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(sync_mutex_tests)
 RUN_TEST(test_mutexes)
 RUN_TEST(test_try_mutexes)
 RUN_TEST(test_timeout_elapsed)
+RUN_TEST(test_spin_counts)
+RUN_TEST(test_pi_mutex)
 END_TEST_CASE(sync_mutex_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -280,12 +280,49 @@ static bool wait_many_failures_test(void) {
     END_TEST;
 }
 
+static bool wait_many_max_items_test(void) {
+    BEGIN_TEST;
+
+    zx_wait_item_t* items = calloc(ZX_WAIT_MANY_MAX_ITEMS + 1, sizeof(zx_wait_item_t));
+    ASSERT_NONNULL(items, "");
+    for (size_t ix = 0; ix < ZX_WAIT_MANY_MAX_ITEMS; ++ix) {
+        ASSERT_EQ(zx_event_create(0u, &items[ix].handle), ZX_OK, "Error during event creation");
+        items[ix].waitfor = ZX_EVENT_SIGNALED;
+    }
+    items[ZX_WAIT_MANY_MAX_ITEMS] = items[0];
+
+    ASSERT_EQ(zx_object_wait_many(items, ZX_WAIT_MANY_MAX_ITEMS + 1, 0), ZX_ERR_OUT_OF_RANGE,
+              "Wait-many should have failed with ZX_ERR_OUT_OF_RANGE");
+
+    ASSERT_EQ(zx_object_wait_many(items, ZX_WAIT_MANY_MAX_ITEMS, 0), ZX_ERR_TIMED_OUT,
+              "wait should have timed out");
+
+    // Only the last item's event is signaled.
+    zx_handle_t last = items[ZX_WAIT_MANY_MAX_ITEMS - 1].handle;
+    ASSERT_EQ(zx_object_signal(last, 0u, ZX_EVENT_SIGNALED), ZX_OK, "Error during event signal");
+    ASSERT_EQ(zx_object_wait_many(items, ZX_WAIT_MANY_MAX_ITEMS, ZX_TIME_INFINITE), ZX_OK,
+              "wait failed");
+    for (size_t ix = 0; ix < ZX_WAIT_MANY_MAX_ITEMS - 1; ++ix) {
+        ASSERT_EQ(items[ix].pending & ZX_EVENT_SIGNALED, 0u, "");
+    }
+    ASSERT_EQ(items[ZX_WAIT_MANY_MAX_ITEMS - 1].pending & ZX_EVENT_SIGNALED, ZX_EVENT_SIGNALED,
+              "");
+
+    for (size_t ix = 0; ix < ZX_WAIT_MANY_MAX_ITEMS; ++ix) {
+        ASSERT_EQ(zx_handle_close(items[ix].handle), ZX_OK, "Error during handle close");
+    }
+    free(items);
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(event_tests)
 RUN_TEST(basic_test)
 RUN_TEST(user_signals_test)
 RUN_TEST(wait_signals_test)
 RUN_TEST(reset_test)
 RUN_TEST(wait_many_failures_test)
+RUN_TEST(wait_many_max_items_test)
 END_TEST_CASE(event_tests)
 
 int main(int argc, char** argv) {
@@ -0,0 +1,234 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/fzl/channel-ring.h>
+
+#include <string.h>
+#include <threads.h>
+
+#include <fbl/unique_ptr.h>
+#include <lib/zx/channel.h>
+#include <lib/zx/event.h>
+#include <unittest/unittest.h>
+
+namespace {
+
+bool CreateRings(fzl::ChannelRing* ring0, fzl::ChannelRing* ring1) {
+    BEGIN_HELPER;
+    zx::channel channel0, channel1;
+    ASSERT_EQ(zx::channel::create(ZX_CHANNEL_RING, &channel0, &channel1), ZX_OK);
+    ASSERT_EQ(ring0->Init(fbl::move(channel0)), ZX_OK);
+    ASSERT_EQ(ring1->Init(fbl::move(channel1)), ZX_OK);
+    END_HELPER;
+}
+
+bool ring_requires_ring_channel() {
+    BEGIN_TEST;
+
+    zx::channel channel0, channel1;
+    ASSERT_EQ(zx::channel::create(0, &channel0, &channel1), ZX_OK);
+    fzl::ChannelRing ring;
+    EXPECT_EQ(ring.Init(fbl::move(channel0)), ZX_ERR_NOT_SUPPORTED);
+    EXPECT_EQ(ring.Write("x", 1, nullptr, 0), ZX_ERR_BAD_STATE);
+
+    END_TEST;
+}
+
+bool ring_read_write() {
+    BEGIN_TEST;
+
+    fzl::ChannelRing ring0, ring1;
+    ASSERT_TRUE(CreateRings(&ring0, &ring1));
+
+    char buf[64];
+    uint32_t actual_bytes, actual_handles;
+    EXPECT_EQ(ring1.Read(buf, nullptr, sizeof(buf), 0, &actual_bytes, &actual_handles),
+              ZX_ERR_SHOULD_WAIT);
+
+    // Both directions, including an empty message.
+    ASSERT_EQ(ring0.Write("hello", 5, nullptr, 0), ZX_OK);
+    ASSERT_EQ(ring0.Write(nullptr, 0, nullptr, 0), ZX_OK);
+    ASSERT_EQ(ring1.Write("world!", 6, nullptr, 0), ZX_OK);
+
+    ASSERT_EQ(ring1.Read(buf, nullptr, sizeof(buf), 0, &actual_bytes, &actual_handles), ZX_OK);
+    EXPECT_EQ(actual_bytes, 5u);
+    EXPECT_EQ(actual_handles, 0u);
+    EXPECT_EQ(memcmp(buf, "hello", 5), 0);
+    ASSERT_EQ(ring1.Read(buf, nullptr, sizeof(buf), 0, &actual_bytes, &actual_handles), ZX_OK);
+    EXPECT_EQ(actual_bytes, 0u);
+
+    // A short buffer leaves the message in place.
+    EXPECT_EQ(ring0.Read(buf, nullptr, 2, 0, &actual_bytes, &actual_handles),
+              ZX_ERR_BUFFER_TOO_SMALL);
+    EXPECT_EQ(actual_bytes, 6u);
+    ASSERT_EQ(ring0.Read(buf, nullptr, sizeof(buf), 0, &actual_bytes, &actual_handles), ZX_OK);
+    EXPECT_EQ(memcmp(buf, "world!", 6), 0);
+
+    END_TEST;
+}
+
+// Messages with handles and oversized messages go through the channel, but
+// keep their place in the order.
+bool ring_channel_fallback() {
+    BEGIN_TEST;
+
+    fzl::ChannelRing ring0, ring1;
+    ASSERT_TRUE(CreateRings(&ring0, &ring1));
+
+    const uint32_t kBigSize = fzl::ChannelRing::kMaxInlineBytes + 1;
+    fbl::unique_ptr<uint8_t[]> big(new uint8_t[kBigSize]);
+    memset(big.get(), 0xa5, kBigSize);
+    zx::event event;
+    ASSERT_EQ(zx::event::create(0, &event), ZX_OK);
+    zx_handle_t handle = event.release();
+
+    uint32_t id = 1;
+    ASSERT_EQ(ring0.Write(&id, sizeof(id), nullptr, 0), ZX_OK);
+    ASSERT_EQ(ring0.Write(big.get(), kBigSize, nullptr, 0), ZX_OK);
+    id = 2;
+    ASSERT_EQ(ring0.Write(&id, sizeof(id), &handle, 1), ZX_OK);
+    id = 3;
+    ASSERT_EQ(ring0.Write(&id, sizeof(id), nullptr, 0), ZX_OK);
+
+    fbl::unique_ptr<uint8_t[]> buf(new uint8_t[kBigSize]);
+    uint32_t actual_bytes, actual_handles;
+    ASSERT_EQ(ring1.Read(buf.get(), nullptr, kBigSize, 0, &actual_bytes, &actual_handles), ZX_OK);
+    EXPECT_EQ(actual_bytes, sizeof(id));
+    EXPECT_EQ(*reinterpret_cast<uint32_t*>(buf.get()), 1u);
+
+    ASSERT_EQ(ring1.Read(buf.get(), nullptr, kBigSize, 0, &actual_bytes, &actual_handles), ZX_OK);
+    EXPECT_EQ(actual_bytes, kBigSize);
+    EXPECT_EQ(memcmp(buf.get(), big.get(), kBigSize), 0);
+
+    zx_handle_t received = ZX_HANDLE_INVALID;
+    ASSERT_EQ(ring1.Read(buf.get(), &received, kBigSize, 1, &actual_bytes, &actual_handles),
+              ZX_OK);
+    EXPECT_EQ(*reinterpret_cast<uint32_t*>(buf.get()), 2u);
+    EXPECT_EQ(actual_handles, 1u);
+    EXPECT_EQ(zx_handle_close(received), ZX_OK);
+
+    ASSERT_EQ(ring1.Read(buf.get(), nullptr, kBigSize, 0, &actual_bytes, &actual_handles), ZX_OK);
+    EXPECT_EQ(*reinterpret_cast<uint32_t*>(buf.get()), 3u);
+
+    END_TEST;
+}
+
+// Fill the ring, then drain it, more than once so the indices wrap.
+bool ring_full() {
+    BEGIN_TEST;
+
+    fzl::ChannelRing ring0, ring1;
+    ASSERT_TRUE(CreateRings(&ring0, &ring1));
+
+    uint8_t buf[1000] = {};
+    for (int round = 0; round < 3; ++round) {
+        uint32_t written = 0;
+        zx_status_t status;
+        while ((status = ring0.Write(buf, sizeof(buf), nullptr, 0)) == ZX_OK) {
+            ++written;
+        }
+        EXPECT_EQ(status, ZX_ERR_SHOULD_WAIT);
+        EXPECT_GT(written, 0u);
+        EXPECT_EQ(ring0.WaitWritable(zx::time(0)), ZX_ERR_TIMED_OUT);
+
+        uint32_t read = 0;
+        uint32_t actual_bytes, actual_handles;
+        while (ring1.Read(buf, nullptr, sizeof(buf), 0, &actual_bytes, &actual_handles) ==
+               ZX_OK) {
+            ++read;
+        }
+        EXPECT_EQ(read, written);
+        EXPECT_EQ(ring0.WaitWritable(zx::time(0)), ZX_OK);
+    }
+
+    END_TEST;
+}
+
+struct EchoArgs {
+    fzl::ChannelRing* ring;
+    uint32_t count;
+};
+
+int EchoThread(void* arg) {
+    auto* args = static_cast<EchoArgs*>(arg);
+    for (uint32_t i = 0; i < args->count; ++i) {
+        uint32_t value;
+        uint32_t actual_bytes, actual_handles;
+        while (args->ring->Read(&value, nullptr, sizeof(value), 0, &actual_bytes,
+                                &actual_handles) == ZX_ERR_SHOULD_WAIT) {
+            if (args->ring->WaitReadable(zx::time::infinite()) != ZX_OK) {
+                return -1;
+            }
+        }
+        while (args->ring->Write(&value, sizeof(value), nullptr, 0) == ZX_ERR_SHOULD_WAIT) {
+            if (args->ring->WaitWritable(zx::time::infinite()) != ZX_OK) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Both sides block in turn, so every message needs a wakeup.
+bool ring_wait() {
+    BEGIN_TEST;
+
+    fzl::ChannelRing ring0, ring1;
+    ASSERT_TRUE(CreateRings(&ring0, &ring1));
+
+    constexpr uint32_t kCount = 1000;
+    EchoArgs args = {&ring1, kCount};
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, EchoThread, &args), thrd_success);
+
+    for (uint32_t i = 0; i < kCount; ++i) {
+        ASSERT_EQ(ring0.Write(&i, sizeof(i), nullptr, 0), ZX_OK);
+        uint32_t value;
+        uint32_t actual_bytes, actual_handles;
+        zx_status_t status;
+        while ((status = ring0.Read(&value, nullptr, sizeof(value), 0, &actual_bytes,
+                                    &actual_handles)) == ZX_ERR_SHOULD_WAIT) {
+            ASSERT_EQ(ring0.WaitReadable(zx::time::infinite()), ZX_OK);
+        }
+        ASSERT_EQ(status, ZX_OK);
+        EXPECT_EQ(value, i);
+    }
+
+    int result;
+    ASSERT_EQ(thrd_join(thread, &result), thrd_success);
+    EXPECT_EQ(result, 0);
+
+    END_TEST;
+}
+
+bool ring_peer_closed() {
+    BEGIN_TEST;
+
+    fzl::ChannelRing ring0;
+    {
+        fzl::ChannelRing ring1;
+        ASSERT_TRUE(CreateRings(&ring0, &ring1));
+        ASSERT_EQ(ring1.Write("x", 1, nullptr, 0), ZX_OK);
+    }
+
+    // What was written before the peer went away can still be read.
+    EXPECT_EQ(ring0.WaitReadable(zx::time::infinite()), ZX_OK);
+    char buf[1];
+    uint32_t actual_bytes, actual_handles;
+    EXPECT_EQ(ring0.Read(buf, nullptr, sizeof(buf), 0, &actual_bytes, &actual_handles), ZX_OK);
+    EXPECT_EQ(ring0.WaitReadable(zx::time::infinite()), ZX_ERR_PEER_CLOSED);
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(channel_ring_tests)
+RUN_TEST(ring_requires_ring_channel)
+RUN_TEST(ring_read_write)
+RUN_TEST(ring_channel_fallback)
+RUN_TEST(ring_full)
+RUN_TEST(ring_wait)
+RUN_TEST(ring_peer_closed)
+END_TEST_CASE(channel_ring_tests)
@@ -11,6 +11,7 @@ MODULE_TYPE := usertest
 MODULE_NAME := fzl-test
 
 MODULE_SRCS := \
+    $(LOCAL_DIR)/channel_ring_tests.cpp \
     $(LOCAL_DIR)/fdio.cpp \
     $(LOCAL_DIR)/main.c \
     $(LOCAL_DIR)/memory_probe_tests.cpp \
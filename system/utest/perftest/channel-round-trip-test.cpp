@@ -0,0 +1,102 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <mini-process/mini-process.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+// Echoes every message received on the channel passed in |arg| back to the
+// sender, until the other end is closed.
+int EchoThread(void* arg) {
+    zx_handle_t channel = static_cast<zx_handle_t>(reinterpret_cast<uintptr_t>(arg));
+    for (;;) {
+        zx_signals_t observed;
+        ZX_ASSERT(zx_object_wait_one(channel, ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
+                                     ZX_TIME_INFINITE, &observed) == ZX_OK);
+        if (!(observed & ZX_CHANNEL_READABLE)) {
+            break;
+        }
+        uint32_t msg;
+        uint32_t actual_bytes;
+        ZX_ASSERT(zx_channel_read(channel, 0, &msg, nullptr, sizeof(msg), 0,
+                                  &actual_bytes, nullptr) == ZX_OK);
+        ZX_ASSERT(zx_channel_write(channel, 0, &msg, actual_bytes, nullptr, 0) == ZX_OK);
+    }
+    zx_handle_close(channel);
+    return 0;
+}
+
+// Measures the time for a message to be sent to a thread in the same process
+// and echoed back. Both ends share an address space, so there is no address
+// space switch on the way.
+bool SameProcessTest(perftest::RepeatState* state) {
+    zx_handle_t local;
+    zx_handle_t remote;
+    ZX_ASSERT(zx_channel_create(0, &local, &remote) == ZX_OK);
+
+    thrd_t thread;
+    ZX_ASSERT(thrd_create(&thread, EchoThread,
+                          reinterpret_cast<void*>(static_cast<uintptr_t>(remote))) ==
+              thrd_success);
+
+    while (state->KeepRunning()) {
+        uint32_t msg = 0;
+        uint32_t actual_bytes;
+        ZX_ASSERT(zx_channel_write(local, 0, &msg, sizeof(msg), nullptr, 0) == ZX_OK);
+        ZX_ASSERT(zx_object_wait_one(local, ZX_CHANNEL_READABLE, ZX_TIME_INFINITE,
+                                     nullptr) == ZX_OK);
+        ZX_ASSERT(zx_channel_read(local, 0, &msg, nullptr, sizeof(msg), 0,
+                                  &actual_bytes, nullptr) == ZX_OK);
+    }
+
+    zx_handle_close(local);
+    ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+    return true;
+}
+
+// Measures the time for a message to be sent to another process and echoed
+// back. Every round trip switches address spaces twice, which is where
+// tagging TLB entries with the address space they belong to (such as with
+// x86 PCIDs) pays off. Compare against a boot with kernel.x86.pcid=false.
+bool CrossProcessTest(perftest::RepeatState* state) {
+    zx_handle_t process;
+    zx_handle_t vmar;
+    static const char kName[] = "round-trip";
+    ZX_ASSERT(zx_process_create(zx_job_default(), kName, sizeof(kName) - 1, 0,
+                                &process, &vmar) == ZX_OK);
+    zx_handle_t thread;
+    ZX_ASSERT(zx_thread_create(process, kName, sizeof(kName) - 1, 0, &thread) == ZX_OK);
+
+    zx_handle_t event;
+    ZX_ASSERT(zx_event_create(0, &event) == ZX_OK);
+    zx_handle_t control;
+    ZX_ASSERT(start_mini_process_etc(process, thread, vmar, event, &control) == ZX_OK);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(mini_process_cmd(control, MINIP_CMD_ECHO_MSG, nullptr) == ZX_OK);
+    }
+
+    ZX_ASSERT(zx_task_kill(process) == ZX_OK);
+    ZX_ASSERT(zx_object_wait_one(process, ZX_TASK_TERMINATED, ZX_TIME_INFINITE,
+                                 nullptr) == ZX_OK);
+    zx_handle_close(control);
+    zx_handle_close(thread);
+    zx_handle_close(vmar);
+    zx_handle_close(process);
+    return true;
+}
+
+void RegisterTests() {
+    perftest::RegisterTest("Channel/RoundTrip/SameProcess", SameProcessTest);
+    perftest::RegisterTest("Channel/RoundTrip/CrossProcess", CrossProcessTest);
+}
+PERFTEST_CTOR(RegisterTests);
+
+} // namespace
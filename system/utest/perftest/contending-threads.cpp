@@ -0,0 +1,37 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "contending-threads.h"
+
+#include <zircon/assert.h>
+
+void ContendingThreads::Start(uint32_t count) {
+    // |args_| must not grow once the threads hold pointers into it.
+    args_.reserve(count);
+    threads_.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        args_.push_back(ThreadArgs{this, i});
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        thrd_t thread;
+        ZX_ASSERT(thrd_create(&thread, ThreadEntry, &args_[i]) == thrd_success);
+        threads_.push_back(thread);
+    }
+}
+
+ContendingThreads::~ContendingThreads() {
+    stop_.store(true);
+    for (auto& thread : threads_) {
+        ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+    }
+}
+
+int ContendingThreads::ThreadEntry(void* arg) {
+    auto* args = static_cast<ThreadArgs*>(arg);
+    ContendingThreads* owner = args->owner;
+    while (!owner->stop_.load(std::memory_order_relaxed)) {
+        owner->body_(args->index);
+    }
+    return 0;
+}
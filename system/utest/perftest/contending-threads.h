@@ -0,0 +1,40 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <atomic>
+#include <threads.h>
+
+#include <fbl/function.h>
+#include <fbl/type_support.h>
+#include <fbl/vector.h>
+
+// Runs |body| in a loop on |count| background threads, for tests that measure
+// an operation while other threads in the process contend with it. Each
+// thread passes its index, 0 to |count - 1|, to |body|. The threads stop and
+// are joined when this is destroyed.
+class ContendingThreads {
+public:
+    template <typename Callable>
+    ContendingThreads(uint32_t count, Callable body)
+        : body_(fbl::move(body)) {
+        Start(count);
+    }
+    ~ContendingThreads();
+
+private:
+    void Start(uint32_t count);
+    struct ThreadArgs {
+        ContendingThreads* owner;
+        uint32_t index;
+    };
+
+    static int ThreadEntry(void* arg);
+
+    fbl::Function<void(uint32_t)> body_;
+    std::atomic<bool> stop_{false};
+    fbl::Vector<ThreadArgs> args_;
+    fbl::Vector<thrd_t> threads_;
+};
@@ -0,0 +1,55 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/string_printf.h>
+#include <fbl/vector.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+#include "contending-threads.h"
+
+namespace {
+
+// Measures zx_object_signal() on an event while |thread_count - 1| other
+// threads in the same process do the same on their own events. Each call
+// resolves a handle value in the process's handle table, so if lookups
+// contend with each other the per-call time grows with the thread count.
+bool HandleLookupTest(perftest::RepeatState* state, uint32_t thread_count) {
+    fbl::Vector<zx_handle_t> events;
+    events.reserve(thread_count - 1);
+    for (uint32_t i = 0; i < thread_count - 1; ++i) {
+        zx_handle_t event;
+        ZX_ASSERT(zx_event_create(0, &event) == ZX_OK);
+        events.push_back(event);
+    }
+
+    zx_handle_t event;
+    ZX_ASSERT(zx_event_create(0, &event) == ZX_OK);
+    {
+        ContendingThreads threads(thread_count - 1, [&events](uint32_t i) {
+            ZX_ASSERT(zx_object_signal(events[i], 0, 0) == ZX_OK);
+        });
+        while (state->KeepRunning()) {
+            ZX_ASSERT(zx_object_signal(event, 0, 0) == ZX_OK);
+        }
+    }
+
+    for (auto background_event : events) {
+        ZX_ASSERT(zx_handle_close(background_event) == ZX_OK);
+    }
+    ZX_ASSERT(zx_handle_close(event) == ZX_OK);
+    return true;
+}
+
+void RegisterTests() {
+    static const uint32_t kThreadCounts[] = {1, 2, 4, 8};
+    for (auto thread_count : kThreadCounts) {
+        auto name = fbl::StringPrintf("HandleLookup/%uthreads", thread_count);
+        perftest::RegisterTest(name.c_str(), HandleLookupTest, thread_count);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+} // namespace
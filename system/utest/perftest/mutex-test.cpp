@@ -4,7 +4,12 @@
 
 #include <threads.h>
 
+#include <fbl/string_printf.h>
+#include <lib/sync/mutex.h>
 #include <perftest/perftest.h>
+#include <zircon/assert.h>
+
+#include "contending-threads.h"
 
 namespace {
 
@@ -24,8 +29,38 @@ bool MutexLockUnlockTest(perftest::RepeatState* state) {
     return true;
 }
 
+// Measure the time taken to lock and unlock a sync_mutex while
+// |thread_count - 1| other threads do the same to it, with the mutex's spin
+// budget set to |spin_count|. The inverse is the per-thread lock/unlock
+// throughput under contention.
+bool ContendedLockUnlockTest(perftest::RepeatState* state, uint32_t thread_count,
+                             uint32_t spin_count) {
+    sync_mutex_t mutex(spin_count);
+    ContendingThreads threads(thread_count - 1, [&mutex](uint32_t) {
+        sync_mutex_lock(&mutex);
+        sync_mutex_unlock(&mutex);
+    });
+
+    while (state->KeepRunning()) {
+        sync_mutex_lock(&mutex);
+        sync_mutex_unlock(&mutex);
+    }
+    return true;
+}
+
 void RegisterTests() {
     perftest::RegisterTest("MutexLockUnlock", MutexLockUnlockTest);
+
+    static const uint32_t kThreadCounts[] = {2, 4, 8};
+    for (auto thread_count : kThreadCounts) {
+        auto name = fbl::StringPrintf("Mutex/Contended/%uthreads", thread_count);
+        perftest::RegisterTest(name.c_str(), ContendedLockUnlockTest, thread_count, 0u);
+
+        // the same with spinning, to see what the spin phase buys
+        name = fbl::StringPrintf("Mutex/Contended/Spin/%uthreads", thread_count);
+        perftest::RegisterTest(name.c_str(), ContendedLockUnlockTest, thread_count,
+                               SYNC_MUTEX_SHORT_SPIN_COUNT);
+    }
 }
 PERFTEST_CTOR(RegisterTests);
 
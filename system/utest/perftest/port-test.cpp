@@ -0,0 +1,62 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/algorithm.h>
+#include <fbl/string_printf.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+namespace {
+
+constexpr size_t kPacketsPerRun = 64;
+
+// Measures the time to drain kPacketsPerRun packets from a port with
+// zx_port_wait_many(), taking up to |batch| packets per call.  Dividing
+// kPacketsPerRun by the "wait" step's time gives packets/sec.
+bool PortWaitManyTest(perftest::RepeatState* state, size_t batch) {
+    state->DeclareStep("queue");
+    state->DeclareStep("wait");
+
+    zx_handle_t port;
+    ZX_ASSERT(zx_port_create(0, &port) == ZX_OK);
+
+    zx_port_packet_t packets[kPacketsPerRun];
+    while (state->KeepRunning()) {
+        for (size_t i = 0; i < kPacketsPerRun; ++i) {
+            zx_port_packet_t packet = {};
+            packet.key = i;
+            packet.type = ZX_PKT_TYPE_USER;
+            ZX_ASSERT(zx_port_queue(port, &packet) == ZX_OK);
+        }
+        state->NextStep();
+
+        size_t remaining = kPacketsPerRun;
+        while (remaining > 0) {
+            size_t actual;
+            ZX_ASSERT(zx_port_wait_many(port, 0, packets, fbl::min(batch, remaining),
+                                        &actual) == ZX_OK);
+            remaining -= actual;
+        }
+    }
+
+    zx_handle_close(port);
+    return true;
+}
+
+void RegisterTests() {
+    static const size_t kBatchSizes[] = {
+        1,
+        8,
+        64,
+    };
+    for (auto batch : kBatchSizes) {
+        auto name = fbl::StringPrintf("Port/WaitMany/%zupackets", batch);
+        perftest::RegisterTest(name.c_str(), PortWaitManyTest, batch);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
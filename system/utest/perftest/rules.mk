@@ -9,17 +9,23 @@ MODULE := $(LOCAL_DIR)
 MODULE_TYPE := usertest
 
 MODULE_SRCS += \
+    $(LOCAL_DIR)/channel-round-trip-test.cpp \
     $(LOCAL_DIR)/clock-test.cpp \
+    $(LOCAL_DIR)/contending-threads.cpp \
     $(LOCAL_DIR)/handle-creation-test.cpp \
+    $(LOCAL_DIR)/handle-lookup-test.cpp \
     $(LOCAL_DIR)/malloc-test.cpp \
     $(LOCAL_DIR)/memcpy-test.cpp \
     $(LOCAL_DIR)/mutex-test.cpp \
     $(LOCAL_DIR)/null-test.cpp \
+    $(LOCAL_DIR)/port-test.cpp \
     $(LOCAL_DIR)/process-test.cpp \
     $(LOCAL_DIR)/results-test.cpp \
     $(LOCAL_DIR)/runner-test.cpp \
     $(LOCAL_DIR)/sleep-test.cpp \
     $(LOCAL_DIR)/syscalls-test.cpp \
+    $(LOCAL_DIR)/vmar-fault-test.cpp \
+    $(LOCAL_DIR)/wait-many-test.cpp \
 
 MODULE_NAME := perf-test
 
@@ -30,6 +36,7 @@ MODULE_STATIC_LIBS := \
     system/ulib/async.cpp \
     system/ulib/fbl \
     system/ulib/perftest \
+    system/ulib/sync \
     system/ulib/trace \
     system/ulib/trace-provider \
     system/ulib/zx \
@@ -40,6 +47,7 @@ MODULE_LIBS := \
     system/ulib/c \
     system/ulib/fdio \
     system/ulib/launchpad \
+    system/ulib/mini-process \
     system/ulib/trace-engine \
     system/ulib/unittest \
     system/ulib/zircon \
@@ -0,0 +1,97 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+
+#include <fbl/string_printf.h>
+#include <fbl/type_support.h>
+#include <lib/zx/process.h>
+#include <lib/zx/vmar.h>
+#include <lib/zx/vmo.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+
+namespace {
+
+constexpr size_t kScanSize = 4 * 1024 * 1024;
+
+uint64_t GetPageFaults() {
+    zx_info_task_stats_t info;
+    ZX_ASSERT(zx::process::self()->get_info(ZX_INFO_TASK_STATS, &info, sizeof(info),
+                                            nullptr, nullptr) == ZX_OK);
+    return info.page_faults;
+}
+
+// Test the cost of reading one byte from every page of a freshly mapped VMO,
+// which is dominated by the page faults taken. |fault_around| is passed to
+// ZX_VM_FAULT_AROUND(), or is -1 to use the kernel's default. If |clone| is
+// true, the pages are read through a copy-on-write clone of the VMO.
+//
+// The number of faults taken per scan is printed once the test has run.
+bool SequentialReadTest(perftest::RepeatState* state, int fault_around, bool clone) {
+    state->SetBytesProcessedPerRun(kScanSize);
+
+    zx::vmo vmo;
+    ZX_ASSERT(zx::vmo::create(kScanSize, 0, &vmo) == ZX_OK);
+    ZX_ASSERT(vmo.op_range(ZX_VMO_OP_COMMIT, 0, kScanSize, nullptr, 0) == ZX_OK);
+    if (clone) {
+        zx::vmo child;
+        ZX_ASSERT(vmo.clone(ZX_VMO_CLONE_COPY_ON_WRITE, 0, kScanSize, &child) == ZX_OK);
+        vmo = fbl::move(child);
+    }
+
+    zx_vm_option_t options = ZX_VM_PERM_READ;
+    if (fault_around >= 0) {
+        options |= ZX_VM_FAULT_AROUND(fault_around);
+    }
+
+    state->DeclareStep("map");
+    state->DeclareStep("scan");
+    state->DeclareStep("unmap");
+
+    uint64_t runs = 0;
+    uint64_t start_faults = GetPageFaults();
+    while (state->KeepRunning()) {
+        uintptr_t addr;
+        ZX_ASSERT(zx::vmar::root_self()->map(0, vmo, 0, kScanSize, options, &addr) == ZX_OK);
+        state->NextStep();
+
+        auto ptr = reinterpret_cast<const volatile uint8_t*>(addr);
+        for (size_t off = 0; off < kScanSize; off += PAGE_SIZE) {
+            (void)ptr[off];
+        }
+        runs++;
+        state->NextStep();
+
+        ZX_ASSERT(zx::vmar::root_self()->unmap(addr, kScanSize) == ZX_OK);
+    }
+
+    // nothing else in the loop touches unmapped memory, so the scans account
+    // for all of the faults
+    uint64_t faults = GetPageFaults() - start_faults;
+    if (runs > 0) {
+        printf("%s, fault-around %d: %" PRIu64 " faults per %zu page scan\n",
+               clone ? "clone" : "vmo", fault_around, faults / runs, kScanSize / PAGE_SIZE);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    static const int kFaultAround[] = {-1, 0, 4, 9};
+    for (bool clone : {false, true}) {
+        for (int fault_around : kFaultAround) {
+            auto name = (fault_around < 0)
+                ? fbl::StringPrintf("Vmar/SequentialRead/%s/DefaultFaultAround",
+                                    clone ? "Clone" : "Vmo")
+                : fbl::StringPrintf("Vmar/SequentialRead/%s/FaultAround%d",
+                                    clone ? "Clone" : "Vmo", fault_around);
+            perftest::RegisterTest(name.c_str(), SequentialReadTest, fault_around, clone);
+        }
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
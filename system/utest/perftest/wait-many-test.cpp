@@ -0,0 +1,111 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <fbl/string_printf.h>
+#include <fbl/vector.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+// Creates |count| events and wait items for them.
+fbl::Vector<zx_wait_item_t> CreateItems(size_t count) {
+    fbl::Vector<zx_wait_item_t> items;
+    items.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        zx_wait_item_t item = {};
+        ZX_ASSERT(zx_event_create(0, &item.handle) == ZX_OK);
+        item.waitfor = ZX_EVENT_SIGNALED;
+        items.push_back(item);
+    }
+    return items;
+}
+
+void CloseItems(const fbl::Vector<zx_wait_item_t>& items) {
+    for (const auto& item : items) {
+        ZX_ASSERT(zx_handle_close(item.handle) == ZX_OK);
+    }
+}
+
+// Measures zx_object_wait_many() on |count| handles when the last one is
+// already signaled, so the call never blocks.  This is the cost of setting
+// up and tearing down the wait on every handle.
+bool WaitManySignaledTest(perftest::RepeatState* state, size_t count) {
+    fbl::Vector<zx_wait_item_t> items = CreateItems(count);
+    ZX_ASSERT(zx_object_signal(items[count - 1].handle, 0, ZX_EVENT_SIGNALED) == ZX_OK);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(zx_object_wait_many(items.get(), count, ZX_TIME_INFINITE) == ZX_OK);
+    }
+
+    CloseItems(items);
+    return true;
+}
+
+struct WakerArgs {
+    zx_handle_t event;
+    zx_handle_t ack;
+};
+
+// Signals |event| each time |ack| is signaled, until |ack| is closed.
+int WakerThread(void* arg) {
+    auto* args = static_cast<WakerArgs*>(arg);
+    for (;;) {
+        if (zx_object_wait_one(args->ack, ZX_EVENT_SIGNALED, ZX_TIME_INFINITE,
+                               nullptr) != ZX_OK) {
+            break;
+        }
+        ZX_ASSERT(zx_object_signal(args->ack, ZX_EVENT_SIGNALED, 0) == ZX_OK);
+        ZX_ASSERT(zx_object_signal(args->event, 0, ZX_EVENT_SIGNALED) == ZX_OK);
+    }
+    return 0;
+}
+
+// Measures zx_object_wait_many() on |count| handles where another thread
+// signals the last handle, so the waiter typically blocks and is unblocked.
+bool WaitManyWakeTest(perftest::RepeatState* state, size_t count) {
+    fbl::Vector<zx_wait_item_t> items = CreateItems(count);
+
+    WakerArgs args;
+    args.event = items[count - 1].handle;
+    ZX_ASSERT(zx_event_create(0, &args.ack) == ZX_OK);
+    zx_handle_t ack;
+    ZX_ASSERT(zx_handle_duplicate(args.ack, ZX_RIGHT_SAME_RIGHTS, &ack) == ZX_OK);
+
+    thrd_t thread;
+    ZX_ASSERT(thrd_create(&thread, WakerThread, &args) == thrd_success);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(zx_object_signal(ack, 0, ZX_EVENT_SIGNALED) == ZX_OK);
+        ZX_ASSERT(zx_object_wait_many(items.get(), count, ZX_TIME_INFINITE) == ZX_OK);
+        ZX_ASSERT(zx_object_signal(args.event, ZX_EVENT_SIGNALED, 0) == ZX_OK);
+    }
+
+    // Closing the waker's handle to |ack| cancels its wait.
+    ZX_ASSERT(zx_handle_close(args.ack) == ZX_OK);
+    ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+    ZX_ASSERT(zx_handle_close(ack) == ZX_OK);
+    CloseItems(items);
+    return true;
+}
+
+void RegisterTests() {
+    static const size_t kCounts[] = {
+        16,
+        256,
+        1024,
+    };
+    for (auto count : kCounts) {
+        auto name = fbl::StringPrintf("WaitMany/Signaled/%zuhandles", count);
+        perftest::RegisterTest(name.c_str(), WaitManySignaledTest, count);
+        name = fbl::StringPrintf("WaitMany/Wake/%zuhandles", count);
+        perftest::RegisterTest(name.c_str(), WaitManyWakeTest, count);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
@@ -1432,6 +1432,42 @@ bool vmo_decommit_misaligned_test() {
     END_TEST;
 }
 
+bool vmo_lock_unlock_test() {
+    BEGIN_TEST;
+
+    const size_t size = PAGE_SIZE * 2;
+    zx_handle_t vmo;
+    ASSERT_EQ(ZX_OK, zx_vmo_create(size, 0, &vmo), "vm_object_create");
+
+    // only the whole vmo can be unlocked
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, zx_vmo_op_range(vmo, ZX_VMO_OP_UNLOCK, 0, PAGE_SIZE, NULL, 0),
+              "unlocking part of the vmo");
+    EXPECT_EQ(ZX_OK, zx_vmo_op_range(vmo, ZX_VMO_OP_UNLOCK, 0, size, NULL, 0), "unlock");
+
+    // whether the pages were discarded depends on memory pressure, but if
+    // they were the vmo reads as zeros
+    uint32_t discarded = UINT32_MAX;
+    EXPECT_EQ(ZX_OK, zx_vmo_op_range(vmo, ZX_VMO_OP_LOCK, 0, size, &discarded,
+                                     sizeof(discarded)), "lock");
+    EXPECT_TRUE(discarded == 0 || discarded == 1, "discarded result");
+
+    zx_handle_t read_only;
+    ASSERT_EQ(ZX_OK, zx_handle_duplicate(vmo, ZX_RIGHT_READ, &read_only), "duplicate");
+    EXPECT_EQ(ZX_ERR_ACCESS_DENIED, zx_vmo_op_range(read_only, ZX_VMO_OP_UNLOCK, 0, size, NULL, 0),
+              "unlock without write right");
+    EXPECT_EQ(ZX_OK, zx_handle_close(read_only), "close handle");
+
+    // a clone's missing pages would read through to its parent
+    zx_handle_t clone;
+    ASSERT_EQ(ZX_OK, zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE, 0, size, &clone), "vm_clone");
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, zx_vmo_op_range(clone, ZX_VMO_OP_UNLOCK, 0, size, NULL, 0),
+              "unlocking a clone");
+    EXPECT_EQ(ZX_OK, zx_handle_close(clone), "close handle");
+
+    EXPECT_EQ(ZX_OK, zx_handle_close(vmo), "close handle");
+    END_TEST;
+}
+
 // test set 4: deal with clones with nonzero offsets and offsets that extend beyond the original
 bool vmo_clone_test_4() {
     BEGIN_TEST;
@@ -1785,6 +1821,7 @@ RUN_TEST(vmo_clone_size_align_test);
 RUN_TEST(vmo_rights_test);
 RUN_TEST(vmo_commit_test);
 RUN_TEST(vmo_decommit_misaligned_test);
+RUN_TEST(vmo_lock_unlock_test);
 RUN_TEST(vmo_cache_test);
 RUN_TEST_PERFORMANCE(vmo_cache_map_test);
 RUN_TEST(vmo_cache_op_test);
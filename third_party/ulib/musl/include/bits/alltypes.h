@@ -467,7 +467,7 @@ typedef struct
     __attribute__((__capability__("mutex")))
 #endif
 {
-    int __i[1];
+    int __i[2];
 } mtx_t;
 #define __DEFINED_mtx_t
 #endif